@@ -346,6 +346,45 @@ GL_PROTO_ARG(pointer, const GLvoid *))
 GL_PROTO_INVOKE(VertexAttribPointer, void, (index, size, type, normalized, stride, pointer))
 GL_PROTO_END()
 
+GL_PROTO_BEGIN(GenBuffers, void, CORE_1_5)
+GL_PROTO_ARG_LIST(
+GL_PROTO_ARG(n, GLsizei),
+GL_PROTO_ARG(buffers, GLuint *))
+GL_PROTO_INVOKE(GenBuffers, void, (n, buffers))
+GL_PROTO_END()
+
+GL_PROTO_BEGIN(DeleteBuffers, void, CORE_1_5)
+GL_PROTO_ARG_LIST(
+GL_PROTO_ARG(n, GLsizei),
+GL_PROTO_ARG(buffers, const GLuint *))
+GL_PROTO_INVOKE(DeleteBuffers, void, (n, buffers))
+GL_PROTO_END()
+
+GL_PROTO_BEGIN(BindBuffer, void, CORE_1_5)
+GL_PROTO_ARG_LIST(
+GL_PROTO_ARG(target, GLenum),
+GL_PROTO_ARG(buffer, GLuint))
+GL_PROTO_INVOKE(BindBuffer, void, (target, buffer))
+GL_PROTO_END()
+
+GL_PROTO_BEGIN(BufferData, void, CORE_1_5)
+GL_PROTO_ARG_LIST(
+GL_PROTO_ARG(target, GLenum),
+GL_PROTO_ARG(size, GLsizeiptr),
+GL_PROTO_ARG(data, const GLvoid *),
+GL_PROTO_ARG(usage, GLenum))
+GL_PROTO_INVOKE(BufferData, void, (target, size, data, usage))
+GL_PROTO_END()
+
+GL_PROTO_BEGIN(BufferSubData, void, CORE_1_5)
+GL_PROTO_ARG_LIST(
+GL_PROTO_ARG(target, GLenum),
+GL_PROTO_ARG(offset, GLintptr),
+GL_PROTO_ARG(size, GLsizeiptr),
+GL_PROTO_ARG(data, const GLvoid *))
+GL_PROTO_INVOKE(BufferSubData, void, (target, offset, size, data))
+GL_PROTO_END()
+
 GL_PROTO_BEGIN(DrawArrays, void, CORE_1_1)
 GL_PROTO_ARG_LIST(
 GL_PROTO_ARG(mode, GLenum),
@@ -446,9 +485,8 @@ GL_PROTO_ARG(width, GLsizei),
 GL_PROTO_ARG(height, GLsizei),
 GL_PROTO_ARG(format, GLenum),
 GL_PROTO_ARG(type, GLenum),
-GL_PROTO_ARG(UNUSED, GLuint),
 GL_PROTO_ARG(pixels, const GLvoid *))
-GL_PROTO_INVOKE(TexSubImage2D, void, (target, level, xoffset, yoffset, width, height, format, type, UNUSED, pixels))
+GL_PROTO_INVOKE(TexSubImage2D, void, (target, level, xoffset, yoffset, width, height, format, type, pixels))
 GL_PROTO_END()
 
 GL_PROTO_BEGIN(PixelStoref, void, CORE_1_0)
@@ -747,6 +785,7 @@ GL_PROTO_END()
 GL_DEFINE_EXTENSION(CORE_1_0)
 GL_DEFINE_EXTENSION(CORE_1_1)
 GL_DEFINE_EXTENSION(CORE_1_3)
+GL_DEFINE_EXTENSION(CORE_1_5)
 GL_DEFINE_EXTENSION(CORE_2_0)
 GL_DEFINE_EXTENSION(OES_EGL_image)
 
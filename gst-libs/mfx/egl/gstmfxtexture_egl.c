@@ -30,9 +30,28 @@
 #include "gstmfxdisplay_egl_priv.h"
 #include "gstmfxprimebufferproxy.h"
 #include "gstmfxutils_vaapi.h"
+#include "gstmfxsurfacepool.h"
+#include "gstmfxsurface_priv.h"
 
 #define DEBUG 1
 
+/* Number of EGL images kept for surfaces that do not come from a pool */
+#define DEFAULT_CACHE_SIZE 16
+
+typedef struct _TextureCacheEntry TextureCacheEntry;
+
+/* EGL image and texture imported from the PRIME export of a surface */
+struct _TextureCacheEntry
+{
+  GstMfxID surface_id;
+  GstMfxPrimeBufferProxy *proxy;
+  EGLImageKHR egl_image;
+  guint texture_id;
+  guint width;
+  guint height;
+  GList link;
+};
+
 /**
  * GstMfxTextureEGL:
  *
@@ -47,11 +66,21 @@ struct _GstMfxTextureEGL
   GstMfxDisplay *display;
 
   EglContext *egl_context;
-  EGLImageKHR egl_image;
   guint gl_target;
   guint gl_format;
   guint width;
   guint height;
+
+  /* Imported surfaces, keyed by VASurfaceID, least recently used first */
+  GHashTable *cache;
+  GQueue cache_lru;
+  /* Detached PRIME exports last swept from the cache */
+  guint detach_count;
+
+  /* Texture receiving uploads of system memory surfaces */
+  guint upload_texture_id;
+  guint upload_width;
+  guint upload_height;
 };
 
 typedef struct
@@ -62,78 +91,230 @@ typedef struct
   gboolean success;             /* result */
 } UploadSurfaceArgs;
 
-static gboolean
-do_bind_texture_unlocked (GstMfxTextureEGL * texture,
-    GstMfxSurface * surface)
+static TextureCacheEntry *
+cache_entry_new (GstMfxTextureEGL * texture, GstMfxSurface * surface,
+    GstMfxPrimeBufferProxy * proxy)
 {
   EglContext *const ctx = texture->egl_context;
   EglVTable *const vtable = egl_context_get_vtable (ctx, FALSE);
-  GstMfxPrimeBufferProxy *buffer_proxy;
+  TextureCacheEntry *entry;
   VaapiImage *image;
+  GLint attribs[23], *attrib;
 
-  if (gst_mfx_surface_has_video_memory (surface)) {
-    GLint attribs[23], *attrib;
+  image = gst_mfx_prime_buffer_proxy_get_vaapi_image (proxy);
+  if (!image)
+    return NULL;
 
-    buffer_proxy = gst_mfx_prime_buffer_proxy_new_from_surface (surface);
-    if (!buffer_proxy)
-      return FALSE;
+  entry = g_slice_new0 (TextureCacheEntry);
+  entry->surface_id = GST_MFX_SURFACE_ID (surface);
+  entry->proxy = gst_mfx_prime_buffer_proxy_ref (proxy);
+  entry->egl_image = EGL_NO_IMAGE_KHR;
+  entry->width = vaapi_image_get_width (image);
+  entry->height = vaapi_image_get_height (image);
+  entry->link.data = entry;
+
+  attrib = attribs;
+  *attrib++ = EGL_LINUX_DRM_FOURCC_EXT;
+  *attrib++ = DRM_FORMAT_ARGB8888;
+  *attrib++ = EGL_WIDTH;
+  *attrib++ = entry->width;
+  *attrib++ = EGL_HEIGHT;
+  *attrib++ = entry->height;
+  *attrib++ = EGL_DMA_BUF_PLANE0_FD_EXT;
+  *attrib++ = GST_MFX_PRIME_BUFFER_PROXY_HANDLE (proxy);
+  *attrib++ = EGL_DMA_BUF_PLANE0_OFFSET_EXT;
+  *attrib++ = vaapi_image_get_offset (image, 0);
+  *attrib++ = EGL_DMA_BUF_PLANE0_PITCH_EXT;
+  *attrib++ = vaapi_image_get_pitch (image, 0);
+  *attrib++ = EGL_NONE;
+  vaapi_image_unref (image);
+
+  entry->egl_image =
+      vtable->eglCreateImageKHR (ctx->display->base.handle.p, EGL_NO_CONTEXT,
+        EGL_LINUX_DMA_BUF_EXT, (EGLClientBuffer) NULL, attribs);
+  if (!entry->egl_image) {
+    GST_ERROR ("failed to import VA buffer (RGBA) into EGL image");
+    goto error;
+  }
 
-    image = gst_mfx_prime_buffer_proxy_get_vaapi_image (buffer_proxy);
-
-    texture->width = vaapi_image_get_width (image);
-    texture->height = vaapi_image_get_height (image);
-
-    attrib = attribs;
-    *attrib++ = EGL_LINUX_DRM_FOURCC_EXT;
-    *attrib++ = DRM_FORMAT_ARGB8888;
-    *attrib++ = EGL_WIDTH;
-    *attrib++ = texture->width;
-    *attrib++ = EGL_HEIGHT;
-    *attrib++ = texture->height;
-    *attrib++ = EGL_DMA_BUF_PLANE0_FD_EXT;
-    *attrib++ = GST_MFX_PRIME_BUFFER_PROXY_HANDLE (buffer_proxy);
-    *attrib++ = EGL_DMA_BUF_PLANE0_OFFSET_EXT;
-    *attrib++ = vaapi_image_get_offset (image, 0);
-    *attrib++ = EGL_DMA_BUF_PLANE0_PITCH_EXT;
-    *attrib++ = vaapi_image_get_pitch (image, 0);
-    *attrib++ = EGL_NONE;
-
-    texture->egl_image =
-        vtable->eglCreateImageKHR (ctx->display->base.handle.p, EGL_NO_CONTEXT,
-          EGL_LINUX_DMA_BUF_EXT, (EGLClientBuffer) NULL, attribs);
-    if (!texture->egl_image) {
-      GST_ERROR ("failed to import VA buffer (RGBA) into EGL image");
-      goto error;
-    }
+  entry->texture_id = egl_create_texture_from_egl_image (ctx,
+      texture->gl_target, entry->egl_image);
+  if (!entry->texture_id) {
+    GST_ERROR ("failed to create texture from EGL image");
+    goto error;
+  }
+  return entry;
+
+error:
+  {
+    if (entry->egl_image)
+      vtable->eglDestroyImageKHR (ctx->display->base.handle.p,
+          entry->egl_image);
+    gst_mfx_prime_buffer_proxy_unref (entry->proxy);
+    g_slice_free (TextureCacheEntry, entry);
+    return NULL;
+  }
+}
+
+static void
+cache_entry_free (GstMfxTextureEGL * texture, TextureCacheEntry * entry)
+{
+  EglContext *const ctx = texture->egl_context;
+  EglVTable *const vtable = egl_context_get_vtable (ctx, FALSE);
+
+  if (entry->texture_id)
+    egl_destroy_texture (ctx, entry->texture_id);
+  if (entry->egl_image != EGL_NO_IMAGE_KHR)
+    vtable->eglDestroyImageKHR (ctx->display->base.handle.p,
+        entry->egl_image);
+  gst_mfx_prime_buffer_proxy_unref (entry->proxy);
+  g_slice_free (TextureCacheEntry, entry);
+}
+
+static void
+cache_remove_entry (GstMfxTextureEGL * texture, TextureCacheEntry * entry)
+{
+  g_hash_table_remove (texture->cache, GUINT_TO_POINTER (entry->surface_id));
+  g_queue_unlink (&texture->cache_lru, &entry->link);
+  cache_entry_free (texture, entry);
+}
+
+/* Drops the EGL images of surfaces that were destroyed, e.g. along with
+ * their pool, whenever any was */
+static void
+cache_sweep (GstMfxTextureEGL * texture)
+{
+  const guint detach_count = gst_mfx_prime_buffer_proxy_get_detach_count ();
+  TextureCacheEntry *entry;
+  GList *l, *next;
+
+  if (detach_count == texture->detach_count)
+    return;
+  texture->detach_count = detach_count;
+
+  for (l = texture->cache_lru.head; l; l = next) {
+    next = l->next;
+    entry = l->data;
+    if (gst_mfx_prime_buffer_proxy_is_detached (entry->proxy))
+      cache_remove_entry (texture, entry);
+  }
+}
 
-    texture->texture_id =
-        egl_create_texture_from_egl_image (texture->egl_context,
-          texture->gl_target, texture->egl_image);
-    if (!texture->texture_id) {
-      GST_ERROR ("failed to create texture from EGL image");
-      goto error;
+/* Keeps one EGL image per surface of the pool that is cycled through,
+ * so that steady-state playback does not import anything */
+static guint
+cache_get_max_size (GstMfxSurface * surface)
+{
+  if (surface->pool)
+    return MAX (gst_mfx_surface_pool_get_size (surface->pool), 1);
+  return DEFAULT_CACHE_SIZE;
+}
+
+static TextureCacheEntry *
+cache_lookup (GstMfxTextureEGL * texture, GstMfxSurface * surface)
+{
+  gpointer surface_id = GUINT_TO_POINTER (GST_MFX_SURFACE_ID (surface));
+  GstMfxPrimeBufferProxy *proxy;
+  TextureCacheEntry *entry;
+  guint max_size;
+
+  proxy = gst_mfx_prime_buffer_proxy_get_from_surface (surface);
+  if (!proxy)
+    return NULL;
+
+  cache_sweep (texture);
+  entry = g_hash_table_lookup (texture->cache, surface_id);
+  /* A different export means the surface pool was torn down and the
+   * VASurfaceID reused since the EGL image was created */
+  if (entry && entry->proxy != proxy) {
+    cache_remove_entry (texture, entry);
+    entry = NULL;
+  }
+
+  if (entry) {
+    g_queue_unlink (&texture->cache_lru, &entry->link);
+    g_queue_push_tail_link (&texture->cache_lru, &entry->link);
+  } else {
+    entry = cache_entry_new (texture, surface, proxy);
+    if (entry) {
+      g_hash_table_insert (texture->cache, surface_id, entry);
+      g_queue_push_tail_link (&texture->cache_lru, &entry->link);
+
+      max_size = cache_get_max_size (surface);
+      while (texture->cache_lru.length > max_size)
+        cache_remove_entry (texture, texture->cache_lru.head->data);
     }
+  }
+  gst_mfx_prime_buffer_proxy_unref (proxy);
+  return entry;
+}
 
-    vaapi_image_unref (image);
-    gst_mfx_prime_buffer_proxy_unref (buffer_proxy);
+static void
+cache_clear (GstMfxTextureEGL * texture)
+{
+  while (texture->cache_lru.head)
+    cache_remove_entry (texture, texture->cache_lru.head->data);
+}
+
+static gboolean
+upload_surface (GstMfxTextureEGL * texture, GstMfxSurface * surface)
+{
+  EglContext *const ctx = texture->egl_context;
+  EglVTable *const vtable = egl_context_get_vtable (ctx, FALSE);
+  guint width, height;
+
+  /* Upload whole rows so that the pitch does not need to be specified,
+   * and let the renderer crop through texture coordinates */
+  width = gst_mfx_surface_get_pitch (surface, 0) / 4;
+  height = gst_mfx_surface_get_height (surface);
+
+  if (texture->upload_texture_id && texture->upload_width == width
+      && texture->upload_height == height) {
+    vtable->glBindTexture (GL_TEXTURE_2D, texture->upload_texture_id);
+    vtable->glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, width, height,
+        GL_BGRA_EXT, GL_UNSIGNED_BYTE, gst_mfx_surface_get_plane (surface, 0));
+    vtable->glBindTexture (GL_TEXTURE_2D, 0);
   } else {
-    texture->texture_id =
-        egl_create_texture_from_data (texture->egl_context, GL_TEXTURE_2D,
-          GL_BGRA_EXT, texture->width, texture->height,
-          gst_mfx_surface_get_plane (surface, 0));
-    if (!texture->texture_id) {
+    if (texture->upload_texture_id)
+      egl_destroy_texture (ctx, texture->upload_texture_id);
+
+    texture->upload_texture_id = egl_create_texture_from_data (ctx,
+        GL_TEXTURE_2D, GL_BGRA_EXT, width, height,
+        gst_mfx_surface_get_plane (surface, 0));
+    if (!texture->upload_texture_id) {
       GST_ERROR ("failed to create texture from raw data");
       return FALSE;
     }
+    texture->upload_width = width;
+    texture->upload_height = height;
   }
 
+  texture->texture_id = texture->upload_texture_id;
+  texture->width = width;
+  texture->height = height;
   return TRUE;
-error:
-  {
-    vaapi_image_unref (image);
-    gst_mfx_prime_buffer_proxy_unref (buffer_proxy);
+}
+
+static gboolean
+do_bind_texture_unlocked (GstMfxTextureEGL * texture,
+    GstMfxSurface * surface)
+{
+  TextureCacheEntry *entry;
+
+  if (!gst_mfx_surface_sync (surface))
     return FALSE;
-  }
+
+  if (!gst_mfx_surface_has_video_memory (surface))
+    return upload_surface (texture, surface);
+
+  entry = cache_lookup (texture, surface);
+  if (!entry)
+    return FALSE;
+
+  texture->texture_id = entry->texture_id;
+  texture->width = entry->width;
+  texture->height = entry->height;
+  return TRUE;
 }
 
 static void
@@ -152,28 +333,16 @@ do_bind_texture (UploadSurfaceArgs * args)
   GST_MFX_DISPLAY_UNLOCK (texture->display);
 }
 
-static void
-destroy_objects (GstMfxTextureEGL * texture)
-{
-  EglContext *const ctx = texture->egl_context;
-  EglVTable *const vtable = egl_context_get_vtable (ctx, FALSE);
-
-  if (texture->egl_image != EGL_NO_IMAGE_KHR) {
-    vtable->eglDestroyImageKHR (ctx->display->base.handle.p,
-        texture->egl_image);
-    texture->egl_image = EGL_NO_IMAGE_KHR;
-  }
-}
-
 static void
 do_destroy_texture_unlocked (GstMfxTextureEGL * texture)
 {
-  destroy_objects (texture);
+  cache_clear (texture);
 
-  if (texture->texture_id) {
-    egl_destroy_texture (texture->egl_context, texture->texture_id);
-    texture->texture_id = 0;
+  if (texture->upload_texture_id) {
+    egl_destroy_texture (texture->egl_context, texture->upload_texture_id);
+    texture->upload_texture_id = 0;
   }
+  texture->texture_id = 0;
 }
 
 static void
@@ -206,6 +375,8 @@ gst_mfx_texture_egl_init (GstMfxTextureEGL * texture, GstMfxDisplay * display,
   texture->gl_format = format;
   texture->width = width;
   texture->height = height;
+  texture->cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_queue_init (&texture->cache_lru);
 
   egl_object_replace (&texture->egl_context,
       GST_MFX_DISPLAY_EGL_CONTEXT (texture->display));
@@ -216,6 +387,7 @@ gst_mfx_texture_egl_finalize (GstMfxTextureEGL * texture)
 {
   gst_mfx_texture_egl_destroy (texture);
 
+  g_hash_table_unref (texture->cache);
   gst_mfx_display_unref (texture->display);
 }
 
@@ -335,12 +507,49 @@ gst_mfx_texture_egl_get_height (GstMfxTextureEGL * texture)
   return texture->height;
 }
 
+/**
+ * gst_mfx_texture_egl_put_surface:
+ * @texture: a #GstMfxTextureEGL
+ * @surface: the #GstMfxSurface to display
+ *
+ * Binds @texture to the contents of @surface. Surfaces in video memory
+ * are imported as EGL images once and kept around, keyed by surface, so
+ * that displaying a pooled surface again only rebinds the texture. The
+ * cache holds as many entries as the pool of @surface has surfaces, and
+ * evicts the least recently displayed one beyond that.
+ *
+ * Return value: %TRUE on success
+ */
 gboolean
 gst_mfx_texture_egl_put_surface (GstMfxTextureEGL * texture,
     GstMfxSurface * surface)
 {
   UploadSurfaceArgs args = { texture, surface };
 
+  g_return_val_if_fail (texture != NULL, FALSE);
+  g_return_val_if_fail (surface != NULL, FALSE);
+
   return egl_context_run (texture->egl_context,
       (EglContextRunFunc) do_bind_texture, &args) && args.success;
 }
+
+/**
+ * gst_mfx_texture_egl_put_surface_unlocked:
+ * @texture: a #GstMfxTextureEGL
+ * @surface: the #GstMfxSurface to display
+ *
+ * Same as gst_mfx_texture_egl_put_surface(), for callers already
+ * running on the EGL thread with the display locked and the texture
+ * context current.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_mfx_texture_egl_put_surface_unlocked (GstMfxTextureEGL * texture,
+    GstMfxSurface * surface)
+{
+  g_return_val_if_fail (texture != NULL, FALSE);
+  g_return_val_if_fail (surface != NULL, FALSE);
+
+  return do_bind_texture_unlocked (texture, surface);
+}
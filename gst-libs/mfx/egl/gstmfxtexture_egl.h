@@ -77,6 +77,10 @@ gboolean
 gst_mfx_texture_egl_put_surface (GstMfxTextureEGL * texture,
     GstMfxSurface * surface);
 
+gboolean
+gst_mfx_texture_egl_put_surface_unlocked (GstMfxTextureEGL * texture,
+    GstMfxSurface * surface);
+
 G_END_DECLS
 
 #endif /* GST_MFX_TEXTURE_EGL_H */
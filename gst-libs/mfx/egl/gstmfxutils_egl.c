@@ -332,6 +332,7 @@ egl_vtable_load_gl_symbols(EglVTable * vtable, EGLDisplay display)
   vtable->has_GL_CORE_1_0 = 1;
   vtable->has_GL_CORE_1_1 = 1;
   vtable->has_GL_CORE_1_3 = 1;
+  vtable->has_GL_CORE_1_5 = 1;
   vtable->has_GL_CORE_2_0 = 1;
 
 #define GL_DEFINE_EXTENSION(NAME) do {                  \
@@ -353,6 +354,7 @@ egl_vtable_load_gl_symbols(EglVTable * vtable, EGLDisplay display)
   --vtable->has_GL_CORE_1_0;
   --vtable->has_GL_CORE_1_1;
   --vtable->has_GL_CORE_1_3;
+  --vtable->has_GL_CORE_1_5;
   --vtable->has_GL_CORE_2_0;
 
   vtable->glEGLImageTargetTexture2DOES =
@@ -53,6 +53,13 @@ struct _GstMfxWindowEGL
   EglVTable *egl_vtable;
   EglProgram *render_program;
   gfloat render_projection[16];
+
+  /* Interleaved position/texcoord quad, rebuilt when the layout changes */
+  GLuint vertex_buffer;
+  GstMfxRectangle vertex_src_rect;
+  GstMfxRectangle vertex_dst_rect;
+  guint vertex_tex_width;
+  guint vertex_tex_height;
 };
 
 struct _GstMfxWindowEGLClass
@@ -117,6 +124,11 @@ ensure_texture (GstMfxWindowEGL * window, guint width, guint height)
   GstMfxTextureEGL *texture;
   GstMfxDisplay *display = GST_MFX_WINDOW (window)->display;
 
+  /* The texture keeps the EGL images of the surfaces shown so far, so
+   * it has to outlive individual frames */
+  if (window->texture)
+    return TRUE;
+
   texture = gst_mfx_texture_egl_new (display,
       GL_TEXTURE_2D, GL_RGBA, width, height);
 
@@ -158,6 +170,18 @@ ensure_shaders (GstMfxWindowEGL * window)
       vtable->glGetUniformLocation (prog_id, "tex2");
   vtable->glUseProgram (0);
 
+  vtable->glGenBuffers (1, &window->vertex_buffer);
+  if (!window->vertex_buffer) {
+    egl_object_replace (&program, NULL);
+    return FALSE;
+  }
+  vtable->glBindBuffer (GL_ARRAY_BUFFER, window->vertex_buffer);
+  vtable->glBufferData (GL_ARRAY_BUFFER, 16 * sizeof (GLfloat), NULL,
+      GL_DYNAMIC_DRAW);
+  vtable->glBindBuffer (GL_ARRAY_BUFFER, 0);
+  window->vertex_tex_width = 0;
+  window->vertex_tex_height = 0;
+
   egl_matrix_set_identity (window->render_projection);
 
   egl_object_replace (&window->render_program, program);
@@ -234,6 +258,10 @@ gst_mfx_window_egl_create (GstMfxWindow * window,
 static void
 do_destroy_objects_unlocked (GstMfxWindowEGL * window)
 {
+  if (window->vertex_buffer) {
+    window->egl_vtable->glDeleteBuffers (1, &window->vertex_buffer);
+    window->vertex_buffer = 0;
+  }
   egl_object_replace (&window->render_program, NULL);
   egl_object_replace (&window->egl_vtable, NULL);
   egl_object_replace (&window->egl_window, NULL);
@@ -359,6 +387,74 @@ gst_mfx_window_egl_resize (GstMfxWindow * window, guint width, guint height)
       (EglContextRunFunc) do_resize_window, &args) && args.success;
 }
 
+static inline gboolean
+rect_equal (const GstMfxRectangle * a, const GstMfxRectangle * b)
+{
+  return a->x == b->x && a->y == b->y && a->width == b->width
+      && a->height == b->height;
+}
+
+/* Uploads the quad to the vertex buffer, unless it is the same as for
+ * the previous frame, which is the case as long as the stream and the
+ * window keep their sizes */
+static void
+update_vertex_buffer (GstMfxWindowEGL * window, guint tex_width,
+    guint tex_height, const GstMfxRectangle * src_rect,
+    const GstMfxRectangle * dst_rect)
+{
+  EglVTable *const vtable = window->egl_vtable;
+  GLfloat x0, y0, x1, y1;
+  GLfloat s0, t0, s1, t1;
+  GLfloat vertices[4][4];
+  guint win_width, win_height;
+
+  if (window->vertex_tex_width == tex_width
+      && window->vertex_tex_height == tex_height
+      && rect_equal (&window->vertex_src_rect, src_rect)
+      && rect_equal (&window->vertex_dst_rect, dst_rect))
+    return;
+
+  win_width = dst_rect->width + dst_rect->x * 2;
+  win_height = dst_rect->height + dst_rect->y * 2;
+
+  // Source coords in VA surface
+  s0 = (GLfloat) src_rect->x / tex_width;
+  t0 = (GLfloat) src_rect->y / tex_height;
+  s1 = (GLfloat) (src_rect->x + src_rect->width) / tex_width;
+  t1 = (GLfloat) (src_rect->y + src_rect->height) / tex_height;
+
+  // Target coords in EGL surface
+  x0 = 2.0f * ((GLfloat) dst_rect->x / win_width) - 1.0f;
+  y1 = -2.0f * ((GLfloat) dst_rect->y / win_height) + 1.0f;
+  x1 = 2.0f * ((GLfloat) (dst_rect->x + dst_rect->width) / win_width) - 1.0f;
+  y0 = -2.0f * ((GLfloat) (dst_rect->y + dst_rect->height) / win_height) + 1.0f;
+
+  // Triangle strip order: bottom-left, bottom-right, top-left, top-right
+  vertices[0][0] = x0;
+  vertices[0][1] = y0;
+  vertices[0][2] = s0;
+  vertices[0][3] = t1;
+  vertices[1][0] = x1;
+  vertices[1][1] = y0;
+  vertices[1][2] = s1;
+  vertices[1][3] = t1;
+  vertices[2][0] = x0;
+  vertices[2][1] = y1;
+  vertices[2][2] = s0;
+  vertices[2][3] = t0;
+  vertices[3][0] = x1;
+  vertices[3][1] = y1;
+  vertices[3][2] = s1;
+  vertices[3][3] = t0;
+
+  vtable->glBufferSubData (GL_ARRAY_BUFFER, 0, sizeof (vertices), vertices);
+
+  window->vertex_tex_width = tex_width;
+  window->vertex_tex_height = tex_height;
+  window->vertex_src_rect = *src_rect;
+  window->vertex_dst_rect = *dst_rect;
+}
+
 static gboolean
 do_render_texture (GstMfxWindowEGL * window, const GstMfxRectangle * src_rect,
     const GstMfxRectangle * dst_rect)
@@ -366,49 +462,21 @@ do_render_texture (GstMfxWindowEGL * window, const GstMfxRectangle * src_rect,
   const GLuint tex_id = GST_MFX_TEXTURE_EGL_ID (window->texture);
   EglVTable *const vtable = window->egl_vtable;
   EglProgram *program;
-  GLfloat x0, y0, x1, y1;
-  GLfloat texcoords[4][2];
-  GLfloat positions[4][2];
-  guint tex_width, tex_height, win_width, win_height;
+  const GLsizei stride = 4 * sizeof (GLfloat);
+  guint tex_width, tex_height;
 
   if (!ensure_shaders (window))
     return FALSE;
 
   tex_width = GST_MFX_TEXTURE_EGL_WIDTH (window->texture);
   tex_height = GST_MFX_TEXTURE_EGL_HEIGHT (window->texture);
-  win_width = dst_rect->width + dst_rect->x * 2;
-  win_height = dst_rect->height + dst_rect->y * 2;
   program = window->render_program;
 
   if(!tex_width || !tex_height)
     return FALSE;
-  // Source coords in VA surface
-  x0 = (GLfloat) src_rect->x / tex_width;
-  y0 = (GLfloat) src_rect->y / tex_height;
-  x1 = (GLfloat) (src_rect->x + src_rect->width) / tex_width;
-  y1 = (GLfloat) (src_rect->y + src_rect->height) / tex_height;
-  texcoords[0][0] = x0;
-  texcoords[0][1] = y1;
-  texcoords[1][0] = x1;
-  texcoords[1][1] = y1;
-  texcoords[2][0] = x1;
-  texcoords[2][1] = y0;
-  texcoords[3][0] = x0;
-  texcoords[3][1] = y0;
 
-  // Target coords in EGL surface
-  x0 = 2.0f * ((GLfloat) dst_rect->x / win_width) - 1.0f;
-  y1 = -2.0f * ((GLfloat) dst_rect->y / win_height) + 1.0f;
-  x1 = 2.0f * ((GLfloat) (dst_rect->x + dst_rect->width) / win_width) - 1.0f;
-  y0 = -2.0f * ((GLfloat) (dst_rect->y + dst_rect->height) / win_height) + 1.0f;
-  positions[0][0] = x0;
-  positions[0][1] = y0;
-  positions[1][0] = x1;
-  positions[1][1] = y0;
-  positions[2][0] = x1;
-  positions[2][1] = y1;
-  positions[3][0] = x0;
-  positions[3][1] = y1;
+  vtable->glBindBuffer (GL_ARRAY_BUFFER, window->vertex_buffer);
+  update_vertex_buffer (window, tex_width, tex_height, src_rect, dst_rect);
 
   vtable->glClear (GL_COLOR_BUFFER_BIT);
 
@@ -416,17 +484,21 @@ do_render_texture (GstMfxWindowEGL * window, const GstMfxRectangle * src_rect,
   vtable->glUniformMatrix4fv (program->uniforms[RENDER_PROGRAM_VAR_PROJ],
       1, GL_FALSE, window->render_projection);
   vtable->glEnableVertexAttribArray (0);
-  vtable->glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE, 0, positions);
+  vtable->glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE, stride,
+      (const GLvoid *) 0);
   vtable->glEnableVertexAttribArray (1);
-  vtable->glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE, 0, texcoords);
+  vtable->glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE, stride,
+      (const GLvoid *) (2 * sizeof (GLfloat)));
 
   vtable->glBindTexture (GST_MFX_TEXTURE_EGL_TARGET (window->texture), tex_id);
   vtable->glUniform1i (program->uniforms[RENDER_PROGRAM_VAR_TEX0], 0);
 
-  vtable->glDrawArrays (GL_TRIANGLE_FAN, 0, 4);
+  vtable->glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
 
+  vtable->glBindTexture (GST_MFX_TEXTURE_EGL_TARGET (window->texture), 0);
   vtable->glDisableVertexAttribArray (1);
   vtable->glDisableVertexAttribArray (0);
+  vtable->glBindBuffer (GL_ARRAY_BUFFER, 0);
   vtable->glUseProgram (0);
 
   eglSwapBuffers (window->egl_window->context->display->base.handle.p,
@@ -442,7 +514,7 @@ do_upload_surface_unlocked (GstMfxWindowEGL * window,
 {
   if (!ensure_texture (window, src_rect->width, src_rect->height))
     return FALSE;
-  if (!gst_mfx_texture_egl_put_surface (window->texture, surface))
+  if (!gst_mfx_texture_egl_put_surface_unlocked (window->texture, surface))
     return FALSE;
   if (!do_render_texture (window, src_rect, dst_rect))
     return FALSE;
@@ -33,6 +33,8 @@ typedef double                  GLdouble;
 typedef GLuint                  GLenum;
 typedef GLuint                  GLbitfield;
 typedef GLfloat                 GLclampf;
+typedef long                    GLintptr;
+typedef long                    GLsizeiptr;
 
 #define GL_VENDOR               0x1F00
 #define GL_RENDERER             0x1F01
@@ -63,6 +65,7 @@ typedef GLfloat                 GLclampf;
 
 #define GL_UNPACK_ALIGNMENT     0x0cf5
 
+#define GL_TRIANGLE_STRIP       0x0005
 #define GL_TRIANGLE_FAN         0x0006
 
 #define GL_BYTE                 0x1400
@@ -85,6 +88,10 @@ typedef GLfloat                 GLclampf;
 #define GL_VERTEX_ARRAY         0x8074
 #define GL_TEXTURE_COORD_ARRAY  0x8078
 
+#define GL_ARRAY_BUFFER         0x8892
+#define GL_STATIC_DRAW          0x88E4
+#define GL_DYNAMIC_DRAW         0x88E8
+
 #define GL_FRAGMENT_SHADER      0x8B30
 #define GL_VERTEX_SHADER        0x8B31
 #define GL_COMPILE_STATUS       0x8B81
@@ -0,0 +1,196 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gstmfxbackpressure.h"
+
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+/* Number of busy retries that only yield the CPU before sleeping */
+#define SPIN_RETRIES 4
+/* Bounds of the exponential backoff, in microseconds */
+#define MIN_WAIT_TIME 50
+#define MAX_WAIT_TIME 4000
+
+/**
+ * GstMfxBackpressure:
+ *
+ * Wait primitive shared by the MFX tasks of an aggregator. Tasks that are
+ * told the device is busy back off adaptively, and are woken up early
+ * whenever a sync point completes or a surface is released, since either
+ * event is likely to let the device accept new work.
+ */
+struct _GstMfxBackpressure
+{
+  /*< private > */
+  GstMfxMiniObject parent_instance;
+
+  GMutex mutex;
+  GCond cond;
+  guint generation;
+};
+
+static void
+gst_mfx_backpressure_finalize (GstMfxBackpressure * bp)
+{
+  g_cond_clear (&bp->cond);
+  g_mutex_clear (&bp->mutex);
+}
+
+static inline const GstMfxMiniObjectClass *
+gst_mfx_backpressure_class (void)
+{
+  static const GstMfxMiniObjectClass GstMfxBackpressureClass = {
+    sizeof (GstMfxBackpressure),
+    (GDestroyNotify) gst_mfx_backpressure_finalize
+  };
+  return &GstMfxBackpressureClass;
+}
+
+GstMfxBackpressure *
+gst_mfx_backpressure_new (void)
+{
+  GstMfxBackpressure *bp;
+
+  bp = (GstMfxBackpressure *)
+      gst_mfx_mini_object_new0 (gst_mfx_backpressure_class ());
+  if (!bp)
+    return NULL;
+
+  g_mutex_init (&bp->mutex);
+  g_cond_init (&bp->cond);
+
+  return bp;
+}
+
+GstMfxBackpressure *
+gst_mfx_backpressure_ref (GstMfxBackpressure * bp)
+{
+  g_return_val_if_fail (bp != NULL, NULL);
+
+  return (GstMfxBackpressure *)
+      gst_mfx_mini_object_ref (GST_MFX_MINI_OBJECT (bp));
+}
+
+void
+gst_mfx_backpressure_unref (GstMfxBackpressure * bp)
+{
+  gst_mfx_mini_object_unref (GST_MFX_MINI_OBJECT (bp));
+}
+
+void
+gst_mfx_backpressure_replace (GstMfxBackpressure ** old_bp_ptr,
+    GstMfxBackpressure * new_bp)
+{
+  g_return_if_fail (old_bp_ptr != NULL);
+
+  gst_mfx_mini_object_replace ((GstMfxMiniObject **) old_bp_ptr,
+      GST_MFX_MINI_OBJECT (new_bp));
+}
+
+/**
+ * gst_mfx_backpressure_wait:
+ * @bp: a #GstMfxBackpressure
+ * @retry: number of consecutive busy statuses seen so far, starting at 0
+ *
+ * Backs off after the device reported MFX_WRN_DEVICE_BUSY. The first
+ * retries only yield the CPU, then the wait time doubles on each retry
+ * up to a bound, unless another task signals progress in the meantime.
+ *
+ * Returns: the time spent waiting, in microseconds
+ */
+guint64
+gst_mfx_backpressure_wait (GstMfxBackpressure * bp, guint retry)
+{
+  gint64 start, end_time;
+  guint generation;
+
+  g_return_val_if_fail (bp != NULL, 0);
+
+  start = g_get_monotonic_time ();
+
+  if (retry < SPIN_RETRIES) {
+    g_thread_yield ();
+    return g_get_monotonic_time () - start;
+  }
+
+  retry = MIN (retry - SPIN_RETRIES, 16);
+  end_time = start + MIN (MIN_WAIT_TIME << retry, MAX_WAIT_TIME);
+
+  g_mutex_lock (&bp->mutex);
+  generation = bp->generation;
+  while (generation == bp->generation)
+    if (!g_cond_wait_until (&bp->cond, &bp->mutex, end_time))
+      break;
+  g_mutex_unlock (&bp->mutex);
+
+  return g_get_monotonic_time () - start;
+}
+
+/**
+ * gst_mfx_backpressure_wait_until:
+ * @bp: a #GstMfxBackpressure
+ * @func: condition to wait for
+ * @user_data: data passed to @func
+ * @timeout: maximum time to wait, in microseconds
+ *
+ * Blocks until @func returns %TRUE or @timeout expires. @func is evaluated
+ * again each time the backpressure is signalled.
+ *
+ * Returns: the time spent waiting, in microseconds
+ */
+guint64
+gst_mfx_backpressure_wait_until (GstMfxBackpressure * bp,
+    GstMfxBackpressureFunc func, gpointer user_data, gint64 timeout)
+{
+  gint64 start, end_time;
+
+  g_return_val_if_fail (bp != NULL, 0);
+  g_return_val_if_fail (func != NULL, 0);
+
+  start = g_get_monotonic_time ();
+  end_time = start + timeout;
+
+  g_mutex_lock (&bp->mutex);
+  while (!func (user_data))
+    if (!g_cond_wait_until (&bp->cond, &bp->mutex, end_time))
+      break;
+  g_mutex_unlock (&bp->mutex);
+
+  return g_get_monotonic_time () - start;
+}
+
+/**
+ * gst_mfx_backpressure_signal:
+ * @bp: a #GstMfxBackpressure
+ *
+ * Wakes up all waiters, e.g. once a sync point has completed or a surface
+ * has been released.
+ */
+void
+gst_mfx_backpressure_signal (GstMfxBackpressure * bp)
+{
+  g_return_if_fail (bp != NULL);
+
+  g_mutex_lock (&bp->mutex);
+  bp->generation++;
+  g_cond_broadcast (&bp->cond);
+  g_mutex_unlock (&bp->mutex);
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFX_BACKPRESSURE_H
+#define GST_MFX_BACKPRESSURE_H
+
+#include "sysdeps.h"
+#include "gstmfxminiobject.h"
+
+G_BEGIN_DECLS
+
+#define GST_MFX_BACKPRESSURE(obj) \
+  ((GstMfxBackpressure *) (obj))
+
+typedef struct _GstMfxBackpressure GstMfxBackpressure;
+
+/**
+ * GstMfxBackpressureFunc:
+ * @user_data: data passed to gst_mfx_backpressure_wait_until()
+ *
+ * Checks whether the condition waited for is met. It is called with
+ * the backpressure lock held and must not block.
+ *
+ * Returns: %TRUE to stop waiting
+ */
+typedef gboolean (*GstMfxBackpressureFunc) (gpointer user_data);
+
+GstMfxBackpressure *
+gst_mfx_backpressure_new (void);
+
+GstMfxBackpressure *
+gst_mfx_backpressure_ref (GstMfxBackpressure * bp);
+
+void
+gst_mfx_backpressure_unref (GstMfxBackpressure * bp);
+
+void
+gst_mfx_backpressure_replace (GstMfxBackpressure ** old_bp_ptr,
+    GstMfxBackpressure * new_bp);
+
+guint64
+gst_mfx_backpressure_wait (GstMfxBackpressure * bp, guint retry);
+
+guint64
+gst_mfx_backpressure_wait_until (GstMfxBackpressure * bp,
+    GstMfxBackpressureFunc func, gpointer user_data, gint64 timeout);
+
+void
+gst_mfx_backpressure_signal (GstMfxBackpressure * bp);
+
+G_END_DECLS
+
+#endif /* GST_MFX_BACKPRESSURE_H */
@@ -0,0 +1,335 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gstmfxbitstreampool.h"
+
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+/* Maximum number of idle bitstream blocks kept around for reuse */
+#define MAX_FREE_BLOCKS 16
+
+typedef struct _GstMfxBitstreamBlock GstMfxBitstreamBlock;
+
+/* Header stored in front of every bitstream buffer, so that the block
+ * can be recovered from mfxBitstream.Data without any lookup */
+struct _GstMfxBitstreamBlock
+{
+  GstMfxBitstreamPool *pool;
+  GstMfxBitstreamBlock *next;
+  gsize size;
+};
+
+#define BLOCK_HEADER_SIZE \
+  GST_ROUND_UP_32 (sizeof (GstMfxBitstreamBlock))
+#define BLOCK_DATA(block) \
+  ((mfxU8 *) (block) + BLOCK_HEADER_SIZE)
+#define BLOCK_FROM_DATA(data) \
+  ((GstMfxBitstreamBlock *) ((mfxU8 *) (data) - BLOCK_HEADER_SIZE))
+
+/**
+ * GstMfxBitstreamPool:
+ *
+ * Pool of refcounted coded buffers. Blocks are handed downstream as
+ * GstBuffers without copying, and come back to the pool once the last
+ * reference to the buffer is dropped. Each outstanding block holds a
+ * reference on the pool, so the pool outlives the encoder if needed.
+ */
+struct _GstMfxBitstreamPool
+{
+  /*< private > */
+  GstMfxMiniObject parent_instance;
+
+  GMutex mutex;
+  GstMfxBitstreamBlock *free_blocks;
+  guint num_free_blocks;
+  gsize buffer_size;
+};
+
+static void
+free_block (GstMfxBitstreamBlock * block)
+{
+  g_free (block);
+}
+
+static void
+gst_mfx_bitstream_pool_finalize (GstMfxBitstreamPool * pool)
+{
+  GstMfxBitstreamBlock *block;
+
+  while ((block = pool->free_blocks) != NULL) {
+    pool->free_blocks = block->next;
+    free_block (block);
+  }
+  g_mutex_clear (&pool->mutex);
+}
+
+static inline const GstMfxMiniObjectClass *
+gst_mfx_bitstream_pool_class (void)
+{
+  static const GstMfxMiniObjectClass GstMfxBitstreamPoolClass = {
+    sizeof (GstMfxBitstreamPool),
+    (GDestroyNotify) gst_mfx_bitstream_pool_finalize
+  };
+  return &GstMfxBitstreamPoolClass;
+}
+
+GstMfxBitstreamPool *
+gst_mfx_bitstream_pool_new (gsize buffer_size)
+{
+  GstMfxBitstreamPool *pool;
+
+  g_return_val_if_fail (buffer_size > 0, NULL);
+
+  pool = (GstMfxBitstreamPool *)
+      gst_mfx_mini_object_new0 (gst_mfx_bitstream_pool_class ());
+  if (!pool)
+    return NULL;
+
+  g_mutex_init (&pool->mutex);
+  pool->buffer_size = buffer_size;
+
+  return pool;
+}
+
+GstMfxBitstreamPool *
+gst_mfx_bitstream_pool_ref (GstMfxBitstreamPool * pool)
+{
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  return (GstMfxBitstreamPool *)
+      gst_mfx_mini_object_ref (GST_MFX_MINI_OBJECT (pool));
+}
+
+void
+gst_mfx_bitstream_pool_unref (GstMfxBitstreamPool * pool)
+{
+  gst_mfx_mini_object_unref (GST_MFX_MINI_OBJECT (pool));
+}
+
+void
+gst_mfx_bitstream_pool_replace (GstMfxBitstreamPool ** old_pool_ptr,
+    GstMfxBitstreamPool * new_pool)
+{
+  g_return_if_fail (old_pool_ptr != NULL);
+
+  gst_mfx_mini_object_replace ((GstMfxMiniObject **) old_pool_ptr,
+      GST_MFX_MINI_OBJECT (new_pool));
+}
+
+gsize
+gst_mfx_bitstream_pool_get_buffer_size (GstMfxBitstreamPool * pool)
+{
+  gsize size;
+
+  g_return_val_if_fail (pool != NULL, 0);
+
+  g_mutex_lock (&pool->mutex);
+  size = pool->buffer_size;
+  g_mutex_unlock (&pool->mutex);
+
+  return size;
+}
+
+/* Gives a block back to the pool, dropping it if it is too small for
+ * the current buffer size or if enough blocks are idle already */
+static void
+put_block (GstMfxBitstreamPool * pool, GstMfxBitstreamBlock * block)
+{
+  g_mutex_lock (&pool->mutex);
+  if (block->size >= pool->buffer_size
+      && pool->num_free_blocks < MAX_FREE_BLOCKS) {
+    block->next = pool->free_blocks;
+    pool->free_blocks = block;
+    pool->num_free_blocks++;
+    block = NULL;
+  }
+  g_mutex_unlock (&pool->mutex);
+
+  if (block)
+    free_block (block);
+}
+
+static void
+release_block (GstMfxBitstreamBlock * block)
+{
+  GstMfxBitstreamPool *const pool = block->pool;
+
+  block->pool = NULL;
+  put_block (pool, block);
+  gst_mfx_bitstream_pool_unref (pool);
+}
+
+/**
+ * gst_mfx_bitstream_pool_acquire:
+ * @pool: a #GstMfxBitstreamPool
+ * @bs: the #mfxBitstream to attach a buffer to
+ *
+ * Attaches an idle coded buffer of at least the current pool buffer size
+ * to @bs, allocating a new one only when no idle buffer is available.
+ * Any coded data in @bs is discarded.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gst_mfx_bitstream_pool_acquire (GstMfxBitstreamPool * pool, mfxBitstream * bs)
+{
+  GstMfxBitstreamBlock *block;
+  gsize size;
+
+  g_return_val_if_fail (pool != NULL, FALSE);
+  g_return_val_if_fail (bs != NULL, FALSE);
+  g_return_val_if_fail (bs->Data == NULL, FALSE);
+
+  g_mutex_lock (&pool->mutex);
+  block = pool->free_blocks;
+  if (block) {
+    pool->free_blocks = block->next;
+    pool->num_free_blocks--;
+  }
+  size = pool->buffer_size;
+  g_mutex_unlock (&pool->mutex);
+
+  if (!block) {
+    block = g_try_malloc (BLOCK_HEADER_SIZE + size);
+    if (!block) {
+      GST_ERROR ("failed to allocate %" G_GSIZE_FORMAT " bytes bitstream",
+          size);
+      return FALSE;
+    }
+    block->size = size;
+  }
+  block->next = NULL;
+  block->pool = gst_mfx_bitstream_pool_ref (pool);
+
+  bs->Data = BLOCK_DATA (block);
+  bs->MaxLength = block->size;
+  bs->DataOffset = 0;
+  bs->DataLength = 0;
+
+  return TRUE;
+}
+
+/**
+ * gst_mfx_bitstream_pool_grow:
+ * @pool: a #GstMfxBitstreamPool
+ * @bs: an #mfxBitstream with a buffer from @pool attached
+ *
+ * Enlarges the buffer attached to @bs after the encoder returned
+ * MFX_ERR_NOT_ENOUGH_BUFFER, keeping any coded data. The pool buffer
+ * size is raised accordingly, so that buffers acquired afterwards are
+ * large enough from the start.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gst_mfx_bitstream_pool_grow (GstMfxBitstreamPool * pool, mfxBitstream * bs)
+{
+  GstMfxBitstreamBlock *block;
+  gsize size;
+
+  g_return_val_if_fail (pool != NULL, FALSE);
+  g_return_val_if_fail (bs != NULL && bs->Data != NULL, FALSE);
+
+  block = BLOCK_FROM_DATA (bs->Data);
+  g_return_val_if_fail (block->pool == pool, FALSE);
+
+  size = block->size + block->size / 2;
+
+  g_mutex_lock (&pool->mutex);
+  if (pool->buffer_size < size)
+    pool->buffer_size = size;
+  g_mutex_unlock (&pool->mutex);
+
+  block = g_try_realloc (block, BLOCK_HEADER_SIZE + size);
+  if (!block) {
+    GST_ERROR ("failed to grow bitstream to %" G_GSIZE_FORMAT " bytes", size);
+    return FALSE;
+  }
+  block->size = size;
+
+  bs->Data = BLOCK_DATA (block);
+  bs->MaxLength = size;
+
+  GST_DEBUG ("bitstream buffer size raised to %" G_GSIZE_FORMAT " bytes",
+      size);
+
+  return TRUE;
+}
+
+/**
+ * gst_mfx_bitstream_pool_release:
+ * @pool: a #GstMfxBitstreamPool
+ * @bs: an #mfxBitstream with a buffer from @pool attached
+ *
+ * Detaches the buffer from @bs and gives it back to @pool.
+ */
+void
+gst_mfx_bitstream_pool_release (GstMfxBitstreamPool * pool, mfxBitstream * bs)
+{
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (bs != NULL);
+
+  if (!bs->Data)
+    return;
+
+  release_block (BLOCK_FROM_DATA (bs->Data));
+
+  bs->Data = NULL;
+  bs->MaxLength = 0;
+  bs->DataOffset = 0;
+  bs->DataLength = 0;
+}
+
+/**
+ * gst_mfx_bitstream_pool_wrap:
+ * @pool: a #GstMfxBitstreamPool
+ * @bs: an #mfxBitstream with a buffer from @pool attached
+ *
+ * Detaches the buffer from @bs and wraps its coded data into a
+ * #GstBuffer without copying. The buffer returns to @pool once the
+ * #GstBuffer is freed. A new buffer has to be acquired before @bs can
+ * be used by the encoder again.
+ *
+ * Returns: (transfer full): a new #GstBuffer, or %NULL on error
+ */
+GstBuffer *
+gst_mfx_bitstream_pool_wrap (GstMfxBitstreamPool * pool, mfxBitstream * bs)
+{
+  GstMfxBitstreamBlock *block;
+  GstBuffer *buffer;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+  g_return_val_if_fail (bs != NULL && bs->Data != NULL, NULL);
+
+  block = BLOCK_FROM_DATA (bs->Data);
+
+  buffer = gst_buffer_new_wrapped_full (0, bs->Data, block->size,
+      bs->DataOffset, bs->DataLength, block, (GDestroyNotify) release_block);
+  if (!buffer)
+    return NULL;
+
+  bs->Data = NULL;
+  bs->MaxLength = 0;
+  bs->DataOffset = 0;
+  bs->DataLength = 0;
+
+  return buffer;
+}
@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFX_BITSTREAM_POOL_H
+#define GST_MFX_BITSTREAM_POOL_H
+
+#include "sysdeps.h"
+#include "gstmfxminiobject.h"
+
+G_BEGIN_DECLS
+
+#define GST_MFX_BITSTREAM_POOL(obj) \
+  ((GstMfxBitstreamPool *) (obj))
+
+typedef struct _GstMfxBitstreamPool GstMfxBitstreamPool;
+
+GstMfxBitstreamPool *
+gst_mfx_bitstream_pool_new (gsize buffer_size);
+
+GstMfxBitstreamPool *
+gst_mfx_bitstream_pool_ref (GstMfxBitstreamPool * pool);
+
+void
+gst_mfx_bitstream_pool_unref (GstMfxBitstreamPool * pool);
+
+void
+gst_mfx_bitstream_pool_replace (GstMfxBitstreamPool ** old_pool_ptr,
+    GstMfxBitstreamPool * new_pool);
+
+gsize
+gst_mfx_bitstream_pool_get_buffer_size (GstMfxBitstreamPool * pool);
+
+gboolean
+gst_mfx_bitstream_pool_acquire (GstMfxBitstreamPool * pool,
+    mfxBitstream * bs);
+
+gboolean
+gst_mfx_bitstream_pool_grow (GstMfxBitstreamPool * pool, mfxBitstream * bs);
+
+void
+gst_mfx_bitstream_pool_release (GstMfxBitstreamPool * pool,
+    mfxBitstream * bs);
+
+GstBuffer *
+gst_mfx_bitstream_pool_wrap (GstMfxBitstreamPool * pool, mfxBitstream * bs);
+
+G_END_DECLS
+
+#endif /* GST_MFX_BITSTREAM_POOL_H */
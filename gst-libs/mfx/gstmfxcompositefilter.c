@@ -30,6 +30,15 @@
 #include "gstmfxsurface_vaapi.h"
 #include "gstmfxsurfacecomposition.h"
 
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+/* Compositions are rendered round-robin into at least this many
+ * surfaces. A surface still referenced downstream, e.g. by a frame being
+ * displayed or queued, is skipped, and more surfaces are allocated up to
+ * MAX_OUTPUT_SURFACES when all of them are in use */
+#define NUM_OUTPUT_SURFACES 3
+#define MAX_OUTPUT_SURFACES 16
 
 struct _GstMfxCompositeFilter
 {
@@ -37,7 +46,11 @@ struct _GstMfxCompositeFilter
   GstMfxMiniObject parent_instance;
   GstMfxTaskAggregator *aggregator;
   GstMfxTask *vpp;
-  GstMfxSurface *out_surface;
+  GPtrArray *out_surfaces;
+  GstVideoInfo out_info;
+  /* Display of the output surfaces, NULL for system memory output */
+  GstMfxDisplay *display;
+  guint out_index;
   gboolean inited;
 
   mfxSession session;
@@ -47,16 +60,22 @@ struct _GstMfxCompositeFilter
   mfxExtBuffer *ext_buffer;
   mfxExtVPPComposite composite;
   guint num_rect;
+
+  /* Subpicture surfaces of the last composition, keyed by seqnum */
+  GHashTable *subpictures;
 };
 
 static void
 gst_mfx_composite_filter_finalize (GstMfxCompositeFilter * filter)
 {
   /* Free allocated memory for filters */
-  if (filter->composite.InputStream)
-    g_slice_free1 ((sizeof (mfxVPPCompInputStream) * filter->composite.NumInputStream), filter->composite.InputStream);
+  g_free (filter->composite.InputStream);
 
-  gst_mfx_surface_replace (&filter->out_surface, NULL);
+  if (filter->out_surfaces)
+    g_ptr_array_free (filter->out_surfaces, TRUE);
+  gst_mfx_display_replace (&filter->display, NULL);
+  if (filter->subpictures)
+    g_hash_table_unref (filter->subpictures);
   gst_mfx_task_aggregator_unref (filter->aggregator);
 
   MFXVideoVPP_Close (filter->session);
@@ -64,11 +83,14 @@ gst_mfx_composite_filter_finalize (GstMfxCompositeFilter * filter)
   gst_mfx_task_replace(&filter->vpp, NULL);
 }
 
+/* Fills the composite parameters from @composition, and returns in
+ * @changed whether they differ from the ones VPP was configured with */
 static gboolean
 configure_composite_filter (GstMfxCompositeFilter * filter,
-  GstMfxSurfaceComposition * composition)
+  GstMfxSurfaceComposition * composition, gboolean * changed)
 {
   GstMfxSubpicture *subpicture = NULL;
+  mfxVPPCompInputStream *stream;
   guint num_rect = 0;
 
   g_return_val_if_fail (filter != NULL, FALSE);
@@ -85,41 +107,52 @@ configure_composite_filter (GstMfxCompositeFilter * filter,
 
   num_rect = gst_mfx_surface_composition_get_num_subpictures (composition);
 
-  if (filter->num_rect != num_rect && filter->composite.InputStream) {
-    g_slice_free1(((num_rect+1)*sizeof (mfxVPPCompInputStream)),
-        filter->composite.InputStream);
-  }
-
-  filter->num_rect = num_rect;
-
-  /* Set number of input stream to composed
-   * Input Stream = Number of rectangle + number of base surface*/
-  filter->composite.NumInputStream = num_rect + 1;
-
-  if(!filter->composite.InputStream) {
+  *changed = !filter->inited;
+  if (filter->num_rect != num_rect || !filter->composite.InputStream) {
+    /* Set number of input stream to composed
+     * Input Stream = Number of rectangle + number of base surface*/
     filter->composite.InputStream =
-        g_slice_alloc (filter->composite.NumInputStream *
-        sizeof (mfxVPPCompInputStream));
-    if (!filter->composite.InputStream)
-      return FALSE;
+        g_renew (mfxVPPCompInputStream, filter->composite.InputStream,
+        num_rect + 1);
+    memset (filter->composite.InputStream, 0,
+        (num_rect + 1) * sizeof (mfxVPPCompInputStream));
+    filter->composite.NumInputStream = num_rect + 1;
+    filter->num_rect = num_rect;
+    *changed = TRUE;
   }
 
   /* Fill the base picture */
-  filter->composite.InputStream[0].DstX = filter->frame_info.CropX;
-  filter->composite.InputStream[0].DstY = filter->frame_info.CropY;
-  filter->composite.InputStream[0].DstW = filter->frame_info.CropW;
-  filter->composite.InputStream[0].DstH = filter->frame_info.CropH;
+  stream = &filter->composite.InputStream[0];
+  if (stream->DstX != filter->frame_info.CropX
+      || stream->DstY != filter->frame_info.CropY
+      || stream->DstW != filter->frame_info.CropW
+      || stream->DstH != filter->frame_info.CropH) {
+    stream->DstX = filter->frame_info.CropX;
+    stream->DstY = filter->frame_info.CropY;
+    stream->DstW = filter->frame_info.CropW;
+    stream->DstH = filter->frame_info.CropH;
+    *changed = TRUE;
+  }
 
   /* Fill the subpicture info */
   for (guint i=1; i < filter->composite.NumInputStream; i++) {
     subpicture = gst_mfx_surface_composition_get_subpicture (composition, i-1);
     if (!subpicture)
       return FALSE;
-    filter->composite.InputStream[i].DstX = subpicture->sub_rect.x;
-    filter->composite.InputStream[i].DstY = subpicture->sub_rect.y;
-    filter->composite.InputStream[i].DstH = subpicture->sub_rect.height;
-    filter->composite.InputStream[i].DstW = subpicture->sub_rect.width;
-    filter->composite.InputStream[i].PixelAlphaEnable = 1;
+
+    stream = &filter->composite.InputStream[i];
+    if (stream->DstX != subpicture->sub_rect.x
+        || stream->DstY != subpicture->sub_rect.y
+        || stream->DstW != subpicture->sub_rect.width
+        || stream->DstH != subpicture->sub_rect.height
+        || !stream->PixelAlphaEnable) {
+      stream->DstX = subpicture->sub_rect.x;
+      stream->DstY = subpicture->sub_rect.y;
+      stream->DstH = subpicture->sub_rect.height;
+      stream->DstW = subpicture->sub_rect.width;
+      stream->PixelAlphaEnable = 1;
+      *changed = TRUE;
+    }
   }
 
   filter->ext_buffer = (mfxExtBuffer *) &filter->composite;
@@ -129,11 +162,14 @@ configure_composite_filter (GstMfxCompositeFilter * filter,
   return TRUE;
 }
 
+/* Only resets VPP when the layout of the composition differs from the
+ * previous one, which for subtitles and logos is seldom the case */
 static gboolean
 gst_mfx_composite_filter_reset (GstMfxCompositeFilter * filter,
     GstMfxSurfaceComposition * composition)
 {
   mfxStatus sts = MFX_ERR_NONE;
+  gboolean changed;
 
   g_return_val_if_fail (filter != NULL, FALSE);
   g_return_val_if_fail (composition != NULL, FALSE);
@@ -141,8 +177,12 @@ gst_mfx_composite_filter_reset (GstMfxCompositeFilter * filter,
   if (!filter->inited)
     return TRUE;
 
-  if (!configure_composite_filter (filter, composition))
+  if (!configure_composite_filter (filter, composition, &changed))
       return FALSE;
+  if (!changed)
+    return TRUE;
+
+  GST_DEBUG ("composition layout changed, %u subpictures", filter->num_rect);
 
   sts = MFXVideoVPP_Reset (filter->session, &filter->params);
   if (sts < 0) {
@@ -152,6 +192,48 @@ gst_mfx_composite_filter_reset (GstMfxCompositeFilter * filter,
   return TRUE;
 }
 
+/* Attaches a surface to every subpicture of @composition, reusing the
+ * ones of the previous composition for rectangles that did not change.
+ * Surfaces of rectangles that are gone are released. */
+static gboolean
+ensure_subpicture_surfaces (GstMfxCompositeFilter * filter,
+    GstMfxSurfaceComposition * composition)
+{
+  GstMfxSubpicture *subpicture;
+  GstMfxSurface *surface;
+  GHashTable *subpictures;
+  guint i, num_subpictures;
+
+  num_subpictures =
+      gst_mfx_surface_composition_get_num_subpictures (composition);
+  subpictures = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) gst_mfx_surface_unref);
+
+  for (i = 0; i < num_subpictures; i++) {
+    subpicture = gst_mfx_surface_composition_get_subpicture (composition, i);
+
+    surface = filter->subpictures ? g_hash_table_lookup (filter->subpictures,
+        GUINT_TO_POINTER (subpicture->seqnum)) : NULL;
+    if (surface)
+      gst_mfx_surface_replace (&subpicture->surface, surface);
+    else if (!gst_mfx_surface_composition_upload_subpicture (composition, i))
+      goto error;
+
+    g_hash_table_replace (subpictures, GUINT_TO_POINTER (subpicture->seqnum),
+        gst_mfx_surface_ref (subpicture->surface));
+  }
+
+  if (filter->subpictures)
+    g_hash_table_unref (filter->subpictures);
+  filter->subpictures = subpictures;
+  return TRUE;
+
+error:
+  GST_ERROR ("Failed to upload subpicture %u", i);
+  g_hash_table_unref (subpictures);
+  return FALSE;
+}
+
 static gboolean
 gst_mfx_composite_filter_init (GstMfxCompositeFilter * filter,
     GstMfxTaskAggregator * aggregator, gboolean memtype_is_system)
@@ -237,10 +319,12 @@ static gboolean
 init_params (GstMfxCompositeFilter * filter,
     GstMfxSurfaceComposition * composition)
 {
+  gboolean changed;
+
   filter->params.vpp.In = filter->frame_info;
   filter->params.vpp.Out = filter->frame_info;
 
-  if (!configure_composite_filter (filter, composition)) {
+  if (!configure_composite_filter (filter, composition, &changed)) {
     GST_ERROR ("Error initializing composite filter params.");
     return FALSE;
   }
@@ -248,6 +332,52 @@ init_params (GstMfxCompositeFilter * filter,
   return TRUE;
 }
 
+static GstMfxSurface *
+add_output_surface (GstMfxCompositeFilter * filter)
+{
+  GstMfxSurface *surface;
+
+  if (filter->display)
+    surface = gst_mfx_surface_vaapi_new (filter->display, &filter->out_info,
+        NULL);
+  else
+    surface = gst_mfx_surface_new (&filter->out_info);
+  if (!surface)
+    return NULL;
+
+  g_ptr_array_add (filter->out_surfaces, surface);
+  return surface;
+}
+
+/* Returns the next output surface only referenced by @filter, so that a
+ * composition still held downstream is never overwritten */
+static GstMfxSurface *
+get_output_surface (GstMfxCompositeFilter * filter)
+{
+  GstMfxSurface *surface;
+  guint i, index;
+
+  for (i = 0; i < filter->out_surfaces->len; i++) {
+    index = (filter->out_index + i) % filter->out_surfaces->len;
+    surface = g_ptr_array_index (filter->out_surfaces, index);
+    if (GST_MFX_MINI_OBJECT_REFCOUNT_VALUE (surface) == 1) {
+      filter->out_index = (index + 1) % filter->out_surfaces->len;
+      return surface;
+    }
+  }
+
+  if (filter->out_surfaces->len >= MAX_OUTPUT_SURFACES) {
+    GST_ERROR ("All %u composition output surfaces are still in use",
+        filter->out_surfaces->len);
+    return NULL;
+  }
+
+  GST_DEBUG ("All composition output surfaces are in use, adding one");
+  surface = add_output_surface (filter);
+  filter->out_index = 0;
+  return surface;
+}
+
 static gboolean
 gst_mfx_composite_filter_start (GstMfxCompositeFilter * filter,
   GstMfxSurfaceComposition * composition)
@@ -255,6 +385,7 @@ gst_mfx_composite_filter_start (GstMfxCompositeFilter * filter,
   GstMfxSurface *base_surface;
   mfxStatus sts = MFX_ERR_NONE;
   GstVideoInfo info;
+  guint i;
 
   gst_video_info_init(&info);
 
@@ -269,19 +400,17 @@ gst_mfx_composite_filter_start (GstMfxCompositeFilter * filter,
   gst_video_info_set_format(&info, GST_MFX_SURFACE_FORMAT (base_surface),
     GST_MFX_SURFACE_WIDTH (base_surface), GST_MFX_SURFACE_HEIGHT (base_surface));
 
-  /* Allocate output surface for final composition */
+  /* Allocate output surfaces for final composition */
+  filter->out_info = info;
+  filter->out_surfaces =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_mfx_surface_unref);
   if (filter->params.IOPattern & MFX_IOPATTERN_OUT_VIDEO_MEMORY) {
-    GstMfxDisplay *display =
-        gst_mfx_surface_vaapi_get_display (base_surface);
-    filter->out_surface = gst_mfx_surface_vaapi_new (display, &info, NULL);
-    gst_mfx_display_unref (display);
-
+    filter->display = gst_mfx_surface_vaapi_get_display (base_surface);
     gst_mfx_task_use_video_memory (filter->vpp);
-  } else {
-    filter->out_surface = gst_mfx_surface_new (&info);
   }
-  if (!filter->out_surface)
-    return FALSE;
+  for (i = 0; i < NUM_OUTPUT_SURFACES; i++)
+    if (!add_output_surface (filter))
+      return FALSE;
 
   sts = MFXVideoVPP_Init (filter->session, &filter->params);
   if (sts < 0) {
@@ -295,18 +424,19 @@ gboolean
 gst_mfx_composite_filter_apply_composition (GstMfxCompositeFilter * filter,
   GstMfxSurfaceComposition * composition, GstMfxSurface ** out_surface)
 {
-  GstMfxSurface *surface;
+  GstMfxSurface *surface, *out;
   GstMfxSubpicture *subpicture = NULL;
   mfxFrameSurface1 *insurf, *outsurf = NULL;
   mfxSyncPoint syncp;
   mfxStatus sts = MFX_ERR_NONE;
-  guint i, num_subpictures;
+  guint i, num_subpictures, busy_retries = 0;
 
   num_subpictures =
       gst_mfx_surface_composition_get_num_subpictures (composition);
 
-  /* Reset filter for every frame because subpicture dimension
-   * and position will be different for every frame. */
+  if (!ensure_subpicture_surfaces (filter, composition))
+    return FALSE;
+
   if (!gst_mfx_composite_filter_reset (filter, composition))
     return FALSE;
 
@@ -321,7 +451,10 @@ gst_mfx_composite_filter_apply_composition (GstMfxCompositeFilter * filter,
   insurf = gst_mfx_surface_get_frame_surface (surface);
 
   /* Get output surface */
-  outsurf = gst_mfx_surface_get_frame_surface (filter->out_surface);
+  out = get_output_surface (filter);
+  if (!out)
+    return FALSE;
+  outsurf = gst_mfx_surface_get_frame_surface (out);
   do {
     sts =
         MFXVideoVPP_RunFrameVPPAsync (filter->session,
@@ -331,7 +464,8 @@ gst_mfx_composite_filter_apply_composition (GstMfxCompositeFilter * filter,
           &syncp);
 
     if (MFX_WRN_DEVICE_BUSY == sts)
-        g_usleep (100);
+      gst_mfx_backpressure_wait (gst_mfx_task_get_backpressure (filter->vpp),
+          busy_retries++);
   } while (MFX_WRN_DEVICE_BUSY == sts);
 
   if (MFX_ERR_MORE_DATA == sts) {
@@ -340,6 +474,7 @@ gst_mfx_composite_filter_apply_composition (GstMfxCompositeFilter * filter,
           gst_mfx_surface_composition_get_subpicture (composition, i);
       insurf = gst_mfx_surface_get_frame_surface (subpicture->surface);
 
+      busy_retries = 0;
       do {
         sts =
             MFXVideoVPP_RunFrameVPPAsync (filter->session,
@@ -349,7 +484,8 @@ gst_mfx_composite_filter_apply_composition (GstMfxCompositeFilter * filter,
               &syncp);
 
         if (MFX_WRN_DEVICE_BUSY == sts)
-            g_usleep (500);
+          gst_mfx_backpressure_wait (
+              gst_mfx_task_get_backpressure (filter->vpp), busy_retries++);
       } while (MFX_WRN_DEVICE_BUSY == sts);
     }
   }
@@ -360,8 +496,9 @@ gst_mfx_composite_filter_apply_composition (GstMfxCompositeFilter * filter,
   do {
     sts = MFXVideoCORE_SyncOperation (filter->session, syncp, 1000);
   } while (MFX_WRN_IN_EXECUTION == sts);
+  gst_mfx_backpressure_signal (gst_mfx_task_get_backpressure (filter->vpp));
 
-  *out_surface = filter->out_surface;
+  *out_surface = out;
 
   return TRUE;
 }
@@ -0,0 +1,422 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gstmfxcopy.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define USE_X86_SIMD 1
+# include <immintrin.h>
+#endif
+
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+/* Frames smaller than this are copied by the calling thread alone */
+#define MIN_STRIPED_COPY_SIZE (4 * 1024 * 1024)
+/* Smallest amount of data worth handing over to another thread */
+#define MIN_STRIPE_SIZE (1024 * 1024)
+#define MAX_STRIPES 4
+
+typedef void (*CopyRowsFunc) (const GstMfxCopyPlane * plane,
+    guint first_row, guint num_rows, GstMfxCopyFlags flags);
+
+typedef struct _CopyBatch CopyBatch;
+typedef struct _CopyStripe CopyStripe;
+
+struct _CopyBatch
+{
+  const GstMfxCopyPlane *planes;
+  guint num_planes;
+  GstMfxCopyFlags flags;
+  guint num_stripes;
+
+  GMutex lock;
+  GCond cond;
+  guint pending;
+};
+
+struct _CopyStripe
+{
+  CopyBatch *batch;
+  guint index;
+};
+
+static CopyRowsFunc copy_rows;
+static GThreadPool *copy_pool;
+
+static void
+copy_rows_c (const GstMfxCopyPlane * plane, guint first_row, guint num_rows,
+    GstMfxCopyFlags flags)
+{
+  const guint8 *src = plane->src + (gsize) first_row * plane->src_stride;
+  guint8 *dst = plane->dst + (gsize) first_row * plane->dst_stride;
+  guint i;
+
+  for (i = 0; i < num_rows; i++) {
+    memcpy (dst, src, plane->row_bytes);
+    src += plane->src_stride;
+    dst += plane->dst_stride;
+  }
+}
+
+#ifdef USE_X86_SIMD
+/* Uncached (USWC) memory is only read efficiently by full cache line
+ * streaming loads, which need aligned addresses: both kernels copy the
+ * unaligned head of each row with memcpy, then move whole cache lines
+ * with streaming loads when requested and streaming stores whenever the
+ * destination happens to be aligned as well, so that large frames do not
+ * evict the working set of the decoder and encoder threads */
+__attribute__ ((target ("sse4.1")))
+static void
+copy_rows_sse41 (const GstMfxCopyPlane * plane, guint first_row,
+    guint num_rows, GstMfxCopyFlags flags)
+{
+  const gboolean stream_load = !!(flags & GST_MFX_COPY_FLAG_UNCACHED_SRC);
+  guint i;
+
+  for (i = first_row; i < first_row + num_rows; i++) {
+    const guint8 *src = plane->src + (gsize) i * plane->src_stride;
+    guint8 *dst = plane->dst + (gsize) i * plane->dst_stride;
+    gsize n = plane->row_bytes;
+    gsize head = MIN ((-(guintptr) src) & 15, n);
+    __m128i x0, x1, x2, x3;
+
+    memcpy (dst, src, head);
+    src += head;
+    dst += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, src += 64, dst += 64) {
+      if (stream_load) {
+        x0 = _mm_stream_load_si128 ((__m128i *) src);
+        x1 = _mm_stream_load_si128 ((__m128i *) src + 1);
+        x2 = _mm_stream_load_si128 ((__m128i *) src + 2);
+        x3 = _mm_stream_load_si128 ((__m128i *) src + 3);
+      } else {
+        x0 = _mm_load_si128 ((const __m128i *) src);
+        x1 = _mm_load_si128 ((const __m128i *) src + 1);
+        x2 = _mm_load_si128 ((const __m128i *) src + 2);
+        x3 = _mm_load_si128 ((const __m128i *) src + 3);
+      }
+      if (((guintptr) dst & 15) == 0) {
+        _mm_stream_si128 ((__m128i *) dst, x0);
+        _mm_stream_si128 ((__m128i *) dst + 1, x1);
+        _mm_stream_si128 ((__m128i *) dst + 2, x2);
+        _mm_stream_si128 ((__m128i *) dst + 3, x3);
+      } else {
+        _mm_storeu_si128 ((__m128i *) dst, x0);
+        _mm_storeu_si128 ((__m128i *) dst + 1, x1);
+        _mm_storeu_si128 ((__m128i *) dst + 2, x2);
+        _mm_storeu_si128 ((__m128i *) dst + 3, x3);
+      }
+    }
+    for (; n >= 16; n -= 16, src += 16, dst += 16) {
+      x0 = stream_load ? _mm_stream_load_si128 ((__m128i *) src) :
+          _mm_load_si128 ((const __m128i *) src);
+      _mm_storeu_si128 ((__m128i *) dst, x0);
+    }
+    memcpy (dst, src, n);
+  }
+  _mm_sfence ();
+}
+
+__attribute__ ((target ("avx2")))
+static void
+copy_rows_avx2 (const GstMfxCopyPlane * plane, guint first_row,
+    guint num_rows, GstMfxCopyFlags flags)
+{
+  const gboolean stream_load = !!(flags & GST_MFX_COPY_FLAG_UNCACHED_SRC);
+  guint i;
+
+  for (i = first_row; i < first_row + num_rows; i++) {
+    const guint8 *src = plane->src + (gsize) i * plane->src_stride;
+    guint8 *dst = plane->dst + (gsize) i * plane->dst_stride;
+    gsize n = plane->row_bytes;
+    gsize head = MIN ((-(guintptr) src) & 31, n);
+    __m256i y0, y1;
+
+    memcpy (dst, src, head);
+    src += head;
+    dst += head;
+    n -= head;
+
+    for (; n >= 64; n -= 64, src += 64, dst += 64) {
+      if (stream_load) {
+        y0 = _mm256_stream_load_si256 ((const __m256i *) src);
+        y1 = _mm256_stream_load_si256 ((const __m256i *) src + 1);
+      } else {
+        y0 = _mm256_load_si256 ((const __m256i *) src);
+        y1 = _mm256_load_si256 ((const __m256i *) src + 1);
+      }
+      if (((guintptr) dst & 31) == 0) {
+        _mm256_stream_si256 ((__m256i *) dst, y0);
+        _mm256_stream_si256 ((__m256i *) dst + 1, y1);
+      } else {
+        _mm256_storeu_si256 ((__m256i *) dst, y0);
+        _mm256_storeu_si256 ((__m256i *) dst + 1, y1);
+      }
+    }
+    for (; n >= 32; n -= 32, src += 32, dst += 32) {
+      y0 = stream_load ? _mm256_stream_load_si256 ((const __m256i *) src) :
+          _mm256_load_si256 ((const __m256i *) src);
+      _mm256_storeu_si256 ((__m256i *) dst, y0);
+    }
+    memcpy (dst, src, n);
+  }
+  _mm_sfence ();
+  _mm256_zeroupper ();
+}
+#endif
+
+static void
+copy_stripe (CopyBatch * batch, guint index)
+{
+  guint i;
+
+  for (i = 0; i < batch->num_planes; i++) {
+    const GstMfxCopyPlane *const plane = &batch->planes[i];
+    guint first_row = (guint64) plane->rows * index / batch->num_stripes;
+    guint end_row = (guint64) plane->rows * (index + 1) / batch->num_stripes;
+
+    if (end_row > first_row)
+      copy_rows (plane, first_row, end_row - first_row, batch->flags);
+  }
+}
+
+static void
+copy_stripe_func (CopyStripe * stripe, gpointer user_data)
+{
+  CopyBatch *const batch = stripe->batch;
+
+  copy_stripe (batch, stripe->index);
+
+  g_mutex_lock (&batch->lock);
+  if (--batch->pending == 0)
+    g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->lock);
+}
+
+static gpointer
+init_copy_engine (gpointer data)
+{
+  guint num_threads = MIN (g_get_num_processors (), MAX_STRIPES) - 1;
+  const gchar *kernel_name = "scalar";
+
+  copy_rows = copy_rows_c;
+#ifdef USE_X86_SIMD
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2")) {
+    copy_rows = copy_rows_avx2;
+    kernel_name = "AVX2";
+  } else if (__builtin_cpu_supports ("sse4.1")) {
+    copy_rows = copy_rows_sse41;
+    kernel_name = "SSE4.1";
+  }
+#endif
+
+  if (num_threads > 0) {
+    GError *error = NULL;
+
+    copy_pool = g_thread_pool_new ((GFunc) copy_stripe_func, NULL,
+        num_threads, FALSE, &error);
+    if (!copy_pool) {
+      GST_WARNING ("failed to create copy threads: %s", error->message);
+      g_clear_error (&error);
+    }
+  }
+
+  GST_INFO ("using %s copy kernel with %u helper threads", kernel_name,
+      copy_pool ? num_threads : 0);
+
+  return NULL;
+}
+
+/**
+ * gst_mfx_copy_get_plane_row_bytes:
+ * @info: a #GstVideoInfo
+ * @plane: the plane index
+ *
+ * Computes the number of bytes holding visible pixels in each row of
+ * @plane, i.e. what actually needs to be copied out of a pitched buffer.
+ *
+ * Returns: the size of a plane row, in bytes
+ */
+guint
+gst_mfx_copy_get_plane_row_bytes (const GstVideoInfo * info, guint plane)
+{
+  guint width, i;
+
+  g_return_val_if_fail (info != NULL, 0);
+
+  width = GST_VIDEO_INFO_WIDTH (info);
+
+  switch (GST_VIDEO_INFO_FORMAT (info)) {
+    case GST_VIDEO_FORMAT_NV12:
+      /* Interleaved chroma spans as many bytes as luma */
+      return GST_ROUND_UP_2 (width);
+#if GST_CHECK_VERSION(1,10,0)
+    case GST_VIDEO_FORMAT_P010_10LE:
+      return GST_ROUND_UP_2 (width) * 2;
+#endif
+    case GST_VIDEO_FORMAT_YUY2:
+    case GST_VIDEO_FORMAT_UYVY:
+      return GST_ROUND_UP_2 (width) * 2;
+    case GST_VIDEO_FORMAT_BGRA:
+    case GST_VIDEO_FORMAT_BGRx:
+      return width * 4;
+    default:
+      break;
+  }
+
+  for (i = 0; i < GST_VIDEO_INFO_N_COMPONENTS (info); i++)
+    if (GST_VIDEO_INFO_COMP_PLANE (info, i) == plane)
+      return GST_VIDEO_INFO_COMP_WIDTH (info, i) *
+          GST_VIDEO_INFO_COMP_PSTRIDE (info, i);
+  return GST_VIDEO_INFO_PLANE_STRIDE (info, plane);
+}
+
+/**
+ * gst_mfx_copy_get_plane_rows:
+ * @info: a #GstVideoInfo
+ * @plane: the plane index
+ *
+ * Returns: the number of rows of @plane
+ */
+guint
+gst_mfx_copy_get_plane_rows (const GstVideoInfo * info, guint plane)
+{
+  guint i;
+
+  g_return_val_if_fail (info != NULL, 0);
+
+  for (i = 0; i < GST_VIDEO_INFO_N_COMPONENTS (info); i++)
+    if (GST_VIDEO_INFO_COMP_PLANE (info, i) == plane)
+      return GST_VIDEO_INFO_COMP_HEIGHT (info, i);
+  return GST_VIDEO_INFO_HEIGHT (info);
+}
+
+/**
+ * gst_mfx_copy_planes:
+ * @planes: the planes to copy
+ * @num_planes: the number of @planes
+ * @flags: #GstMfxCopyFlags describing the source memory
+ *
+ * Copies @planes with the fastest kernel the CPU supports. Large frames
+ * are cut into horizontal stripes that are copied concurrently, as a
+ * single core cannot saturate the memory bandwidth when reading from
+ * uncached video memory.
+ */
+void
+gst_mfx_copy_planes (const GstMfxCopyPlane * planes, guint num_planes,
+    GstMfxCopyFlags flags)
+{
+  static GOnce copy_once = G_ONCE_INIT;
+  CopyStripe stripes[MAX_STRIPES];
+  CopyBatch batch;
+  gsize total_size = 0;
+  guint i;
+
+  g_return_if_fail (planes != NULL);
+
+  g_once (&copy_once, init_copy_engine, NULL);
+
+  for (i = 0; i < num_planes; i++)
+    total_size += (gsize) planes[i].row_bytes * planes[i].rows;
+
+  batch.planes = planes;
+  batch.num_planes = num_planes;
+  batch.flags = flags;
+  batch.num_stripes = 1;
+
+  if (copy_pool && total_size >= MIN_STRIPED_COPY_SIZE)
+    batch.num_stripes = CLAMP (total_size / MIN_STRIPE_SIZE, 1,
+        g_thread_pool_get_max_threads (copy_pool) + 1);
+
+  if (batch.num_stripes == 1) {
+    copy_stripe (&batch, 0);
+    return;
+  }
+
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.cond);
+  batch.pending = batch.num_stripes - 1;
+
+  for (i = 1; i < batch.num_stripes; i++) {
+    stripes[i].batch = &batch;
+    stripes[i].index = i;
+    g_thread_pool_push (copy_pool, &stripes[i], NULL);
+  }
+  copy_stripe (&batch, 0);
+
+  g_mutex_lock (&batch.lock);
+  while (batch.pending > 0)
+    g_cond_wait (&batch.cond, &batch.lock);
+  g_mutex_unlock (&batch.lock);
+
+  g_cond_clear (&batch.cond);
+  g_mutex_clear (&batch.lock);
+}
+
+/**
+ * gst_mfx_copy_video_frame:
+ * @dst: the destination #GstVideoFrame
+ * @src: the source #GstVideoFrame
+ * @flags: #GstMfxCopyFlags describing the memory of @src
+ *
+ * Copies the visible contents of @src into @dst, honouring the pitch of
+ * each. The dimensions of @dst are the ones copied.
+ *
+ * Returns: %TRUE if both frames could be copied
+ */
+gboolean
+gst_mfx_copy_video_frame (GstVideoFrame * dst, const GstVideoFrame * src,
+    GstMfxCopyFlags flags)
+{
+  GstMfxCopyPlane planes[GST_VIDEO_MAX_PLANES];
+  guint i, num_planes;
+
+  g_return_val_if_fail (dst != NULL, FALSE);
+  g_return_val_if_fail (src != NULL, FALSE);
+
+  if (GST_VIDEO_FRAME_FORMAT (dst) != GST_VIDEO_FRAME_FORMAT (src))
+    return FALSE;
+
+  num_planes = GST_VIDEO_FRAME_N_PLANES (dst);
+  for (i = 0; i < num_planes; i++) {
+    gint src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, i);
+    gint dst_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dst, i);
+
+    /* Bottom-up layouts are left to the generic copy */
+    if (src_stride < 0 || dst_stride < 0)
+      return gst_video_frame_copy (dst, src);
+
+    planes[i].dst = GST_VIDEO_FRAME_PLANE_DATA (dst, i);
+    planes[i].dst_stride = dst_stride;
+    planes[i].src = GST_VIDEO_FRAME_PLANE_DATA (src, i);
+    planes[i].src_stride = src_stride;
+    planes[i].row_bytes =
+        MIN (gst_mfx_copy_get_plane_row_bytes (&dst->info, i),
+        MIN (src_stride, dst_stride));
+    planes[i].rows = gst_mfx_copy_get_plane_rows (&dst->info, i);
+  }
+
+  gst_mfx_copy_planes (planes, num_planes, flags);
+  return TRUE;
+}
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFX_COPY_H
+#define GST_MFX_COPY_H
+
+#include "sysdeps.h"
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstMfxCopyFlags:
+ * @GST_MFX_COPY_FLAG_NONE: source is regular cached memory
+ * @GST_MFX_COPY_FLAG_UNCACHED_SRC: source is uncached, write-combined
+ *   memory, such as a mapped VA surface, and is read with streaming loads
+ */
+typedef enum
+{
+  GST_MFX_COPY_FLAG_NONE = 0,
+  GST_MFX_COPY_FLAG_UNCACHED_SRC = 1 << 0,
+} GstMfxCopyFlags;
+
+typedef struct _GstMfxCopyPlane GstMfxCopyPlane;
+
+/**
+ * GstMfxCopyPlane:
+ * @dst: destination of the first row
+ * @dst_stride: distance in bytes between two destination rows
+ * @src: source of the first row
+ * @src_stride: distance in bytes between two source rows
+ * @row_bytes: number of bytes copied per row
+ * @rows: number of rows
+ *
+ * Describes the copy of one plane between two pitched buffers.
+ */
+struct _GstMfxCopyPlane
+{
+  guint8       *dst;
+  guint         dst_stride;
+  const guint8 *src;
+  guint         src_stride;
+  guint         row_bytes;
+  guint         rows;
+};
+
+guint
+gst_mfx_copy_get_plane_row_bytes (const GstVideoInfo * info, guint plane);
+
+guint
+gst_mfx_copy_get_plane_rows (const GstVideoInfo * info, guint plane);
+
+void
+gst_mfx_copy_planes (const GstMfxCopyPlane * planes, guint num_planes,
+    GstMfxCopyFlags flags);
+
+gboolean
+gst_mfx_copy_video_frame (GstVideoFrame * dst, const GstVideoFrame * src,
+    GstMfxCopyFlags flags);
+
+G_END_DECLS
+
+#endif /* GST_MFX_COPY_H */
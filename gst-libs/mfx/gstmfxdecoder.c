@@ -36,12 +36,32 @@
 #define NAL_UNITTYPE_BITS 0X1F
 #define DEFAULT_EXTRA_SURFACE 5;
 
+typedef struct _GstMfxDecodeOperation GstMfxDecodeOperation;
+
+struct _GstMfxDecodeOperation
+{
+  mfxSyncPoint syncp;
+  GstMfxSurface *surface;
+};
+
+typedef struct _GstMfxDecodeTiming GstMfxDecodeTiming;
+struct _GstMfxDecodeTiming
+{
+  guint32 frame_number;
+  gint64 start_time;
+};
+
+/* Frames whose output could not be matched to their input, such as
+ * discarded partial frames, are forgotten beyond this many timings */
+#define MAX_PENDING_TIMINGS 64
+
 struct _GstMfxDecoder
 {
   /*< private > */
   GstMfxMiniObject parent_instance;
 
   GstMfxTaskAggregator *aggregator;
+  GstMfxBackpressure *backpressure;
   GstMfxTask *decode;
   GstMfxProfile profile;
   GstMfxSurfacePool *pool;
@@ -49,6 +69,11 @@ struct _GstMfxDecoder
   GByteArray *bitstream;
   GByteArray *codec_data;
 
+  /* Offset in bs to rewind to when re-feeding the current frame */
+  guint32 bs_rewind_offset;
+  /* Whether bs points straight into the mapped input buffer */
+  gboolean bs_is_mapped;
+
   GQueue decoded_frames;
   GQueue pending_frames;
   GQueue discarded_frames;
@@ -69,9 +94,29 @@ struct _GstMfxDecoder
   gboolean skip_corrupted_frames;
   gboolean can_double_deinterlace;
   gboolean is_avc;
+  /* Size of the length field preceding each NAL unit of AVC samples */
+  guint nal_length_size;
   gboolean sync_out_surf;
+  gboolean low_latency;
   guint num_partial_frames;
 
+  /* Ring of decode operations submitted to the SDK but not yet
+   * synchronized, oldest first */
+  GstMfxDecodeOperation *in_flight;
+  guint in_flight_size;
+  guint in_flight_head;
+  volatile gint in_flight_count;
+  guint in_flight_depth;
+
+  /* Total time spent waiting on a busy device, in microseconds */
+  guint64 wait_time;
+
+  /* Time each pending frame entered the decoder, and the resulting
+   * decode latencies */
+  GArray *timings;
+  GstMfxDecoderLatency latency;
+  GstClockTime last_input_pts;
+
   /* For special double frame rate deinterlacing case */
   GstClockTime current_pts;
   GstClockTime duration;
@@ -159,15 +204,46 @@ gst_mfx_decoder_should_use_video_memory (GstMfxDecoder * decoder,
   return;
 }
 
+static void
+discard_in_flight (GstMfxDecoder * decoder)
+{
+  GstMfxDecodeOperation *op;
+
+  while (g_atomic_int_get (&decoder->in_flight_count)) {
+    op = &decoder->in_flight[decoder->in_flight_head];
+    gst_mfx_surface_replace (&op->surface, NULL);
+    op->syncp = NULL;
+
+    decoder->in_flight_head =
+        (decoder->in_flight_head + 1) % decoder->in_flight_size;
+    g_atomic_int_dec_and_test (&decoder->in_flight_count);
+  }
+}
+
 static gboolean
 init_decoder (GstMfxDecoder * decoder)
 {
+  guint ring_size;
+
   mfxStatus sts = MFXVideoDECODE_Init (decoder->session, &decoder->params);
   if (sts < 0) {
     GST_ERROR ("Error re-initializing the MFX video decoder %d", sts);
     return FALSE;
   }
 
+  /* Draining may have given up on operations that failed to sync, so drop
+   * whatever is left before the ring is resized and rewound */
+  discard_in_flight (decoder);
+
+  ring_size = MAX (MAX (decoder->params.AsyncDepth,
+          decoder->in_flight_depth), 1);
+  if (ring_size > decoder->in_flight_size) {
+    g_free (decoder->in_flight);
+    decoder->in_flight = g_new0 (GstMfxDecodeOperation, ring_size);
+    decoder->in_flight_size = ring_size;
+  }
+  decoder->in_flight_head = 0;
+
   if (!decoder->pool) {
     if ( decoder->memtype_is_system == TRUE && decoder->decode ) {
       mfxU16 num_surfaces = decoder->params.AsyncDepth + DEFAULT_EXTRA_SURFACE;
@@ -186,6 +262,7 @@ init_decoder (GstMfxDecoder * decoder)
 static void
 close_decoder (GstMfxDecoder * decoder)
 {
+  discard_in_flight (decoder);
   gst_mfx_surface_pool_replace (&decoder->pool, NULL);
 
   MFXVideoDECODE_Close (decoder->session);
@@ -201,6 +278,7 @@ gst_mfx_decoder_finalize (GstMfxDecoder * decoder)
   g_byte_array_unref (decoder->bitstream);
   if (decoder->codec_data)
     g_byte_array_unref (decoder->codec_data);
+  gst_mfx_backpressure_replace (&decoder->backpressure, NULL);
   gst_mfx_task_aggregator_unref (decoder->aggregator);
 
   g_queue_foreach (&decoder->pending_frames,
@@ -219,6 +297,8 @@ gst_mfx_decoder_finalize (GstMfxDecoder * decoder)
     MFXVideoUSER_UnLoad(decoder->session, &decoder->plugin_uid);
 
   close_decoder (decoder);
+  g_free (decoder->in_flight);
+  g_array_unref (decoder->timings);
 
   gst_mfx_task_replace (&decoder->decode, NULL);
 }
@@ -392,26 +472,44 @@ error_query_request:
   }
 }
 
+static inline guint32
+read_nal_length (const guint8 * data, guint nal_length_size)
+{
+  switch (nal_length_size) {
+    case 1:
+      return GST_READ_UINT8 (data);
+    case 2:
+      return GST_READ_UINT16_BE (data);
+    default:
+      return GST_READ_UINT32_BE (data);
+  }
+}
+
 static gboolean
 gst_mfx_decoder_is_avc_intra (GstMfxDecoder * decoder, guint8 * cdata,
     gint size)
 {
   gboolean have_intra = FALSE;
+  guint nal_length_size;
 
   if (!decoder || !cdata || !size)
     return FALSE;
 
   gint32 offset = 0;
-  gint32 packet_size = 0;
+  guint32 packet_size = 0;
+
+  nal_length_size = decoder->nal_length_size;
+  while (offset + nal_length_size < size) {
+    packet_size = read_nal_length (&cdata[offset], nal_length_size);
 
-  while (offset < (size - 8)) {
-    packet_size = GST_READ_UINT32_BE(&cdata[offset]);
+    offset += nal_length_size;
+    if (packet_size > size - offset)
+      break;
 
-    offset += 4;
     switch (cdata[offset] & 0x1f) {
     case GST_H264_NAL_SLICE:
       have_intra = gst_mfx_utils_h264_is_slice_intra (
-                       &cdata[offset], size - offset);
+                       &cdata[offset], packet_size);
       break;
     case GST_H264_NAL_SLICE_IDR:
       have_intra = TRUE;
@@ -425,22 +523,56 @@ gst_mfx_decoder_is_avc_intra (GstMfxDecoder * decoder, guint8 * cdata,
   return have_intra;
 }
 
+/* Rewrites the 4-byte length fields of an AVC sample into start codes, so
+ * that the SDK can read the sample directly. The sample is left untouched
+ * if any of its NAL units is truncated */
+static gboolean
+gst_mfx_decoder_convert_avc_stream_in_place (GstMfxDecoder * decoder,
+    guint8 * cdata, gsize size)
+{
+  gsize offset;
+  guint32 packet_size;
+
+  if (decoder->nal_length_size != 4)
+    return FALSE;
+
+  for (offset = 0; size - offset > 4; offset += 4 + packet_size) {
+    packet_size = GST_READ_UINT32_BE (&cdata[offset]);
+    if (packet_size > size - offset - 4)
+      return FALSE;
+  }
+  if (offset != size)
+    return FALSE;
+
+  for (offset = 0; offset < size; offset += 4 + packet_size) {
+    packet_size = GST_READ_UINT32_BE (&cdata[offset]);
+    GST_WRITE_UINT32_BE (&cdata[offset], 1);
+  }
+
+  return TRUE;
+}
+
 static gboolean
 gst_mfx_decoder_convert_avc_stream (GstMfxDecoder * decoder, guint8 * cdata,
     gint size, gboolean drop_ps)
 {
   guint8 startcode[4] = {0, 0, 0, 1}, nal_unit_type = 0;
-  gint32 offset = 0, packet_size = 0;
+  gint32 offset = 0;
+  guint32 packet_size = 0;
+  guint nal_length_size;
 
   if (!decoder || !cdata || !size)
     return FALSE;
 
-  while (offset < size) {
-    packet_size = GST_READ_UINT32_BE(&cdata[offset]);
-    nal_unit_type = (GstH264NalUnitType)(GST_READ_UINT8(&cdata[offset += 4]) &
-                                    NAL_UNITTYPE_BITS);
+  nal_length_size = decoder->nal_length_size;
+  while (offset + nal_length_size < size) {
+    packet_size = read_nal_length (&cdata[offset], nal_length_size);
+    offset += nal_length_size;
 
-    if (offset + packet_size > size) break;
+    if (packet_size > size - offset) break;
+
+    nal_unit_type = (GstH264NalUnitType)(GST_READ_UINT8(&cdata[offset]) &
+                                    NAL_UNITTYPE_BITS);
 
     /* Avoid mutiple SPS/PPS NAL reinsertion when stream-format=avc. Forced
      * to insert only the first SPS/PPS to fix some video corruption issue.
@@ -505,6 +637,11 @@ gst_mfx_decoder_handle_avc_codec_data (GstMfxDecoder * decoder,
         GST_ERROR ("Codec data header error.\n");
         goto error;
       }
+      if ((cdata[4] & 0x03) == 2) {
+        GST_ERROR ("Invalid NAL unit length size.\n");
+        goto error;
+      }
+      decoder->nal_length_size = (cdata[4] & 0x03) + 1;
     }
 
     for (gchar **pchar = msgs; *pchar != NULL; pchar++) {
@@ -609,16 +746,21 @@ gst_mfx_decoder_init (GstMfxDecoder * decoder,
     return FALSE;
 
   decoder->is_avc = is_avc;
+  decoder->nal_length_size = 4;
   if (is_avc && !gst_mfx_decoder_handle_avc_codec_data(decoder, codec_data))
     goto error_init;
 
   decoder->pts_offset = GST_CLOCK_TIME_NONE;
+  decoder->last_input_pts = GST_CLOCK_TIME_NONE;
+  decoder->timings = g_array_new (FALSE, FALSE, sizeof (GstMfxDecodeTiming));
 
   g_queue_init (&decoder->decoded_frames);
   g_queue_init (&decoder->pending_frames);
   g_queue_init (&decoder->discarded_frames);
 
   decoder->aggregator = gst_mfx_task_aggregator_ref (aggregator);
+  decoder->backpressure = gst_mfx_backpressure_ref (
+      gst_mfx_task_aggregator_get_backpressure (aggregator));
   if (!task_init(decoder))
     goto error_init;
 
@@ -850,13 +992,15 @@ gst_mfx_decoder_reinit (GstMfxDecoder * decoder, mfxFrameInfo * info)
   if (!init_decoder (decoder))
     goto error;
 
-  decoder->bs.DataLength += decoder->bs.DataOffset;
-  decoder->bs.DataOffset = 0;
+  decoder->bs.DataLength +=
+      decoder->bs.DataOffset - decoder->bs_rewind_offset;
+  decoder->bs.DataOffset = decoder->bs_rewind_offset;
 
   GstMfxSurface *surface;
   mfxFrameSurface1 *insurf, *outsurf = NULL;
   mfxSyncPoint syncp;
   mfxStatus sts = MFX_ERR_NONE;
+  guint busy_retries = 0;
 
   do {
     surface = gst_mfx_surface_new_from_pool (decoder->pool);
@@ -869,7 +1013,8 @@ gst_mfx_decoder_reinit (GstMfxDecoder * decoder, mfxFrameInfo * info)
     GST_DEBUG ("MFXVideoDECODE_DecodeFrameAsync status: %d", sts);
 
     if (MFX_WRN_DEVICE_BUSY == sts)
-      g_usleep (100);
+      decoder->wait_time += gst_mfx_backpressure_wait (decoder->backpressure,
+          busy_retries++);
   } while (sts > 0 || MFX_ERR_MORE_SURFACE == sts);
 
   if (syncp) {
@@ -900,12 +1045,19 @@ gst_mfx_decoder_reset (GstMfxDecoder * decoder)
       g_queue_pop_head(&decoder->pending_frames));
 
   decoder->pts_offset = GST_CLOCK_TIME_NONE;
+  decoder->last_input_pts = GST_CLOCK_TIME_NONE;
   decoder->current_pts = 0;
+  g_array_set_size (decoder->timings, 0);
+
+  /* Pending sync points are invalidated by the reset */
+  discard_in_flight (decoder);
 
   if (decoder->bitstream->len)
     g_byte_array_remove_range (decoder->bitstream, 0,
       decoder->bitstream->len);
   memset(&decoder->bs, 0, sizeof(mfxBitstream));
+  decoder->bs_rewind_offset = 0;
+  decoder->bs_is_mapped = FALSE;
 
   decoder->was_reset = TRUE;
   decoder->has_ready_frames = FALSE;
@@ -929,15 +1081,74 @@ new_frame (GstMfxDecoder * decoder)
   return frame;
 }
 
+static void
+record_start_time (GstMfxDecoder * decoder, GstVideoCodecFrame * frame)
+{
+  GstMfxDecodeTiming timing;
+
+  if (decoder->timings->len >= MAX_PENDING_TIMINGS)
+    g_array_remove_index (decoder->timings, 0);
+
+  timing.frame_number = frame->system_frame_number;
+  timing.start_time = g_get_monotonic_time ();
+  g_array_append_val (decoder->timings, timing);
+}
+
+static void
+record_latency (GstMfxDecoder * decoder, GstVideoCodecFrame * frame)
+{
+  GstMfxDecoderLatency *const latency = &decoder->latency;
+  GstMfxDecodeTiming *timing;
+  guint64 elapsed, elapsed_ms;
+  guint i, bin;
+
+  for (i = 0; i < decoder->timings->len; i++) {
+    timing = &g_array_index (decoder->timings, GstMfxDecodeTiming, i);
+    if (timing->frame_number == frame->system_frame_number)
+      break;
+  }
+  if (i == decoder->timings->len)
+    return;
+
+  elapsed = g_get_monotonic_time () - timing->start_time;
+  g_array_remove_index (decoder->timings, i);
+
+  /* Bin 0 counts frames decoded within a millisecond, bin n > 0 those
+   * decoded within [2^(n-1), 2^n) milliseconds, the last bin the rest */
+  elapsed_ms = elapsed / 1000;
+  bin = elapsed_ms ?
+      MIN (g_bit_storage (elapsed_ms), GST_MFX_DECODER_LATENCY_BINS - 1) : 0;
+  latency->histogram[bin]++;
+
+  if (!latency->num_frames || elapsed < latency->min)
+    latency->min = elapsed;
+  if (elapsed > latency->max)
+    latency->max = elapsed;
+  latency->total += elapsed;
+  latency->num_frames++;
+}
+
 static void
 queue_output_frame (GstMfxDecoder * decoder, GstMfxSurface * surface)
 {
   GstVideoCodecFrame *out_frame;
 
-  if (!decoder->can_double_deinterlace)
+  if (!decoder->can_double_deinterlace) {
     out_frame = g_queue_pop_tail (&decoder->pending_frames);
-  else
+    if (out_frame)
+      record_latency (decoder, out_frame);
+  }
+  else {
     out_frame = new_frame (decoder);
+  }
+
+  /* The surface is dropped rather than queued without a frame, which
+   * gst_mfx_decoder_get_frame() could not hand out */
+  if (!out_frame) {
+    GST_WARNING ("No frame left for decoded surface %u, dropping it",
+        GST_MFX_SURFACE_FRAME_SURFACE (surface)->Data.FrameOrder);
+    return;
+  }
 
   gst_video_codec_frame_set_user_data(out_frame,
       gst_mfx_surface_ref (surface), (GDestroyNotify) gst_mfx_surface_unref);
@@ -956,17 +1167,203 @@ sort_pts (gconstpointer frame1, gconstpointer frame2, gpointer data)
   return (pts1 > pts2 ? -1 : pts1 == pts2 ? 0 : +1);
 }
 
+/* Marks the data consumed so far as no longer needed. Consumed bytes are
+ * only compacted away once they outgrow the residual data, so that
+ * partial frames do not trigger a memmove on every decoded frame */
+static void
+release_consumed_data (GstMfxDecoder * decoder)
+{
+  decoder->bs_rewind_offset = decoder->bs.DataOffset;
+  if (decoder->bs_is_mapped)
+    return;
+
+  if (!decoder->bs.DataLength) {
+    g_byte_array_set_size (decoder->bitstream, 0);
+    decoder->bs.DataOffset = decoder->bs_rewind_offset = 0;
+  }
+  else if (decoder->bs.DataOffset >= decoder->bs.DataLength) {
+    g_byte_array_remove_range (decoder->bitstream, 0,
+        decoder->bs.DataOffset);
+    decoder->bs.DataOffset = decoder->bs_rewind_offset = 0;
+  }
+  decoder->bs.Data = decoder->bitstream->data;
+  decoder->bs.MaxLength = decoder->bitstream->len;
+}
+
+/* Copies whatever may still be needed from the mapped input buffer into
+ * the bitstream array before the buffer gets unmapped */
+static void
+save_mapped_data (GstMfxDecoder * decoder)
+{
+  guint32 start = decoder->bs_rewind_offset;
+  guint32 end = decoder->bs.DataOffset + decoder->bs.DataLength;
+
+  decoder->bs_is_mapped = FALSE;
+
+  if (end > start)
+    decoder->bitstream = g_byte_array_append (decoder->bitstream,
+        decoder->bs.Data + start, end - start);
+  decoder->bs.DataOffset -= start;
+  decoder->bs_rewind_offset = 0;
+  decoder->bs.Data = decoder->bitstream->data;
+  decoder->bs.MaxLength = decoder->bitstream->len;
+}
+
+static guint
+get_in_flight_limit (GstMfxDecoder * decoder)
+{
+  guint limit = decoder->in_flight_depth ?
+      decoder->in_flight_depth : decoder->params.AsyncDepth;
+
+  if (decoder->low_latency)
+    limit = 1;
+
+  /* Streams with a very large DPB may have their output surfaces
+   * overwritten before being synchronized, while in a fused transcode
+   * the output is handed over without waiting for it at all */
+  if (decoder->sync_out_surf
+      || gst_mfx_task_aggregator_is_fused_transcode (decoder->aggregator,
+          decoder->decode))
+    limit = 1;
+
+  return CLAMP (limit, 1, decoder->in_flight_size);
+}
+
+static void
+push_in_flight (GstMfxDecoder * decoder, mfxSyncPoint syncp,
+    GstMfxSurface * surface)
+{
+  GstMfxDecodeOperation *op;
+
+  op = &decoder->in_flight[(decoder->in_flight_head +
+          decoder->in_flight_count) % decoder->in_flight_size];
+  op->syncp = syncp;
+  op->surface = gst_mfx_surface_ref (surface);
+
+  g_atomic_int_inc (&decoder->in_flight_count);
+}
+
+/* Synchronizes the oldest in-flight decode operation and queues its
+ * surface for output, going through the VPP filter if needed */
+static GstMfxDecoderStatus
+sync_oldest_frame (GstMfxDecoder * decoder)
+{
+  GstMfxDecoderStatus ret = GST_MFX_DECODER_STATUS_SUCCESS;
+  GstMfxFilterStatus filter_sts;
+  GstMfxDecodeOperation *op;
+  GstMfxSurface *surface, *filter_surface;
+  mfxStatus sts = MFX_ERR_NONE;
+  gboolean fused;
+
+  op = &decoder->in_flight[decoder->in_flight_head];
+  surface = op->surface;
+  op->surface = NULL;
+
+  /* Downstream tasks of a fused transcode are ordered by the SDK, others
+   * wait on the sync point carried by the surface when they need it */
+  fused = gst_mfx_task_aggregator_is_fused_transcode (decoder->aggregator,
+      decoder->decode);
+  if (fused)
+    gst_mfx_surface_set_sync_point (surface, op->syncp);
+  else
+    do {
+      sts = MFXVideoCORE_SyncOperation (decoder->session, op->syncp, 1000);
+      GST_DEBUG ("MFXVideoCORE_SyncOperation status: %d", sts);
+    } while (MFX_WRN_IN_EXECUTION == sts);
+  op->syncp = NULL;
+
+  /* A completed operation frees up device resources for other tasks */
+  gst_mfx_backpressure_signal (decoder->backpressure);
+
+  decoder->in_flight_head =
+      (decoder->in_flight_head + 1) % decoder->in_flight_size;
+  g_atomic_int_dec_and_test (&decoder->in_flight_count);
+
+  if (sts < 0) {
+    GST_ERROR ("Status %d : Error synchronizing decoded frame", sts);
+    ret = GST_MFX_DECODER_STATUS_ERROR_UNKNOWN;
+    goto done;
+  }
+
+  /* Corruption is only reported once the operation has completed */
+  if (decoder->skip_corrupted_frames && !fused
+      && GST_MFX_SURFACE_FRAME_SURFACE (surface)->Data.Corrupted &
+          MFX_CORRUPTION_MAJOR) {
+    gst_mfx_decoder_reset (decoder);
+    ret = GST_MFX_DECODER_STATUS_ERROR_MORE_DATA;
+    goto done;
+  }
+
+  if (decoder->filter) {
+    do {
+      filter_sts = gst_mfx_filter_process (decoder->filter, surface,
+        &filter_surface);
+      queue_output_frame (decoder, filter_surface);
+    } while (GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE == filter_sts);
+
+    if (GST_MFX_FILTER_STATUS_SUCCESS != filter_sts) {
+      GST_ERROR ("MFX post-processing error while decoding.");
+      ret = GST_MFX_DECODER_STATUS_ERROR_UNKNOWN;
+    }
+  }
+  else {
+    queue_output_frame (decoder, surface);
+  }
+
+done:
+  gst_mfx_surface_unref (surface);
+  return ret;
+}
+
+/* Synchronizes every in-flight operation, e.g. before re-initializing
+ * the decoder which would otherwise invalidate their sync points */
+static GstMfxDecoderStatus
+drain_in_flight (GstMfxDecoder * decoder)
+{
+  GstMfxDecoderStatus ret = GST_MFX_DECODER_STATUS_SUCCESS;
+
+  while (g_atomic_int_get (&decoder->in_flight_count)
+      && GST_MFX_DECODER_STATUS_SUCCESS == ret)
+    ret = sync_oldest_frame (decoder);
+
+  return ret;
+}
+
+/* Frames synchronized by drain_in_flight() have to be collected by the
+ * caller right away, rather than on some later call */
+static inline GstMfxDecoderStatus
+get_drained_status (GstMfxDecoder * decoder)
+{
+  return g_queue_is_empty (&decoder->decoded_frames) ?
+      GST_MFX_DECODER_STATUS_ERROR_MORE_DATA : GST_MFX_DECODER_STATUS_SUCCESS;
+}
+
+/* Decoded order output only suits streams without frame reordering. Once
+ * a reordered frame shows up, decoding restarts from the next key frame
+ * with display order output */
+static void
+disable_decoded_order (GstMfxDecoder * decoder)
+{
+  GST_WARNING ("Frame reordering detected, falling back to display order");
+
+  decoder->params.mfx.DecodedOrder = 0;
+  decoder->last_input_pts = GST_CLOCK_TIME_NONE;
+  if (decoder->inited)
+    gst_mfx_decoder_reset (decoder);
+}
+
 GstMfxDecoderStatus
 gst_mfx_decoder_decode (GstMfxDecoder * decoder,
     GstVideoCodecFrame * frame)
 {
   GstMapInfo minfo;
+  GstMapFlags map_flags;
   GstMfxDecoderStatus ret = GST_MFX_DECODER_STATUS_SUCCESS;
-  GstMfxFilterStatus filter_sts;
-  GstMfxSurface *surface, *filter_surface;
+  GstMfxSurface *surface;
   mfxFrameSurface1 *insurf, *outsurf = NULL;
   mfxSyncPoint syncp;
   mfxStatus sts = MFX_ERR_NONE;
+  guint busy_retries = 0;
 
   if(!GST_CLOCK_TIME_IS_VALID(frame->pts)) {
    frame->pts = frame->dts;
@@ -977,7 +1374,23 @@ gst_mfx_decoder_decode (GstMfxDecoder * decoder,
       && GST_CLOCK_TIME_IS_VALID (frame->pts))
     decoder->pts_offset = frame->pts;
 
-  if (!gst_buffer_map (frame->input_buffer, &minfo, GST_MAP_READ)) {
+  if (decoder->params.mfx.DecodedOrder && GST_CLOCK_TIME_IS_VALID (frame->pts)) {
+    if (GST_CLOCK_TIME_IS_VALID (decoder->last_input_pts)
+        && frame->pts < decoder->last_input_pts)
+      disable_decoded_order (decoder);
+    decoder->last_input_pts = frame->pts;
+  }
+
+  /* AVC samples get converted into a byte stream in place whenever the
+   * input buffer can be written to. Mapping it for writing only copies its
+   * memory if that memory is shared with another buffer */
+  map_flags = GST_MAP_READ;
+  if (decoder->is_avc && decoder->inited && decoder->nal_length_size == 4
+      && !decoder->bitstream->len
+      && gst_buffer_is_writable (frame->input_buffer))
+    map_flags |= GST_MAP_WRITE;
+
+  if (!gst_buffer_map (frame->input_buffer, &minfo, map_flags)) {
     GST_ERROR ("Failed to map input buffer");
     return GST_MFX_DECODER_STATUS_ERROR_UNKNOWN;
   }
@@ -1029,8 +1442,13 @@ gst_mfx_decoder_decode (GstMfxDecoder * decoder,
   }
 
   if (!decoder->can_double_deinterlace) {
-    /* Save frames for later synchronization with decoded MFX surfaces */
-    g_queue_insert_sorted (&decoder->pending_frames, frame, sort_pts, NULL);
+    /* Save frames for later synchronization with decoded MFX surfaces.
+     * Frames are output as they are decoded, so there is nothing to sort */
+    if (decoder->params.mfx.DecodedOrder)
+      g_queue_push_head (&decoder->pending_frames, frame);
+    else
+      g_queue_insert_sorted (&decoder->pending_frames, frame, sort_pts, NULL);
+    record_start_time (decoder, frame);
   }
   else {
     g_queue_push_head(&decoder->discarded_frames, frame);
@@ -1046,12 +1464,30 @@ gst_mfx_decoder_decode (GstMfxDecoder * decoder,
         decoder->bs.Data = decoder->bitstream->data;
       }
 
-      if (!gst_mfx_decoder_convert_avc_stream (
-            decoder, minfo.data, minfo.size, !decoder->inited))
-        GST_ERROR ("Error in %s !", __func__);
+      if ((minfo.flags & GST_MAP_WRITE) && !decoder->bitstream->len
+          && gst_mfx_decoder_convert_avc_stream_in_place (decoder,
+              minfo.data, minfo.size)) {
+        decoder->bs.Data = minfo.data;
+        decoder->bs.DataOffset = 0;
+        decoder->bs.DataLength = decoder->bs.MaxLength = minfo.size;
+        decoder->bs_rewind_offset = 0;
+        decoder->bs_is_mapped = TRUE;
+      } else {
+        if (!gst_mfx_decoder_convert_avc_stream (
+              decoder, minfo.data, minfo.size, !decoder->inited))
+          GST_ERROR ("Error in %s !", __func__);
 
-      decoder->bs.MaxLength = decoder->bitstream->len;
-      decoder->bs.Data = decoder->bitstream->data;
+        decoder->bs.MaxLength = decoder->bitstream->len;
+        decoder->bs.Data = decoder->bitstream->data;
+      }
+    } else if (!decoder->bitstream->len) {
+      /* No data left over from previous input, so the SDK can read the
+       * mapped input buffer directly */
+      decoder->bs.Data = minfo.data;
+      decoder->bs.DataOffset = 0;
+      decoder->bs.DataLength = decoder->bs.MaxLength = minfo.size;
+      decoder->bs_rewind_offset = 0;
+      decoder->bs_is_mapped = TRUE;
     } else {
       decoder->bitstream = g_byte_array_append (decoder->bitstream,
           minfo.data, minfo.size);
@@ -1067,10 +1503,17 @@ gst_mfx_decoder_decode (GstMfxDecoder * decoder,
       goto end;
   }
 
+  /* Input buffers hold whole frames, which the SDK can then decode
+   * without waiting for the start of the next one */
+  if (decoder->low_latency)
+    decoder->bs.DataFlag |= MFX_BITSTREAM_COMPLETE_FRAME;
+
   do {
     surface = gst_mfx_surface_new_from_pool (decoder->pool);
-    if (!surface)
-      return GST_MFX_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
+    if (!surface) {
+      ret = GST_MFX_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
+      goto end;
+    }
 
     insurf = gst_mfx_surface_get_frame_surface (surface);
     sts = MFXVideoDECODE_DecodeFrameAsync (decoder->session, &decoder->bs,
@@ -1078,7 +1521,8 @@ gst_mfx_decoder_decode (GstMfxDecoder * decoder,
     GST_DEBUG ("MFXVideoDECODE_DecodeFrameAsync status: %d", sts);
 
     if (MFX_WRN_DEVICE_BUSY == sts)
-      g_usleep (100);
+      decoder->wait_time += gst_mfx_backpressure_wait (decoder->backpressure,
+          busy_retries++);
   } while (sts > 0 || MFX_ERR_MORE_SURFACE == sts);
 
   if (MFX_ERR_MORE_DATA == sts) {
@@ -1089,11 +1533,12 @@ gst_mfx_decoder_decode (GstMfxDecoder * decoder,
   }
 
   if (MFX_ERR_INCOMPATIBLE_VIDEO_PARAM == sts) {
+    drain_in_flight (decoder);
     if (!gst_mfx_decoder_reinit(decoder, &insurf->Info)) {
       ret = GST_MFX_DECODER_STATUS_ERROR_UNKNOWN;
       goto end;
     }
-    ret = GST_MFX_DECODER_STATUS_ERROR_MORE_DATA;
+    ret = get_drained_status (decoder);
     goto end;
   }
 
@@ -1120,21 +1565,13 @@ gst_mfx_decoder_decode (GstMfxDecoder * decoder,
       }
     }
 
-    if (decoder->skip_corrupted_frames
-        && insurf->Data.Corrupted & MFX_CORRUPTION_MAJOR) {
-      gst_mfx_decoder_reset (decoder);
-      ret = GST_MFX_DECODER_STATUS_ERROR_MORE_DATA;
-      goto end;
-    }
     decoder->has_ready_frames = TRUE;
 
-    if (!gst_mfx_task_has_type (decoder->decode, GST_MFX_TASK_ENCODER))
-      do {
-        sts = MFXVideoCORE_SyncOperation (decoder->session, syncp, 1000);
-        GST_DEBUG ("MFXVideoCORE_SyncOperation status: %d", sts);
-      } while (MFX_WRN_IN_EXECUTION == sts);
-
     surface = gst_mfx_surface_pool_find_surface (decoder->pool, outsurf);
+    if (!surface) {
+      ret = GST_MFX_DECODER_STATUS_ERROR_INVALID_SURFACE;
+      goto end;
+    }
 
     /* Update stream properties if they have interlaced frames. An interlaced H264
      * can only be detected after decoding the first frame, hence the delayed VPP
@@ -1179,40 +1616,32 @@ update:
      * another task type at this point. */
     if ((decoder->enable_csc || decoder->enable_deinterlace)
         && (gst_mfx_task_get_task_type (decoder->decode) == GST_MFX_TASK_DECODER)) {
+      drain_in_flight (decoder);
       if (!gst_mfx_decoder_reinit (decoder, &outsurf->Info))
         ret = GST_MFX_DECODER_STATUS_ERROR_INIT_FAILED;
       else
-        ret = GST_MFX_DECODER_STATUS_ERROR_MORE_DATA;
+        ret = get_drained_status (decoder);
       goto end;
     }
 
-    if (decoder->filter) {
-      do {
-        filter_sts = gst_mfx_filter_process (decoder->filter, surface,
-          &filter_surface);
-        queue_output_frame (decoder, filter_surface);
-      } while (GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE == filter_sts);
-
-      if (GST_MFX_FILTER_STATUS_SUCCESS != filter_sts) {
-        GST_ERROR ("MFX post-processing error while decoding.");
-        ret = GST_MFX_DECODER_STATUS_ERROR_UNKNOWN;
-        goto end;
-      }
-    }
-    else {
-      queue_output_frame (decoder, surface);
-    }
+    push_in_flight (decoder, syncp, surface);
 
-    decoder->bitstream = g_byte_array_remove_range (decoder->bitstream, 0,
-      decoder->bs.DataOffset);
-    decoder->bs.DataOffset = 0;
-    decoder->bs.Data = decoder->bitstream->data;
-    decoder->bs.MaxLength = decoder->bitstream->len;
+    release_consumed_data (decoder);
 
-    ret = GST_MFX_DECODER_STATUS_SUCCESS;
+    /* Only wait for the oldest operations once the ring is full, so that
+     * the hardware queue stays busy */
+    ret = GST_MFX_DECODER_STATUS_ERROR_MORE_DATA;
+    while ((guint) g_atomic_int_get (&decoder->in_flight_count) >=
+        get_in_flight_limit (decoder)) {
+      ret = sync_oldest_frame (decoder);
+      if (GST_MFX_DECODER_STATUS_SUCCESS != ret)
+        break;
+    }
   }
 
 end:
+  if (decoder->bs_is_mapped)
+    save_mapped_data (decoder);
   gst_buffer_unmap (frame->input_buffer, &minfo);
 
   return ret;
@@ -1221,12 +1650,11 @@ end:
 GstMfxDecoderStatus
 gst_mfx_decoder_flush (GstMfxDecoder * decoder)
 {
-  GstMfxDecoderStatus ret;
-  GstMfxFilterStatus filter_sts;
-  GstMfxSurface *surface, *filter_surface;
+  GstMfxSurface *surface;
   mfxFrameSurface1 *insurf, *outsurf = NULL;
   mfxSyncPoint syncp;
   mfxStatus sts = MFX_ERR_NONE;
+  guint busy_retries = 0;
 
   g_return_val_if_fail(decoder != NULL, GST_MFX_DECODER_STATUS_FLUSHED);
 
@@ -1243,33 +1671,22 @@ gst_mfx_decoder_flush (GstMfxDecoder * decoder)
         insurf, &outsurf, &syncp);
     GST_DEBUG ("MFXVideoDECODE_DecodeFrameAsync status: %d", sts);
     if (sts == MFX_WRN_DEVICE_BUSY)
-      g_usleep (100);
+      decoder->wait_time += gst_mfx_backpressure_wait (decoder->backpressure,
+          busy_retries++);
   } while (MFX_WRN_DEVICE_BUSY == sts);
 
   if (syncp) {
-    do {
-      sts = MFXVideoCORE_SyncOperation (decoder->session, syncp, 1000);
-      GST_DEBUG ("MFXVideoCORE_SyncOperation status: %d", sts);
-    } while (MFX_WRN_IN_EXECUTION == sts);
-
     surface = gst_mfx_surface_pool_find_surface (decoder->pool, outsurf);
+    if (surface)
+      push_in_flight (decoder, syncp, surface);
+  }
 
-    if (decoder->filter) {
-      do {
-        filter_sts = gst_mfx_filter_process (decoder->filter, surface,
-          &filter_surface);
-        queue_output_frame (decoder, filter_surface);
-      } while (GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE == filter_sts);
-    }
-    else {
-      queue_output_frame (decoder, surface);
-    }
+  /* Output one frame per call, oldest first, until both the SDK and the
+   * in-flight ring are drained */
+  if (!g_atomic_int_get (&decoder->in_flight_count))
+    return GST_MFX_DECODER_STATUS_FLUSHED;
 
-    ret = GST_MFX_DECODER_STATUS_SUCCESS;
-  } else {
-    ret = GST_MFX_DECODER_STATUS_FLUSHED;
-  }
-  return ret;
+  return sync_oldest_frame (decoder);
 }
 
 gboolean
@@ -1281,5 +1698,81 @@ gst_mfx_decoder_check_system_memory (GstMfxDecoder * decoder)
 void
 gst_mfx_decoder_reset_async_depth (GstMfxDecoder *decoder, mfxU16 async_depth)
 {
+   if (decoder->low_latency)
+     return;
    decoder->params.AsyncDepth = async_depth;
 }
+
+/**
+ * gst_mfx_decoder_set_low_latency:
+ * @decoder: a #GstMfxDecoder
+ * @low_latency: whether to output each frame as soon as it is decoded
+ *
+ * Outputs each frame right after it is decoded: a single operation is
+ * kept in flight, input buffers are taken as complete frames, and H.264
+ * and HEVC frames are output in decoding order instead of waiting for
+ * the reorder delay. Decoding order output is dropped at the first
+ * reordered frame, so streams with B-frames still decode correctly
+ * though not as fast.
+ *
+ * This must be set before the first frame is decoded.
+ */
+void
+gst_mfx_decoder_set_low_latency (GstMfxDecoder * decoder,
+    gboolean low_latency)
+{
+  g_return_if_fail (decoder != NULL);
+  g_return_if_fail (!decoder->inited);
+
+  decoder->low_latency = low_latency;
+  if (!low_latency)
+    return;
+
+  decoder->params.AsyncDepth = 1;
+  if (decoder->params.mfx.CodecId == MFX_CODEC_AVC
+      || decoder->params.mfx.CodecId == MFX_CODEC_HEVC)
+    decoder->params.mfx.DecodedOrder = 1;
+}
+
+/**
+ * gst_mfx_decoder_get_latency:
+ * @decoder: a #GstMfxDecoder
+ * @latency: return location for the decode latency statistics
+ *
+ * Retrieves the time taken by the frames decoded so far from entering
+ * the decoder to being ready for output, i.e. including the wait for
+ * the device to complete them.
+ */
+void
+gst_mfx_decoder_get_latency (GstMfxDecoder * decoder,
+    GstMfxDecoderLatency * latency)
+{
+  g_return_if_fail (decoder != NULL);
+  g_return_if_fail (latency != NULL);
+
+  *latency = decoder->latency;
+}
+
+void
+gst_mfx_decoder_set_in_flight_depth (GstMfxDecoder * decoder, guint depth)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->in_flight_depth = depth;
+}
+
+guint
+gst_mfx_decoder_get_in_flight_count (GstMfxDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, 0);
+
+  return g_atomic_int_get (&decoder->in_flight_count);
+}
+
+guint64
+gst_mfx_decoder_get_wait_time (GstMfxDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, 0);
+
+  return decoder->wait_time;
+}
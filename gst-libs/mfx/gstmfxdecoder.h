@@ -66,6 +66,29 @@ typedef enum {
   GST_MFX_DECODER_STATUS_ERROR_UNKNOWN = -1
 } GstMfxDecoderStatus;
 
+/* Number of bins of the decode latency histogram */
+#define GST_MFX_DECODER_LATENCY_BINS 8
+
+/**
+ * GstMfxDecoderLatency:
+ * @num_frames: number of frames measured
+ * @min: lowest decode latency, in microseconds
+ * @max: highest decode latency, in microseconds
+ * @total: sum of the decode latencies, in microseconds
+ * @histogram: number of frames per latency range. Bin 0 counts frames
+ *   decoded in less than a millisecond, bin n > 0 frames decoded within
+ *   [2^(n-1), 2^n) milliseconds, and the last bin everything slower.
+ *
+ * Decode latency statistics for gst_mfx_decoder_get_latency().
+ */
+typedef struct {
+  guint64 num_frames;
+  guint64 min;
+  guint64 max;
+  guint64 total;
+  guint64 histogram[GST_MFX_DECODER_LATENCY_BINS];
+} GstMfxDecoderLatency;
+
 GstMfxDecoder *
 gst_mfx_decoder_new (GstMfxTaskAggregator * aggregator,
     GstMfxProfile profile, const GstVideoInfo * info, mfxU16 async_depth,
@@ -117,6 +140,23 @@ gst_mfx_decoder_check_system_memory (GstMfxDecoder * decoder);
 void
 gst_mfx_decoder_reset_async_depth (GstMfxDecoder *decoder, mfxU16 async_depth);
 
+void
+gst_mfx_decoder_set_in_flight_depth (GstMfxDecoder * decoder, guint depth);
+
+guint
+gst_mfx_decoder_get_in_flight_count (GstMfxDecoder * decoder);
+
+guint64
+gst_mfx_decoder_get_wait_time (GstMfxDecoder * decoder);
+
+void
+gst_mfx_decoder_set_low_latency (GstMfxDecoder * decoder,
+    gboolean low_latency);
+
+void
+gst_mfx_decoder_get_latency (GstMfxDecoder * decoder,
+    GstMfxDecoderLatency * latency);
+
 G_END_DECLS
 
 #endif /* GST_MFX_DECODER_H */
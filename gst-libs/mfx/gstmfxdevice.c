@@ -0,0 +1,343 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <libudev.h>
+#include "gstmfxdevice.h"
+
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+typedef struct
+{
+  gchar *path;
+  /* Number of aggregators bound to the device */
+  guint num_users;
+  /* Number of MFX sessions currently borrowed on the device */
+  guint num_sessions;
+} GstMfxDeviceNode;
+
+/* Process-wide list of DRM nodes, enumerated on first use */
+G_LOCK_DEFINE_STATIC (device_list);
+static GPtrArray *device_nodes;
+static guint next_device;
+static GstMfxDeviceSelection default_selection =
+    GST_MFX_DEVICE_SELECTION_ROUND_ROBIN;
+
+/* GstMfxDeviceSelection enumerations */
+GType
+gst_mfx_device_selection_get_type (void)
+{
+  static GType g_type = 0;
+
+  static const GEnumValue device_selections[] = {
+    {GST_MFX_DEVICE_SELECTION_ROUND_ROBIN,
+        "Round-robin", "round-robin"},
+    {GST_MFX_DEVICE_SELECTION_LEAST_SESSIONS,
+        "Least active sessions", "least-sessions"},
+    {0, NULL, NULL},
+  };
+
+  if (!g_type)
+    g_type = g_enum_register_static ("GstMfxDeviceSelection",
+        device_selections);
+  return g_type;
+}
+
+static void
+free_device_node (GstMfxDeviceNode * node)
+{
+  g_free (node->path);
+  g_slice_free (GstMfxDeviceNode, node);
+}
+
+static void
+append_device_node (GPtrArray * nodes, const gchar * path)
+{
+  GstMfxDeviceNode *node = g_slice_new0 (GstMfxDeviceNode);
+
+  node->path = g_strdup (path);
+  g_ptr_array_add (nodes, node);
+}
+
+/* Lists the DRM nodes of PCI devices, render nodes first. Primary nodes
+ * are only used when no render node is available */
+static GPtrArray *
+enumerate_device_nodes (void)
+{
+  const gchar *sysnames[] = { "renderD[0-9]*", "card[0-9]*", NULL };
+  const gchar *syspath, *devpath;
+  struct udev *udev = NULL;
+  struct udev_device *device, *parent;
+  struct udev_enumerate *e;
+  struct udev_list_entry *l;
+  GPtrArray *nodes;
+  guint i;
+
+  nodes = g_ptr_array_new_with_free_func ((GDestroyNotify) free_device_node);
+
+  udev = udev_new ();
+  if (!udev)
+    return nodes;
+
+  for (i = 0; sysnames[i] && !nodes->len; i++) {
+    e = udev_enumerate_new (udev);
+    if (!e)
+      break;
+
+    udev_enumerate_add_match_subsystem (e, "drm");
+    udev_enumerate_add_match_sysname (e, sysnames[i]);
+    udev_enumerate_scan_devices (e);
+    udev_list_entry_foreach (l, udev_enumerate_get_list_entry (e)) {
+      syspath = udev_list_entry_get_name (l);
+      device = udev_device_new_from_syspath (udev, syspath);
+      if (!device)
+        continue;
+      parent = udev_device_get_parent (device);
+
+      devpath = udev_device_get_devnode (device);
+      if (parent && devpath
+          && !g_strcmp0 (udev_device_get_subsystem (parent), "pci"))
+        append_device_node (nodes, devpath);
+      udev_device_unref (device);
+    }
+    udev_enumerate_unref (e);
+  }
+  udev_unref (udev);
+
+  for (i = 0; i < nodes->len; i++)
+    GST_INFO ("found DRM node %s",
+        ((GstMfxDeviceNode *) g_ptr_array_index (nodes, i))->path);
+
+  return nodes;
+}
+
+/* Must be called with the device list lock held */
+static GPtrArray *
+ensure_device_nodes (void)
+{
+  if (!device_nodes)
+    device_nodes = enumerate_device_nodes ();
+  return device_nodes;
+}
+
+/* Must be called with the device list lock held */
+static GstMfxDeviceNode *
+find_device_node (const gchar * device_path)
+{
+  GPtrArray *const nodes = ensure_device_nodes ();
+  GstMfxDeviceNode *node;
+  guint i;
+
+  if (!device_path)
+    return NULL;
+
+  for (i = 0; i < nodes->len; i++) {
+    node = g_ptr_array_index (nodes, i);
+    if (!g_strcmp0 (node->path, device_path))
+      return node;
+  }
+  return NULL;
+}
+
+/**
+ * gst_mfx_device_list_set_nodes:
+ * @paths: (allow-none): %NULL-terminated array of DRM node paths
+ *
+ * Replaces the enumerated DRM nodes with @paths, or enumerates them
+ * again if @paths is %NULL. Session counts are reset.
+ */
+void
+gst_mfx_device_list_set_nodes (const gchar * const *paths)
+{
+  GPtrArray *nodes;
+  guint i;
+
+  if (paths) {
+    nodes =
+        g_ptr_array_new_with_free_func ((GDestroyNotify) free_device_node);
+    for (i = 0; paths[i]; i++)
+      append_device_node (nodes, paths[i]);
+  }
+  else {
+    nodes = enumerate_device_nodes ();
+  }
+
+  G_LOCK (device_list);
+  if (device_nodes)
+    g_ptr_array_unref (device_nodes);
+  device_nodes = nodes;
+  next_device = 0;
+  G_UNLOCK (device_list);
+}
+
+guint
+gst_mfx_device_list_get_count (void)
+{
+  guint count;
+
+  G_LOCK (device_list);
+  count = ensure_device_nodes ()->len;
+  G_UNLOCK (device_list);
+
+  return count;
+}
+
+gchar *
+gst_mfx_device_list_get_path (guint index)
+{
+  GPtrArray *nodes;
+  gchar *path = NULL;
+
+  G_LOCK (device_list);
+  nodes = ensure_device_nodes ();
+  if (index < nodes->len)
+    path = g_strdup (((GstMfxDeviceNode *) g_ptr_array_index (nodes,
+                index))->path);
+  G_UNLOCK (device_list);
+
+  return path;
+}
+
+/**
+ * gst_mfx_device_list_select:
+ * @selection: the #GstMfxDeviceSelection policy
+ * @device_path: (allow-none): explicitly requested DRM node
+ *
+ * Chooses the DRM node a new pipeline should run on. An explicitly
+ * requested node is honored as is, even if it was not enumerated.
+ * Otherwise @selection picks one of the enumerated nodes. The chosen
+ * node gets one more user, to be dropped with
+ * gst_mfx_device_list_add_users() when the pipeline goes away.
+ *
+ * Returns: (transfer full): the path of the chosen node, or %NULL if no
+ *   node is available
+ */
+gchar *
+gst_mfx_device_list_select (GstMfxDeviceSelection selection,
+    const gchar * device_path)
+{
+  GPtrArray *nodes;
+  GstMfxDeviceNode *node = NULL, *candidate;
+  gchar *path = NULL;
+  guint i;
+
+  G_LOCK (device_list);
+  nodes = ensure_device_nodes ();
+
+  if (device_path) {
+    node = find_device_node (device_path);
+    if (!node)
+      path = g_strdup (device_path);
+  }
+  else if (nodes->len > 0) {
+    switch (selection) {
+      case GST_MFX_DEVICE_SELECTION_LEAST_SESSIONS:
+        for (i = 0; i < nodes->len; i++) {
+          candidate = g_ptr_array_index (nodes, i);
+          if (!node || candidate->num_sessions < node->num_sessions
+              || (candidate->num_sessions == node->num_sessions
+                  && candidate->num_users < node->num_users))
+            node = candidate;
+        }
+        break;
+      case GST_MFX_DEVICE_SELECTION_ROUND_ROBIN:
+      default:
+        node = g_ptr_array_index (nodes, next_device++ % nodes->len);
+        break;
+    }
+  }
+
+  if (node) {
+    node->num_users++;
+    path = g_strdup (node->path);
+  }
+  G_UNLOCK (device_list);
+
+  if (path)
+    GST_INFO ("selected DRM node %s", path);
+  return path;
+}
+
+void
+gst_mfx_device_list_set_default_selection (GstMfxDeviceSelection selection)
+{
+  G_LOCK (device_list);
+  default_selection = selection;
+  G_UNLOCK (device_list);
+}
+
+GstMfxDeviceSelection
+gst_mfx_device_list_get_default_selection (void)
+{
+  GstMfxDeviceSelection selection;
+
+  G_LOCK (device_list);
+  selection = default_selection;
+  G_UNLOCK (device_list);
+
+  return selection;
+}
+
+void
+gst_mfx_device_list_add_users (const gchar * device_path, gint num_users)
+{
+  GstMfxDeviceNode *node;
+
+  G_LOCK (device_list);
+  node = find_device_node (device_path);
+  if (node)
+    node->num_users = MAX ((gint) node->num_users + num_users, 0);
+  G_UNLOCK (device_list);
+}
+
+void
+gst_mfx_device_list_add_sessions (const gchar * device_path,
+    gint num_sessions)
+{
+  GstMfxDeviceNode *node;
+
+  G_LOCK (device_list);
+  node = find_device_node (device_path);
+  if (node)
+    node->num_sessions = MAX ((gint) node->num_sessions + num_sessions, 0);
+  G_UNLOCK (device_list);
+}
+
+/**
+ * gst_mfx_device_list_get_num_sessions:
+ * @device_path: a DRM node path
+ *
+ * Returns: the number of MFX sessions currently in use on @device_path
+ */
+guint
+gst_mfx_device_list_get_num_sessions (const gchar * device_path)
+{
+  GstMfxDeviceNode *node;
+  guint num_sessions = 0;
+
+  G_LOCK (device_list);
+  node = find_device_node (device_path);
+  if (node)
+    num_sessions = node->num_sessions;
+  G_UNLOCK (device_list);
+
+  return num_sessions;
+}
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFX_DEVICE_H
+#define GST_MFX_DEVICE_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GST_MFX_TYPE_DEVICE_SELECTION \
+  (gst_mfx_device_selection_get_type ())
+
+/**
+ * GstMfxDeviceSelection:
+ * @GST_MFX_DEVICE_SELECTION_ROUND_ROBIN: cycle through the devices
+ * @GST_MFX_DEVICE_SELECTION_LEAST_SESSIONS: pick the device with the
+ *   fewest active MFX sessions
+ *
+ * Policy used to choose a render node for a new pipeline, when no
+ * device is requested explicitly.
+ */
+typedef enum
+{
+  GST_MFX_DEVICE_SELECTION_ROUND_ROBIN = 0,
+  GST_MFX_DEVICE_SELECTION_LEAST_SESSIONS,
+} GstMfxDeviceSelection;
+
+GType
+gst_mfx_device_selection_get_type (void);
+
+void
+gst_mfx_device_list_set_nodes (const gchar * const *paths);
+
+guint
+gst_mfx_device_list_get_count (void);
+
+gchar *
+gst_mfx_device_list_get_path (guint index);
+
+gchar *
+gst_mfx_device_list_select (GstMfxDeviceSelection selection,
+    const gchar * device_path);
+
+void
+gst_mfx_device_list_set_default_selection (GstMfxDeviceSelection selection);
+
+GstMfxDeviceSelection
+gst_mfx_device_list_get_default_selection (void);
+
+void
+gst_mfx_device_list_add_users (const gchar * device_path, gint num_users);
+
+void
+gst_mfx_device_list_add_sessions (const gchar * device_path,
+    gint num_sessions);
+
+guint
+gst_mfx_device_list_get_num_sessions (const gchar * device_path);
+
+G_END_DECLS
+
+#endif /* GST_MFX_DEVICE_H */
@@ -60,6 +60,15 @@ get_display_fd (GstMfxDisplay * display)
   struct udev_list_entry *l;
   guint i;
 
+  if (!priv->display_fd && priv->device_path) {
+    priv->display_fd = open (priv->device_path, O_RDWR | O_CLOEXEC);
+    if (priv->display_fd < 0) {
+      GST_ERROR ("failed to open DRM node %s", priv->device_path);
+      priv->display_fd = 0;
+    }
+    return priv->display_fd;
+  }
+
   if (!priv->display_fd) {
     udev = udev_new ();
     if (!udev)
@@ -211,6 +220,9 @@ gst_mfx_display_destroy (GstMfxDisplay * display)
 
   g_free (priv->vendor_string);
   priv->vendor_string = NULL;
+
+  g_free (priv->device_path);
+  priv->device_path = NULL;
 }
 
 static gboolean
@@ -364,6 +376,41 @@ gst_mfx_display_new (void)
   return display;
 }
 
+/**
+ * gst_mfx_display_new_with_device:
+ * @device_path: (allow-none): path of the DRM node to open
+ *
+ * Creates a display on the DRM node at @device_path, or on the first
+ * suitable node if @device_path is %NULL.
+ *
+ * Returns: a new #GstMfxDisplay
+ */
+GstMfxDisplay *
+gst_mfx_display_new_with_device (const gchar * device_path)
+{
+  GstMfxDisplay *display;
+
+  display = (GstMfxDisplay *)
+      gst_mfx_mini_object_new0 (GST_MFX_MINI_OBJECT_CLASS(gst_mfx_display_class ()));
+  if (!display)
+    return NULL;
+
+  GST_MFX_DISPLAY_GET_PRIVATE (display)->device_path = g_strdup (device_path);
+  gst_mfx_display_init (display);
+
+  GST_DEBUG ("creating display on %s", device_path ? device_path : "any node");
+
+  return display;
+}
+
+const gchar *
+gst_mfx_display_get_device_path (GstMfxDisplay * display)
+{
+  g_return_val_if_fail (display != NULL, NULL);
+
+  return GST_MFX_DISPLAY_GET_PRIVATE (display)->device_path;
+}
+
 GstMfxDisplay *
 gst_mfx_display_ref (GstMfxDisplay * display)
 {
@@ -86,6 +86,12 @@ gst_mfx_display_get_type(void);
 GstMfxDisplay *
 gst_mfx_display_new (void);
 
+GstMfxDisplay *
+gst_mfx_display_new_with_device (const gchar * device_path);
+
+const gchar *
+gst_mfx_display_get_device_path (GstMfxDisplay * display);
+
 GstMfxDisplay *
 gst_mfx_display_ref (GstMfxDisplay * display);
 
@@ -93,6 +93,7 @@ struct _GstMfxDisplayPrivate
 {
   GRecMutex mutex;
   GstMfxDisplayType display_type;
+  gchar *device_path;
   int display_fd;
   VADisplay va_display;
   gpointer native_display;
@@ -33,6 +33,16 @@
 #define DEFAULT_QUANTIZER           21
 #define DEFAULT_ASYNC_DEPTH         4
 
+/* Frames whose output could not be matched to their input are forgotten
+ * beyond this many timings */
+#define MAX_PENDING_TIMINGS         64
+
+typedef struct
+{
+  mfxU64 timestamp;
+  gint64 start_time;
+} GstMfxEncodeTiming;
+
 /* Helper function to create a new encoder property object */
 static GstMfxEncoderPropData *
 prop_new (gint id, GParamSpec * pspec)
@@ -470,18 +480,18 @@ gst_mfx_encoder_init_properties (GstMfxEncoder * encoder,
     GstMfxTaskAggregator * aggregator, const GstVideoInfo * info,
     gboolean memtype_is_system)
 {
-  encoder->aggregator = gst_mfx_task_aggregator_ref (aggregator);
+  GstMfxTask *task;
 
-  if ((GST_VIDEO_INFO_FORMAT (info) == GST_VIDEO_FORMAT_NV12) &&
-      !memtype_is_system) {
-    GstMfxTask *task =
-        gst_mfx_task_aggregator_get_current_task (encoder->aggregator);
+  encoder->aggregator = gst_mfx_task_aggregator_ref (aggregator);
+  encoder->backpressure = gst_mfx_backpressure_ref (
+      gst_mfx_task_aggregator_get_backpressure (aggregator));
 
-     if (!task) {
-       GST_ERROR ("Unable to retrieve upstream MFX task from task aggregator.");
-       return FALSE;
-     }
+  task = gst_mfx_task_aggregator_get_current_task (encoder->aggregator);
 
+  /* Without any upstream MFX task, the video memory input surfaces come
+   * from outside of the SDK, such as imported dmabufs */
+  if ((GST_VIDEO_INFO_FORMAT (info) == GST_VIDEO_FORMAT_NV12) &&
+      !memtype_is_system && task) {
     /* This could be a potentially shared task, so get the mfxFrameInfo
      * from the current task to initialize the new encoder
      * or shared VPP / encoder task */
@@ -493,6 +503,7 @@ gst_mfx_encoder_init_properties (GstMfxEncoder * encoder,
       mfxFrameAllocRequest *req = gst_mfx_task_get_request(task);
       if (!req) {
         GST_ERROR ("Unable to retrieve allocation request for encoder task.");
+        gst_mfx_task_unref (task);
         return FALSE;
       }
       encoder->frame_info = req->Info;
@@ -520,17 +531,15 @@ gst_mfx_encoder_init_properties (GstMfxEncoder * encoder,
     }
   }
   else {
+    if (task)
+      gst_mfx_task_unref (task);
     init_encoder_task (encoder);
   }
   if (!encoder->encode)
     return FALSE;
 
-  encoder->bs.MaxLength = info->width * info->height * 4;
-  encoder->bitstream = g_byte_array_sized_new (encoder->bs.MaxLength);
-  if (!encoder->bitstream)
-    return FALSE;
-  encoder->bs.Data = encoder->bitstream->data;
   encoder->async_depth = DEFAULT_ASYNC_DEPTH;
+  encoder->timings = g_array_new (FALSE, FALSE, sizeof (GstMfxEncodeTiming));
 
   encoder->info = *info;
   if (!encoder->info.fps_n)
@@ -582,6 +591,49 @@ error_invalid_vtable:
   }
 }
 
+/* Encode operation submitted to the device and not output yet */
+typedef struct
+{
+  mfxBitstream bs;
+  mfxSyncPoint syncp;
+  mfxEncodeCtrl ctrl;
+  GstVideoCodecFrame *frame;
+} GstMfxEncodeOperation;
+
+static GstMfxEncodeOperation *
+encode_operation_new (GstMfxEncoder * encoder, GstVideoCodecFrame * frame)
+{
+  GstMfxEncodeOperation *op = g_slice_new0 (GstMfxEncodeOperation);
+
+  if (!gst_mfx_bitstream_pool_acquire (encoder->bitstream_pool, &op->bs)) {
+    g_slice_free (GstMfxEncodeOperation, op);
+    return NULL;
+  }
+  if (frame)
+    op->frame = gst_video_codec_frame_ref (frame);
+  return op;
+}
+
+static void
+encode_operation_free (GstMfxEncoder * encoder, GstMfxEncodeOperation * op)
+{
+  gst_mfx_bitstream_pool_release (encoder->bitstream_pool, &op->bs);
+  if (op->frame)
+    gst_video_codec_frame_unref (op->frame);
+  g_slice_free (GstMfxEncodeOperation, op);
+}
+
+static void
+discard_operations (GstMfxEncoder * encoder)
+{
+  GstMfxEncodeOperation *op;
+
+  while ((op = g_queue_pop_head (&encoder->pending_ops)))
+    encode_operation_free (encoder, op);
+  while ((op = g_queue_pop_head (&encoder->ready_ops)))
+    encode_operation_free (encoder, op);
+}
+
 /* Base encoder cleanup (internal) */
 void
 gst_mfx_encoder_finalize (GstMfxEncoder * encoder)
@@ -590,8 +642,14 @@ gst_mfx_encoder_finalize (GstMfxEncoder * encoder)
 
   klass->finalize (encoder);
 
-  g_byte_array_unref (encoder->bitstream);
+  if (encoder->bitstream_pool) {
+    discard_operations (encoder);
+    gst_mfx_bitstream_pool_unref (encoder->bitstream_pool);
+  }
+  gst_mfx_backpressure_replace (&encoder->backpressure, NULL);
   gst_mfx_task_aggregator_unref (encoder->aggregator);
+  if (encoder->timings)
+    g_array_unref (encoder->timings);
 
   if (encoder->properties) {
     g_ptr_array_unref (encoder->properties);
@@ -661,6 +719,33 @@ gst_mfx_encoder_set_async_depth (GstMfxEncoder * encoder, mfxU16 async_depth)
   return TRUE;
 }
 
+guint64
+gst_mfx_encoder_get_wait_time (GstMfxEncoder * encoder)
+{
+  g_return_val_if_fail (encoder != NULL, 0);
+
+  return encoder->wait_time;
+}
+
+/**
+ * gst_mfx_encoder_get_latency:
+ * @encoder: a #GstMfxEncoder
+ * @latency: return location for the encode latency statistics
+ *
+ * Retrieves the time taken by the frames encoded so far from being
+ * submitted to the encoder to being output, including any time spent
+ * buffered by the encoder for lookahead or B-frames.
+ */
+void
+gst_mfx_encoder_get_latency (GstMfxEncoder * encoder,
+    GstMfxEncoderLatency * latency)
+{
+  g_return_if_fail (encoder != NULL);
+  g_return_if_fail (latency != NULL);
+
+  *latency = encoder->latency;
+}
+
 gboolean
 gst_mfx_encoder_set_gop_refdist (GstMfxEncoder * encoder, gint gop_refdist)
 {
@@ -793,6 +878,31 @@ set_extended_coding_options (GstMfxEncoder * encoder)
     encoder->extco.CAVLC =
         !encoder->use_cabac ? MFX_CODINGOPTION_ON : MFX_CODINGOPTION_OFF;
     encoder->extco2.Trellis = encoder->trellis;
+
+    /* Lets decoders output each frame as soon as it is decoded */
+    if (encoder->low_latency)
+      encoder->extco.MaxDecFrameBuffering = encoder->num_refs;
+  }
+
+  if (encoder->intra_refresh != GST_MFX_ENCODER_INTRA_REFRESH_NONE) {
+    gdouble frame_rate;
+
+    encoder->extco2.IntRefType = encoder->intra_refresh;
+    encoder->extco2.IntRefQPDelta = encoder->intra_refresh_qp_delta;
+    if (encoder->intra_refresh_cycle_size) {
+      encoder->extco2.IntRefCycleSize = encoder->intra_refresh_cycle_size;
+    }
+    else {
+      /* Refresh the whole picture about once per second */
+      gst_util_fraction_to_double (encoder->info.fps_n,
+          encoder->info.fps_d, &frame_rate);
+      encoder->extco2.IntRefCycleSize = MAX ((mfxU16) (frame_rate + 0.5), 2);
+    }
+
+    /* Signals decoders where they can start from, since there are no
+     * IDR frames past the first one */
+    if (MFX_CODEC_AVC == encoder->codec)
+      encoder->extco.RecoveryPointSEI = MFX_CODINGOPTION_ON;
   }
 
   switch (encoder->rc_method) {
@@ -828,10 +938,57 @@ set_extended_coding_options (GstMfxEncoder * encoder)
   encoder->params.ExtParam = encoder->extparam_internal;
 }
 
+/* Outputs each frame as soon as it is encoded, at the expense of
+ * compression efficiency: no lookahead and no B-frames to wait for, and
+ * a single frame in flight */
+static void
+set_low_latency_options (GstMfxEncoder * encoder)
+{
+  GstMfxRateControl rc_method = encoder->rc_method;
+
+  switch (rc_method) {
+    case GST_MFX_RATECONTROL_LA_BRC:
+      rc_method = GST_MFX_RATECONTROL_VBR;
+      break;
+    case GST_MFX_RATECONTROL_LA_HRD:
+      rc_method = GST_MFX_RATECONTROL_CBR;
+      break;
+    case GST_MFX_RATECONTROL_LA_ICQ:
+      rc_method = GST_MFX_RATECONTROL_ICQ;
+      break;
+    default:
+      break;
+  }
+  if (rc_method != encoder->rc_method) {
+    GST_WARNING ("Lookahead rate control %d replaced with %d in low "
+        "latency mode", encoder->rc_method, rc_method);
+    encoder->rc_method = rc_method;
+  }
+
+  encoder->async_depth = 1;
+  encoder->gop_refdist = 1;
+  encoder->b_strategy = GST_MFX_OPTION_OFF;
+  encoder->adaptive_b = GST_MFX_OPTION_OFF;
+  if (!encoder->num_refs)
+    encoder->num_refs = 1;
+}
+
 /* Many of the default settings here are inspired by Handbrake */
 static void
 gst_mfx_encoder_set_encoding_params (GstMfxEncoder * encoder)
 {
+  if (encoder->low_latency)
+    set_low_latency_options (encoder);
+
+  /* Intra refresh only works with P-frames, and replaces the periodic
+   * IDR frames unless a GOP size was explicitly set */
+  if (encoder->intra_refresh != GST_MFX_ENCODER_INTRA_REFRESH_NONE) {
+    encoder->gop_refdist = 1;
+    encoder->b_strategy = GST_MFX_OPTION_OFF;
+    if (!encoder->gop_size)
+      encoder->gop_size = G_MAXUINT16;
+  }
+
   encoder->params.mfx.CodecProfile = encoder->profile;
   encoder->params.AsyncDepth = encoder->async_depth;
 
@@ -917,6 +1074,7 @@ gst_mfx_encoder_start (GstMfxEncoder *encoder)
   mfxFrameAllocRequest *request;
   mfxFrameAllocRequest enc_request;
   gboolean memtype_is_system = FALSE;
+  gsize bs_size;
 
   /* Use input system memory with SW HEVC encoder or when linked directly
    * with SW HEVC decoder decoding HEVC main-10 streams */
@@ -1020,28 +1178,292 @@ gst_mfx_encoder_start (GstMfxEncoder *encoder)
   memset (&encoder->params, 0, sizeof(mfxVideoParam));
   MFXVideoENCODE_GetVideoParam (encoder->session, &encoder->params);
 
+  /* Size coded buffers from the HRD buffer size reported by the encoder,
+   * falling back to the size of a raw NV12 frame when it is unset */
+  bs_size = (gsize) encoder->params.mfx.BufferSizeInKB
+      * MAX (encoder->params.mfx.BRCParamMultiplier, 1) * 1000;
+  if (!bs_size)
+    bs_size = encoder->info.width * encoder->info.height * 3 / 2;
+
+  if (encoder->bitstream_pool) {
+    discard_operations (encoder);
+    gst_mfx_bitstream_pool_unref (encoder->bitstream_pool);
+  }
+  encoder->bitstream_pool = gst_mfx_bitstream_pool_new (bs_size);
+  if (!encoder->bitstream_pool)
+    return GST_MFX_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
+
   GST_INFO ("Initialized MFX encoder task using input %s memory surfaces",
     memtype_is_system ? "system" : "video");
 
   return GST_MFX_ENCODER_STATUS_SUCCESS;
 }
 
+static guint
+get_in_flight_limit (GstMfxEncoder * encoder)
+{
+  return MAX (encoder->params.AsyncDepth, 1);
+}
+
+/* Waits for the oldest pending operation to complete, or only checks
+ * whether it has when @wait is FALSE, and moves it to the ready queue */
+static GstMfxEncoderStatus
+sync_oldest_operation (GstMfxEncoder * encoder, gboolean wait)
+{
+  GstMfxEncodeOperation *op = g_queue_peek_head (&encoder->pending_ops);
+  mfxStatus sts;
+
+  if (!op)
+    return GST_MFX_ENCODER_STATUS_MORE_DATA;
+
+  do {
+    sts = MFXVideoCORE_SyncOperation (encoder->session, op->syncp,
+        wait ? 1000 : 0);
+  } while (wait && MFX_WRN_IN_EXECUTION == sts);
+
+  if (MFX_WRN_IN_EXECUTION == sts)
+    return GST_MFX_ENCODER_STATUS_MORE_DATA;
+
+  g_queue_pop_head (&encoder->pending_ops);
+  gst_mfx_backpressure_signal (encoder->backpressure);
+
+  if (MFX_ERR_NONE != sts) {
+    GST_ERROR ("Error during MFX encoding sync %d", sts);
+    encode_operation_free (encoder, op);
+    return GST_MFX_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
+
+  g_queue_push_tail (&encoder->ready_ops, op);
+  return GST_MFX_ENCODER_STATUS_SUCCESS;
+}
+
+/* With H.264 intra refresh, a key unit is provided by the next refresh
+ * cycle rather than by an IDR frame, which would defeat the purpose of
+ * intra refresh. The refresh cycles follow each other, so the next one
+ * starts at most a cycle from now. Other codecs have no recovery point
+ * SEI to tell decoders about it, so they still get an IDR frame */
+static void
+request_key_frame (GstMfxEncoder * encoder, GstMfxEncodeOperation * op)
+{
+  if (encoder->intra_refresh != GST_MFX_ENCODER_INTRA_REFRESH_NONE
+      && MFX_CODEC_AVC == encoder->codec) {
+    encoder->refresh_requested = TRUE;
+    return;
+  }
+
+  op->ctrl.FrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_REF |
+      MFX_FRAMETYPE_IDR;
+}
+
+/* Submits @surface, or drains the encoder if @surface is NULL. Returns
+ * MORE_DATA when the encoder buffered the input without producing any
+ * output, in which case @frame is not kept */
+static GstMfxEncoderStatus
+submit_operation (GstMfxEncoder * encoder, GstVideoCodecFrame * frame,
+    mfxFrameSurface1 * surface)
+{
+  GstMfxEncodeOperation *op;
+  GstMfxEncoderStatus status;
+  mfxStatus sts = MFX_ERR_NONE;
+  guint busy_retries = 0;
+
+  /* Keep at most AsyncDepth operations in flight */
+  while (g_queue_get_length (&encoder->pending_ops) >=
+      get_in_flight_limit (encoder)) {
+    status = sync_oldest_operation (encoder, TRUE);
+    if (GST_MFX_ENCODER_STATUS_SUCCESS != status)
+      return status;
+  }
+
+  op = encode_operation_new (encoder, frame);
+  if (!op)
+    return GST_MFX_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
+
+  if (frame && GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame))
+    request_key_frame (encoder, op);
+
+  do {
+    sts = MFXVideoENCODE_EncodeFrameAsync (encoder->session,
+            op->ctrl.FrameType ? &op->ctrl : NULL, surface, &op->bs,
+            &op->syncp);
+
+    if (MFX_WRN_DEVICE_BUSY == sts) {
+      /* Completing the oldest operation frees up the device faster than
+       * sleeping on it */
+      if (!g_queue_is_empty (&encoder->pending_ops)) {
+        status = sync_oldest_operation (encoder, TRUE);
+        if (status < GST_MFX_ENCODER_STATUS_SUCCESS) {
+          encode_operation_free (encoder, op);
+          return status;
+        }
+      }
+      else {
+        encoder->wait_time += gst_mfx_backpressure_wait (encoder->backpressure,
+            busy_retries++);
+      }
+    }
+    else if (MFX_ERR_NOT_ENOUGH_BUFFER == sts) {
+      if (!gst_mfx_bitstream_pool_grow (encoder->bitstream_pool, &op->bs)) {
+        encode_operation_free (encoder, op);
+        return GST_MFX_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
+      }
+    }
+  } while (MFX_WRN_DEVICE_BUSY == sts || MFX_ERR_NOT_ENOUGH_BUFFER == sts);
+
+  if (MFX_ERR_NONE != sts && MFX_WRN_VIDEO_PARAM_CHANGED != sts) {
+    encode_operation_free (encoder, op);
+    if (MFX_ERR_MORE_DATA == sts)
+      return GST_MFX_ENCODER_STATUS_MORE_DATA;
+    else if (MFX_ERR_MORE_BITSTREAM == sts)
+      return GST_MFX_ENCODER_STATUS_NO_BUFFER;
+
+    GST_ERROR ("Error during MFX encoding %d", sts);
+    return GST_MFX_ENCODER_STATUS_ERROR_UNKNOWN;
+  }
+
+  if (!op->syncp) {
+    encode_operation_free (encoder, op);
+    return GST_MFX_ENCODER_STATUS_MORE_DATA;
+  }
+
+  g_queue_push_tail (&encoder->pending_ops, op);
+  return GST_MFX_ENCODER_STATUS_SUCCESS;
+}
+
+static void
+record_start_time (GstMfxEncoder * encoder, mfxU64 timestamp)
+{
+  GstMfxEncodeTiming timing;
+
+  if (encoder->timings->len >= MAX_PENDING_TIMINGS)
+    g_array_remove_index (encoder->timings, 0);
+
+  timing.timestamp = timestamp;
+  timing.start_time = g_get_monotonic_time ();
+  g_array_append_val (encoder->timings, timing);
+}
+
+/* Encoded frames are matched to their input by timestamp, since the
+ * encoder may output them in another order than they were submitted */
 static void
-calculate_new_pts_and_dts (GstMfxEncoder * encoder, GstVideoCodecFrame * frame)
+record_latency (GstMfxEncoder * encoder, mfxU64 timestamp)
+{
+  GstMfxEncoderLatency *const latency = &encoder->latency;
+  GstMfxEncodeTiming *timing;
+  guint64 elapsed;
+  guint i;
+
+  for (i = 0; i < encoder->timings->len; i++) {
+    timing = &g_array_index (encoder->timings, GstMfxEncodeTiming, i);
+    if (timing->timestamp == timestamp)
+      break;
+  }
+  if (i == encoder->timings->len)
+    return;
+
+  elapsed = g_get_monotonic_time () - timing->start_time;
+  g_array_remove_index (encoder->timings, i);
+
+  latency->last = elapsed;
+  if (!latency->num_frames || elapsed < latency->min)
+    latency->min = elapsed;
+  if (elapsed > latency->max)
+    latency->max = elapsed;
+  latency->total += elapsed;
+  latency->num_frames++;
+}
+
+/* Whether the next output frame starts a refresh cycle, and moves on to
+ * the following frame. The picture is fully refreshed once the cycle
+ * completes, so decoding can start from there. Cycles start right after
+ * the IDR frame, and there are no B-frames with intra refresh */
+static gboolean
+next_refresh_phase (GstMfxEncoder * encoder)
+{
+  mfxU16 cycle_size = encoder->extco2.IntRefCycleSize;
+  gboolean cycle_start;
+
+  if (encoder->intra_refresh == GST_MFX_ENCODER_INTRA_REFRESH_NONE
+      || !cycle_size)
+    return FALSE;
+
+  cycle_start = encoder->refresh_phase == 0;
+  encoder->refresh_phase = (encoder->refresh_phase + 1) % cycle_size;
+  return cycle_start;
+}
+
+/* Turns the oldest completed operation into an output frame */
+static GstVideoCodecFrame *
+finish_operation (GstMfxEncoder * encoder)
 {
+  GstMfxEncodeOperation *op = g_queue_pop_head (&encoder->ready_ops);
+  GstVideoCodecFrame *frame;
+
+  record_latency (encoder, op->bs.TimeStamp);
+
+  frame = op->frame;
+  op->frame = NULL;
+  if (!frame) {
+    /* Frames drained at end of stream have no input frame attached */
+    frame = g_slice_new0 (GstVideoCodecFrame);
+    frame->ref_count = 1;
+  }
+  else {
+    gst_mfx_surface_dequeue (gst_video_codec_frame_get_user_data (frame));
+  }
+
   frame->duration = encoder->duration;
-  frame->pts = (encoder->bs.TimeStamp / (gdouble) 90000) * 1000000000;
-  frame->dts = (encoder->bs.DecodeTimeStamp / (gdouble) 90000) * 1000000000;
+  frame->pts = (op->bs.TimeStamp / (gdouble) 90000) * 1000000000;
+  frame->dts = (op->bs.DecodeTimeStamp / (gdouble) 90000) * 1000000000;
+
+  if (op->bs.FrameType & MFX_FRAMETYPE_IDR
+      || op->bs.FrameType & MFX_FRAMETYPE_xIDR) {
+    GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
+    encoder->refresh_phase = 0;
+    encoder->refresh_requested = FALSE;
+  }
+  else if (next_refresh_phase (encoder) && encoder->refresh_requested) {
+    GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
+    encoder->refresh_requested = FALSE;
+  }
+  else {
+    GST_VIDEO_CODEC_FRAME_UNSET_SYNC_POINT (frame);
+  }
+
+  gst_buffer_replace (&frame->output_buffer, NULL);
+  frame->output_buffer =
+      gst_mfx_bitstream_pool_wrap (encoder->bitstream_pool, &op->bs);
+
+  encode_operation_free (encoder, op);
+
+  return frame;
 }
 
+/**
+ * gst_mfx_encoder_encode:
+ * @encoder: a #GstMfxEncoder
+ * @frame: a #GstVideoCodecFrame holding the input surface as user data
+ *
+ * Submits @frame to the encoder without waiting for it to be encoded.
+ * Up to AsyncDepth frames are kept in flight, and the encoded frames are
+ * retrieved in order with gst_mfx_encoder_get_output().
+ *
+ * Return value: a #GstMfxEncoderStatus
+ */
 GstMfxEncoderStatus
 gst_mfx_encoder_encode (GstMfxEncoder * encoder, GstVideoCodecFrame * frame)
 {
   GstMfxSurface *surface, *filter_surface;
   GstMfxFilterStatus filter_sts;
+  GstMfxEncoderStatus status;
   mfxFrameSurface1 *insurf;
-  mfxSyncPoint syncp;
-  mfxStatus sts = MFX_ERR_NONE;
+
+  g_return_val_if_fail (encoder != NULL,
+      GST_MFX_ENCODER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (frame != NULL,
+      GST_MFX_ENCODER_STATUS_ERROR_INVALID_PARAMETER);
+
+  encoder->draining = FALSE;
 
   surface = gst_video_codec_frame_get_user_data (frame);
 
@@ -1066,106 +1488,85 @@ gst_mfx_encoder_encode (GstMfxEncoder * encoder, GstVideoCodecFrame * frame)
   insurf->Data.TimeStamp =
       gst_util_uint64_scale (encoder->current_pts, 90000, GST_SECOND);
   encoder->current_pts += encoder->duration;
+  record_start_time (encoder, insurf->Data.TimeStamp);
 
-  do {
-    sts = MFXVideoENCODE_EncodeFrameAsync (encoder->session,
-            NULL, insurf, &encoder->bs, &syncp);
-
-    if (MFX_WRN_DEVICE_BUSY == sts)
-      g_usleep (500);
-    else if (MFX_ERR_NOT_ENOUGH_BUFFER == sts) {
-      encoder->bs.MaxLength += 1024 * 16;
-      encoder->bitstream = g_byte_array_set_size (encoder->bitstream,
-          encoder->bs.MaxLength);
-      encoder->bs.Data = encoder->bitstream->data;
-    }
-  } while (MFX_WRN_DEVICE_BUSY == sts || MFX_ERR_NOT_ENOUGH_BUFFER == sts);
-
-  if (MFX_ERR_MORE_BITSTREAM == sts)
-    return GST_MFX_ENCODER_STATUS_NO_BUFFER;
-  else if (MFX_ERR_MORE_DATA == sts)
-    return GST_MFX_ENCODER_STATUS_MORE_DATA;
-
-  if (sts != MFX_ERR_NONE
-      && sts != MFX_ERR_MORE_BITSTREAM
-      && sts != MFX_WRN_VIDEO_PARAM_CHANGED) {
-    GST_ERROR ("Error during MFX encoding.");
-    return GST_MFX_ENCODER_STATUS_ERROR_UNKNOWN;
-  }
-
-  if (syncp) {
-    do {
-      sts = MFXVideoCORE_SyncOperation (encoder->session, syncp, 1000);
-    } while (MFX_WRN_IN_EXECUTION == sts);
+  status = submit_operation (encoder, frame, insurf);
+  if (GST_MFX_ENCODER_STATUS_MORE_DATA == status)
+    gst_mfx_surface_dequeue (gst_video_codec_frame_get_user_data (frame));
+  return status;
+}
 
-    frame->output_buffer =
-        gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
-          encoder->bs.Data, encoder->bs.MaxLength,
-          encoder->bs.DataOffset, encoder->bs.DataLength, NULL, NULL);
+/**
+ * gst_mfx_encoder_get_output:
+ * @encoder: a #GstMfxEncoder
+ * @out_frame_ptr: return location for the encoded #GstVideoCodecFrame
+ *
+ * Retrieves the oldest encoded frame if it has completed, without
+ * blocking on the device. In low latency mode, it waits for the frame to
+ * complete instead, so that each frame is output as soon as it was
+ * submitted. Frames are returned in submission order.
+ *
+ * Return value: %GST_MFX_ENCODER_STATUS_SUCCESS if @out_frame_ptr was
+ *   set, %GST_MFX_ENCODER_STATUS_MORE_DATA if no frame is ready yet
+ */
+GstMfxEncoderStatus
+gst_mfx_encoder_get_output (GstMfxEncoder * encoder,
+    GstVideoCodecFrame ** out_frame_ptr)
+{
+  GstMfxEncoderStatus status;
 
-    calculate_new_pts_and_dts (encoder, frame);
+  g_return_val_if_fail (encoder != NULL,
+      GST_MFX_ENCODER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (out_frame_ptr != NULL,
+      GST_MFX_ENCODER_STATUS_ERROR_INVALID_PARAMETER);
 
-    encoder->bs.DataLength = 0;
+  if (g_queue_is_empty (&encoder->ready_ops)) {
+    status = sync_oldest_operation (encoder, encoder->low_latency);
+    if (GST_MFX_ENCODER_STATUS_SUCCESS != status)
+      return status;
   }
 
-  if (encoder->bs.FrameType & MFX_FRAMETYPE_IDR
-      || encoder->bs.FrameType & MFX_FRAMETYPE_xIDR)
-    GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
-  else
-    GST_VIDEO_CODEC_FRAME_UNSET_SYNC_POINT (frame);
-
+  *out_frame_ptr = finish_operation (encoder);
   return GST_MFX_ENCODER_STATUS_SUCCESS;
 }
 
+/**
+ * gst_mfx_encoder_flush:
+ * @encoder: a #GstMfxEncoder
+ * @frame: return location for the encoded #GstVideoCodecFrame
+ *
+ * Drains the frames buffered by the encoder and returns them one at a
+ * time, waiting for each of them to complete.
+ *
+ * Return value: %GST_MFX_ENCODER_STATUS_SUCCESS if @frame was set,
+ *   %GST_MFX_ENCODER_STATUS_MORE_DATA once the encoder is fully drained
+ */
 GstMfxEncoderStatus
 gst_mfx_encoder_flush (GstMfxEncoder * encoder, GstVideoCodecFrame ** frame)
 {
-  mfxSyncPoint syncp;
-  mfxStatus sts = MFX_ERR_NONE;
+  GstMfxEncoderStatus status;
 
-  do {
-    sts = MFXVideoENCODE_EncodeFrameAsync (encoder->session,
-            NULL, NULL, &encoder->bs, &syncp);
+  g_return_val_if_fail (encoder != NULL,
+      GST_MFX_ENCODER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (frame != NULL,
+      GST_MFX_ENCODER_STATUS_ERROR_INVALID_PARAMETER);
 
-    if (MFX_WRN_DEVICE_BUSY == sts)
-      g_usleep (500);
-    else if (MFX_ERR_NOT_ENOUGH_BUFFER == sts) {
-      encoder->bs.MaxLength += 1024 * 16;
-      encoder->bitstream = g_byte_array_set_size (encoder->bitstream,
-          encoder->bs.MaxLength);
-      encoder->bs.Data = encoder->bitstream->data;
+  while (g_queue_is_empty (&encoder->ready_ops)) {
+    if (!encoder->draining) {
+      status = submit_operation (encoder, NULL, NULL);
+      if (GST_MFX_ENCODER_STATUS_MORE_DATA == status)
+        encoder->draining = TRUE;
+      else if (GST_MFX_ENCODER_STATUS_SUCCESS != status)
+        return status;
+      continue;
     }
-  } while (MFX_WRN_DEVICE_BUSY == sts || MFX_ERR_NOT_ENOUGH_BUFFER == sts);
-
-  if (MFX_ERR_NONE != sts)
-    return GST_MFX_ENCODER_STATUS_ERROR_OPERATION_FAILED;
-
-  if (syncp) {
-    do {
-      sts = MFXVideoCORE_SyncOperation (encoder->session, syncp, 1000);
-    } while (MFX_WRN_IN_EXECUTION == sts);
-
-    if (MFX_ERR_NONE != sts)
-      return GST_MFX_ENCODER_STATUS_ERROR_OPERATION_FAILED;
-
-    *frame = g_slice_new0 (GstVideoCodecFrame);
-
-    (*frame)->output_buffer =
-        gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
-          encoder->bs.Data, encoder->bs.MaxLength,
-          encoder->bs.DataOffset, encoder->bs.DataLength, NULL, NULL);
-
-    calculate_new_pts_and_dts (encoder, *frame);
 
-    encoder->bs.DataLength = 0;
+    status = sync_oldest_operation (encoder, TRUE);
+    if (GST_MFX_ENCODER_STATUS_SUCCESS != status)
+      return status;
   }
 
-  if (encoder->bs.FrameType & MFX_FRAMETYPE_IDR
-      || encoder->bs.FrameType & MFX_FRAMETYPE_xIDR)
-    GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (*frame);
-  else
-    GST_VIDEO_CODEC_FRAME_UNSET_SYNC_POINT (*frame);
-
+  *frame = finish_operation (encoder);
   return GST_MFX_ENCODER_STATUS_SUCCESS;
 }
 
@@ -1448,6 +1849,29 @@ gst_mfx_encoder_trellis_get_type (void)
   return g_type;
 }
 
+GType
+gst_mfx_encoder_intra_refresh_get_type (void)
+{
+  static volatile gsize g_type = 0;
+
+  static const GEnumValue intra_refresh_values[] = {
+    {GST_MFX_ENCODER_INTRA_REFRESH_NONE,
+        "No intra refresh", "none"},
+    {GST_MFX_ENCODER_INTRA_REFRESH_VERTICAL,
+        "Vertical intra refresh", "vertical"},
+    {GST_MFX_ENCODER_INTRA_REFRESH_HORIZONTAL,
+        "Horizontal intra refresh", "horizontal"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&g_type)) {
+    GType type = g_enum_register_static ("GstMfxEncoderIntraRefresh",
+        intra_refresh_values);
+    g_once_init_leave (&g_type, type);
+  }
+  return g_type;
+}
+
 GType
 gst_mfx_encoder_lookahead_ds_get_type (void)
 {
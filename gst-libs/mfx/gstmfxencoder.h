@@ -96,6 +96,41 @@ typedef enum {
   GST_MFX_ENCODER_PRESET_VERY_FAST = MFX_TARGETUSAGE_BEST_SPEED,
 } GstMfxEncoderPreset;
 
+/**
+ * GstMfxEncoderIntraRefresh:
+ * @GST_MFX_ENCODER_INTRA_REFRESH_NONE: No intra refresh.
+ * @GST_MFX_ENCODER_INTRA_REFRESH_VERTICAL: Refresh columns of
+ *   macroblocks, sweeping the picture from left to right.
+ * @GST_MFX_ENCODER_INTRA_REFRESH_HORIZONTAL: Refresh rows of
+ *   macroblocks, sweeping the picture from top to bottom (API 1.23).
+ *
+ * Intra refresh modes, spreading the cost of an I-frame over several
+ * P-frames instead of sending periodic IDR frames.
+ */
+typedef enum {
+  GST_MFX_ENCODER_INTRA_REFRESH_NONE = 0,
+  GST_MFX_ENCODER_INTRA_REFRESH_VERTICAL = 1,
+  GST_MFX_ENCODER_INTRA_REFRESH_HORIZONTAL = 2,
+} GstMfxEncoderIntraRefresh;
+
+/**
+ * GstMfxEncoderLatency:
+ * @num_frames: number of frames measured
+ * @last: encode latency of the last frame output, in microseconds
+ * @min: lowest encode latency, in microseconds
+ * @max: highest encode latency, in microseconds
+ * @total: sum of the encode latencies, in microseconds
+ *
+ * Encode latency statistics for gst_mfx_encoder_get_latency().
+ */
+typedef struct {
+  guint64 num_frames;
+  guint64 last;
+  guint64 min;
+  guint64 max;
+  guint64 total;
+} GstMfxEncoderLatency;
+
 typedef enum {
   GST_MFX_ENCODER_PROP_RATECONTROL = 1,
   GST_MFX_ENCODER_PROP_BITRATE,
@@ -143,6 +178,9 @@ gst_mfx_encoder_trellis_get_type (void);
 GType
 gst_mfx_encoder_lookahead_ds_get_type (void);
 
+GType
+gst_mfx_encoder_intra_refresh_get_type (void);
+
 GstMfxEncoder *
 gst_mfx_encoder_ref (GstMfxEncoder * encoder);
 
@@ -186,12 +224,23 @@ gst_mfx_encoder_set_qpb_offset (GstMfxEncoder * encoder, mfxU16 offset);
 gboolean
 gst_mfx_encoder_set_async_depth (GstMfxEncoder * encoder, mfxU16 async_depth);
 
+guint64
+gst_mfx_encoder_get_wait_time (GstMfxEncoder * encoder);
+
+void
+gst_mfx_encoder_get_latency (GstMfxEncoder * encoder,
+    GstMfxEncoderLatency * latency);
+
 GstMfxEncoderStatus
 gst_mfx_encoder_start (GstMfxEncoder * encoder);
 
 GstMfxEncoderStatus
 gst_mfx_encoder_encode (GstMfxEncoder * encoder, GstVideoCodecFrame * frame);
 
+GstMfxEncoderStatus
+gst_mfx_encoder_get_output (GstMfxEncoder * encoder,
+    GstVideoCodecFrame ** out_frame_ptr);
+
 GstMfxEncoderStatus
 gst_mfx_encoder_flush (GstMfxEncoder * encoder, GstVideoCodecFrame ** frame);
 
@@ -250,6 +250,18 @@ gst_mfx_encoder_h264_set_property (GstMfxEncoder * base_encoder,
     case GST_MFX_ENCODER_H264_PROP_LOOKAHEAD_DS:
       base_encoder->look_ahead_downsampling = g_value_get_enum (value);
       break;
+    case GST_MFX_ENCODER_H264_PROP_LOW_LATENCY:
+      base_encoder->low_latency = g_value_get_boolean (value);
+      break;
+    case GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH:
+      base_encoder->intra_refresh = g_value_get_enum (value);
+      break;
+    case GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_CYCLE_SIZE:
+      base_encoder->intra_refresh_cycle_size = g_value_get_uint (value);
+      break;
+    case GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_QP_DELTA:
+      base_encoder->intra_refresh_qp_delta = g_value_get_int (value);
+      break;
     default:
       return GST_MFX_ENCODER_STATUS_ERROR_INVALID_PARAMETER;
   }
@@ -362,6 +374,63 @@ gst_mfx_encoder_h264_get_default_properties (void)
           GST_MFX_ENCODER_LOOKAHEAD_DS_AUTO,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstMfxEncoderH264:low-latency
+   *
+   * Output each frame as soon as it is encoded, without lookahead nor
+   * B-frames and with a single frame in flight.
+   */
+  GST_MFX_ENCODER_PROPERTIES_APPEND (props,
+      GST_MFX_ENCODER_H264_PROP_LOW_LATENCY,
+      g_param_spec_boolean ("low-latency",
+          "Low latency",
+          "Output each frame as soon as it is encoded",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMfxEncoderH264:intra-refresh
+   *
+   * Refresh the picture with a column or row of intra macroblocks per
+   * frame instead of periodic IDR frames, which keeps the frame sizes
+   * even for low latency streaming.
+   */
+  GST_MFX_ENCODER_PROPERTIES_APPEND (props,
+      GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH,
+      g_param_spec_enum ("intra-refresh",
+          "Intra refresh",
+          "Intra refresh instead of periodic IDR frames",
+          gst_mfx_encoder_intra_refresh_get_type (),
+          GST_MFX_ENCODER_INTRA_REFRESH_NONE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMfxEncoderH264:intra-refresh-cycle-size
+   *
+   * Number of frames over which the whole picture is refreshed, which
+   * is also the longest a key unit request may wait for. 0 refreshes
+   * the picture about once per second.
+   */
+  GST_MFX_ENCODER_PROPERTIES_APPEND (props,
+      GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_CYCLE_SIZE,
+      g_param_spec_uint ("intra-refresh-cycle-size",
+          "Intra refresh cycle size",
+          "Number of frames to refresh the whole picture over (0: auto)",
+          0, G_MAXUINT16, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMfxEncoderH264:intra-refresh-qp-delta
+   *
+   * QP difference of the refreshed intra macroblocks from the rest of
+   * the frame. Positive values flatten the bitrate further at the
+   * expense of the quality of the refreshed area.
+   */
+  GST_MFX_ENCODER_PROPERTIES_APPEND (props,
+      GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_QP_DELTA,
+      g_param_spec_int ("intra-refresh-qp-delta",
+          "Intra refresh QP delta",
+          "QP difference of the refreshed macroblocks",
+          -51, 51, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   return props;
 }
 
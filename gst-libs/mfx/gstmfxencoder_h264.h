@@ -40,6 +40,14 @@ typedef struct _GstMfxEncoderH264 GstMfxEncoderH264;
  * @GST_MFX_ENCODER_H264_PROP_CABAC: Enable CABAC entropy coding mode (bool).
  * @GST_MFX_ENCODER_H264_PROP_TRELLIS:
  * @GST_MFX_ENCODER_H264_PROP_LOOKAHEAD_DS:
+ * @GST_MFX_ENCODER_H264_PROP_LOW_LATENCY: Output each frame as soon as
+ *   it is encoded (bool).
+ * @GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH: Intra refresh type
+ *   (#GstMfxEncoderIntraRefresh).
+ * @GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_CYCLE_SIZE: Number of frames
+ *   to refresh the whole picture over (uint).
+ * @GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_QP_DELTA: QP difference of the
+ *   refreshed macroblocks (int).
  *
  * The set of H.264 encoder specific configurable properties.
  */
@@ -49,6 +57,10 @@ typedef enum {
   GST_MFX_ENCODER_H264_PROP_CABAC = -3,
   GST_MFX_ENCODER_H264_PROP_TRELLIS = -5,
   GST_MFX_ENCODER_H264_PROP_LOOKAHEAD_DS = -6,
+  GST_MFX_ENCODER_H264_PROP_LOW_LATENCY = -7,
+  GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH = -8,
+  GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_CYCLE_SIZE = -9,
+  GST_MFX_ENCODER_H264_PROP_INTRA_REFRESH_QP_DELTA = -10,
 } GstMfxEncoderH264Prop;
 
 GstMfxEncoder *
@@ -34,12 +34,24 @@ typedef struct _GstMfxEncoderH265 GstMfxEncoderH265;
  * GstMfxEncoderH265Prop:
  * @GST_MFX_ENCODER_H265_PROP_LA_DEPTH:
  * @GST_MFX_ENCODER_H265_PROP_LOOKAHEAD_DS:
+ * @GST_MFX_ENCODER_H265_PROP_LOW_LATENCY: Output each frame as soon as
+ *   it is encoded (bool).
+ * @GST_MFX_ENCODER_H265_PROP_INTRA_REFRESH: Intra refresh type
+ *   (#GstMfxEncoderIntraRefresh).
+ * @GST_MFX_ENCODER_H265_PROP_INTRA_REFRESH_CYCLE_SIZE: Number of frames
+ *   to refresh the whole picture over (uint).
+ * @GST_MFX_ENCODER_H265_PROP_INTRA_REFRESH_QP_DELTA: QP difference of the
+ *   refreshed macroblocks (int).
  *
  * The set of H.265 encoder specific configurable properties.
  */
 typedef enum {
   GST_MFX_ENCODER_H265_PROP_LA_DEPTH = -1,
   GST_MFX_ENCODER_H265_PROP_LOOKAHEAD_DS = -2,
+  GST_MFX_ENCODER_H265_PROP_LOW_LATENCY = -3,
+  GST_MFX_ENCODER_H265_PROP_INTRA_REFRESH = -4,
+  GST_MFX_ENCODER_H265_PROP_INTRA_REFRESH_CYCLE_SIZE = -5,
+  GST_MFX_ENCODER_H265_PROP_INTRA_REFRESH_QP_DELTA = -6,
 } GstMfxEncoderH265Prop;
 
 GstMfxEncoder *
@@ -24,6 +24,7 @@
 #define GST_MFX_ENCODER_PRIV_H
 
 #include "gstmfxencoder.h"
+#include "gstmfxbitstreampool.h"
 #include "gstmfxfilter.h"
 #include "gstmfxsurfacepool.h"
 #include "gstmfxvalue.h"
@@ -153,16 +154,21 @@ struct _GstMfxEncoder
   mfxU16                  profile;
 
   GstMfxTaskAggregator   *aggregator;
+  GstMfxBackpressure     *backpressure;
   GstMfxTask             *encode;
   GstMfxFilter           *filter;
-  GByteArray             *bitstream;
+  GstMfxBitstreamPool    *bitstream_pool;
   gboolean                memtype_is_system;
   gboolean                shared;
 
   mfxSession              session;
   mfxVideoParam           params;
   mfxFrameInfo            frame_info;
-  mfxBitstream            bs;
+  /* Submitted operations awaiting sync, then completed ones awaiting
+   * output, both in submission order */
+  GQueue                  pending_ops;
+  GQueue                  ready_ops;
+  gboolean                draining;
   mfxU32                  codec;
   gchar                  *plugin_uid;
   GstVideoInfo            info;
@@ -170,6 +176,14 @@ struct _GstMfxEncoder
   GstClockTime            current_pts;
   GstClockTime            duration;
 
+  /* Total time spent waiting on a busy device, in microseconds */
+  guint64                 wait_time;
+
+  /* Time each frame in flight was submitted, by timestamp, and the
+   * resulting encode latencies */
+  GArray                 *timings;
+  GstMfxEncoderLatency    latency;
+
   /* Encoder params */
   GstMfxEncoderPreset     preset;
   GstMfxRateControl       rc_method;
@@ -202,6 +216,17 @@ struct _GstMfxEncoder
   gboolean                use_cabac;
   gint                    max_slice_size;
 
+  /* H264 and H265 low latency options */
+  gboolean                low_latency;
+  GstMfxEncoderIntraRefresh intra_refresh;
+  mfxU16                  intra_refresh_cycle_size;
+  mfxI16                  intra_refresh_qp_delta;
+  /* Position of the next output frame in the intra refresh cycle, and
+   * whether a key unit was requested while intra refresh replaces IDR
+   * frames */
+  guint                   refresh_phase;
+  gboolean                refresh_requested;
+
   GstMfxOption            mbbrc;
   GstMfxOption            extbrc;
   GstMfxOption            b_strategy;
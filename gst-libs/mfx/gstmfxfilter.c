@@ -34,6 +34,7 @@
   ((GstMfxFilter *)(obj))
 
 typedef struct _GstMfxFilterOpData GstMfxFilterOpData;
+typedef struct _GstMfxFilterPending GstMfxFilterPending;
 
 typedef struct
 {
@@ -49,11 +50,19 @@ struct _GstMfxFilterOpData
   gsize size;
 };
 
+/* Output of a frame submitted to VPP that was not synced yet */
+struct _GstMfxFilterPending
+{
+  mfxFrameSurface1 *outsurf;
+  mfxSyncPoint syncp;
+};
+
 struct _GstMfxFilter
 {
   /*< private > */
   GstMfxMiniObject parent_instance;
   GstMfxTaskAggregator *aggregator;
+  GstMfxBackpressure *backpressure;
   GstMfxTask *vpp[2];
   GstMfxSurfacePool *vpp_pool[2];
   gboolean inited;
@@ -78,6 +87,13 @@ struct _GstMfxFilter
 
   mfxExtBuffer **ext_buffer;
   mfxExtVPPDoUse vpp_use;
+
+  /* Total time spent waiting on a busy device, in microseconds */
+  guint64 wait_time;
+
+  /* Submitted frames, oldest first, and how many may be in flight */
+  GQueue pending;
+  guint pipeline_depth;
 };
 
 static const GstMfxFilterMap filter_map[] = {
@@ -286,6 +302,12 @@ init_params (GstMfxFilter * filter)
     filter->params.vpp.Out.FrameRateExtD = filter->fps_d;
   }
 
+  /* The SDK has to accept as many frames as are kept in flight, and size
+   * the output surface request accordingly */
+  if (filter->pipeline_depth > 1
+      && filter->params.AsyncDepth < filter->pipeline_depth)
+    filter->params.AsyncDepth = filter->pipeline_depth;
+
   configure_filters (filter);
 }
 
@@ -389,7 +411,11 @@ gst_mfx_filter_init (GstMfxFilter * filter,
   filter->params.IOPattern |= is_system_out ?
       MFX_IOPATTERN_OUT_SYSTEM_MEMORY : MFX_IOPATTERN_OUT_VIDEO_MEMORY;
   filter->aggregator = gst_mfx_task_aggregator_ref (aggregator);
+  filter->backpressure = gst_mfx_backpressure_ref (
+      gst_mfx_task_aggregator_get_backpressure (aggregator));
   filter->inited = FALSE;
+  filter->pipeline_depth = 1;
+  g_queue_init (&filter->pending);
 
   if (!filter->vpp[1]) {
     if (!filter->session) {
@@ -424,8 +450,12 @@ gst_mfx_filter_init (GstMfxFilter * filter,
 static void
 gst_mfx_filter_finalize (GstMfxFilter * filter)
 {
+  GstMfxFilterPending *pending;
   guint i;
 
+  while ((pending = g_queue_pop_head (&filter->pending)))
+    g_slice_free (GstMfxFilterPending, pending);
+
   MFXVideoVPP_Close (filter->session);
 
   for (i = 0; i < 2; i++) {
@@ -444,6 +474,7 @@ gst_mfx_filter_finalize (GstMfxFilter * filter)
   g_slice_free1 ((sizeof (mfxExtBuffer *) * filter->params.NumExtParam),
       filter->ext_buffer);
   g_ptr_array_free (filter->filter_op_data, TRUE);
+  gst_mfx_backpressure_replace (&filter->backpressure, NULL);
   gst_mfx_task_aggregator_unref (filter->aggregator);
 }
 
@@ -546,6 +577,25 @@ gst_mfx_filter_get_pool (GstMfxFilter * filter, guint flags)
               GST_MFX_TASK_VPP_OUT)]);
 }
 
+/**
+ * gst_mfx_filter_get_task:
+ * @filter: a #GstMfxFilter
+ * @flags: %GST_MFX_TASK_VPP_IN or %GST_MFX_TASK_VPP_OUT
+ *
+ * Returns: (transfer full): the task on the requested side of @filter,
+ *   or %NULL if @filter has none
+ */
+GstMfxTask *
+gst_mfx_filter_get_task (GstMfxFilter * filter, guint flags)
+{
+  GstMfxTask *task;
+
+  g_return_val_if_fail (filter != NULL, NULL);
+
+  task = filter->vpp[!!(flags & GST_MFX_TASK_VPP_OUT)];
+  return task ? gst_mfx_task_ref (task) : NULL;
+}
+
 gboolean
 gst_mfx_filter_set_format (GstMfxFilter * filter, mfxU32 fourcc)
 {
@@ -1054,15 +1104,10 @@ gst_mfx_filter_start (GstMfxFilter * filter)
   return GST_MFX_FILTER_STATUS_SUCCESS;
 }
 
-GstMfxFilterStatus
-gst_mfx_filter_process (GstMfxFilter * filter, GstMfxSurface * surface,
-    GstMfxSurface ** out_surface)
+static GstMfxFilterStatus
+ensure_started (GstMfxFilter * filter)
 {
-  mfxFrameSurface1 *insurf, *outsurf = NULL;
-  mfxSyncPoint syncp;
-  mfxStatus sts = MFX_ERR_NONE;
-  GstMfxFilterStatus ret = GST_MFX_FILTER_STATUS_SUCCESS;
-  gboolean more_surface = FALSE;
+  GstMfxFilterStatus ret;
 
   /* Delayed VPP initialization to enable surface pool sharing with
    * encoder plugin */
@@ -1072,54 +1117,253 @@ gst_mfx_filter_process (GstMfxFilter * filter, GstMfxSurface * surface,
       return ret;
     filter->inited = TRUE;
   }
+  return GST_MFX_FILTER_STATUS_SUCCESS;
+}
 
-  insurf = gst_mfx_surface_get_frame_surface (surface);
+/* Submits one output surface for @insurf, retrying while the device is
+ * busy. Returns the sync point of the operation in @syncp_ptr, which is
+ * NULL if VPP needs more input before producing anything. */
+static GstMfxFilterStatus
+run_frame (GstMfxFilter * filter, mfxFrameSurface1 * insurf,
+    mfxFrameSurface1 ** outsurf_ptr, mfxSyncPoint * syncp_ptr)
+{
+  GstMfxSurface *surface;
+  mfxFrameSurface1 *outsurf;
+  mfxStatus sts = MFX_ERR_NONE;
+  guint busy_retries = 0;
+
+  *syncp_ptr = NULL;
 
   do {
-    *out_surface = gst_mfx_surface_new_from_pool (filter->vpp_pool[1]);
-    if (!*out_surface)
+    surface = gst_mfx_surface_new_from_pool (filter->vpp_pool[1]);
+    if (!surface)
       return GST_MFX_FILTER_STATUS_ERROR_ALLOCATION_FAILED;
 
-    outsurf = gst_mfx_surface_get_frame_surface (*out_surface);
+    outsurf = gst_mfx_surface_get_frame_surface (surface);
     sts =
         MFXVideoVPP_RunFrameVPPAsync (filter->session, insurf, outsurf, NULL,
-        &syncp);
+        syncp_ptr);
 
     if (MFX_WRN_INCOMPATIBLE_VIDEO_PARAM == sts)
       sts = MFX_ERR_NONE;
 
     if (MFX_WRN_DEVICE_BUSY == sts)
-      g_usleep (500);
+      filter->wait_time += gst_mfx_backpressure_wait (filter->backpressure,
+          busy_retries++);
   } while (MFX_WRN_DEVICE_BUSY == sts);
 
+  *outsurf_ptr = outsurf;
+
   if (MFX_ERR_MORE_DATA == sts)
     return GST_MFX_FILTER_STATUS_ERROR_MORE_DATA;
 
   /* The current frame is ready. Hence treat it
    * as MFX_ERR_NONE and request for more surface
    */
-  if (MFX_ERR_MORE_SURFACE == sts) {
-    sts = MFX_ERR_NONE;
-    more_surface = TRUE;
-  }
+  if (MFX_ERR_MORE_SURFACE == sts)
+    return GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE;
 
   if (MFX_ERR_NONE != sts) {
     GST_ERROR ("Error during MFX filter process.");
     return GST_MFX_FILTER_STATUS_ERROR_OPERATION_FAILED;
   }
+  return GST_MFX_FILTER_STATUS_SUCCESS;
+}
+
+static GstMfxSurface *
+sync_frame (GstMfxFilter * filter, mfxFrameSurface1 * outsurf,
+    mfxSyncPoint syncp)
+{
+  GstMfxSurface *surface;
+  mfxStatus sts;
 
-  if (syncp) {
-    if (!gst_mfx_task_has_type (filter->vpp[1], GST_MFX_TASK_ENCODER))
-      do {
-        sts = MFXVideoCORE_SyncOperation (filter->session, syncp, 1000);
-      } while (MFX_WRN_IN_EXECUTION == sts);
+  surface = gst_mfx_surface_pool_find_surface (filter->vpp_pool[1], outsurf);
 
-    *out_surface =
-        gst_mfx_surface_pool_find_surface (filter->vpp_pool[1], outsurf);
-  }
+  /* In a fused transcode the sync point travels with the surface and
+   * only the encoder at the end of the chain waits for it */
+  if (surface && gst_mfx_task_aggregator_is_fused_transcode (
+          filter->aggregator, filter->vpp[1]))
+    gst_mfx_surface_set_sync_point (surface, syncp);
+  else
+    do {
+      sts = MFXVideoCORE_SyncOperation (filter->session, syncp, 1000);
+    } while (MFX_WRN_IN_EXECUTION == sts);
+  gst_mfx_backpressure_signal (filter->backpressure);
 
-  if (more_surface)
-    return GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE;
+  return surface;
+}
+
+GstMfxFilterStatus
+gst_mfx_filter_process (GstMfxFilter * filter, GstMfxSurface * surface,
+    GstMfxSurface ** out_surface)
+{
+  mfxFrameSurface1 *insurf, *outsurf = NULL;
+  mfxSyncPoint syncp;
+  GstMfxFilterStatus ret;
+
+  ret = ensure_started (filter);
+  if (ret != GST_MFX_FILTER_STATUS_SUCCESS)
+    return ret;
+
+  insurf = gst_mfx_surface_get_frame_surface (surface);
+
+  ret = run_frame (filter, insurf, &outsurf, &syncp);
+  if (GST_MFX_FILTER_STATUS_SUCCESS != ret
+      && GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE != ret
+      && GST_MFX_FILTER_STATUS_ERROR_MORE_DATA != ret)
+    return ret;
+
+  *out_surface = syncp ? sync_frame (filter, outsurf, syncp) :
+      gst_mfx_surface_pool_find_surface (filter->vpp_pool[1], outsurf);
+
+  return ret;
+}
+
+/**
+ * gst_mfx_filter_submit:
+ * @filter: a #GstMfxFilter
+ * @surface: the input #GstMfxSurface
+ *
+ * Queues @surface for processing without waiting for VPP to complete.
+ * Every output it produces, including the extra ones of frame rate
+ * conversion, is kept in flight until gst_mfx_filter_get_output()
+ * returns it. @surface must stay alive and unmodified until then.
+ *
+ * Callers should not keep more frames in flight than the pipeline depth
+ * set with gst_mfx_filter_set_pipeline_depth(), which VPP is initialized
+ * for.
+ *
+ * Return value: %GST_MFX_FILTER_STATUS_SUCCESS if at least one output
+ *   was queued, %GST_MFX_FILTER_STATUS_ERROR_MORE_DATA if VPP needs more
+ *   input first, or an error
+ */
+GstMfxFilterStatus
+gst_mfx_filter_submit (GstMfxFilter * filter, GstMfxSurface * surface)
+{
+  GstMfxFilterPending *pending;
+  mfxFrameSurface1 *insurf, *outsurf = NULL;
+  mfxSyncPoint syncp;
+  GstMfxFilterStatus ret;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (surface != NULL,
+      GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  ret = ensure_started (filter);
+  if (ret != GST_MFX_FILTER_STATUS_SUCCESS)
+    return ret;
+
+  insurf = gst_mfx_surface_get_frame_surface (surface);
+
+  do {
+    ret = run_frame (filter, insurf, &outsurf, &syncp);
+    if (GST_MFX_FILTER_STATUS_SUCCESS != ret
+        && GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE != ret)
+      return ret;
+
+    if (syncp) {
+      pending = g_slice_new (GstMfxFilterPending);
+      pending->outsurf = outsurf;
+      pending->syncp = syncp;
+      g_queue_push_tail (&filter->pending, pending);
+    }
+  } while (GST_MFX_FILTER_STATUS_ERROR_MORE_SURFACE == ret);
 
   return GST_MFX_FILTER_STATUS_SUCCESS;
 }
+
+/**
+ * gst_mfx_filter_get_output:
+ * @filter: a #GstMfxFilter
+ * @wait: whether to block until the oldest output is complete
+ * @out_surface: return location for the output #GstMfxSurface
+ *
+ * Returns the oldest output queued by gst_mfx_filter_submit(), so that
+ * outputs come back in submission order. Unless @wait is set, this
+ * returns only if the output is already complete.
+ *
+ * Return value: %GST_MFX_FILTER_STATUS_SUCCESS if @out_surface was set,
+ *   or %GST_MFX_FILTER_STATUS_ERROR_MORE_DATA if no output is available
+ */
+GstMfxFilterStatus
+gst_mfx_filter_get_output (GstMfxFilter * filter, gboolean wait,
+    GstMfxSurface ** out_surface)
+{
+  GstMfxFilterPending *pending;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (out_surface != NULL,
+      GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  pending = g_queue_peek_head (&filter->pending);
+  if (!pending)
+    return GST_MFX_FILTER_STATUS_ERROR_MORE_DATA;
+
+  if (!wait && !gst_mfx_task_aggregator_is_fused_transcode (
+          filter->aggregator, filter->vpp[1])
+      && MFXVideoCORE_SyncOperation (filter->session, pending->syncp,
+          0) == MFX_WRN_IN_EXECUTION)
+    return GST_MFX_FILTER_STATUS_ERROR_MORE_DATA;
+
+  g_queue_pop_head (&filter->pending);
+  *out_surface = sync_frame (filter, pending->outsurf, pending->syncp);
+  g_slice_free (GstMfxFilterPending, pending);
+
+  return *out_surface ? GST_MFX_FILTER_STATUS_SUCCESS :
+      GST_MFX_FILTER_STATUS_ERROR_OPERATION_FAILED;
+}
+
+/**
+ * gst_mfx_filter_set_pipeline_depth:
+ * @filter: a #GstMfxFilter
+ * @depth: the number of frames that may be in flight, from 1 to 20
+ *
+ * Sets how many frames the caller of gst_mfx_filter_submit() intends to
+ * keep in flight before waiting for the oldest one. VPP is initialized
+ * with an async depth at least as large, so this must be called before
+ * gst_mfx_filter_prepare().
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_mfx_filter_set_pipeline_depth (GstMfxFilter * filter, guint depth)
+{
+  g_return_val_if_fail (filter != NULL, FALSE);
+  g_return_val_if_fail (depth > 0 && depth <= 20, FALSE);
+
+  filter->pipeline_depth = depth;
+  return TRUE;
+}
+
+guint
+gst_mfx_filter_get_pipeline_depth (GstMfxFilter * filter)
+{
+  g_return_val_if_fail (filter != NULL, 0);
+
+  return filter->pipeline_depth;
+}
+
+/**
+ * gst_mfx_filter_get_num_in_flight:
+ * @filter: a #GstMfxFilter
+ *
+ * Return value: the number of outputs submitted to VPP that were not
+ *   returned by gst_mfx_filter_get_output() yet
+ */
+guint
+gst_mfx_filter_get_num_in_flight (GstMfxFilter * filter)
+{
+  g_return_val_if_fail (filter != NULL, 0);
+
+  return filter->pending.length;
+}
+
+guint64
+gst_mfx_filter_get_wait_time (GstMfxFilter * filter)
+{
+  g_return_val_if_fail (filter != NULL, 0);
+
+  return filter->wait_time;
+}
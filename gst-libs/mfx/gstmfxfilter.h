@@ -174,6 +174,22 @@ GstMfxFilterStatus
 gst_mfx_filter_process (GstMfxFilter * filter, GstMfxSurface *surface,
     GstMfxSurface ** out_surface);
 
+GstMfxFilterStatus
+gst_mfx_filter_submit (GstMfxFilter * filter, GstMfxSurface * surface);
+
+GstMfxFilterStatus
+gst_mfx_filter_get_output (GstMfxFilter * filter, gboolean wait,
+    GstMfxSurface ** out_surface);
+
+gboolean
+gst_mfx_filter_set_pipeline_depth (GstMfxFilter * filter, guint depth);
+
+guint
+gst_mfx_filter_get_pipeline_depth (GstMfxFilter * filter);
+
+guint
+gst_mfx_filter_get_num_in_flight (GstMfxFilter * filter);
+
 GstMfxFilterStatus
 gst_mfx_filter_reset (GstMfxFilter * filter);
 
@@ -183,6 +199,9 @@ gst_mfx_filter_has_filter (GstMfxFilter * filter, guint flags);
 GstMfxSurfacePool *
 gst_mfx_filter_get_pool (GstMfxFilter * filter, guint flags);
 
+GstMfxTask *
+gst_mfx_filter_get_task (GstMfxFilter * filter, guint flags);
+
 void
 gst_mfx_filter_set_request (GstMfxFilter * filter,
     mfxFrameAllocRequest * request, guint flags);
@@ -237,5 +256,8 @@ gst_mfx_filter_set_frc_algorithm (GstMfxFilter *filter,
 gboolean
 gst_mfx_filter_set_async_depth (GstMfxFilter * filter, mfxU16 async_depth);
 
+guint64
+gst_mfx_filter_get_wait_time (GstMfxFilter * filter);
+
 
 #endif /* GST_MFX_FILTER_H */
@@ -64,6 +64,15 @@ typedef struct _GstMfxMiniObjectClass         GstMfxMiniObjectClass;
 #define GST_MFX_MINI_OBJECT_GET_CLASS(object) \
   (GST_MFX_MINI_OBJECT (object)->object_class)
 
+/**
+ * GST_MFX_MINI_OBJECT_REFCOUNT_VALUE:
+ * @object: a #GstMfxMiniObject
+ *
+ * Retrieves the current reference count of the @object
+ */
+#define GST_MFX_MINI_OBJECT_REFCOUNT_VALUE(object) \
+  (g_atomic_int_get (&GST_MFX_MINI_OBJECT (object)->ref_count))
+
 /**
  * GST_MFX_MINI_OBJECT_FLAGS:
  * @object: a #GstMfxMiniObject
@@ -0,0 +1,337 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include "gstmfxmultifilter.h"
+#include "gstmfxminiobject.h"
+
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+/**
+ * GstMfxMultiFilter:
+ *
+ * Scales and converts each input surface into several outputs, such as
+ * the renditions of an adaptive bitrate ladder. Every output is a VPP
+ * task of its own, since the SDK runs a single VPP per session, but all
+ * of them read the same input surfaces in sessions joined to the one of
+ * the task producing them. There is no copy of the input per output, and
+ * with a downstream encoder per output the whole graph is a fused
+ * transcode in which VPP never waits for the device.
+ */
+struct _GstMfxMultiFilter
+{
+  /*< private > */
+  GstMfxMiniObject parent_instance;
+
+  GstMfxTaskAggregator *aggregator;
+  /* Task producing the input surfaces, NULL for system memory input */
+  GstMfxTask *upstream;
+  GstVideoInfo info;
+  gboolean is_system_in;
+
+  GPtrArray *outputs;
+  gboolean prepared;
+};
+
+static void
+gst_mfx_multi_filter_finalize (GstMfxMultiFilter * filter)
+{
+  g_ptr_array_free (filter->outputs, TRUE);
+  gst_mfx_task_replace (&filter->upstream, NULL);
+  gst_mfx_task_aggregator_unref (filter->aggregator);
+}
+
+static inline const GstMfxMiniObjectClass *
+gst_mfx_multi_filter_class (void)
+{
+  static const GstMfxMiniObjectClass GstMfxMultiFilterClass = {
+    sizeof (GstMfxMultiFilter),
+    (GDestroyNotify) gst_mfx_multi_filter_finalize
+  };
+  return &GstMfxMultiFilterClass;
+}
+
+/**
+ * gst_mfx_multi_filter_new:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @upstream: (allow-none): the #GstMfxTask producing the input surfaces
+ * @info: the #GstVideoInfo of the input surfaces
+ * @is_system_in: whether the input surfaces are in system memory
+ *
+ * Creates a filter without any output. Every output added with
+ * gst_mfx_multi_filter_add_output() is linked downstream of @upstream,
+ * which is ignored for system memory input. The current task of
+ * @aggregator is not used here, as adding outputs keeps changing it.
+ *
+ * Return value: a newly allocated #GstMfxMultiFilter, or %NULL on error
+ */
+GstMfxMultiFilter *
+gst_mfx_multi_filter_new (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * upstream, const GstVideoInfo * info, gboolean is_system_in)
+{
+  GstMfxMultiFilter *filter;
+
+  g_return_val_if_fail (aggregator != NULL, NULL);
+  g_return_val_if_fail (info != NULL, NULL);
+
+  filter = (GstMfxMultiFilter *)
+      gst_mfx_mini_object_new0 (gst_mfx_multi_filter_class ());
+  if (!filter)
+    return NULL;
+
+  filter->aggregator = gst_mfx_task_aggregator_ref (aggregator);
+  filter->info = *info;
+  filter->is_system_in = is_system_in;
+  filter->outputs =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_mfx_filter_unref);
+
+  if (!is_system_in && upstream)
+    filter->upstream = gst_mfx_task_ref (upstream);
+
+  return filter;
+}
+
+GstMfxMultiFilter *
+gst_mfx_multi_filter_ref (GstMfxMultiFilter * filter)
+{
+  g_return_val_if_fail (filter != NULL, NULL);
+
+  return GST_MFX_MULTI_FILTER (gst_mfx_mini_object_ref (GST_MFX_MINI_OBJECT
+          (filter)));
+}
+
+void
+gst_mfx_multi_filter_unref (GstMfxMultiFilter * filter)
+{
+  g_return_if_fail (filter != NULL);
+
+  gst_mfx_mini_object_unref (GST_MFX_MINI_OBJECT (filter));
+}
+
+void
+gst_mfx_multi_filter_replace (GstMfxMultiFilter ** old_filter_ptr,
+    GstMfxMultiFilter * new_filter)
+{
+  g_return_if_fail (old_filter_ptr != NULL);
+
+  gst_mfx_mini_object_replace ((GstMfxMiniObject **) old_filter_ptr,
+      GST_MFX_MINI_OBJECT (new_filter));
+}
+
+/**
+ * gst_mfx_multi_filter_add_output:
+ * @filter: a #GstMfxMultiFilter
+ * @format: the output format, either NV12 or BGRA
+ * @width: the output width
+ * @height: the output height
+ *
+ * Adds an output producing one surface in video memory per input
+ * surface. Outputs can only be added before gst_mfx_multi_filter_prepare()
+ * is called.
+ *
+ * Return value: the index of the new output, or -1 on error
+ */
+gint
+gst_mfx_multi_filter_add_output (GstMfxMultiFilter * filter,
+    GstVideoFormat format, guint width, guint height)
+{
+  GstMfxFilter *output;
+  GstMfxTask *task;
+
+  g_return_val_if_fail (filter != NULL, -1);
+  g_return_val_if_fail (!filter->prepared, -1);
+
+  if (filter->outputs->len >= GST_MFX_MULTI_FILTER_MAX_OUTPUTS) {
+    GST_ERROR ("Too many outputs, at most %d are supported",
+        GST_MFX_MULTI_FILTER_MAX_OUTPUTS);
+    return -1;
+  }
+
+  output = gst_mfx_filter_new (filter->aggregator, filter->is_system_in,
+      FALSE);
+  if (!output)
+    return -1;
+
+  gst_mfx_filter_set_frame_info_from_gst_video_info (output, &filter->info);
+  gst_mfx_filter_set_size (output, width, height);
+  if (!gst_mfx_filter_set_format (output,
+          gst_video_format_to_mfx_fourcc (format))) {
+    GST_ERROR ("Unsupported output format %s",
+        gst_video_format_to_string (format));
+    gst_mfx_filter_unref (output);
+    return -1;
+  }
+
+  /* Creating the filter made it the current task, so that the next output
+   * would be chained after this one. All outputs read the same surfaces */
+  task = gst_mfx_filter_get_task (output, GST_MFX_TASK_VPP_OUT);
+  gst_mfx_task_aggregator_link_tasks (filter->aggregator, filter->upstream,
+      task);
+  gst_mfx_task_unref (task);
+
+  g_ptr_array_add (filter->outputs, output);
+  return filter->outputs->len - 1;
+}
+
+guint
+gst_mfx_multi_filter_get_num_outputs (GstMfxMultiFilter * filter)
+{
+  g_return_val_if_fail (filter != NULL, 0);
+
+  return filter->outputs->len;
+}
+
+/**
+ * gst_mfx_multi_filter_get_output_filter:
+ * @filter: a #GstMfxMultiFilter
+ * @index: the index of an output
+ *
+ * Returns the filter of an output, to enable further operations on that
+ * output only before gst_mfx_multi_filter_prepare() is called. Those must
+ * produce exactly one surface per input surface, which rules out frame
+ * rate conversion and deinterlacing.
+ *
+ * Return value: (transfer none): the #GstMfxFilter of output @index
+ */
+GstMfxFilter *
+gst_mfx_multi_filter_get_output_filter (GstMfxMultiFilter * filter,
+    guint index)
+{
+  g_return_val_if_fail (filter != NULL, NULL);
+  g_return_val_if_fail (index < filter->outputs->len, NULL);
+
+  return g_ptr_array_index (filter->outputs, index);
+}
+
+/**
+ * gst_mfx_multi_filter_get_output_task:
+ * @filter: a #GstMfxMultiFilter
+ * @index: the index of an output
+ *
+ * Returns: (transfer full): the task producing the surfaces of output
+ *   @index, which a downstream MFX element may share
+ */
+GstMfxTask *
+gst_mfx_multi_filter_get_output_task (GstMfxMultiFilter * filter,
+    guint index)
+{
+  g_return_val_if_fail (filter != NULL, NULL);
+  g_return_val_if_fail (index < filter->outputs->len, NULL);
+
+  return gst_mfx_filter_get_task (g_ptr_array_index (filter->outputs, index),
+      GST_MFX_TASK_VPP_OUT);
+}
+
+gboolean
+gst_mfx_multi_filter_prepare (GstMfxMultiFilter * filter)
+{
+  guint i;
+
+  g_return_val_if_fail (filter != NULL, FALSE);
+
+  if (filter->prepared)
+    return TRUE;
+
+  if (!filter->outputs->len) {
+    GST_ERROR ("No output to prepare");
+    return FALSE;
+  }
+
+  for (i = 0; i < filter->outputs->len; i++)
+    if (!gst_mfx_filter_prepare (g_ptr_array_index (filter->outputs, i)))
+      return FALSE;
+
+  filter->prepared = TRUE;
+  return TRUE;
+}
+
+/* Completes the frames already submitted to the first @count outputs */
+static void
+discard_outputs (GstMfxMultiFilter * filter, guint count)
+{
+  GstMfxSurface *out_surface;
+  guint i;
+
+  for (i = 0; i < count; i++)
+    while (gst_mfx_filter_get_output (g_ptr_array_index (filter->outputs, i),
+            TRUE, &out_surface) == GST_MFX_FILTER_STATUS_SUCCESS);
+}
+
+/**
+ * gst_mfx_multi_filter_process:
+ * @filter: a #GstMfxMultiFilter
+ * @surface: the input #GstMfxSurface
+ * @out_surfaces: return location for one #GstMfxSurface per output
+ *
+ * Runs every output on @surface. The frame is submitted to all outputs
+ * before waiting for any of them so that they run concurrently, and
+ * @surface is kept alive until the last of them has consumed it. In a
+ * fused transcode nothing is waited for here, the output surfaces
+ * carry their sync point instead.
+ *
+ * Return value: %GST_MFX_FILTER_STATUS_SUCCESS if @out_surfaces was
+ *   filled, or an error
+ */
+GstMfxFilterStatus
+gst_mfx_multi_filter_process (GstMfxMultiFilter * filter,
+    GstMfxSurface * surface, GstMfxSurface ** out_surfaces)
+{
+  GstMfxFilterStatus status = GST_MFX_FILTER_STATUS_SUCCESS;
+  guint i, num_submitted;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (surface != NULL,
+      GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (out_surfaces != NULL,
+      GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  if (G_UNLIKELY (!filter->prepared))
+    return GST_MFX_FILTER_STATUS_ERROR_INVALID_PARAMETER;
+
+  gst_mfx_surface_ref (surface);
+
+  for (num_submitted = 0; num_submitted < filter->outputs->len;
+      num_submitted++) {
+    status = gst_mfx_filter_submit (g_ptr_array_index (filter->outputs,
+            num_submitted), surface);
+    if (GST_MFX_FILTER_STATUS_SUCCESS != status)
+      goto error;
+  }
+
+  for (i = 0; i < filter->outputs->len; i++) {
+    status = gst_mfx_filter_get_output (g_ptr_array_index (filter->outputs,
+            i), TRUE, &out_surfaces[i]);
+    if (GST_MFX_FILTER_STATUS_SUCCESS != status) {
+      num_submitted = filter->outputs->len;
+      goto error;
+    }
+  }
+
+  gst_mfx_surface_unref (surface);
+  return GST_MFX_FILTER_STATUS_SUCCESS;
+
+error:
+  GST_ERROR ("Error during MFX multi-output filter process %d", status);
+  discard_outputs (filter, num_submitted);
+  gst_mfx_surface_unref (surface);
+  return status;
+}
@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFX_MULTI_FILTER_H
+#define GST_MFX_MULTI_FILTER_H
+
+#include "gstmfxfilter.h"
+
+G_BEGIN_DECLS
+
+#define GST_MFX_MULTI_FILTER(obj) \
+  ((GstMfxMultiFilter *) (obj))
+
+typedef struct _GstMfxMultiFilter GstMfxMultiFilter;
+
+/* Maximum number of outputs of a #GstMfxMultiFilter */
+#define GST_MFX_MULTI_FILTER_MAX_OUTPUTS 16
+
+GstMfxMultiFilter *
+gst_mfx_multi_filter_new (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * upstream, const GstVideoInfo * info, gboolean is_system_in);
+
+GstMfxMultiFilter *
+gst_mfx_multi_filter_ref (GstMfxMultiFilter * filter);
+
+void
+gst_mfx_multi_filter_unref (GstMfxMultiFilter * filter);
+
+void
+gst_mfx_multi_filter_replace (GstMfxMultiFilter ** old_filter_ptr,
+    GstMfxMultiFilter * new_filter);
+
+gint
+gst_mfx_multi_filter_add_output (GstMfxMultiFilter * filter,
+    GstVideoFormat format, guint width, guint height);
+
+guint
+gst_mfx_multi_filter_get_num_outputs (GstMfxMultiFilter * filter);
+
+GstMfxFilter *
+gst_mfx_multi_filter_get_output_filter (GstMfxMultiFilter * filter,
+    guint index);
+
+GstMfxTask *
+gst_mfx_multi_filter_get_output_task (GstMfxMultiFilter * filter,
+    guint index);
+
+gboolean
+gst_mfx_multi_filter_prepare (GstMfxMultiFilter * filter);
+
+GstMfxFilterStatus
+gst_mfx_multi_filter_process (GstMfxMultiFilter * filter,
+    GstMfxSurface * surface, GstMfxSurface ** out_surfaces);
+
+G_END_DECLS
+
+#endif /* GST_MFX_MULTI_FILTER_H */
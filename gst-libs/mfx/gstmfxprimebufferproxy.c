@@ -28,6 +28,7 @@
 #include "gstmfxsurface_vaapi.h"
 #include "gstmfxtaskaggregator.h"
 #include "gstmfxprimebufferproxy.h"
+#include "gstmfxsurface_priv.h"
 
 #define DEBUG 1
 #include "gstmfxdebug.h"
@@ -42,8 +43,18 @@ struct _GstMfxPrimeBufferProxy
   VABufferInfo buf_info;
   guintptr fd;
   guint data_size;
+  /* FALSE for the export cached by the surface itself, which must not
+   * keep its surface alive */
+  gboolean owns_surface;
+  gboolean has_handle;
+  /* Set once the surface of a cached export was destroyed */
+  volatile gint detached;
 };
 
+/* Number of cached exports detached so far, see
+ * gst_mfx_prime_buffer_proxy_get_detach_count() */
+static volatile gint detach_count;
+
 typedef VAStatus (*vaExtGetSurfaceHandle) (VADisplay dpy,
     VASurfaceID * surface, int *prime_fd);
 
@@ -109,29 +120,45 @@ gst_mfx_prime_buffer_proxy_acquire_handle (GstMfxPrimeBufferProxy * proxy)
     proxy->fd = proxy->buf_info.handle;
   }
 
+  proxy->has_handle = TRUE;
   proxy->data_size = va_img.data_size;
 
   return TRUE;
 }
 
+/* Releases the VA resources of @proxy, which must happen before its
+ * surface is destroyed */
 static void
-gst_mfx_prime_buffer_proxy_finalize (GstMfxPrimeBufferProxy * proxy)
+gst_mfx_prime_buffer_proxy_release_handle (GstMfxPrimeBufferProxy * proxy)
 {
-  if (g_va_get_surface_handle) {
-    close (proxy->fd);
-  }
-  else {
-    VAImage va_img;
-
-    vaapi_image_get_image (proxy->image, &va_img);
-
-    GST_MFX_DISPLAY_LOCK (proxy->display);
-    vaReleaseBufferHandle (GST_MFX_DISPLAY_VADISPLAY (proxy->display), va_img.buf);
-    GST_MFX_DISPLAY_UNLOCK (proxy->display);
+  if (proxy->has_handle) {
+    if (g_va_get_surface_handle) {
+      close (proxy->fd);
+    }
+    else {
+      VAImage va_img;
+
+      vaapi_image_get_image (proxy->image, &va_img);
+
+      GST_MFX_DISPLAY_LOCK (proxy->display);
+      vaReleaseBufferHandle (GST_MFX_DISPLAY_VADISPLAY (proxy->display),
+          va_img.buf);
+      GST_MFX_DISPLAY_UNLOCK (proxy->display);
+    }
+    proxy->has_handle = FALSE;
+    proxy->fd = -1;
   }
 
   vaapi_image_replace (&proxy->image, NULL);
-  gst_mfx_surface_replace (&proxy->surface, NULL);
+}
+
+static void
+gst_mfx_prime_buffer_proxy_finalize (GstMfxPrimeBufferProxy * proxy)
+{
+  gst_mfx_prime_buffer_proxy_release_handle (proxy);
+  if (proxy->owns_surface)
+    gst_mfx_surface_replace (&proxy->surface, NULL);
+  proxy->surface = NULL;
   gst_mfx_display_unref (proxy->display);
 }
 
@@ -152,12 +179,17 @@ gst_mfx_prime_buffer_proxy_new_from_surface (GstMfxSurface * surface)
 
   g_return_val_if_fail (surface != NULL, NULL);
 
+  /* The handle is exported to consumers outside of any MFX session */
+  if (!gst_mfx_surface_sync (surface))
+    return NULL;
+
   proxy = (GstMfxPrimeBufferProxy *)
       gst_mfx_mini_object_new0 (gst_mfx_prime_buffer_proxy_class ());
   if (!proxy)
     return NULL;
 
   proxy->surface = gst_mfx_surface_ref (surface);
+  proxy->owns_surface = TRUE;
 
   if (!gst_mfx_prime_buffer_proxy_acquire_handle (proxy))
     goto error_acquire_handle;
@@ -170,6 +202,108 @@ error_acquire_handle:
   return NULL;
 }
 
+/**
+ * gst_mfx_prime_buffer_proxy_detach:
+ * @proxy: the #GstMfxPrimeBufferProxy cached by a surface
+ *
+ * Called by the surface caching @proxy right before it is destroyed.
+ * The handle and derived image are released while the VA surface still
+ * exists, even if renderers still hold references to @proxy. Those only
+ * keep it for identity checks, and drop their objects built from it once
+ * gst_mfx_prime_buffer_proxy_is_detached() tells them to.
+ */
+void
+gst_mfx_prime_buffer_proxy_detach (GstMfxPrimeBufferProxy * proxy)
+{
+  g_return_if_fail (proxy != NULL);
+  g_return_if_fail (!proxy->owns_surface);
+
+  gst_mfx_prime_buffer_proxy_release_handle (proxy);
+  proxy->surface = NULL;
+  g_atomic_int_set (&proxy->detached, TRUE);
+  g_atomic_int_inc (&detach_count);
+}
+
+gboolean
+gst_mfx_prime_buffer_proxy_is_detached (GstMfxPrimeBufferProxy * proxy)
+{
+  g_return_val_if_fail (proxy != NULL, TRUE);
+
+  return g_atomic_int_get (&proxy->detached);
+}
+
+/**
+ * gst_mfx_prime_buffer_proxy_get_detach_count:
+ *
+ * Returns a counter bumped whenever a cached export is detached, e.g.
+ * when a surface pool is torn down. Renderer caches compare it with the
+ * value they last saw, and only look for detached entries when it
+ * changed.
+ *
+ * Returns: the number of cached exports detached so far
+ */
+guint
+gst_mfx_prime_buffer_proxy_get_detach_count (void)
+{
+  return g_atomic_int_get (&detach_count);
+}
+
+/**
+ * gst_mfx_prime_buffer_proxy_get_from_surface:
+ * @surface: a #GstMfxSurface
+ *
+ * Returns the PRIME export of @surface, creating it on first use. The
+ * export is cached by the surface until it is destroyed along with its
+ * pool, so that renderers displaying pooled surfaces over and over do
+ * not have to derive an image and export a handle on every frame.
+ *
+ * Unlike gst_mfx_prime_buffer_proxy_new_from_surface(), the returned
+ * proxy does not keep @surface alive, and is detached when @surface is
+ * destroyed. Renderers holding on to it check for that with
+ * gst_mfx_prime_buffer_proxy_is_detached(), or notice that the surface
+ * ID was reused by comparing it with the proxy returned for the new
+ * surface.
+ *
+ * Returns: (transfer full): the cached #GstMfxPrimeBufferProxy of
+ *   @surface, or %NULL on error
+ */
+GstMfxPrimeBufferProxy *
+gst_mfx_prime_buffer_proxy_get_from_surface (GstMfxSurface * surface)
+{
+  GstMfxPrimeBufferProxy *proxy;
+
+  g_return_val_if_fail (surface != NULL, NULL);
+
+  proxy = g_atomic_pointer_get (&surface->prime_proxy);
+  if (proxy)
+    return gst_mfx_prime_buffer_proxy_ref (proxy);
+
+  proxy = (GstMfxPrimeBufferProxy *)
+      gst_mfx_mini_object_new0 (gst_mfx_prime_buffer_proxy_class ());
+  if (!proxy)
+    return NULL;
+
+  proxy->surface = surface;
+  proxy->owns_surface = FALSE;
+
+  if (!gst_mfx_prime_buffer_proxy_acquire_handle (proxy))
+    goto error_acquire_handle;
+
+  /* Another renderer may have exported the surface concurrently */
+  if (!g_atomic_pointer_compare_and_exchange (&surface->prime_proxy,
+          NULL, proxy)) {
+    gst_mfx_prime_buffer_proxy_unref (proxy);
+    proxy = g_atomic_pointer_get (&surface->prime_proxy);
+  }
+
+  return gst_mfx_prime_buffer_proxy_ref (proxy);
+  /* ERRORS */
+error_acquire_handle:
+  GST_ERROR ("failed to acquire the underlying PRIME buffer handle");
+  gst_mfx_prime_buffer_proxy_unref (proxy);
+  return NULL;
+}
+
 GstMfxPrimeBufferProxy *
 gst_mfx_prime_buffer_proxy_ref (GstMfxPrimeBufferProxy * proxy)
 {
@@ -213,7 +347,7 @@ gst_mfx_prime_buffer_proxy_get_size (GstMfxPrimeBufferProxy * proxy)
 VaapiImage *
 gst_mfx_prime_buffer_proxy_get_vaapi_image (GstMfxPrimeBufferProxy * proxy)
 {
-  g_return_val_if_fail (proxy != NULL, 0);
+  g_return_val_if_fail (proxy != NULL, NULL);
 
-  return vaapi_image_ref (proxy->image);
+  return proxy->image ? vaapi_image_ref (proxy->image) : NULL;
 }
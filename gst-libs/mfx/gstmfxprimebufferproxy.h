@@ -46,6 +46,18 @@ typedef struct _GstMfxPrimeBufferProxy GstMfxPrimeBufferProxy;
 GstMfxPrimeBufferProxy *
 gst_mfx_prime_buffer_proxy_new_from_surface (GstMfxSurface * surface);
 
+GstMfxPrimeBufferProxy *
+gst_mfx_prime_buffer_proxy_get_from_surface (GstMfxSurface * surface);
+
+void
+gst_mfx_prime_buffer_proxy_detach (GstMfxPrimeBufferProxy * proxy);
+
+gboolean
+gst_mfx_prime_buffer_proxy_is_detached (GstMfxPrimeBufferProxy * proxy);
+
+guint
+gst_mfx_prime_buffer_proxy_get_detach_count (void);
+
 GstMfxPrimeBufferProxy *
 gst_mfx_prime_buffer_proxy_ref (GstMfxPrimeBufferProxy * proxy);
 
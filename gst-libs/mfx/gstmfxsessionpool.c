@@ -0,0 +1,514 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gstmfxsessionpool.h"
+
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+/**
+ * GstMfxSessionPool:
+ *
+ * Bounded pool of idle MFX sessions, all bound to the same VA display.
+ * Sessions returned by tasks are kept initialized so that the next task
+ * can skip MFXInitEx, which dominates the setup time of short-lived
+ * pipelines.
+ *
+ * The SDK only lets a session be given a frame allocator once, and keeps
+ * calling it for the lifetime of the session. Sessions are therefore
+ * given a trampoline allocator owned by the pool, which forwards to the
+ * allocator of the task currently using the session, and is unbound when
+ * the session is released.
+ */
+struct _GstMfxSessionPool
+{
+  /*< private > */
+  GstMfxMiniObject parent_instance;
+
+  GstMfxDisplay *display;
+  GMutex mutex;
+  GQueue idle_sessions;
+  /* mfxSession -> SessionAllocator, for the sessions given a trampoline
+   * allocator, whether idle or in use */
+  GHashTable *allocators;
+  guint max_size;
+  /* Number of idle sessions initialized ahead of time */
+  guint prewarm_size;
+  guint hits;
+  guint misses;
+};
+
+typedef struct _SessionAllocator SessionAllocator;
+
+/* Allocator installed once on a session, forwarding to @target while a
+ * task uses the session. @target is only bound before the components of
+ * the session are initialized, and unbound after they are closed */
+struct _SessionAllocator
+{
+  mfxFrameAllocator trampoline;
+  mfxFrameAllocator target;
+};
+
+static mfxStatus
+session_allocator_alloc (mfxHDL pthis, mfxFrameAllocRequest * req,
+    mfxFrameAllocResponse * resp)
+{
+  SessionAllocator *const allocator = pthis;
+
+  /* Lets the SDK fall back to its internal allocator */
+  if (!allocator->target.Alloc)
+    return MFX_ERR_UNSUPPORTED;
+  return allocator->target.Alloc (allocator->target.pthis, req, resp);
+}
+
+static mfxStatus
+session_allocator_lock (mfxHDL pthis, mfxMemId mid, mfxFrameData * ptr)
+{
+  SessionAllocator *const allocator = pthis;
+
+  if (!allocator->target.Lock)
+    return MFX_ERR_INVALID_HANDLE;
+  return allocator->target.Lock (allocator->target.pthis, mid, ptr);
+}
+
+static mfxStatus
+session_allocator_unlock (mfxHDL pthis, mfxMemId mid, mfxFrameData * ptr)
+{
+  SessionAllocator *const allocator = pthis;
+
+  if (!allocator->target.Unlock)
+    return MFX_ERR_INVALID_HANDLE;
+  return allocator->target.Unlock (allocator->target.pthis, mid, ptr);
+}
+
+static mfxStatus
+session_allocator_get_hdl (mfxHDL pthis, mfxMemId mid, mfxHDL * handle)
+{
+  SessionAllocator *const allocator = pthis;
+
+  if (!allocator->target.GetHDL)
+    return MFX_ERR_INVALID_HANDLE;
+  return allocator->target.GetHDL (allocator->target.pthis, mid, handle);
+}
+
+static mfxStatus
+session_allocator_free (mfxHDL pthis, mfxFrameAllocResponse * resp)
+{
+  SessionAllocator *const allocator = pthis;
+
+  if (!allocator->target.Free)
+    return MFX_ERR_INVALID_HANDLE;
+  return allocator->target.Free (allocator->target.pthis, resp);
+}
+
+static SessionAllocator *
+session_allocator_new (void)
+{
+  SessionAllocator *allocator = g_slice_new0 (SessionAllocator);
+
+  allocator->trampoline.pthis = allocator;
+  allocator->trampoline.Alloc = session_allocator_alloc;
+  allocator->trampoline.Lock = session_allocator_lock;
+  allocator->trampoline.Unlock = session_allocator_unlock;
+  allocator->trampoline.GetHDL = session_allocator_get_hdl;
+  allocator->trampoline.Free = session_allocator_free;
+  return allocator;
+}
+
+static void
+session_allocator_free_struct (SessionAllocator * allocator)
+{
+  g_slice_free (SessionAllocator, allocator);
+}
+
+/* Closes @session, and only then frees its trampoline allocator, which
+ * the SDK may still call while closing */
+static void
+close_session (GstMfxSessionPool * pool, mfxSession session)
+{
+  SessionAllocator *allocator;
+
+  MFXClose (session);
+
+  g_mutex_lock (&pool->mutex);
+  allocator = g_hash_table_lookup (pool->allocators, session);
+  if (allocator)
+    g_hash_table_steal (pool->allocators, session);
+  g_mutex_unlock (&pool->mutex);
+
+  if (allocator)
+    session_allocator_free_struct (allocator);
+}
+
+static void
+gst_mfx_session_pool_finalize (GstMfxSessionPool * pool)
+{
+  mfxSession session;
+
+  while ((session = g_queue_pop_head (&pool->idle_sessions)))
+    close_session (pool, session);
+  g_hash_table_unref (pool->allocators);
+  gst_mfx_display_unref (pool->display);
+  g_mutex_clear (&pool->mutex);
+}
+
+static inline const GstMfxMiniObjectClass *
+gst_mfx_session_pool_class (void)
+{
+  static const GstMfxMiniObjectClass GstMfxSessionPoolClass = {
+    sizeof (GstMfxSessionPool),
+    (GDestroyNotify) gst_mfx_session_pool_finalize
+  };
+  return &GstMfxSessionPoolClass;
+}
+
+GstMfxSessionPool *
+gst_mfx_session_pool_new (GstMfxDisplay * display, guint max_size)
+{
+  GstMfxSessionPool *pool;
+
+  g_return_val_if_fail (display != NULL, NULL);
+
+  pool = (GstMfxSessionPool *)
+      gst_mfx_mini_object_new0 (gst_mfx_session_pool_class ());
+  if (!pool)
+    return NULL;
+
+  pool->display = gst_mfx_display_ref (display);
+  pool->max_size = max_size;
+  g_mutex_init (&pool->mutex);
+  g_queue_init (&pool->idle_sessions);
+  pool->allocators = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) session_allocator_free_struct);
+
+  return pool;
+}
+
+GstMfxSessionPool *
+gst_mfx_session_pool_ref (GstMfxSessionPool * pool)
+{
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  return (GstMfxSessionPool *)
+      gst_mfx_mini_object_ref (GST_MFX_MINI_OBJECT (pool));
+}
+
+void
+gst_mfx_session_pool_unref (GstMfxSessionPool * pool)
+{
+  gst_mfx_mini_object_unref (GST_MFX_MINI_OBJECT (pool));
+}
+
+void
+gst_mfx_session_pool_replace (GstMfxSessionPool ** old_pool_ptr,
+    GstMfxSessionPool * new_pool)
+{
+  g_return_if_fail (old_pool_ptr != NULL);
+
+  gst_mfx_mini_object_replace ((GstMfxMiniObject **) old_pool_ptr,
+      GST_MFX_MINI_OBJECT (new_pool));
+}
+
+GstMfxDisplay *
+gst_mfx_session_pool_get_display (GstMfxSessionPool * pool)
+{
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  return pool->display;
+}
+
+static mfxSession
+create_session (GstMfxSessionPool * pool)
+{
+  mfxIMPL impl;
+  mfxVersion version;
+  mfxStatus sts;
+  mfxSession session;
+  const char *desc;
+
+  mfxInitParam init_params;
+
+  memset (&init_params, 0, sizeof (init_params));
+
+  //init_params.GPUCopy = MFX_GPUCOPY_ON;
+  init_params.Implementation = MFX_IMPL_AUTO_ANY;
+  init_params.Version.Major = 1;
+  init_params.Version.Minor = 17;
+
+  sts = MFXInitEx (init_params, &session);
+  if (sts < 0) {
+    GST_ERROR ("Error initializing internal MFX session");
+    return NULL;
+  }
+
+  MFXQueryVersion (session, &version);
+
+  GST_INFO ("Using Media SDK API version %d.%d", version.Major, version.Minor);
+
+  MFXQueryIMPL (session, &impl);
+
+  switch (MFX_IMPL_BASETYPE (impl)) {
+    case MFX_IMPL_SOFTWARE:
+      desc = "software";
+      break;
+    case MFX_IMPL_HARDWARE:
+    case MFX_IMPL_HARDWARE2:
+    case MFX_IMPL_HARDWARE3:
+    case MFX_IMPL_HARDWARE4:
+      desc = "hardware accelerated";
+      break;
+    default:
+      desc = "unknown";
+  }
+
+  GST_INFO ("Initialized internal MFX session using %s implementation", desc);
+
+  /* The VA display can only be set once per session, so sessions of this
+   * pool are bound to its display for their whole lifetime */
+  MFXVideoCORE_SetHandle (session, MFX_HANDLE_VA_DISPLAY,
+      GST_MFX_DISPLAY_VADISPLAY (pool->display));
+
+  return session;
+}
+
+/**
+ * gst_mfx_session_pool_acquire:
+ * @pool: a #GstMfxSessionPool
+ *
+ * Borrows an idle session from @pool, or initializes a new one if the
+ * pool is empty. The session must be handed back with
+ * gst_mfx_session_pool_release() once it is no longer joined to any
+ * other session and all its components are closed.
+ *
+ * Returns: an initialized #mfxSession, or %NULL on error
+ */
+mfxSession
+gst_mfx_session_pool_acquire (GstMfxSessionPool * pool)
+{
+  mfxSession session;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  g_mutex_lock (&pool->mutex);
+  session = g_queue_pop_head (&pool->idle_sessions);
+  if (session)
+    pool->hits++;
+  else
+    pool->misses++;
+  g_mutex_unlock (&pool->mutex);
+
+  if (session) {
+    GST_DEBUG ("reusing pooled MFX session %p", session);
+    return session;
+  }
+  return create_session (pool);
+}
+
+/**
+ * gst_mfx_session_pool_set_frame_allocator:
+ * @pool: a #GstMfxSessionPool
+ * @session: a session acquired from @pool
+ * @allocator: the #mfxFrameAllocator to use for @session
+ *
+ * Makes @session use @allocator until it is released. The first call for
+ * a session installs the trampoline allocator of the pool; later uses of
+ * the same pooled session only rebind it. As with the SDK, the allocator
+ * of a session can not be changed while it is in use.
+ *
+ * Returns: %MFX_ERR_NONE, %MFX_ERR_UNDEFINED_BEHAVIOR if @session is
+ *   already using another allocator, or the error returned by
+ *   MFXVideoCORE_SetFrameAllocator()
+ */
+mfxStatus
+gst_mfx_session_pool_set_frame_allocator (GstMfxSessionPool * pool,
+    mfxSession session, mfxFrameAllocator * allocator)
+{
+  SessionAllocator *session_allocator;
+  mfxStatus sts = MFX_ERR_NONE;
+  gboolean install = FALSE;
+
+  g_return_val_if_fail (pool != NULL, MFX_ERR_NULL_PTR);
+  g_return_val_if_fail (session != NULL, MFX_ERR_NULL_PTR);
+  g_return_val_if_fail (allocator != NULL, MFX_ERR_NULL_PTR);
+
+  g_mutex_lock (&pool->mutex);
+  session_allocator = g_hash_table_lookup (pool->allocators, session);
+  if (!session_allocator) {
+    session_allocator = session_allocator_new ();
+    g_hash_table_insert (pool->allocators, session, session_allocator);
+    install = TRUE;
+  }
+  if (!session_allocator->target.Alloc)
+    session_allocator->target = *allocator;
+  else
+    sts = MFX_ERR_UNDEFINED_BEHAVIOR;
+  g_mutex_unlock (&pool->mutex);
+
+  if (install) {
+    sts = MFXVideoCORE_SetFrameAllocator (session,
+        &session_allocator->trampoline);
+    if (sts < 0)
+      GST_ERROR ("Error setting the frame allocator of session %p: %d",
+          session, sts);
+  }
+  return sts;
+}
+
+/**
+ * gst_mfx_session_pool_release:
+ * @pool: a #GstMfxSessionPool
+ * @session: a session acquired from @pool
+ *
+ * Hands @session back to @pool for later reuse, or closes it if the
+ * pool is already full. The frame allocator of @session is unbound, so
+ * the SDK never calls into a task that is gone.
+ */
+void
+gst_mfx_session_pool_release (GstMfxSessionPool * pool, mfxSession session)
+{
+  SessionAllocator *allocator;
+
+  g_return_if_fail (pool != NULL);
+
+  if (!session)
+    return;
+
+  g_mutex_lock (&pool->mutex);
+  allocator = g_hash_table_lookup (pool->allocators, session);
+  if (allocator)
+    memset (&allocator->target, 0, sizeof (allocator->target));
+
+  if (g_queue_get_length (&pool->idle_sessions) < pool->max_size) {
+    g_queue_push_tail (&pool->idle_sessions, session);
+    session = NULL;
+  }
+  g_mutex_unlock (&pool->mutex);
+
+  if (session)
+    close_session (pool, session);
+}
+
+/* Initializes sessions until @pool holds @num_sessions idle ones, or is
+ * full */
+static gpointer
+prewarm_sessions (gpointer data)
+{
+  GstMfxSessionPool *const pool = data;
+  mfxSession session;
+  guint num_idle;
+
+  for (;;) {
+    g_mutex_lock (&pool->mutex);
+    num_idle = g_queue_get_length (&pool->idle_sessions);
+    g_mutex_unlock (&pool->mutex);
+    if (num_idle >= MIN (pool->prewarm_size, pool->max_size))
+      break;
+
+    session = create_session (pool);
+    if (!session)
+      break;
+    gst_mfx_session_pool_release (pool, session);
+  }
+
+  GST_DEBUG ("%u idle MFX sessions ready", num_idle);
+  gst_mfx_session_pool_unref (pool);
+  return NULL;
+}
+
+/**
+ * gst_mfx_session_pool_prewarm:
+ * @pool: a #GstMfxSessionPool
+ * @num_sessions: the number of idle sessions to have ready
+ *
+ * Initializes up to @num_sessions idle sessions from a background
+ * thread, so that the first tasks of a pipeline do not wait for
+ * MFXInitEx. Sessions acquired in the meantime are initialized as usual.
+ */
+void
+gst_mfx_session_pool_prewarm (GstMfxSessionPool * pool, guint num_sessions)
+{
+  GThread *thread;
+
+  g_return_if_fail (pool != NULL);
+
+  if (!num_sessions)
+    return;
+
+  pool->prewarm_size = num_sessions;
+  thread = g_thread_try_new ("mfx-session-prewarm", prewarm_sessions,
+      gst_mfx_session_pool_ref (pool), NULL);
+  if (!thread) {
+    GST_WARNING ("Unable to pre-initialize MFX sessions");
+    gst_mfx_session_pool_unref (pool);
+    return;
+  }
+  g_thread_unref (thread);
+}
+
+void
+gst_mfx_session_pool_set_max_size (GstMfxSessionPool * pool, guint max_size)
+{
+  mfxSession session;
+  GList *excess = NULL, *l;
+
+  g_return_if_fail (pool != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  pool->max_size = max_size;
+  while (g_queue_get_length (&pool->idle_sessions) > max_size) {
+    session = g_queue_pop_tail (&pool->idle_sessions);
+    excess = g_list_prepend (excess, session);
+  }
+  g_mutex_unlock (&pool->mutex);
+
+  for (l = excess; l; l = l->next)
+    close_session (pool, l->data);
+  g_list_free (excess);
+}
+
+guint
+gst_mfx_session_pool_get_max_size (GstMfxSessionPool * pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
+
+  return pool->max_size;
+}
+
+/**
+ * gst_mfx_session_pool_get_stats:
+ * @pool: a #GstMfxSessionPool
+ * @hits: (out) (allow-none): number of sessions served from the pool
+ * @misses: (out) (allow-none): number of sessions initialized from scratch
+ *
+ * Retrieves the reuse statistics of @pool.
+ */
+void
+gst_mfx_session_pool_get_stats (GstMfxSessionPool * pool, guint * hits,
+    guint * misses)
+{
+  g_return_if_fail (pool != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  if (hits)
+    *hits = pool->hits;
+  if (misses)
+    *misses = pool->misses;
+  g_mutex_unlock (&pool->mutex);
+}
@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFX_SESSION_POOL_H
+#define GST_MFX_SESSION_POOL_H
+
+#include "sysdeps.h"
+#include "gstmfxminiobject.h"
+#include "gstmfxdisplay.h"
+
+G_BEGIN_DECLS
+
+#define GST_MFX_SESSION_POOL(obj) \
+  ((GstMfxSessionPool *) (obj))
+
+typedef struct _GstMfxSessionPool GstMfxSessionPool;
+
+GstMfxSessionPool *
+gst_mfx_session_pool_new (GstMfxDisplay * display, guint max_size);
+
+GstMfxSessionPool *
+gst_mfx_session_pool_ref (GstMfxSessionPool * pool);
+
+void
+gst_mfx_session_pool_unref (GstMfxSessionPool * pool);
+
+void
+gst_mfx_session_pool_replace (GstMfxSessionPool ** old_pool_ptr,
+    GstMfxSessionPool * new_pool);
+
+GstMfxDisplay *
+gst_mfx_session_pool_get_display (GstMfxSessionPool * pool);
+
+mfxSession
+gst_mfx_session_pool_acquire (GstMfxSessionPool * pool);
+
+void
+gst_mfx_session_pool_release (GstMfxSessionPool * pool, mfxSession session);
+
+mfxStatus
+gst_mfx_session_pool_set_frame_allocator (GstMfxSessionPool * pool,
+    mfxSession session, mfxFrameAllocator * allocator);
+
+void
+gst_mfx_session_pool_prewarm (GstMfxSessionPool * pool, guint num_sessions);
+
+void
+gst_mfx_session_pool_set_max_size (GstMfxSessionPool * pool, guint max_size);
+
+guint
+gst_mfx_session_pool_get_max_size (GstMfxSessionPool * pool);
+
+void
+gst_mfx_session_pool_get_stats (GstMfxSessionPool * pool, guint * hits,
+    guint * misses);
+
+G_END_DECLS
+
+#endif /* GST_MFX_SESSION_POOL_H */
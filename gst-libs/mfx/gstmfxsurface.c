@@ -23,6 +23,7 @@
 #include "gstmfxsurfacepool.h"
 #include "gstmfxtask.h"
 #include "gstmfxdisplay.h"
+#include "gstmfxprimebufferproxy.h"
 
 #define DEBUG 1
 #include "gstmfxdebug.h"
@@ -273,6 +274,12 @@ gst_mfx_surface_finalize (GstMfxSurface * surface)
 
   if (surface->ext_buf)
     g_slice_free (mfxExtBuffer *, surface->ext_buf);
+  /* The cached export references the VA surface, so its handle is
+   * released first, even if renderer caches still hold the proxy */
+  if (surface->prime_proxy) {
+    gst_mfx_prime_buffer_proxy_detach (surface->prime_proxy);
+    gst_mfx_prime_buffer_proxy_replace (&surface->prime_proxy, NULL);
+  }
   if (klass->release)
     klass->release(surface);
   gst_mfx_display_replace(&surface->display, NULL);
@@ -323,9 +330,15 @@ gst_mfx_surface_new_from_task (GstMfxTask * task)
 GstMfxSurface *
 gst_mfx_surface_new_from_pool(GstMfxSurfacePool * pool)
 {
+  GstMfxSurface *surface;
+
   g_return_val_if_fail(pool != NULL, NULL);
 
-  return gst_mfx_surface_pool_get_surface(pool);
+  /* A recycled surface may still carry the sync point of its last use */
+  surface = gst_mfx_surface_pool_get_surface(pool);
+  if (surface)
+    g_atomic_pointer_set(&surface->sync_point, NULL);
+  return surface;
 }
 
 GstMfxSurface *
@@ -340,6 +353,22 @@ gst_mfx_surface_new_internal(const GstMfxSurfaceClass * klass,
   if (!surface)
     return NULL;
 
+  if (!gst_mfx_surface_init_internal(surface, display, info, task, is_linear))
+    goto error;
+  return surface;
+
+error:
+  gst_mfx_surface_unref_internal(surface);
+  return NULL;
+}
+
+/* Allocates the underlying memory of a newly created @surface, so that
+ * subclasses can set up their own fields before allocate() is called */
+gboolean
+gst_mfx_surface_init_internal(GstMfxSurface * surface,
+    GstMfxDisplay * display, const GstVideoInfo * info, GstMfxTask * task,
+    gboolean is_linear)
+{
   surface->gem_bo_handle = -1;
   surface->is_gem_linear = is_linear;
 
@@ -347,13 +376,7 @@ gst_mfx_surface_new_internal(const GstMfxSurfaceClass * klass,
   if (display)
     surface->display = gst_mfx_display_ref(display);
 
-  if (!gst_mfx_surface_create(surface, info, task))
-    goto error;
-  return surface;
-
-error:
-  gst_mfx_surface_unref_internal(surface);
-  return NULL;
+  return gst_mfx_surface_create(surface, info, task);
 }
 
 GstMfxSurface *
@@ -495,6 +518,9 @@ gst_mfx_surface_map(GstMfxSurface * surface)
 {
   GstMfxSurfaceClass *const klass = GST_MFX_SURFACE_GET_CLASS(surface);
 
+  if (!gst_mfx_surface_sync(surface))
+    return FALSE;
+
   if (gst_mfx_surface_has_video_memory(surface) && !surface->mapped)
     if (klass->map)
       return (surface->mapped = klass->map(surface));
@@ -533,6 +559,111 @@ gst_mfx_surface_queue(GstMfxSurface * surface)
 void
 gst_mfx_surface_dequeue(GstMfxSurface * surface)
 {
-  if (surface)
-    g_atomic_int_set(&surface->queued, 0);
+  if (!surface)
+    return;
+
+  g_atomic_int_set(&surface->queued, 0);
+
+  /* Wake up tasks waiting for this surface to be released */
+  if (surface->task)
+    gst_mfx_backpressure_signal (gst_mfx_task_get_backpressure (surface->task));
+}
+
+/**
+ * gst_mfx_surface_hold:
+ * @surface: a #GstMfxSurface
+ *
+ * Keeps @surface alive, and keeps its pool from handing it out again,
+ * until a matching gst_mfx_surface_release_hold(). This is meant for
+ * renderers whose display server reads the surface asynchronously, e.g.
+ * when it scans out a DRI3 pixmap wrapping it. Holds are counted.
+ */
+void
+gst_mfx_surface_hold (GstMfxSurface * surface)
+{
+  g_return_if_fail (surface != NULL);
+
+  gst_mfx_surface_ref (surface);
+  g_atomic_int_inc (&surface->num_holds);
+}
+
+/**
+ * gst_mfx_surface_release_hold:
+ * @surface: a #GstMfxSurface
+ *
+ * Releases a hold taken with gst_mfx_surface_hold(), along with the
+ * reference it owned. @surface may be destroyed by this call.
+ */
+void
+gst_mfx_surface_release_hold (GstMfxSurface * surface)
+{
+  g_return_if_fail (surface != NULL);
+
+  if (g_atomic_int_dec_and_test (&surface->num_holds) && surface->task)
+    gst_mfx_backpressure_signal (gst_mfx_task_get_backpressure (surface->task));
+  gst_mfx_surface_unref (surface);
+}
+
+/**
+ * gst_mfx_surface_set_sync_point:
+ * @surface: a #GstMfxSurface
+ * @syncp: the sync point of the operation writing to @surface, or %NULL
+ *
+ * Attaches the sync point of a pending operation to @surface instead of
+ * waiting for it. MFX tasks running in the same or a joined session can
+ * consume @surface right away, since the SDK orders their work; anything
+ * else calls gst_mfx_surface_sync() first, which mapping and rendering
+ * the surface do implicitly.
+ */
+void
+gst_mfx_surface_set_sync_point (GstMfxSurface * surface, mfxSyncPoint syncp)
+{
+  g_return_if_fail (surface != NULL);
+
+  g_atomic_pointer_set (&surface->sync_point, syncp);
+}
+
+mfxSyncPoint
+gst_mfx_surface_get_sync_point (GstMfxSurface * surface)
+{
+  g_return_val_if_fail (surface != NULL, NULL);
+
+  return g_atomic_pointer_get (&surface->sync_point);
+}
+
+/**
+ * gst_mfx_surface_sync:
+ * @surface: a #GstMfxSurface
+ *
+ * Waits for the operation attached with gst_mfx_surface_set_sync_point()
+ * to complete, if any, and detaches it.
+ *
+ * Return value: %FALSE if the operation failed
+ */
+gboolean
+gst_mfx_surface_sync (GstMfxSurface * surface)
+{
+  mfxSyncPoint syncp;
+  mfxSession session;
+  mfxStatus sts;
+
+  g_return_val_if_fail (surface != NULL, FALSE);
+
+  syncp = g_atomic_pointer_get (&surface->sync_point);
+  if (G_LIKELY (!syncp) || !surface->task)
+    return TRUE;
+
+  session = gst_mfx_task_get_session (surface->task);
+  do {
+    sts = MFXVideoCORE_SyncOperation (session, syncp, 1000);
+  } while (MFX_WRN_IN_EXECUTION == sts);
+
+  g_atomic_pointer_compare_and_exchange (&surface->sync_point, syncp, NULL);
+
+  if (MFX_ERR_NONE != sts) {
+    GST_ERROR ("Error synchronizing surface %" GST_MFX_ID_FORMAT " %d",
+        GST_MFX_ID_ARGS (surface->surface_id), sts);
+    return FALSE;
+  }
+  return TRUE;
 }
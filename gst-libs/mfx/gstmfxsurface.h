@@ -122,6 +122,21 @@ gst_mfx_surface_queue(GstMfxSurface * surface);
 void
 gst_mfx_surface_dequeue(GstMfxSurface * surface);
 
+void
+gst_mfx_surface_hold (GstMfxSurface * surface);
+
+void
+gst_mfx_surface_release_hold (GstMfxSurface * surface);
+
+void
+gst_mfx_surface_set_sync_point (GstMfxSurface * surface, mfxSyncPoint syncp);
+
+mfxSyncPoint
+gst_mfx_surface_get_sync_point (GstMfxSurface * surface);
+
+gboolean
+gst_mfx_surface_sync (GstMfxSurface * surface);
+
 G_END_DECLS
 
 #endif /* GST_MFX_SURFACE_H */
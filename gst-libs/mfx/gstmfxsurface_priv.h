@@ -61,10 +61,24 @@ struct _GstMfxSurface
   mfxExtVPPVideoSignalInfo siginfo;
   mfxExtBuffer **ext_buf;
   guint queued;
+  /* Outstanding gst_mfx_surface_hold() calls, which keep the pool from
+   * handing the surface out again */
+  volatile gint num_holds;
+
+  /* Pending operation writing to the surface, waited for on first use
+   * outside of the session that produced it */
+  mfxSyncPoint sync_point;
+
+  /* Owning pool and slot index, set by GstMfxSurfacePool */
+  GstMfxSurfacePool *pool;
+  guint pool_slot;
 
   gint gem_bo_handle;
   gboolean is_gem_linear;
 
+  /* PRIME export cached for renderers, released with the surface */
+  struct _GstMfxPrimeBufferProxy *prime_proxy;
+
   drm_intel_bufmgr *bufmgr;
   drm_intel_bo *bo;
 };
@@ -81,11 +95,21 @@ struct _GstMfxSurfaceClass
   GstMfxSurfaceUnmapFunc unmap;
 };
 
+/* Recovers the GstMfxSurface wrapping an mfxFrameSurface1 returned by
+ * the SDK, since the frame surface is embedded in the surface object */
+#define GST_MFX_SURFACE_FROM_FRAME_SURFACE(surf) \
+  ((GstMfxSurface *)((guint8 *)(surf) - G_STRUCT_OFFSET (GstMfxSurface, surface)))
+
 GstMfxSurface *
 gst_mfx_surface_new_internal(const GstMfxSurfaceClass * klass,
     GstMfxDisplay * display, const GstVideoInfo * info, GstMfxTask * task,
     gboolean is_linear);
 
+gboolean
+gst_mfx_surface_init_internal(GstMfxSurface * surface,
+    GstMfxDisplay * display, const GstVideoInfo * info, GstMfxTask * task,
+    gboolean is_linear);
+
 #define gst_mfx_surface_ref_internal(surface) \
   ((gpointer)gst_mfx_mini_object_ref(GST_MFX_MINI_OBJECT(surface)))
 
@@ -36,12 +36,23 @@
 
 typedef struct _GstMfxSurfaceVaapiClass GstMfxSurfaceVaapiClass;
 
+/* Layout of a dmabuf imported as a surface, only valid during allocation */
+typedef struct
+{
+  gint fd;
+  gsize size;
+  guint num_planes;
+  gsize offsets[GST_VIDEO_MAX_PLANES];
+  gint strides[GST_VIDEO_MAX_PLANES];
+} GstMfxDmaBufImport;
+
 struct _GstMfxSurfaceVaapi
 {
   /*< private > */
   GstMfxSurface parent_instance;
 
   VaapiImage *image;
+  const GstMfxDmaBufImport *import;
 };
 
 struct _GstMfxSurfaceVaapiClass
@@ -63,15 +74,75 @@ gst_mfx_surface_vaapi_from_task(GstMfxSurface * surface,
   return TRUE;
 }
 
+/* Wraps the dmabuf of another device or driver as a VA surface. The
+ * driver holds its own reference to the buffer, so the fd may be closed
+ * afterwards, and the surface sees whatever the producer writes there */
+static gboolean
+gst_mfx_surface_vaapi_import_dmabuf(GstMfxSurface * surface,
+    const GstMfxDmaBufImport * import)
+{
+  mfxFrameInfo *frame_info = &surface->surface.Info;
+  VASurfaceAttribExternalBuffers external;
+  VASurfaceAttrib attribs[2];
+  unsigned long handle = import->fd;
+  VAStatus sts;
+  guint i;
+
+  memset (&external, 0, sizeof(external));
+  external.pixel_format =
+      gst_mfx_video_format_to_va_fourcc(frame_info->FourCC);
+  external.width = frame_info->CropW;
+  external.height = frame_info->CropH;
+  external.data_size = import->size;
+  external.num_planes = import->num_planes;
+  for (i = 0; i < import->num_planes; i++) {
+    external.pitches[i] = import->strides[i];
+    external.offsets[i] = import->offsets[i];
+  }
+  external.num_buffers = 1;
+  external.buffers = &handle;
+
+  memset (&attribs, 0, sizeof(attribs));
+  attribs[0].flags = VA_SURFACE_ATTRIB_SETTABLE;
+  attribs[0].type = VASurfaceAttribMemoryType;
+  attribs[0].value.type = VAGenericValueTypeInteger;
+  attribs[0].value.value.i = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME;
+
+  attribs[1].flags = VA_SURFACE_ATTRIB_SETTABLE;
+  attribs[1].type = VASurfaceAttribExternalBufferDescriptor;
+  attribs[1].value.type = VAGenericValueTypePointer;
+  attribs[1].value.value.p = &external;
+
+  GST_MFX_DISPLAY_LOCK(surface->display);
+  sts = vaCreateSurfaces(GST_MFX_DISPLAY_VADISPLAY(surface->display),
+      gst_mfx_video_format_to_va_format(frame_info->FourCC),
+      frame_info->Width, frame_info->Height,
+      (VASurfaceID *) &surface->surface_id, 1, attribs, 2);
+  GST_MFX_DISPLAY_UNLOCK(surface->display);
+  if (!vaapi_check_status(sts, "vaCreateSurfaces ()"))
+    return FALSE;
+
+  surface->mem_id.mid = &surface->surface_id;
+  surface->mem_id.info = frame_info;
+  surface->surface.Data.MemId = &surface->mem_id;
+
+  return TRUE;
+}
+
 static gboolean
 gst_mfx_surface_vaapi_allocate(GstMfxSurface * surface, GstMfxTask * task)
 {
+  GstMfxSurfaceVaapi *vaapi_surface = GST_MFX_SURFACE_VAAPI(surface);
+
   surface->has_video_memory = TRUE;
 
   if (task) {
     surface->display = gst_mfx_task_get_display (task);
     return gst_mfx_surface_vaapi_from_task(surface, task);
   }
+  else if (vaapi_surface->import) {
+    return gst_mfx_surface_vaapi_import_dmabuf(surface, vaapi_surface->import);
+  }
   else {
     mfxFrameInfo *frame_info = &surface->surface.Info;
     guint fourcc = gst_mfx_video_format_to_va_fourcc(frame_info->FourCC);
@@ -316,6 +387,60 @@ gst_mfx_surface_vaapi_new_from_task(GstMfxTask * task)
         NULL, NULL, task, is_linear);
 }
 
+/**
+ * gst_mfx_surface_vaapi_new_from_dmabuf:
+ * @display: a #GstMfxDisplay
+ * @info: the #GstVideoInfo of the frame held by the dmabuf
+ * @fd: the dmabuf file descriptor, which is not taken over
+ * @size: the size of the dmabuf
+ * @offsets: the offset of each plane of @info in the dmabuf
+ * @strides: the stride of each plane of @info
+ *
+ * Imports a linear dmabuf produced outside of the SDK, such as by a
+ * camera or another driver, as a surface in video memory. Only frames
+ * whose planes all live in the same dmabuf can be imported.
+ *
+ * Return value: the newly allocated #GstMfxSurface, or %NULL on error
+ */
+GstMfxSurface *
+gst_mfx_surface_vaapi_new_from_dmabuf(GstMfxDisplay * display,
+    const GstVideoInfo * info, gint fd, gsize size, const gsize * offsets,
+    const gint * strides)
+{
+  GstMfxSurface *surface;
+  GstMfxDmaBufImport import;
+  guint i;
+
+  g_return_val_if_fail(display != NULL, NULL);
+  g_return_val_if_fail(info != NULL, NULL);
+  g_return_val_if_fail(fd >= 0, NULL);
+
+  import.fd = fd;
+  import.size = size;
+  import.num_planes = GST_VIDEO_INFO_N_PLANES(info);
+  for (i = 0; i < import.num_planes; i++) {
+    import.offsets[i] = offsets[i];
+    import.strides[i] = strides[i];
+  }
+
+  surface = (GstMfxSurface *)
+    gst_mfx_mini_object_new0(GST_MFX_MINI_OBJECT_CLASS(
+        gst_mfx_surface_vaapi_class()));
+  if (!surface)
+    return NULL;
+
+  GST_MFX_SURFACE_VAAPI(surface)->import = &import;
+  if (!gst_mfx_surface_init_internal(surface, display, info, NULL, FALSE))
+    goto error;
+  GST_MFX_SURFACE_VAAPI(surface)->import = NULL;
+  return surface;
+
+error:
+  GST_ERROR("Failed to import dmabuf %d as a VA surface", fd);
+  gst_mfx_surface_unref(surface);
+  return NULL;
+}
+
 GstMfxDisplay *
 gst_mfx_surface_vaapi_get_display(GstMfxSurface * surface)
 {
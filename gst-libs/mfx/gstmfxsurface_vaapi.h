@@ -40,6 +40,11 @@ gst_mfx_surface_vaapi_new (GstMfxDisplay * display, const GstVideoInfo * info,
 GstMfxSurface *
 gst_mfx_surface_vaapi_new_from_task(GstMfxTask * task);
 
+GstMfxSurface *
+gst_mfx_surface_vaapi_new_from_dmabuf(GstMfxDisplay * display,
+    const GstVideoInfo * info, gint fd, gsize size, const gsize * offsets,
+    const gint * strides);
+
 GstMfxDisplay *
 gst_mfx_surface_vaapi_get_display(GstMfxSurface * surface);
 
@@ -25,6 +25,7 @@
 #include "gstmfxsurfacecomposition.h"
 #include "gstmfxsurface.h"
 #include "gstmfxsurface_vaapi.h"
+#include "gstmfxcopy.h"
 
 #define DEBUG 1
 #include "gstmfxdebug.h"
@@ -41,85 +42,97 @@ struct _GstMfxSurfaceComposition
 static void
 destroy_subpicture (GstMfxSubpicture * subpicture)
 {
-  gst_mfx_surface_unref(subpicture->surface);
+  gst_mfx_surface_replace(&subpicture->surface, NULL);
+  gst_video_overlay_rectangle_unref(subpicture->rect);
   g_slice_free(GstMfxSubpicture, subpicture);
 }
 
+/* Only records the rectangle, its pixels are uploaded on demand so that
+ * a filter caching subpicture surfaces does not pay for the copy */
 static gboolean
 create_subpicture (GstMfxSurfaceComposition * composition,
   GstVideoOverlayRectangle * rect)
 {
   GstMfxSubpicture *subpicture;
+
+  subpicture = g_slice_new0(GstMfxSubpicture);
+  subpicture->rect = gst_video_overlay_rectangle_ref(rect);
+  subpicture->seqnum = gst_video_overlay_rectangle_get_seqnum(rect);
+
+  gst_video_overlay_rectangle_get_render_rectangle(rect,
+    (gint *)& subpicture->sub_rect.x, (gint *)& subpicture->sub_rect.y,
+    &subpicture->sub_rect.width, &subpicture->sub_rect.height);
+
+  subpicture->global_alpha = gst_video_overlay_rectangle_get_global_alpha(rect);
+
+  g_ptr_array_add(composition->subpictures, subpicture);
+
+  return TRUE;
+}
+
+static GstMfxSurface *
+upload_subpicture (GstMfxSurfaceComposition * composition,
+  GstMfxSubpicture * subpicture)
+{
+  GstMfxSurface *surface;
   GstBuffer *buffer;
   GstVideoMeta *vmeta;
+  GstMfxCopyPlane plane;
   guint8 *data;
-  guint stride;
+  gint stride;
   GstMapInfo map_info;
   GstVideoInfo info;
 
   gst_video_info_init(&info);
 
-  buffer = gst_video_overlay_rectangle_get_pixels_unscaled_argb (rect,
-    gst_video_overlay_rectangle_get_flags(rect));
+  buffer = gst_video_overlay_rectangle_get_pixels_unscaled_argb (
+    subpicture->rect, gst_video_overlay_rectangle_get_flags(subpicture->rect));
   if (!buffer)
-    return FALSE;
+    return NULL;
 
   vmeta = gst_buffer_get_video_meta(buffer);
   if (!vmeta)
-    return FALSE;
+    return NULL;
 
   gst_video_info_set_format(&info, GST_VIDEO_FORMAT_BGRA,
     vmeta->width, vmeta->height);
 
-  if (!gst_video_meta_map(vmeta, 0, &map_info, (gpointer *)& data,
-      (gint *)& stride, GST_MAP_READ))
-    return FALSE;
-
-  subpicture = g_slice_new0(GstMfxSubpicture);
-
   if (gst_mfx_surface_has_video_memory (composition->base_surface)) {
     GstMfxDisplay *display =
         gst_mfx_surface_vaapi_get_display (composition->base_surface);
-    subpicture->surface = gst_mfx_surface_vaapi_new (display, &info, NULL);
+    surface = gst_mfx_surface_vaapi_new (display, &info, NULL);
     gst_mfx_display_unref (display);
   }
   else {
-    subpicture->surface = gst_mfx_surface_new(&info);
+    surface = gst_mfx_surface_new(&info);
   }
-  if (!subpicture->surface)
-    return FALSE;
+  if (!surface)
+    return NULL;
 
-  gst_video_overlay_rectangle_get_render_rectangle(rect,
-    (gint *)& subpicture->sub_rect.x, (gint *)& subpicture->sub_rect.y,
-    &subpicture->sub_rect.width, &subpicture->sub_rect.height);
+  if (!gst_video_meta_map(vmeta, 0, &map_info, (gpointer *)& data,
+      &stride, GST_MAP_READ))
+    goto error;
 
-  if (!gst_mfx_surface_map(subpicture->surface))
+  if (!gst_mfx_surface_map(surface)) {
+    gst_video_meta_unmap(vmeta, 0, &map_info);
     goto error;
-  if (subpicture->sub_rect.width == GST_MFX_SURFACE_WIDTH (subpicture->surface) &&
-      subpicture->sub_rect.height == GST_MFX_SURFACE_HEIGHT (subpicture->surface)) {
-    memcpy(gst_mfx_surface_get_plane(subpicture->surface, 0), data, map_info.size);
   }
-  else {
-    guint8 *plane = gst_mfx_surface_get_plane(subpicture->surface, 0);
-    guint i;
 
-    for (i = 0; i < subpicture->sub_rect.height; i++)
-      memcpy(plane + i * GST_MFX_SURFACE_WIDTH (subpicture->surface) * 4,
-          data + i * subpicture->sub_rect.width * 4,
-          subpicture->sub_rect.width * 4);
-  }
-  gst_mfx_surface_unmap(subpicture->surface);
+  plane.dst = gst_mfx_surface_get_plane(surface, 0);
+  plane.dst_stride = gst_mfx_surface_get_pitch(surface, 0);
+  plane.src = data;
+  plane.src_stride = stride;
+  plane.row_bytes = vmeta->width * 4;
+  plane.rows = vmeta->height;
+  gst_mfx_copy_planes (&plane, 1, GST_MFX_COPY_FLAG_NONE);
 
+  gst_mfx_surface_unmap(surface);
   gst_video_meta_unmap(vmeta, 0, &map_info);
 
-  subpicture->global_alpha = gst_video_overlay_rectangle_get_global_alpha(rect);
-
-  g_ptr_array_add(composition->subpictures, subpicture);
-
-  return TRUE;
+  return surface;
 error:
-  destroy_subpicture (subpicture);
-  return FALSE;
+  gst_mfx_surface_unref(surface);
+  return NULL;
 }
 
 static gboolean
@@ -241,3 +254,31 @@ gst_mfx_surface_composition_get_num_subpictures(
 {
   return composition->subpictures->len;
 }
+
+/**
+ * gst_mfx_surface_composition_upload_subpicture:
+ * @composition: a #GstMfxSurfaceComposition
+ * @index: index of the subpicture
+ *
+ * Copies the pixels of the overlay rectangle of the subpicture at
+ * @index into a new surface, in the same memory type as the base
+ * surface. Subpictures do not have a surface until one is either
+ * uploaded this way or attached from a cache keyed by
+ * #GstMfxSubpicture.seqnum.
+ *
+ * Return value: %TRUE if the subpicture has a surface
+ */
+gboolean
+gst_mfx_surface_composition_upload_subpicture(
+  GstMfxSurfaceComposition * composition, guint index)
+{
+  GstMfxSubpicture *subpicture;
+
+  g_return_val_if_fail(composition != NULL, FALSE);
+  g_return_val_if_fail(index < composition->subpictures->len, FALSE);
+
+  subpicture = g_ptr_array_index(composition->subpictures, index);
+  if (!subpicture->surface)
+    subpicture->surface = upload_subpicture (composition, subpicture);
+  return subpicture->surface != NULL;
+}
@@ -40,6 +40,8 @@ struct _GstMfxSubpicture
   GstMfxSurface *surface;
   gfloat global_alpha;
   GstMfxRectangle sub_rect;
+  GstVideoOverlayRectangle *rect;
+  guint seqnum;
 };
 
 GstMfxSurfaceComposition *
@@ -67,6 +69,10 @@ GstMfxSubpicture *
 gst_mfx_surface_composition_get_subpicture(GstMfxSurfaceComposition * composition,
   guint index);
 
+gboolean
+gst_mfx_surface_composition_upload_subpicture(
+  GstMfxSurfaceComposition * composition, guint index);
+
 G_END_DECLS
 
 #endif /* GST_MFX_SUBPICTURE_COMPOSITION_H */
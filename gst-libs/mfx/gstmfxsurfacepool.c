@@ -22,12 +22,41 @@
 
 #include "gstmfxsurfacepool.h"
 #include "gstmfxsurface.h"
+#include "gstmfxsurface_priv.h"
 #include "gstmfxsurface_vaapi.h"
 #include "gstmfxminiobject.h"
 
 #define DEBUG 1
 #include "gstmfxdebug.h"
 
+/* Slots live in fixed-size chunks that are never moved or freed before the
+ * pool itself, so slot addresses remain stable while the pool grows. */
+#define SLOT_CHUNK_SHIFT 5
+#define SLOT_CHUNK_SIZE (1 << SLOT_CHUNK_SHIFT)
+#define SLOT_CHUNK_MASK (SLOT_CHUNK_SIZE - 1)
+#define MAX_SLOT_CHUNKS 64
+#define MAX_SLOTS (MAX_SLOT_CHUNKS * SLOT_CHUNK_SIZE)
+
+/* The free-list head packs the index of the first free slot with a
+ * generation tag bumped on every update to guard against ABA. */
+#define SLOT_NONE 0xffff
+#define HEAD_INDEX(head) ((guint)(head) & 0xffff)
+#define HEAD_TAG(head) (((guint)(head) >> 16) & 0xffff)
+#define HEAD_PACK(index, tag) \
+  ((gint)((((guint)(tag) & 0xffff) << 16) | ((guint)(index) & 0xffff)))
+
+#define POOL_SLOT(pool, index) \
+  (&(pool)->slots[(index) >> SLOT_CHUNK_SHIFT][(index) & SLOT_CHUNK_MASK])
+
+typedef struct _GstMfxSurfacePoolSlot GstMfxSurfacePoolSlot;
+
+struct _GstMfxSurfacePoolSlot
+{
+  GstMfxSurface *surface;
+  volatile gint in_use;
+  volatile gint next;
+};
+
 struct _GstMfxSurfacePool
 {
   /*< private > */
@@ -37,34 +66,111 @@ struct _GstMfxSurfacePool
   GstMfxTask *task;
   GstVideoInfo info;
   gboolean memtype_is_system;
-  GQueue free_surfaces;
-  GList *used_surfaces;
-  guint used_count;
+
+  GstMfxSurfacePoolSlot *slots[MAX_SLOT_CHUNKS];
+  volatile gint num_slots;
+  volatile gint free_head;
   GMutex mutex;
 };
 
 static void
-gst_mfx_surface_pool_put_surface (GstMfxSurfacePool * pool,
-    GstMfxSurface * surface);
+gst_mfx_surface_pool_push_free (GstMfxSurfacePool * pool, guint index)
+{
+  GstMfxSurfacePoolSlot *const slot = POOL_SLOT (pool, index);
+  gint old_head, new_head;
+
+  do {
+    old_head = g_atomic_int_get (&pool->free_head);
+    g_atomic_int_set (&slot->next, HEAD_INDEX (old_head));
+    new_head = HEAD_PACK (index, HEAD_TAG (old_head) + 1);
+  } while (!g_atomic_int_compare_and_exchange (&pool->free_head,
+          old_head, new_head));
+}
 
-static gint
-sync_output_surface (gconstpointer surface, gconstpointer surf)
+static GstMfxSurfacePoolSlot *
+gst_mfx_surface_pool_pop_free (GstMfxSurfacePool * pool)
 {
-  GstMfxSurface *_surface = (GstMfxSurface *) surface;
-  mfxFrameSurface1 *_surf = (mfxFrameSurface1 *) surf;
+  GstMfxSurfacePoolSlot *slot;
+  gint old_head, new_head;
+  guint index;
+
+  do {
+    old_head = g_atomic_int_get (&pool->free_head);
+    index = HEAD_INDEX (old_head);
+    if (index == SLOT_NONE)
+      return NULL;
+
+    slot = POOL_SLOT (pool, index);
+    new_head = HEAD_PACK (g_atomic_int_get (&slot->next),
+        HEAD_TAG (old_head) + 1);
+  } while (!g_atomic_int_compare_and_exchange (&pool->free_head,
+          old_head, new_head));
 
-  return _surf != GST_MFX_SURFACE_FRAME_SURFACE (_surface);
+  return slot;
 }
 
-static void
-release_surfaces (gpointer surface, gpointer pool)
+/* Registers a surface in the next unused slot. The slot array only grows,
+ * so a mutex here is confined to the allocation slow path. */
+static GstMfxSurfacePoolSlot *
+gst_mfx_surface_pool_add_slot (GstMfxSurfacePool * pool,
+    GstMfxSurface * surface, gboolean in_use)
 {
-  GstMfxSurface *_surface = (GstMfxSurface *) surface;
-  GstMfxSurfacePool *_pool = (GstMfxSurfacePool *) pool;
+  GstMfxSurfacePoolSlot *slot = NULL;
+  guint index, chunk;
+
+  g_mutex_lock (&pool->mutex);
+  index = g_atomic_int_get (&pool->num_slots);
+  if (index >= MAX_SLOTS) {
+    GST_ERROR ("Surface pool is exhausted (%u surfaces)", MAX_SLOTS);
+    goto done;
+  }
+
+  chunk = index >> SLOT_CHUNK_SHIFT;
+  if (!pool->slots[chunk]) {
+    pool->slots[chunk] = g_new0 (GstMfxSurfacePoolSlot, SLOT_CHUNK_SIZE);
+    if (!pool->slots[chunk])
+      goto done;
+  }
+
+  surface->pool = pool;
+  surface->pool_slot = index;
 
-  mfxFrameSurface1 *surf = gst_mfx_surface_get_frame_surface (_surface);
-  if (surf && !surf->Data.Locked)
-    gst_mfx_surface_pool_put_surface (_pool, _surface);
+  slot = POOL_SLOT (pool, index);
+  slot->surface = surface;
+  slot->in_use = in_use;
+  slot->next = SLOT_NONE;
+
+  /* Publish the slot only once it is fully initialized */
+  g_atomic_int_set (&pool->num_slots, index + 1);
+
+done:
+  g_mutex_unlock (&pool->mutex);
+  return slot;
+}
+
+/* Returns every in-use slot whose surface is no longer locked by the SDK
+ * nor held by a renderer to the free list. This only runs once the free list has run dry, and
+ * recycles all reclaimable surfaces at once, so its cost is amortized
+ * over the following acquisitions. */
+static void
+gst_mfx_surface_pool_reclaim_surfaces (GstMfxSurfacePool * pool)
+{
+  GstMfxSurfacePoolSlot *slot;
+  guint i, num_slots;
+
+  num_slots = g_atomic_int_get (&pool->num_slots);
+  for (i = 0; i < num_slots; i++) {
+    slot = POOL_SLOT (pool, i);
+    if (!g_atomic_int_get (&slot->in_use)
+        || slot->surface->surface.Data.Locked
+        || g_atomic_int_get (&slot->surface->num_holds))
+      continue;
+
+    if (g_atomic_int_compare_and_exchange (&slot->in_use, TRUE, FALSE)) {
+      gst_mfx_surface_unref (slot->surface);
+      gst_mfx_surface_pool_push_free (pool, i);
+    }
+  }
 }
 
 static void
@@ -72,6 +178,7 @@ gst_mfx_surface_pool_add_surfaces(GstMfxSurfacePool * pool)
 {
   guint i, num_surfaces;
   GstMfxSurface *surface;
+  GstMfxSurfacePoolSlot *slot;
 
   num_surfaces = gst_mfx_task_get_num_surfaces(pool->task);
 
@@ -84,17 +191,21 @@ gst_mfx_surface_pool_add_surfaces(GstMfxSurfacePool * pool)
     if (!surface)
       return;
 
-    g_queue_push_tail (&pool->free_surfaces, surface);
+    slot = gst_mfx_surface_pool_add_slot (pool, surface, FALSE);
+    if (!slot) {
+      gst_mfx_surface_unref (surface);
+      return;
+    }
+    gst_mfx_surface_pool_push_free (pool, surface->pool_slot);
   }
 }
 
 static void
 gst_mfx_surface_pool_init (GstMfxSurfacePool * pool)
 {
-  pool->used_surfaces = NULL;
-  pool->used_count = 0;
+  pool->num_slots = 0;
+  pool->free_head = HEAD_PACK (SLOT_NONE, 0);
 
-  g_queue_init (&pool->free_surfaces);
   g_mutex_init (&pool->mutex);
 
   if (pool->task)
@@ -104,17 +215,21 @@ gst_mfx_surface_pool_init (GstMfxSurfacePool * pool)
 void
 gst_mfx_surface_pool_finalize (GstMfxSurfacePool * pool)
 {
-  GstMfxSurface *surface;
+  GstMfxSurfacePoolSlot *slot;
+  guint i;
+
+  for (i = 0; i < (guint) pool->num_slots; i++) {
+    slot = POOL_SLOT (pool, i);
 
-  while (g_list_length(pool->used_surfaces)) {
-    surface = g_list_nth_data (pool->used_surfaces, 0);
-    gst_mfx_surface_pool_put_surface(pool, surface);
+    /* Surfaces may outlive the pool if still referenced downstream */
+    slot->surface->pool = NULL;
+    if (slot->in_use)
+      gst_mfx_surface_unref (slot->surface);
+    gst_mfx_surface_unref (slot->surface);
   }
 
-  g_list_free (pool->used_surfaces);
-  g_queue_foreach (&pool->free_surfaces,
-      (GFunc) gst_mfx_surface_unref, NULL);
-  g_queue_clear (&pool->free_surfaces);
+  for (i = 0; i < MAX_SLOT_CHUNKS; i++)
+    g_free (pool->slots[i]);
   g_mutex_clear (&pool->mutex);
 
   gst_mfx_display_replace(&pool->display, NULL);
@@ -196,88 +311,92 @@ gst_mfx_surface_pool_replace (GstMfxSurfacePool ** old_pool_ptr,
       GST_MFX_MINI_OBJECT (new_pool));
 }
 
-
-static void
-gst_mfx_surface_pool_put_surface_unlocked (GstMfxSurfacePool * pool,
-    GstMfxSurface * surface)
-{
-  GList *elem;
-
-  elem = g_list_find (pool->used_surfaces, surface);
-  if (!elem)
-    return;
-
-  gst_mfx_surface_unref (surface);
-  --pool->used_count;
-  pool->used_surfaces = g_list_delete_link (pool->used_surfaces, elem);
-  g_queue_push_tail (&pool->free_surfaces, surface);
-}
-
-static void
-gst_mfx_surface_pool_put_surface (GstMfxSurfacePool * pool,
-    GstMfxSurface * surface)
-{
-  g_return_if_fail (pool != NULL);
-  g_return_if_fail (surface != NULL);
-
-  g_mutex_lock (&pool->mutex);
-  gst_mfx_surface_pool_put_surface_unlocked (pool, surface);
-  g_mutex_unlock (&pool->mutex);
-}
-
 static GstMfxSurface *
-gst_mfx_surface_pool_get_surface_unlocked (GstMfxSurfacePool * pool)
+gst_mfx_surface_pool_create_surface (GstMfxSurfacePool * pool)
 {
   GstMfxSurface *surface;
 
-  surface = g_queue_pop_head (&pool->free_surfaces);
-  if (!surface) {
-    g_mutex_unlock (&pool->mutex);
-    if (pool->task) {
-      surface = gst_mfx_surface_new_from_task (pool->task);
-    }
-    else {
-      if (!pool->memtype_is_system)
-        surface = gst_mfx_surface_vaapi_new(pool->display, &pool->info, NULL);
-      else
-        surface = gst_mfx_surface_new(&pool->info);
-    }
-
-    g_mutex_lock (&pool->mutex);
-    if (!surface)
-      return NULL;
+  if (pool->task) {
+    surface = gst_mfx_surface_new_from_task (pool->task);
   }
-
-  ++pool->used_count;
-  pool->used_surfaces = g_list_prepend (pool->used_surfaces, surface);
-
-  return gst_mfx_surface_ref (surface);
+  else {
+    if (!pool->memtype_is_system)
+      surface = gst_mfx_surface_vaapi_new(pool->display, &pool->info, NULL);
+    else
+      surface = gst_mfx_surface_new(&pool->info);
+  }
+  return surface;
 }
 
 GstMfxSurface *
 gst_mfx_surface_pool_get_surface (GstMfxSurfacePool * pool)
 {
+  GstMfxSurfacePoolSlot *slot;
   GstMfxSurface *surface;
 
   g_return_val_if_fail (pool != NULL, NULL);
 
-  g_list_foreach (pool->used_surfaces, release_surfaces, pool);
+  slot = gst_mfx_surface_pool_pop_free (pool);
+  if (!slot) {
+    gst_mfx_surface_pool_reclaim_surfaces (pool);
+    slot = gst_mfx_surface_pool_pop_free (pool);
+  }
 
-  g_mutex_lock (&pool->mutex);
-  surface = gst_mfx_surface_pool_get_surface_unlocked (pool);
-  g_mutex_unlock (&pool->mutex);
+  if (slot) {
+    g_atomic_int_set (&slot->in_use, TRUE);
+    surface = slot->surface;
+  }
+  else {
+    surface = gst_mfx_surface_pool_create_surface (pool);
+    if (!surface)
+      return NULL;
 
-  return surface;
+    if (!gst_mfx_surface_pool_add_slot (pool, surface, TRUE)) {
+      gst_mfx_surface_unref (surface);
+      return NULL;
+    }
+  }
+
+  /* The extra reference is held by the pool until the surface is
+   * reclaimed, in addition to the one owned by the slot */
+  return gst_mfx_surface_ref (surface);
 }
 
 GstMfxSurface *
 gst_mfx_surface_pool_find_surface (GstMfxSurfacePool * pool,
     mfxFrameSurface1 * surface)
 {
+  GstMfxSurface *_surface;
+
   g_return_val_if_fail (pool != NULL, NULL);
+  g_return_val_if_fail (surface != NULL, NULL);
+
+  _surface = GST_MFX_SURFACE_FROM_FRAME_SURFACE (surface);
+  if (_surface->pool != pool
+      || _surface->pool_slot >= (guint) g_atomic_int_get (&pool->num_slots)
+      || POOL_SLOT (pool, _surface->pool_slot)->surface != _surface) {
+    GST_ERROR ("Frame surface %p does not belong to pool %p", surface, pool);
+    return NULL;
+  }
+
+  return _surface;
+}
 
-  GList *l = g_list_find_custom (pool->used_surfaces, surface,
-      sync_output_surface);
+/**
+ * gst_mfx_surface_pool_get_size:
+ * @pool: a #GstMfxSurfacePool
+ *
+ * Returns the number of surfaces allocated by @pool so far. The pool
+ * only grows, so this is an upper bound on the number of distinct
+ * surfaces a downstream renderer may be handed until the pool is
+ * destroyed.
+ *
+ * Return value: the number of surfaces owned by @pool
+ */
+guint
+gst_mfx_surface_pool_get_size (GstMfxSurfacePool * pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
 
-  return GST_MFX_SURFACE (l->data);
+  return g_atomic_int_get (&pool->num_slots);
 }
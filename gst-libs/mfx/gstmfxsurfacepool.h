@@ -54,6 +54,9 @@ GstMfxSurface *
 gst_mfx_surface_pool_find_surface (GstMfxSurfacePool * pool,
     mfxFrameSurface1 * surface);
 
+guint
+gst_mfx_surface_pool_get_size (GstMfxSurfacePool * pool);
+
 G_END_DECLS
 
 #endif /* GST_MFX_SURFACE_POOL_H */
@@ -46,7 +46,10 @@ struct _GstMfxTask
 
   GstMfxDisplay *display;
   GstMfxTaskAggregator *aggregator;
+  guint id;
+  /* Allocation responses, most recent first, and indexed by mids */
   GList *saved_responses;
+  GHashTable *responses;
   mfxFrameAllocRequest request;
   mfxVideoParam params;
   mfxSession session;
@@ -63,15 +66,6 @@ struct _GstMfxTask
   mfxU16 num_surfaces;
 };
 
-static gint
-find_response (gconstpointer response_data, gconstpointer response)
-{
-  ResponseData *_response_data = (ResponseData *) response_data;
-  mfxFrameAllocResponse *_response = (mfxFrameAllocResponse *) response;
-
-  return _response_data ? _response->mids != _response_data->mids : -1;
-}
-
 mfxStatus
 gst_mfx_task_frame_alloc (mfxHDL pthis, mfxFrameAllocRequest * req,
     mfxFrameAllocResponse * resp)
@@ -204,6 +198,7 @@ gst_mfx_task_frame_alloc (mfxHDL pthis, mfxFrameAllocRequest * req,
 
   response_data->response = resp;
   task->saved_responses = g_list_prepend (task->saved_responses, response_data);
+  g_hash_table_insert (task->responses, response_data->mids, response_data);
 
   return MFX_ERR_NONE;
 
@@ -236,12 +231,11 @@ gst_mfx_task_frame_free (mfxHDL pthis, mfxFrameAllocResponse * resp)
   mfxU16 i, num_surfaces;
   ResponseData *response_data;
 
-  GList *l = g_list_find_custom (task->saved_responses, resp,
-      find_response);
-  if (!l)
+  response_data = resp ?
+      g_hash_table_lookup (task->responses, resp->mids) : NULL;
+  if (!response_data)
     return MFX_ERR_NOT_FOUND;
 
-  response_data = l->data;
   info = &response_data->frame_info;
 
   num_surfaces = response_data->num_surfaces;
@@ -274,7 +268,8 @@ gst_mfx_task_frame_free (mfxHDL pthis, mfxFrameAllocResponse * resp)
       response_data->mem_ids);
   g_slice_free1 (num_surfaces * sizeof (mfxMemId), response_data->mids);
 
-  task->saved_responses = g_list_delete_link (task->saved_responses, l);
+  g_hash_table_remove (task->responses, response_data->mids);
+  task->saved_responses = g_list_remove (task->saved_responses, response_data);
   g_free (response_data);
 
   return MFX_ERR_NONE;
@@ -342,6 +337,22 @@ gst_mfx_task_get_display (GstMfxTask * task)
   return gst_mfx_display_ref(task->display);
 }
 
+GstMfxBackpressure *
+gst_mfx_task_get_backpressure (GstMfxTask * task)
+{
+  g_return_val_if_fail (task != NULL, NULL);
+
+  return gst_mfx_task_aggregator_get_backpressure (task->aggregator);
+}
+
+guint
+gst_mfx_task_get_id (GstMfxTask * task)
+{
+  g_return_val_if_fail (task != NULL, 0);
+
+  return task->id;
+}
+
 mfxSession
 gst_mfx_task_get_session (GstMfxTask * task)
 {
@@ -421,6 +432,7 @@ gst_mfx_task_set_task_type (GstMfxTask * task, guint flags)
   g_return_if_fail (task != NULL);
 
   task->task_type = flags;
+  gst_mfx_task_aggregator_update_task_type (task->aggregator, task, flags);
 }
 
 guint
@@ -451,7 +463,8 @@ gst_mfx_task_use_video_memory (GstMfxTask * task)
     .GetHDL = gst_mfx_task_frame_get_hdl,
   };
 
-  MFXVideoCORE_SetFrameAllocator (task->session, &frame_allocator);
+  gst_mfx_task_aggregator_set_frame_allocator (task->aggregator,
+      task->session, &frame_allocator);
   task->memtype_is_system = FALSE;
 }
 
@@ -489,14 +502,14 @@ gst_mfx_task_update_video_params (GstMfxTask * task, mfxVideoParam * params)
 static void
 gst_mfx_task_finalize (GstMfxTask * task)
 {
-  if (task->is_joined) {
-    MFXDisjoinSession (task->session);
-    MFXClose (task->session);
-  }
+  if (task->is_joined)
+    gst_mfx_task_aggregator_release_session (task->aggregator, task->session,
+        task->is_joined);
   gst_mfx_task_aggregator_remove_task (task->aggregator, task);
   gst_mfx_task_aggregator_unref (task->aggregator);
   gst_mfx_display_unref (task->display);
   g_list_free_full (task->saved_responses, g_free);
+  g_hash_table_unref (task->responses);
 }
 
 
@@ -519,11 +532,10 @@ gst_mfx_task_init (GstMfxTask * task, GstMfxTaskAggregator * aggregator,
   task->display = gst_mfx_task_aggregator_get_display(aggregator);
   task->session = session;
   task->aggregator = gst_mfx_task_aggregator_ref (aggregator);
+  task->responses = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-  gst_mfx_task_aggregator_add_task (aggregator, task);
-
-  MFXVideoCORE_SetHandle (task->session, MFX_HANDLE_VA_DISPLAY,
-      GST_MFX_DISPLAY_VADISPLAY (task->display));
+  task->id =
+      gst_mfx_task_aggregator_add_task (aggregator, task, task->task_type);
 
   task->memtype_is_system = FALSE;
   task->soft_reinit = FALSE;
@@ -24,6 +24,7 @@
 #include "sysdeps.h"
 #include "gstmfxminiobject.h"
 #include "gstmfxdisplay.h"
+#include "gstmfxbackpressure.h"
 
 #include <mfxvideo.h>
 #include <va/va.h>
@@ -115,9 +116,15 @@ gst_mfx_task_get_num_surfaces (GstMfxTask * task);
 void
 gst_mfx_task_set_num_surfaces (GstMfxTask *task, mfxU16 num_surf);
 
+guint
+gst_mfx_task_get_id (GstMfxTask * task);
+
 mfxSession
 gst_mfx_task_get_session (GstMfxTask * task);
 
+GstMfxBackpressure *
+gst_mfx_task_get_backpressure (GstMfxTask * task);
+
 void
 gst_mfx_task_set_soft_reinit (GstMfxTask * task, gboolean reinit_status);
 
@@ -23,6 +23,30 @@
 #define DEBUG 1
 #include "gstmfxdebug.h"
 
+/* Default number of idle sessions kept per display */
+#define DEFAULT_SESSION_POOL_SIZE 4
+/* Maximum number of idle displays, with their sessions, kept warm for
+ * the aggregators created next */
+#define MAX_WARM_SESSION_POOLS 2
+
+/* Number of distinct GstMfxTaskType flags */
+#define NUM_TASK_TYPES 4
+
+G_LOCK_DEFINE_STATIC (warm_session_pools);
+static GQueue warm_session_pools = G_QUEUE_INIT;
+
+/* Registry entry of a task. Tasks are not referenced by the registry,
+ * they unregister themselves when they are destroyed */
+typedef struct _GstMfxTaskNode GstMfxTaskNode;
+struct _GstMfxTaskNode
+{
+  GstMfxTask *task;
+  guint id;
+  guint type_flags;
+  GstMfxTaskNode *upstream;
+  GList *downstream;
+};
+
 /**
 * GstMfxTaskAggregator:
 *
@@ -34,17 +58,102 @@ struct _GstMfxTaskAggregator
   GstMfxMiniObject parent_instance;
 
   GstMfxDisplay *display;
-  GList *cache;
+  /* DRM node the display was opened on, NULL if picked by the display */
+  gchar *device_path;
+
+  /* Task registry, protected by lock */
+  GMutex lock;
+  GHashTable *nodes_by_task;
+  GHashTable *nodes_by_id;
+  /* Most recently registered tasks first, one queue per task type */
+  GQueue nodes_by_type[NUM_TASK_TYPES];
+  guint next_task_id;
   GstMfxTask *current_task;
+
   mfxSession parent_session;
+  /* Set once a session could not be joined to the parent session */
+  gboolean join_failed;
+  GstMfxBackpressure *backpressure;
+  GstMfxSessionPool *session_pool;
 };
 
+/* Takes an idle session pool, along with its VA display, left over by a
+ * previous aggregator on the same DRM node */
+static GstMfxSessionPool *
+take_warm_session_pool (const gchar * device_path)
+{
+  GstMfxSessionPool *pool = NULL;
+  GstMfxDisplay *display;
+  GList *l;
+
+  G_LOCK (warm_session_pools);
+  for (l = warm_session_pools.head; l; l = l->next) {
+    display = gst_mfx_session_pool_get_display (l->data);
+    if (!g_strcmp0 (gst_mfx_display_get_device_path (display), device_path)) {
+      pool = l->data;
+      g_queue_delete_link (&warm_session_pools, l);
+      break;
+    }
+  }
+  G_UNLOCK (warm_session_pools);
+
+  return pool;
+}
+
+/* Keeps @pool around for the next aggregator. Displays that got bound to
+ * an OpenGL context are not reused, since that state is not reset */
+static void
+give_warm_session_pool (GstMfxSessionPool * pool)
+{
+  GstMfxDisplay *const display = gst_mfx_session_pool_get_display (pool);
+
+  if (gst_mfx_display_has_opengl (display))
+    goto drop;
+
+  G_LOCK (warm_session_pools);
+  if (g_queue_get_length (&warm_session_pools) < MAX_WARM_SESSION_POOLS) {
+    g_queue_push_tail (&warm_session_pools, pool);
+    pool = NULL;
+  }
+  G_UNLOCK (warm_session_pools);
+
+drop:
+  if (pool)
+    gst_mfx_session_pool_unref (pool);
+}
+
+static void
+free_task_node (GstMfxTaskNode * node)
+{
+  g_list_free (node->downstream);
+  g_slice_free (GstMfxTaskNode, node);
+}
+
 static void
 gst_mfx_task_aggregator_finalize (GstMfxTaskAggregator * aggregator)
 {
-  MFXClose (aggregator->parent_session);
-  g_list_free(aggregator->cache);
-  gst_mfx_display_unref (aggregator->display);
+  guint i;
+
+  if (aggregator->session_pool) {
+    if (aggregator->parent_session)
+      gst_mfx_device_list_add_sessions (aggregator->device_path, -1);
+    gst_mfx_session_pool_release (aggregator->session_pool,
+        aggregator->parent_session);
+    give_warm_session_pool (aggregator->session_pool);
+  }
+  gst_mfx_device_list_add_users (aggregator->device_path, -1);
+  g_free (aggregator->device_path);
+
+  for (i = 0; i < NUM_TASK_TYPES; i++)
+    g_queue_clear (&aggregator->nodes_by_type[i]);
+  if (aggregator->nodes_by_id)
+    g_hash_table_unref (aggregator->nodes_by_id);
+  if (aggregator->nodes_by_task)
+    g_hash_table_unref (aggregator->nodes_by_task);
+  g_mutex_clear (&aggregator->lock);
+
+  gst_mfx_backpressure_replace (&aggregator->backpressure, NULL);
+  gst_mfx_display_replace (&aggregator->display, NULL);
 }
 
 static inline const GstMfxMiniObjectClass *
@@ -58,26 +167,73 @@ gst_mfx_task_aggregator_class (void)
 }
 
 static gboolean
-aggregator_create (GstMfxTaskAggregator * aggregator)
+aggregator_create (GstMfxTaskAggregator * aggregator,
+    GstMfxDeviceSelection selection, const gchar * device_path)
 {
   g_return_val_if_fail (aggregator != NULL, FALSE);
 
-  aggregator->cache = NULL;
-  aggregator->display = gst_mfx_display_new ();
-  if (!aggregator->display)
-    return FALSE;
+  g_mutex_init (&aggregator->lock);
+  aggregator->nodes_by_task = g_hash_table_new (g_direct_hash, g_direct_equal);
+  aggregator->nodes_by_id = g_hash_table_new_full (g_direct_hash,
+      g_direct_equal, NULL, (GDestroyNotify) free_task_node);
+  aggregator->next_task_id = 1;
 
-  if (!gst_mfx_display_init_vaapi (aggregator->display))
+  aggregator->device_path =
+      gst_mfx_device_list_select (selection, device_path);
+
+  aggregator->session_pool = take_warm_session_pool (aggregator->device_path);
+  if (aggregator->session_pool) {
+    aggregator->display = gst_mfx_display_ref (
+        gst_mfx_session_pool_get_display (aggregator->session_pool));
+  }
+  else {
+    aggregator->display =
+        gst_mfx_display_new_with_device (aggregator->device_path);
+    if (!aggregator->display)
+      return FALSE;
+
+    if (!gst_mfx_display_init_vaapi (aggregator->display))
+      goto error;
+
+    aggregator->session_pool = gst_mfx_session_pool_new (aggregator->display,
+        DEFAULT_SESSION_POOL_SIZE);
+    if (!aggregator->session_pool)
+      goto error;
+    gst_mfx_session_pool_prewarm (aggregator->session_pool,
+        DEFAULT_SESSION_POOL_SIZE);
+  }
+
+  aggregator->backpressure = gst_mfx_backpressure_new ();
+  if (!aggregator->backpressure)
     goto error;
 
   return TRUE;
 error:
-  gst_mfx_display_unref (aggregator->display);
+  gst_mfx_session_pool_replace (&aggregator->session_pool, NULL);
+  gst_mfx_display_replace (&aggregator->display, NULL);
   return FALSE;
 }
 
 GstMfxTaskAggregator *
 gst_mfx_task_aggregator_new (void)
+{
+  return gst_mfx_task_aggregator_new_with_device (
+      gst_mfx_device_list_get_default_selection (), NULL);
+}
+
+/**
+ * gst_mfx_task_aggregator_new_with_device:
+ * @selection: policy used to pick a DRM node when @device_path is %NULL
+ * @device_path: (allow-none): DRM node to run the pipeline on
+ *
+ * Creates an aggregator whose tasks all run on the same DRM node, either
+ * @device_path or one picked among the available nodes by @selection.
+ *
+ * Returns: a new #GstMfxTaskAggregator
+ */
+GstMfxTaskAggregator *
+gst_mfx_task_aggregator_new_with_device (GstMfxDeviceSelection selection,
+    const gchar * device_path)
 {
   GstMfxTaskAggregator *aggregator;
 
@@ -86,7 +242,7 @@ gst_mfx_task_aggregator_new (void)
   if (!aggregator)
     return NULL;
 
-  if (!aggregator_create (aggregator))
+  if (!aggregator_create (aggregator, selection, device_path))
     goto error;
 
   return aggregator;
@@ -128,52 +284,36 @@ gst_mfx_task_aggregator_get_display (GstMfxTaskAggregator * aggregator)
   return gst_mfx_display_ref (aggregator->display);
 }
 
+const gchar *
+gst_mfx_task_aggregator_get_device_path (GstMfxTaskAggregator * aggregator)
+{
+  g_return_val_if_fail (aggregator != NULL, NULL);
+
+  return aggregator->device_path;
+}
+
+GstMfxBackpressure *
+gst_mfx_task_aggregator_get_backpressure (GstMfxTaskAggregator * aggregator)
+{
+  g_return_val_if_fail (aggregator != NULL, NULL);
+
+  return aggregator->backpressure;
+}
+
 mfxSession
 gst_mfx_task_aggregator_create_session (GstMfxTaskAggregator * aggregator,
     gboolean * is_joined)
 {
-  mfxIMPL impl;
-  mfxVersion version;
   mfxStatus sts;
   mfxSession session;
-  const char *desc;
-
-  mfxInitParam init_params;
 
-  memset (&init_params, 0, sizeof (init_params));
-
-  //init_params.GPUCopy = MFX_GPUCOPY_ON;
-  init_params.Implementation = MFX_IMPL_AUTO_ANY;
-  init_params.Version.Major = 1;
-  init_params.Version.Minor = 17;
+  g_return_val_if_fail (aggregator != NULL, NULL);
+  g_return_val_if_fail (is_joined != NULL, NULL);
 
-  sts = MFXInitEx (init_params, &session);
-  if (sts < 0) {
-    GST_ERROR ("Error initializing internal MFX session");
+  session = gst_mfx_session_pool_acquire (aggregator->session_pool);
+  if (!session)
     return NULL;
-  }
-
-  MFXQueryVersion (session, &version);
-
-  GST_INFO ("Using Media SDK API version %d.%d", version.Major, version.Minor);
-
-  MFXQueryIMPL (session, &impl);
-
-  switch (MFX_IMPL_BASETYPE (impl)) {
-    case MFX_IMPL_SOFTWARE:
-      desc = "software";
-      break;
-    case MFX_IMPL_HARDWARE:
-    case MFX_IMPL_HARDWARE2:
-    case MFX_IMPL_HARDWARE3:
-    case MFX_IMPL_HARDWARE4:
-      desc = "hardware accelerated";
-      break;
-    default:
-      desc = "unknown";
-  }
-
-  GST_INFO ("Initialized internal MFX session using %s implementation", desc);
+  gst_mfx_device_list_add_sessions (aggregator->device_path, 1);
 
   if (!aggregator->parent_session) {
     aggregator->parent_session = session;
@@ -181,19 +321,153 @@ gst_mfx_task_aggregator_create_session (GstMfxTaskAggregator * aggregator,
   }
   else {
     sts = MFXJoinSession (aggregator->parent_session, session);
+    if (sts < 0) {
+      GST_WARNING ("Unable to join MFX session %d", sts);
+      aggregator->join_failed = TRUE;
+    }
     *is_joined = TRUE;
   }
 
   return session;
 }
 
+/**
+ * gst_mfx_task_aggregator_release_session:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @session: a session created by gst_mfx_task_aggregator_create_session()
+ * @is_joined: whether @session was joined to the parent session
+ *
+ * Disjoins @session if needed and hands it back to the session pool.
+ * The parent session stays with the aggregator until it is destroyed.
+ */
+void
+gst_mfx_task_aggregator_release_session (GstMfxTaskAggregator * aggregator,
+    mfxSession session, gboolean is_joined)
+{
+  g_return_if_fail (aggregator != NULL);
+
+  if (!is_joined || session == aggregator->parent_session)
+    return;
+
+  MFXDisjoinSession (session);
+  gst_mfx_session_pool_release (aggregator->session_pool, session);
+  gst_mfx_device_list_add_sessions (aggregator->device_path, -1);
+}
+
+/**
+ * gst_mfx_task_aggregator_set_frame_allocator:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @session: a session created by gst_mfx_task_aggregator_create_session()
+ * @allocator: the #mfxFrameAllocator to use for @session
+ *
+ * Makes @session use @allocator until it is released back to the
+ * session pool, which keeps the session for reuse by other tasks.
+ *
+ * Returns: the status of gst_mfx_session_pool_set_frame_allocator()
+ */
+mfxStatus
+gst_mfx_task_aggregator_set_frame_allocator (GstMfxTaskAggregator *
+    aggregator, mfxSession session, mfxFrameAllocator * allocator)
+{
+  g_return_val_if_fail (aggregator != NULL, MFX_ERR_NULL_PTR);
+
+  return gst_mfx_session_pool_set_frame_allocator (aggregator->session_pool,
+      session, allocator);
+}
+
+/**
+ * gst_mfx_task_aggregator_set_session_pool_size:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @size: the maximum number of idle sessions
+ *
+ * Sets how many idle sessions the pool of @aggregator keeps, and
+ * initializes that many ahead of time. Elements set it from the
+ * "session-pool-size" field of the aggregator context.
+ */
+void
+gst_mfx_task_aggregator_set_session_pool_size (GstMfxTaskAggregator *
+    aggregator, guint size)
+{
+  g_return_if_fail (aggregator != NULL);
+
+  gst_mfx_session_pool_set_max_size (aggregator->session_pool, size);
+  gst_mfx_session_pool_prewarm (aggregator->session_pool, size);
+}
+
+/**
+ * gst_mfx_task_aggregator_get_session_stats:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @hits: (out) (allow-none): number of sessions reused from the pool
+ * @misses: (out) (allow-none): number of sessions initialized from scratch
+ *
+ * Retrieves the session reuse statistics of the pool used by
+ * @aggregator. The counters cover every aggregator that used the same
+ * pool.
+ */
+void
+gst_mfx_task_aggregator_get_session_stats (GstMfxTaskAggregator *
+    aggregator, guint * hits, guint * misses)
+{
+  g_return_if_fail (aggregator != NULL);
+
+  gst_mfx_session_pool_get_stats (aggregator->session_pool, hits, misses);
+}
+
+static inline GstMfxTaskNode *
+lookup_node (GstMfxTaskAggregator * aggregator, GstMfxTask * task)
+{
+  return task ? g_hash_table_lookup (aggregator->nodes_by_task, task) : NULL;
+}
+
+static void
+index_node_by_type (GstMfxTaskAggregator * aggregator, GstMfxTaskNode * node)
+{
+  guint i;
+
+  for (i = 0; i < NUM_TASK_TYPES; i++)
+    if (node->type_flags & (1 << i))
+      g_queue_push_head (&aggregator->nodes_by_type[i], node);
+}
+
+static void
+unindex_node_by_type (GstMfxTaskAggregator * aggregator,
+    GstMfxTaskNode * node)
+{
+  guint i;
+
+  for (i = 0; i < NUM_TASK_TYPES; i++)
+    if (node->type_flags & (1 << i))
+      g_queue_remove (&aggregator->nodes_by_type[i], node);
+}
+
+static void
+link_nodes (GstMfxTaskNode * upstream, GstMfxTaskNode * downstream)
+{
+  if (downstream->upstream == upstream)
+    return;
+
+  if (downstream->upstream)
+    downstream->upstream->downstream =
+        g_list_remove (downstream->upstream->downstream, downstream);
+
+  downstream->upstream = upstream;
+  if (upstream)
+    upstream->downstream = g_list_prepend (upstream->downstream, downstream);
+}
+
 GstMfxTask *
 gst_mfx_task_aggregator_get_current_task (GstMfxTaskAggregator * aggregator)
 {
+  GstMfxTask *task;
+
   g_return_val_if_fail (aggregator != NULL, NULL);
 
-  return aggregator->current_task ?
+  g_mutex_lock (&aggregator->lock);
+  task = aggregator->current_task ?
     gst_mfx_task_ref (aggregator->current_task) : NULL;
+  g_mutex_unlock (&aggregator->lock);
+
+  return task;
 }
 
 gboolean
@@ -203,7 +477,9 @@ gst_mfx_task_aggregator_set_current_task (GstMfxTaskAggregator * aggregator,
   g_return_val_if_fail (aggregator != NULL, FALSE);
   g_return_val_if_fail (task != NULL, FALSE);
 
+  g_mutex_lock (&aggregator->lock);
   aggregator->current_task = task;
+  g_mutex_unlock (&aggregator->lock);
 
   return TRUE;
 }
@@ -215,52 +491,240 @@ gst_mfx_task_aggregator_remove_current_task (GstMfxTaskAggregator * aggregator,
   g_return_if_fail (aggregator != NULL);
   g_return_if_fail (task != NULL);
 
+  g_mutex_lock (&aggregator->lock);
   if (aggregator->current_task == task)
     aggregator->current_task = NULL;
+  g_mutex_unlock (&aggregator->lock);
 }
 
-void
+/**
+ * gst_mfx_task_aggregator_add_task:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @task: the #GstMfxTask to register
+ * @type_flags: the #GstMfxTaskType flags of @task
+ *
+ * Registers @task and links it downstream of the current task, which is
+ * the task producing the surfaces the new task is going to consume.
+ *
+ * Returns: the id of @task within @aggregator, or 0 on error
+ */
+guint
 gst_mfx_task_aggregator_add_task (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * task, guint type_flags)
+{
+  GstMfxTaskNode *node;
+  guint id;
+
+  g_return_val_if_fail (aggregator != NULL, 0);
+  g_return_val_if_fail (task != NULL, 0);
+
+  g_mutex_lock (&aggregator->lock);
+  node = lookup_node (aggregator, task);
+  if (node) {
+    id = node->id;
+    goto done;
+  }
+
+  node = g_slice_new0 (GstMfxTaskNode);
+  node->task = task;
+  node->id = id = aggregator->next_task_id++;
+  node->type_flags = type_flags;
+
+  g_hash_table_insert (aggregator->nodes_by_task, task, node);
+  g_hash_table_insert (aggregator->nodes_by_id, GUINT_TO_POINTER (id), node);
+  index_node_by_type (aggregator, node);
+
+  if (aggregator->current_task != task)
+    link_nodes (lookup_node (aggregator, aggregator->current_task), node);
+
+done:
+  g_mutex_unlock (&aggregator->lock);
+  return id;
+}
+
+/**
+ * gst_mfx_task_aggregator_remove_task:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @task: the #GstMfxTask to unregister
+ *
+ * Unregisters @task. Its downstream tasks are linked to its own upstream
+ * task, so that the task graph stays connected.
+ */
+void
+gst_mfx_task_aggregator_remove_task (GstMfxTaskAggregator * aggregator,
     GstMfxTask * task)
 {
+  GstMfxTaskNode *node;
+
   g_return_if_fail (aggregator != NULL);
   g_return_if_fail (task != NULL);
 
-  aggregator->cache = g_list_prepend (aggregator->cache, task);
+  g_mutex_lock (&aggregator->lock);
+  node = lookup_node (aggregator, task);
+  if (!node)
+    goto done;
+
+  while (node->downstream)
+    link_nodes (node->upstream, node->downstream->data);
+  link_nodes (NULL, node);
+
+  unindex_node_by_type (aggregator, node);
+  if (aggregator->current_task == task)
+    aggregator->current_task = NULL;
+
+  g_hash_table_remove (aggregator->nodes_by_task, task);
+  g_hash_table_remove (aggregator->nodes_by_id, GUINT_TO_POINTER (node->id));
+
+done:
+  g_mutex_unlock (&aggregator->lock);
 }
 
 void
-gst_mfx_task_aggregator_remove_task (GstMfxTaskAggregator * aggregator,
-    GstMfxTask * task)
+gst_mfx_task_aggregator_update_task_type (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * task, guint type_flags)
 {
-  GList *elem;
+  GstMfxTaskNode *node;
 
   g_return_if_fail (aggregator != NULL);
   g_return_if_fail (task != NULL);
 
-  elem = g_list_find (aggregator->cache, task);
-  if (!elem)
-    return;
+  g_mutex_lock (&aggregator->lock);
+  node = lookup_node (aggregator, task);
+  if (node && node->type_flags != type_flags) {
+    unindex_node_by_type (aggregator, node);
+    node->type_flags = type_flags;
+    index_node_by_type (aggregator, node);
+  }
+  g_mutex_unlock (&aggregator->lock);
+}
+
+GstMfxTask *
+gst_mfx_task_aggregator_find_task_by_id (GstMfxTaskAggregator * aggregator,
+    guint id)
+{
+  GstMfxTaskNode *node;
+  GstMfxTask *task = NULL;
+
+  g_return_val_if_fail (aggregator != NULL, NULL);
+
+  g_mutex_lock (&aggregator->lock);
+  node = g_hash_table_lookup (aggregator->nodes_by_id, GUINT_TO_POINTER (id));
+  if (node)
+    task = gst_mfx_task_ref (node->task);
+  g_mutex_unlock (&aggregator->lock);
 
-  aggregator->cache = g_list_delete_link (aggregator->cache, elem);
+  return task;
+}
+
+/**
+ * gst_mfx_task_aggregator_find_task_by_type:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @type: a single #GstMfxTaskType flag
+ *
+ * Returns: (transfer full): the most recently registered task with the
+ *   @type flag set, or %NULL if there is none
+ */
+GstMfxTask *
+gst_mfx_task_aggregator_find_task_by_type (GstMfxTaskAggregator * aggregator,
+    GstMfxTaskType type)
+{
+  GstMfxTaskNode *node = NULL;
+  GstMfxTask *task = NULL;
+  guint i;
+
+  g_return_val_if_fail (aggregator != NULL, NULL);
+
+  g_mutex_lock (&aggregator->lock);
+  for (i = 0; i < NUM_TASK_TYPES; i++) {
+    if (type & (1 << i)) {
+      node = g_queue_peek_head (&aggregator->nodes_by_type[i]);
+      break;
+    }
+  }
+  if (node)
+    task = gst_mfx_task_ref (node->task);
+  g_mutex_unlock (&aggregator->lock);
+
+  return task;
+}
+
+/**
+ * gst_mfx_task_aggregator_get_upstream_task:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @task: a registered #GstMfxTask
+ *
+ * Returns: (transfer full): the task @task consumes surfaces from, or
+ *   %NULL if @task is the first one in its branch
+ */
+GstMfxTask *
+gst_mfx_task_aggregator_get_upstream_task (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * task)
+{
+  GstMfxTaskNode *node;
+  GstMfxTask *upstream_task = NULL;
+
+  g_return_val_if_fail (aggregator != NULL, NULL);
+  g_return_val_if_fail (task != NULL, NULL);
+
+  g_mutex_lock (&aggregator->lock);
+  node = lookup_node (aggregator, task);
+  if (node && node->upstream)
+    upstream_task = gst_mfx_task_ref (node->upstream->task);
+  g_mutex_unlock (&aggregator->lock);
+
+  return upstream_task;
+}
+
+/**
+ * gst_mfx_task_aggregator_link_tasks:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @upstream: (allow-none): the task producing surfaces
+ * @downstream: the task consuming surfaces from @upstream
+ *
+ * Explicitly links @downstream to @upstream, replacing the link set up
+ * when @downstream was registered. A %NULL @upstream unlinks it.
+ *
+ * Returns: %TRUE if both tasks are registered with @aggregator
+ */
+gboolean
+gst_mfx_task_aggregator_link_tasks (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * upstream, GstMfxTask * downstream)
+{
+  GstMfxTaskNode *upstream_node, *downstream_node;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (aggregator != NULL, FALSE);
+  g_return_val_if_fail (downstream != NULL, FALSE);
+  g_return_val_if_fail (upstream != downstream, FALSE);
+
+  g_mutex_lock (&aggregator->lock);
+  upstream_node = lookup_node (aggregator, upstream);
+  downstream_node = lookup_node (aggregator, downstream);
+  if (downstream_node && (upstream_node || !upstream)) {
+    link_nodes (upstream_node, downstream_node);
+    success = TRUE;
+  }
+  g_mutex_unlock (&aggregator->lock);
+
+  return success;
 }
 
 void
 gst_mfx_task_aggregator_update_peer_memtypes (GstMfxTaskAggregator * aggregator,
     gboolean memtype_is_system)
 {
+  GstMfxTaskNode *node;
   GstMfxTask *upstream_task;
-  guint task_index;
   mfxVideoParam *params;
 
   g_return_if_fail (aggregator != NULL);
 
-  task_index = g_list_index (aggregator->cache, aggregator->current_task);
+  g_mutex_lock (&aggregator->lock);
 
-  do {
-    upstream_task = g_list_nth_data (aggregator->cache, task_index++);
-    if (!upstream_task)
-      break;
+  /* Walk up the branch of the current task only */
+  node = lookup_node (aggregator, aggregator->current_task);
+  while (node) {
+    upstream_task = node->task;
     params = gst_mfx_task_get_video_params (upstream_task);
     if (gst_mfx_task_has_type (upstream_task, GST_MFX_TASK_VPP_OUT)) {
       if (memtype_is_system) {
@@ -278,5 +742,74 @@ gst_mfx_task_aggregator_update_peer_memtypes (GstMfxTaskAggregator * aggregator,
         MFX_IOPATTERN_OUT_SYSTEM_MEMORY : MFX_IOPATTERN_OUT_VIDEO_MEMORY;
     }
     memtype_is_system = !!(params->IOPattern & MFX_IOPATTERN_IN_SYSTEM_MEMORY);
-  } while (memtype_is_system);
+    if (!memtype_is_system)
+      break;
+    node = node->upstream;
+  }
+
+  g_mutex_unlock (&aggregator->lock);
+}
+
+/* A node is fused if its surfaces stay in video memory and are only
+ * consumed by the encoder sharing its task, or by fused tasks in the same
+ * session or a joined one */
+static gboolean
+node_is_fused (GstMfxTaskAggregator * aggregator, GstMfxTaskNode * node)
+{
+  GstMfxTaskNode *peer;
+  GList *l;
+
+  if (!gst_mfx_task_has_video_memory (node->task))
+    return FALSE;
+  if (node->type_flags & GST_MFX_TASK_ENCODER)
+    return TRUE;
+  if (!node->downstream)
+    return FALSE;
+
+  for (l = node->downstream; l; l = l->next) {
+    peer = l->data;
+    if (aggregator->join_failed && gst_mfx_task_get_session (peer->task) !=
+        gst_mfx_task_get_session (node->task))
+      return FALSE;
+    if (!node_is_fused (aggregator, peer))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * gst_mfx_task_aggregator_is_fused_transcode:
+ * @aggregator: a #GstMfxTaskAggregator
+ * @task: a registered #GstMfxTask
+ *
+ * Checks whether @task is part of a fused transcode chain, that is a
+ * decoder, optionally followed by VPP tasks, feeding encoders only, all
+ * in video memory and in sessions joined to each other. The SDK then
+ * orders the work of the whole chain by itself, so @task should attach
+ * the sync point of each operation to its output surface with
+ * gst_mfx_surface_set_sync_point() rather than wait for it, leaving the
+ * encoders as the only stage blocking on the device.
+ *
+ * The task graph changes as elements are linked, so this is meant to be
+ * checked for every frame rather than cached.
+ *
+ * Returns: %TRUE if @task does not need to synchronize its output
+ */
+gboolean
+gst_mfx_task_aggregator_is_fused_transcode (GstMfxTaskAggregator *
+    aggregator, GstMfxTask * task)
+{
+  GstMfxTaskNode *node;
+  gboolean fused = FALSE;
+
+  g_return_val_if_fail (aggregator != NULL, FALSE);
+  g_return_val_if_fail (task != NULL, FALSE);
+
+  g_mutex_lock (&aggregator->lock);
+  node = lookup_node (aggregator, task);
+  if (node)
+    fused = node_is_fused (aggregator, node);
+  g_mutex_unlock (&aggregator->lock);
+
+  return fused;
 }
@@ -25,6 +25,9 @@
 #include "gstmfxminiobject.h"
 #include "gstmfxdisplay.h"
 #include "gstmfxtask.h"
+#include "gstmfxbackpressure.h"
+#include "gstmfxsessionpool.h"
+#include "gstmfxdevice.h"
 
 #include <mfxvideo.h>
 #include <va/va.h>
@@ -38,6 +41,10 @@ G_BEGIN_DECLS
 GstMfxTaskAggregator *
 gst_mfx_task_aggregator_new (void);
 
+GstMfxTaskAggregator *
+gst_mfx_task_aggregator_new_with_device (GstMfxDeviceSelection selection,
+    const gchar * device_path);
+
 GstMfxTask *
 gst_mfx_task_aggregator_get_current_task (GstMfxTaskAggregator * aggregator);
 
@@ -49,9 +56,9 @@ void
 gst_mfx_task_aggregator_remove_current_task (GstMfxTaskAggregator * aggregator,
     GstMfxTask * task);
 
-void
+guint
 gst_mfx_task_aggregator_add_task (GstMfxTaskAggregator * aggregator,
-    GstMfxTask * task);
+    GstMfxTask * task, guint type_flags);
 
 GstMfxTaskAggregator *
 gst_mfx_task_aggregator_ref (GstMfxTaskAggregator * aggregator);
@@ -66,18 +73,63 @@ gst_mfx_task_aggregator_replace (GstMfxTaskAggregator ** old_aggregator_ptr,
 GstMfxDisplay *
 gst_mfx_task_aggregator_get_display (GstMfxTaskAggregator * aggregator);
 
+const gchar *
+gst_mfx_task_aggregator_get_device_path (GstMfxTaskAggregator * aggregator);
+
+GstMfxBackpressure *
+gst_mfx_task_aggregator_get_backpressure (GstMfxTaskAggregator * aggregator);
+
 mfxSession
 gst_mfx_task_aggregator_create_session (GstMfxTaskAggregator * aggregator,
     gboolean * is_joined);
 
+void
+gst_mfx_task_aggregator_release_session (GstMfxTaskAggregator * aggregator,
+    mfxSession session, gboolean is_joined);
+
+mfxStatus
+gst_mfx_task_aggregator_set_frame_allocator (GstMfxTaskAggregator *
+    aggregator, mfxSession session, mfxFrameAllocator * allocator);
+
+void
+gst_mfx_task_aggregator_set_session_pool_size (GstMfxTaskAggregator *
+    aggregator, guint size);
+
+void
+gst_mfx_task_aggregator_get_session_stats (GstMfxTaskAggregator *
+    aggregator, guint * hits, guint * misses);
+
 void
 gst_mfx_task_aggregator_remove_task (GstMfxTaskAggregator * aggregator,
     GstMfxTask * task);
 
+void
+gst_mfx_task_aggregator_update_task_type (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * task, guint type_flags);
+
+GstMfxTask *
+gst_mfx_task_aggregator_find_task_by_id (GstMfxTaskAggregator * aggregator,
+    guint id);
+
+GstMfxTask *
+gst_mfx_task_aggregator_find_task_by_type (GstMfxTaskAggregator * aggregator,
+    GstMfxTaskType type);
+
+GstMfxTask *
+gst_mfx_task_aggregator_get_upstream_task (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * task);
+
+gboolean
+gst_mfx_task_aggregator_link_tasks (GstMfxTaskAggregator * aggregator,
+    GstMfxTask * upstream, GstMfxTask * downstream);
+
 void
 gst_mfx_task_aggregator_update_peer_memtypes (GstMfxTaskAggregator * aggregator,
     gboolean memtype_is_system);
 
+gboolean
+gst_mfx_task_aggregator_is_fused_transcode (GstMfxTaskAggregator *
+    aggregator, GstMfxTask * task);
 
 G_END_DECLS
 
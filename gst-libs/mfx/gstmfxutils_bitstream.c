@@ -0,0 +1,335 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gstmfxutils_bitstream.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define USE_X86_SIMD 1
+# include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+# define USE_NEON 1
+# include <arm_neon.h>
+#endif
+
+#define DEBUG 1
+#include "gstmfxdebug.h"
+
+/* Both start codes and emulation prevention sequences are two zero bytes
+ * followed by a byte of value @last. The scanners return the offset of the
+ * first such sequence starting at or after @pos, or @size */
+typedef gsize (*FindSequenceFunc) (const guint8 * data, gsize size,
+    gsize pos, guint8 last);
+
+static FindSequenceFunc find_sequence;
+
+static gsize
+find_sequence_c (const guint8 * data, gsize size, gsize pos, guint8 last)
+{
+  while (pos + 3 <= size) {
+    /* None of the next three positions can start a sequence */
+    if (data[pos + 2] && data[pos + 2] != last)
+      pos += 3;
+    else if (!data[pos] && !data[pos + 1] && data[pos + 2] == last)
+      return pos;
+    else
+      pos++;
+  }
+  return size;
+}
+
+#ifdef USE_X86_SIMD
+/* Compares three overlapping loads, so that bit i of the mask is set when a
+ * sequence starts at byte i of the block. Blocks whose loads would go past
+ * the end of the data are left to the narrower kernels */
+__attribute__ ((target ("sse2")))
+static gsize
+find_sequence_sse2 (const guint8 * data, gsize size, gsize pos, guint8 last)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i third = _mm_set1_epi8 ((gchar) last);
+  guint mask;
+
+  for (; pos + 18 <= size; pos += 16) {
+    __m128i x0 = _mm_loadu_si128 ((const __m128i *) (data + pos));
+    __m128i x1 = _mm_loadu_si128 ((const __m128i *) (data + pos + 1));
+    __m128i x2 = _mm_loadu_si128 ((const __m128i *) (data + pos + 2));
+
+    mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_and_si128
+            (_mm_cmpeq_epi8 (x0, zero), _mm_cmpeq_epi8 (x1, zero)),
+            _mm_cmpeq_epi8 (x2, third)));
+    if (mask)
+      return pos + __builtin_ctz (mask);
+  }
+  return find_sequence_c (data, size, pos, last);
+}
+
+__attribute__ ((target ("avx2")))
+static gsize
+find_sequence_avx2 (const guint8 * data, gsize size, gsize pos, guint8 last)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i third = _mm256_set1_epi8 ((gchar) last);
+  guint mask;
+
+  for (; pos + 34 <= size; pos += 32) {
+    __m256i y0 = _mm256_loadu_si256 ((const __m256i *) (data + pos));
+    __m256i y1 = _mm256_loadu_si256 ((const __m256i *) (data + pos + 1));
+    __m256i y2 = _mm256_loadu_si256 ((const __m256i *) (data + pos + 2));
+
+    mask = (guint) _mm256_movemask_epi8 (_mm256_and_si256 (_mm256_and_si256
+            (_mm256_cmpeq_epi8 (y0, zero), _mm256_cmpeq_epi8 (y1, zero)),
+            _mm256_cmpeq_epi8 (y2, third)));
+    if (mask) {
+      _mm256_zeroupper ();
+      return pos + __builtin_ctz (mask);
+    }
+  }
+  _mm256_zeroupper ();
+  return find_sequence_sse2 (data, size, pos, last);
+}
+#endif
+
+#ifdef USE_NEON
+/* NEON has no byte mask extraction, so a block holding a match is handed
+ * over to the scalar scanner, which then finds it within that block */
+static gsize
+find_sequence_neon (const guint8 * data, gsize size, gsize pos, guint8 last)
+{
+  const uint8x16_t zero = vdupq_n_u8 (0);
+  const uint8x16_t third = vdupq_n_u8 (last);
+
+  for (; pos + 18 <= size; pos += 16) {
+    uint8x16_t m = vandq_u8 (vandq_u8 (vceqq_u8 (vld1q_u8 (data + pos), zero),
+            vceqq_u8 (vld1q_u8 (data + pos + 1), zero)),
+        vceqq_u8 (vld1q_u8 (data + pos + 2), third));
+    uint64x2_t m64 = vreinterpretq_u64_u8 (m);
+
+    if (vgetq_lane_u64 (m64, 0) | vgetq_lane_u64 (m64, 1))
+      return find_sequence_c (data, pos + 18, pos, last);
+  }
+  return find_sequence_c (data, size, pos, last);
+}
+#endif
+
+static gpointer
+init_scanner (gpointer data)
+{
+  const gchar *kernel_name = "scalar";
+
+  find_sequence = find_sequence_c;
+#if defined(USE_X86_SIMD)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2")) {
+    find_sequence = find_sequence_avx2;
+    kernel_name = "AVX2";
+  } else if (__builtin_cpu_supports ("sse2")) {
+    find_sequence = find_sequence_sse2;
+    kernel_name = "SSE2";
+  }
+#elif defined(USE_NEON)
+  find_sequence = find_sequence_neon;
+  kernel_name = "NEON";
+#endif
+
+  GST_INFO ("using %s start code scanner", kernel_name);
+
+  return NULL;
+}
+
+static inline gsize
+scan (const guint8 * data, gsize size, gsize pos, guint8 last)
+{
+  static GOnce scanner_once = G_ONCE_INIT;
+
+  g_once (&scanner_once, init_scanner, NULL);
+
+  if (G_UNLIKELY (!data || pos >= size))
+    return size;
+  return find_sequence (data, size, pos, last);
+}
+
+/**
+ * gst_mfx_utils_find_start_code:
+ * @data: the byte stream to scan
+ * @size: the size of @data
+ * @pos: the offset to start scanning from
+ *
+ * Looks for the 00 00 01 prefix of the start codes of H.264, H.265,
+ * MPEG-2 and VC-1 byte streams. A 4-byte start code is found at the offset
+ * of its last three bytes.
+ *
+ * Returns: the offset of the first start code at or after @pos, or @size
+ *   if there is none
+ */
+gsize
+gst_mfx_utils_find_start_code (const guint8 * data, gsize size, gsize pos)
+{
+  return scan (data, size, pos, 0x01);
+}
+
+/**
+ * gst_mfx_utils_find_emulation_prevention:
+ * @data: the NAL unit to scan
+ * @size: the size of @data
+ * @pos: the offset to start scanning from
+ *
+ * Looks for the 00 00 03 sequences of H.264 and H.265 NAL units, whose
+ * last byte has to be dropped to recover the payload.
+ *
+ * Returns: the offset of the first sequence at or after @pos, or @size if
+ *   there is none
+ */
+gsize
+gst_mfx_utils_find_emulation_prevention (const guint8 * data, gsize size,
+    gsize pos)
+{
+  return scan (data, size, pos, 0x03);
+}
+
+/* Moves to the next byte, stepping over an emulation prevention byte */
+static inline void
+next_byte (GstMfxBitReader * reader)
+{
+  reader->zeros = reader->data[reader->byte] ? 0 : reader->zeros + 1;
+  reader->byte++;
+  reader->bit = 0;
+
+  if (reader->zeros >= 2 && reader->byte < reader->size
+      && reader->data[reader->byte] == 0x03) {
+    reader->byte++;
+    reader->zeros = 0;
+  }
+}
+
+void
+gst_mfx_bit_reader_init (GstMfxBitReader * reader, const guint8 * data,
+    gsize size)
+{
+  g_return_if_fail (reader != NULL);
+
+  reader->data = data;
+  reader->size = data ? size : 0;
+  reader->byte = 0;
+  reader->bit = 0;
+  reader->zeros = 0;
+}
+
+/**
+ * gst_mfx_bit_reader_read_bits:
+ * @reader: a #GstMfxBitReader
+ * @nbits: the number of bits to read, at most 32
+ * @value: return location for the bits read
+ *
+ * Returns: %TRUE if @nbits bits were read, or %FALSE if the payload is too
+ *   short
+ */
+gboolean
+gst_mfx_bit_reader_read_bits (GstMfxBitReader * reader, guint nbits,
+    guint32 * value)
+{
+  guint32 res = 0;
+  guint n;
+
+  g_return_val_if_fail (reader != NULL, FALSE);
+  g_return_val_if_fail (nbits <= 32, FALSE);
+
+  /* Take as many bits as possible out of each byte */
+  while (nbits) {
+    if (reader->byte >= reader->size)
+      return FALSE;
+
+    n = MIN (nbits, 8 - reader->bit);
+    res = (res << n) | ((reader->data[reader->byte] >> (8 - reader->bit - n))
+        & ((1 << n) - 1));
+    nbits -= n;
+
+    reader->bit += n;
+    if (reader->bit == 8)
+      next_byte (reader);
+  }
+
+  if (value)
+    *value = res;
+  return TRUE;
+}
+
+/**
+ * gst_mfx_bit_reader_read_ue:
+ * @reader: a #GstMfxBitReader
+ * @value: return location for the value read
+ *
+ * Reads an unsigned Exp-Golomb code. Leading zero bits are counted a byte
+ * at a time whenever the reader sits on a zero byte.
+ *
+ * Returns: %TRUE if a complete code of at most 32 bits was read
+ */
+gboolean
+gst_mfx_bit_reader_read_ue (GstMfxBitReader * reader, guint32 * value)
+{
+  guint leading_zeros = 0;
+  guint32 bits, suffix;
+  guint avail;
+
+  g_return_val_if_fail (reader != NULL, FALSE);
+
+  for (;;) {
+    if (reader->byte >= reader->size)
+      return FALSE;
+
+    avail = 8 - reader->bit;
+    bits = reader->data[reader->byte] & ((1 << avail) - 1);
+    if (bits) {
+      /* The first set bit ends the prefix, and is consumed with it */
+      guint n = avail - g_bit_storage (bits) + 1;
+
+      leading_zeros += n - 1;
+      if (leading_zeros > 31)
+        return FALSE;
+      reader->bit += n;
+      if (reader->bit == 8)
+        next_byte (reader);
+      break;
+    }
+    leading_zeros += avail;
+    if (leading_zeros > 31)
+      return FALSE;
+    next_byte (reader);
+  }
+
+  if (!gst_mfx_bit_reader_read_bits (reader, leading_zeros, &suffix))
+    return FALSE;
+
+  if (value)
+    *value = ((1U << leading_zeros) - 1) + suffix;
+  return TRUE;
+}
+
+gboolean
+gst_mfx_bit_reader_read_se (GstMfxBitReader * reader, gint32 * value)
+{
+  guint32 code;
+
+  if (!gst_mfx_bit_reader_read_ue (reader, &code))
+    return FALSE;
+
+  if (value)
+    *value = (code & 1) ? (gint32) ((code >> 1) + 1) : -(gint32) (code >> 1);
+  return TRUE;
+}
@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFX_UTILS_BITSTREAM_H
+#define GST_MFX_UTILS_BITSTREAM_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstMfxBitReader GstMfxBitReader;
+
+/**
+ * GstMfxBitReader:
+ *
+ * Reads the bits of an H.264 or H.265 NAL unit payload, skipping the
+ * emulation prevention bytes on the way. All fields are private.
+ */
+struct _GstMfxBitReader
+{
+  /*< private >*/
+  const guint8 *data;
+  gsize size;
+  gsize byte;
+  guint bit;
+  /* Number of consecutive zero bytes preceding the current byte */
+  guint zeros;
+};
+
+/* Returns the offset of the first 00 00 01 sequence at or after @pos, or
+ * @size if there is none */
+gsize
+gst_mfx_utils_find_start_code (const guint8 * data, gsize size, gsize pos);
+
+/* Returns the offset of the first 00 00 03 sequence at or after @pos, or
+ * @size if there is none */
+gsize
+gst_mfx_utils_find_emulation_prevention (const guint8 * data, gsize size,
+    gsize pos);
+
+void
+gst_mfx_bit_reader_init (GstMfxBitReader * reader, const guint8 * data,
+    gsize size);
+
+gboolean
+gst_mfx_bit_reader_read_bits (GstMfxBitReader * reader, guint nbits,
+    guint32 * value);
+
+gboolean
+gst_mfx_bit_reader_read_ue (GstMfxBitReader * reader, guint32 * value);
+
+gboolean
+gst_mfx_bit_reader_read_se (GstMfxBitReader * reader, gint32 * value);
+
+G_END_DECLS
+
+#endif /* GST_MFX_UTILS_BITSTREAM_H */
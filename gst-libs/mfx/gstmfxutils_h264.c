@@ -23,6 +23,7 @@
 #include "sysdeps.h"
 #include <gst/codecparsers/gsth264parser.h>
 #include "gstmfxutils_h264.h"
+#include "gstmfxutils_bitstream.h"
 
 struct map
 {
@@ -99,54 +100,22 @@ gst_mfx_utils_h264_get_profile_string (mfxU16 profile)
   return m ? m->name : NULL;
 }
 
-static guint16 read_ue(const guint8 *slice_buf, gint *nbits, gint size)
-{
-  if (!slice_buf || !nbits)
-    return 0;
-
-  guint16 res = 0;
-  gint offset = *nbits / 8, c = *nbits, i;
-  guint8 bit = 0x80 >> (*nbits % 8);
-
-  while (!(slice_buf[offset] & bit)) {
-    bit >>= 1;
-    ++(*nbits);
-    if (!(*nbits % 8)) {
-      ++offset;
-      bit = 0x80;
-    }
-  }
-
-  i = c = *nbits - c;
-  while (c) {
-    bit >>= 1;
-    ++(*nbits);
-    if (!(*nbits % 8)) {
-      ++offset;
-      bit = 0x80;
-    }
-    res <<= 1;
-    res |= (slice_buf[offset] & bit) ? 1 : 0;
-    --c;
-  }
-
-  ++(*nbits);
-  res = res + (1 << i) - 1;
-
-  return res;
-}
-
 gboolean
 gst_mfx_utils_h264_is_slice_intra (const guint8 *slice_buf, gint size)
 {
-  gint nbits = 8;
+  GstMfxBitReader reader;
+  guint32 slice_type;
+
+  if (!slice_buf || size < 2)
+    return FALSE;
 
-  /* First UE value is fist_mb_in_slice */
-  read_ue(slice_buf, &nbits, size);
+  /* Skip the NAL unit header */
+  gst_mfx_bit_reader_init (&reader, slice_buf + 1, size - 1);
 
-  /* Second UE value is slice type */
-  if ((read_ue(slice_buf, &nbits, size) % 5) == GST_H264_I_SLICE)
-    return TRUE;
+  /* First UE value is first_mb_in_slice, the second one is slice type */
+  if (!gst_mfx_bit_reader_read_ue (&reader, NULL)
+      || !gst_mfx_bit_reader_read_ue (&reader, &slice_type))
+    return FALSE;
 
-  return FALSE;
+  return (slice_type % 5) == GST_H264_I_SLICE;
 }
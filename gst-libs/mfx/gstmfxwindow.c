@@ -443,6 +443,9 @@ gst_mfx_window_put_surface (GstMfxWindow * window,
   if (!klass->render)
     return FALSE;
 
+  if (!gst_mfx_surface_sync (surface))
+    return FALSE;
+
   if (!src_rect) {
     src_rect = &src_rect_default;
     get_surface_rect (surface, &src_rect_default);
@@ -32,6 +32,8 @@
 #include "gstmfxdisplay_wayland.h"
 #include "gstmfxdisplay_wayland_priv.h"
 #include "gstmfxsurface.h"
+#include "gstmfxsurface_priv.h"
+#include "gstmfxsurfacepool.h"
 #include "gstmfxprimebufferproxy.h"
 #include "gstmfxutils_vaapi.h"
 #include "wayland-drm-client-protocol.h"
@@ -39,6 +41,9 @@
 #define DEBUG 1
 #include "gstmfxdebug.h"
 
+/* Number of cached buffers for surfaces that do not belong to a pool */
+#define DEFAULT_BUFFER_CACHE_SIZE 16
+
 #define GST_MFX_WINDOW_WAYLAND_CAST(obj) \
 	((GstMfxWindowWayland *)(obj))
 
@@ -48,6 +53,7 @@
 typedef struct _GstMfxWindowWaylandPrivate GstMfxWindowWaylandPrivate;
 typedef struct _GstMfxWindowWaylandClass GstMfxWindowWaylandClass;
 typedef struct _FrameState FrameState;
+typedef struct _BufferState BufferState;
 
 struct _FrameState
 {
@@ -84,6 +90,38 @@ frame_state_free (FrameState *frame)
   g_slice_free (FrameState, frame);
 }
 
+/* A wl_buffer wrapping the PRIME export of a surface. Buffers are cached
+ * per VA surface and attached again whenever their surface comes back
+ * from the pool, until the crop changes or the least recently displayed
+ * buffers are evicted to make room for new surfaces */
+struct _BufferState
+{
+  GstMfxWindow *window;
+  GstMfxID surface_id;
+  GstMfxPrimeBufferProxy *proxy;
+  struct wl_buffer *wl_buffer;
+  guint width;
+  guint height;
+  /* Frame using the buffer until the compositor releases it */
+  FrameState *frame;
+  /* Buffers no longer cached are destroyed on release */
+  gboolean orphaned;
+  GList link;
+};
+
+static void
+buffer_state_free (BufferState *buffer)
+{
+  if (!buffer)
+    return;
+
+  frame_state_free (buffer->frame);
+  if (buffer->wl_buffer)
+    wl_buffer_destroy (buffer->wl_buffer);
+  gst_mfx_prime_buffer_proxy_unref (buffer->proxy);
+  g_slice_free (BufferState, buffer);
+}
+
 struct _GstMfxWindowWaylandPrivate
 {
   struct wl_shell_surface *shell_surface;
@@ -102,6 +140,15 @@ struct _GstMfxWindowWaylandPrivate
 #endif
   GstPoll *poll;
   GstPollFD pollfd;
+  /* VASurfaceID -> BufferState, least recently displayed first, and the
+   * buffers evicted while still in use by the compositor. All of them are
+   * protected by buffer_lock */
+  GHashTable *buffers;
+  GQueue buffers_lru;
+  GList *orphaned_buffers;
+  GMutex buffer_lock;
+  /* Detached PRIME exports last swept from the cache */
+  guint detach_count;
   guint is_shown:1;
   guint fullscreen_on_show:1;
   guint sync_failed:1;
@@ -143,19 +190,210 @@ static const struct wl_callback_listener frame_callback_listener = {
 };
 
 static void
-frame_release_callback (void *data, struct wl_buffer *wl_buffer)
+buffer_release_callback (void *data, struct wl_buffer *wl_buffer)
 {
-  FrameState *const frame = data;
-  if (!frame->done)
+  BufferState *const buffer = data;
+  GstMfxWindowWaylandPrivate *const priv =
+      GST_MFX_WINDOW_WAYLAND_GET_PRIVATE (buffer->window);
+  FrameState *frame;
+
+  g_mutex_lock (&priv->buffer_lock);
+  frame = buffer->frame;
+  buffer->frame = NULL;
+  if (frame && !frame->done)
     frame_done (frame);
-  wl_buffer_destroy (wl_buffer);
   frame_state_free (frame);
+
+  if (buffer->orphaned) {
+    priv->orphaned_buffers = g_list_remove (priv->orphaned_buffers, buffer);
+    buffer_state_free (buffer);
+  }
+  g_mutex_unlock (&priv->buffer_lock);
 }
 
 static const struct wl_buffer_listener frame_buffer_listener = {
-  frame_release_callback
+  buffer_release_callback
 };
 
+static BufferState *
+buffer_state_new (GstMfxWindow * window, GstMfxSurface * surface,
+    GstMfxPrimeBufferProxy * proxy, guint width, guint height)
+{
+  GstMfxWindowWaylandPrivate *const priv =
+      GST_MFX_WINDOW_WAYLAND_GET_PRIVATE (window);
+  GstMfxDisplayWaylandPrivate *const display_priv =
+      GST_MFX_DISPLAY_WAYLAND_GET_PRIVATE (GST_MFX_WINDOW_DISPLAY (window));
+  BufferState *buffer;
+  VaapiImage *vaapi_image;
+  guint32 drm_format = 0;
+  gint offsets[3] = { 0 }, pitches[3] = { 0 }, num_planes, i;
+
+  if (!display_priv->drm)
+    return NULL;
+
+  vaapi_image = gst_mfx_prime_buffer_proxy_get_vaapi_image (proxy);
+  num_planes = vaapi_image_get_plane_count (vaapi_image);
+  for (i = 0; i < num_planes; i++) {
+    offsets[i] = vaapi_image_get_offset (vaapi_image, i);
+    pitches[i] = vaapi_image_get_pitch (vaapi_image, i);
+  }
+
+  if (GST_VIDEO_FORMAT_NV12 == vaapi_image_get_format (vaapi_image)) {
+    drm_format = WL_DRM_FORMAT_NV12;
+  } else if (GST_VIDEO_FORMAT_BGRA == vaapi_image_get_format (vaapi_image)) {
+    drm_format = WL_DRM_FORMAT_ARGB8888;
+  }
+  vaapi_image_unref (vaapi_image);
+
+  if (!drm_format)
+    return NULL;
+
+  buffer = g_slice_new0 (BufferState);
+  buffer->window = window;
+  buffer->surface_id = GST_MFX_SURFACE_ID (surface);
+  buffer->proxy = gst_mfx_prime_buffer_proxy_ref (proxy);
+  buffer->width = width;
+  buffer->height = height;
+  buffer->link.data = buffer;
+
+  GST_MFX_DISPLAY_LOCK (GST_MFX_WINDOW_DISPLAY (window));
+  buffer->wl_buffer =
+      wl_drm_create_prime_buffer (display_priv->drm,
+          GST_MFX_PRIME_BUFFER_PROXY_HANDLE (proxy), width, height, drm_format,
+          offsets[0], pitches[0],
+          offsets[1], pitches[1],
+          offsets[2], pitches[2]);
+  if (buffer->wl_buffer) {
+    wl_proxy_set_queue ((struct wl_proxy *) buffer->wl_buffer,
+        priv->event_queue);
+    wl_buffer_add_listener (buffer->wl_buffer, &frame_buffer_listener, buffer);
+  }
+  GST_MFX_DISPLAY_UNLOCK (GST_MFX_WINDOW_DISPLAY (window));
+  if (!buffer->wl_buffer) {
+    GST_ERROR ("No wl_buffer created\n");
+    buffer_state_free (buffer);
+    return NULL;
+  }
+  return buffer;
+}
+
+/* Called with buffer_lock held */
+static void
+buffer_state_retire (GstMfxWindowWaylandPrivate * priv, BufferState * buffer)
+{
+  if (buffer->frame) {
+    buffer->orphaned = TRUE;
+    priv->orphaned_buffers = g_list_prepend (priv->orphaned_buffers, buffer);
+  } else
+    buffer_state_free (buffer);
+}
+
+/* Called with buffer_lock held */
+static void
+buffer_cache_remove (GstMfxWindowWaylandPrivate * priv, BufferState * buffer)
+{
+  g_hash_table_steal (priv->buffers, GUINT_TO_POINTER (buffer->surface_id));
+  g_queue_unlink (&priv->buffers_lru, &buffer->link);
+  buffer_state_retire (priv, buffer);
+}
+
+/* Called with buffer_lock held. Drops the buffers of surfaces that were
+ * destroyed, e.g. along with their pool, whenever any was */
+static void
+buffer_cache_sweep (GstMfxWindowWaylandPrivate * priv)
+{
+  const guint detach_count = gst_mfx_prime_buffer_proxy_get_detach_count ();
+  BufferState *buffer;
+  GList *l, *next;
+
+  if (detach_count == priv->detach_count)
+    return;
+  priv->detach_count = detach_count;
+
+  for (l = priv->buffers_lru.head; l; l = next) {
+    next = l->next;
+    buffer = l->data;
+    if (gst_mfx_prime_buffer_proxy_is_detached (buffer->proxy))
+      buffer_cache_remove (priv, buffer);
+  }
+}
+
+/* Keeps one buffer per surface of the pool that is cycled through, so
+ * that steady-state playback does not create any wl_buffer */
+static guint
+buffer_cache_get_max_size (GstMfxSurface * surface)
+{
+  if (surface->pool)
+    return MAX (gst_mfx_surface_pool_get_size (surface->pool), 1);
+  return DEFAULT_BUFFER_CACHE_SIZE;
+}
+
+static BufferState *
+get_buffer (GstMfxWindow * window, GstMfxSurface * surface,
+    const GstMfxRectangle * src_rect)
+{
+  GstMfxWindowWaylandPrivate *const priv =
+      GST_MFX_WINDOW_WAYLAND_GET_PRIVATE (window);
+  gpointer surface_id = GUINT_TO_POINTER (GST_MFX_SURFACE_ID (surface));
+  GstMfxPrimeBufferProxy *proxy;
+  BufferState *buffer;
+  gboolean cache = TRUE;
+  guint max_size;
+
+  proxy = gst_mfx_prime_buffer_proxy_get_from_surface (surface);
+  if (!proxy)
+    return NULL;
+
+  g_mutex_lock (&priv->buffer_lock);
+  buffer_cache_sweep (priv);
+  buffer = g_hash_table_lookup (priv->buffers, surface_id);
+  /* A different export means the surface pool was torn down and the
+   * VASurfaceID reused since the buffer was created */
+  if (buffer && (buffer->proxy != proxy || buffer->width != src_rect->width
+          || buffer->height != src_rect->height)) {
+    buffer_cache_remove (priv, buffer);
+    buffer = NULL;
+  }
+  /* The same surface is displayed twice in a row, and the compositor still
+   * holds the buffer: wrap it into a one-shot wl_buffer */
+  if (buffer && buffer->frame) {
+    buffer = NULL;
+    cache = FALSE;
+  }
+  if (buffer) {
+    g_queue_unlink (&priv->buffers_lru, &buffer->link);
+    g_queue_push_tail_link (&priv->buffers_lru, &buffer->link);
+  }
+  g_mutex_unlock (&priv->buffer_lock);
+
+  if (!buffer) {
+    buffer = buffer_state_new (window, surface, proxy, src_rect->width,
+        src_rect->height);
+    if (buffer) {
+      g_mutex_lock (&priv->buffer_lock);
+      if (cache) {
+        g_hash_table_insert (priv->buffers, surface_id, buffer);
+        g_queue_push_tail_link (&priv->buffers_lru, &buffer->link);
+
+        /* The buffer being displayed is the most recent one, so it is
+         * never evicted here */
+        max_size = buffer_cache_get_max_size (surface);
+        while (priv->buffers_lru.length > max_size)
+          buffer_cache_remove (priv, priv->buffers_lru.head->data);
+      }
+      else {
+        buffer->orphaned = TRUE;
+        priv->orphaned_buffers =
+            g_list_prepend (priv->orphaned_buffers, buffer);
+      }
+      g_mutex_unlock (&priv->buffer_lock);
+    }
+  }
+
+  gst_mfx_prime_buffer_proxy_unref (proxy);
+  return buffer;
+}
+
 /**
  * GstMfxWindowWaylandClass:
  *
@@ -232,26 +470,15 @@ gst_mfx_window_wayland_render (GstMfxWindow * window,
 {
   GstMfxWindowWaylandPrivate *const priv =
       GST_MFX_WINDOW_WAYLAND_GET_PRIVATE (window);
-  GstMfxDisplayWaylandPrivate *const display_priv =
-      GST_MFX_DISPLAY_WAYLAND_GET_PRIVATE (GST_MFX_WINDOW_DISPLAY (window));
   struct wl_display *const display =
       GST_MFX_DISPLAY_HANDLE (GST_MFX_WINDOW_DISPLAY (window));
-  GstMfxPrimeBufferProxy *buffer_proxy;
-  struct wl_buffer *buffer;
+  BufferState *buffer;
   FrameState *frame;
-  guintptr fd = 0;
-  guint32 drm_format = 0;
-  gint offsets[3] = { 0 }, pitches[3] = { 0 }, num_planes = 0, i = 0;
-  VaapiImage *vaapi_image;
 
-  buffer_proxy = gst_mfx_prime_buffer_proxy_new_from_surface (surface);
-  if (!buffer_proxy)
+  buffer = get_buffer (window, surface, src_rect);
+  if (!buffer)
     return FALSE;
 
-  fd = GST_MFX_PRIME_BUFFER_PROXY_HANDLE (buffer_proxy);
-  vaapi_image = gst_mfx_prime_buffer_proxy_get_vaapi_image (buffer_proxy);
-  num_planes = vaapi_image_get_plane_count (vaapi_image);
-
   if ((dst_rect->height != src_rect->height)
       || (dst_rect->width != src_rect->width)) {
 #ifdef USE_WESTON_4_0
@@ -267,45 +494,19 @@ gst_mfx_window_wayland_render (GstMfxWindow * window,
 #endif
   }
 
-  for (i = 0; i < num_planes; i++) {
-    offsets[i] = vaapi_image_get_offset (vaapi_image, i);
-    pitches[i] = vaapi_image_get_pitch (vaapi_image, i);
-  }
-
-  if (GST_VIDEO_FORMAT_NV12 == vaapi_image_get_format (vaapi_image)) {
-    drm_format = WL_DRM_FORMAT_NV12;
-  } else if (GST_VIDEO_FORMAT_BGRA == vaapi_image_get_format (vaapi_image)) {
-    drm_format = WL_DRM_FORMAT_ARGB8888;
-  }
-
-  if (!drm_format)
-    goto error;
-
-  if (!display_priv->drm)
-    goto error;
-
-  GST_MFX_DISPLAY_LOCK (GST_MFX_WINDOW_DISPLAY (window));
-  buffer =
-      wl_drm_create_prime_buffer (display_priv->drm, fd,
-          src_rect->width, src_rect->height, drm_format,
-          offsets[0], pitches[0],
-          offsets[1], pitches[1],
-          offsets[2], pitches[2]);
-  GST_MFX_DISPLAY_UNLOCK (GST_MFX_WINDOW_DISPLAY (window));
-  if (!buffer) {
-    GST_ERROR ("No wl_buffer created\n");
-    goto error;
-  }
-
   frame = frame_state_new (window);
   if (!frame)
-    goto error;
+    return FALSE;
 
   g_atomic_pointer_set (&priv->last_frame, frame);
   g_atomic_int_inc (&priv->num_frames_pending);
 
+  g_mutex_lock (&priv->buffer_lock);
+  buffer->frame = frame;
+  g_mutex_unlock (&priv->buffer_lock);
+
   GST_MFX_DISPLAY_LOCK (GST_MFX_WINDOW_DISPLAY (window));
-  wl_surface_attach (priv->surface, buffer, 0, 0);
+  wl_surface_attach (priv->surface, buffer->wl_buffer, 0, 0);
 
   wl_surface_damage (priv->surface, 0, 0, dst_rect->width, dst_rect->height);
 
@@ -314,8 +515,6 @@ gst_mfx_window_wayland_render (GstMfxWindow * window,
     wl_region_destroy (priv->opaque_region);
     priv->opaque_region = NULL;
   }
-  wl_proxy_set_queue ((struct wl_proxy *) buffer, priv->event_queue);
-  wl_buffer_add_listener (buffer, &frame_buffer_listener, frame);
 
   frame->callback = wl_surface_frame (priv->surface);
   wl_callback_add_listener (frame->callback, &frame_callback_listener, frame);
@@ -325,16 +524,7 @@ gst_mfx_window_wayland_render (GstMfxWindow * window,
 
   GST_MFX_DISPLAY_UNLOCK (GST_MFX_WINDOW_DISPLAY (window));
 
-  vaapi_image_unref (vaapi_image);
-  gst_mfx_prime_buffer_proxy_unref (buffer_proxy);
-
   return TRUE;
-error:
-  {
-    vaapi_image_unref (vaapi_image);
-    gst_mfx_prime_buffer_proxy_unref (buffer_proxy);
-    return FALSE;
-  }
 }
 
 static gboolean
@@ -413,6 +603,11 @@ gst_mfx_window_wayland_create (GstMfxWindow * window,
 
   GST_DEBUG ("create window, size %ux%u", *width, *height);
 
+  g_mutex_init (&priv->buffer_lock);
+  priv->buffers = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) buffer_state_free);
+  g_queue_init (&priv->buffers_lru);
+
   g_return_val_if_fail (priv_display->compositor != NULL, FALSE);
   g_return_val_if_fail (priv_display->shell != NULL, FALSE);
 
@@ -511,6 +706,16 @@ gst_mfx_window_wayland_destroy (GstMfxWindow * window)
     priv->thread = NULL;
   }
 
+  if (priv->buffers) {
+    g_hash_table_unref (priv->buffers);
+    priv->buffers = NULL;
+    g_queue_init (&priv->buffers_lru);
+    g_list_free_full (priv->orphaned_buffers,
+        (GDestroyNotify) buffer_state_free);
+    priv->orphaned_buffers = NULL;
+    g_mutex_clear (&priv->buffer_lock);
+  }
+
 #ifdef USE_WESTON_4_0
   if (priv->wp_viewport) {
     wp_viewport_destroy (priv->wp_viewport);
@@ -46,10 +46,15 @@
 #include "gstmfxutils_vaapi.h"
 #include "gstmfxutils_x11.h"
 #include "gstmfxprimebufferproxy.h"
+#include "gstmfxsurface_priv.h"
+#include "gstmfxsurfacepool.h"
 
 #define DEBUG 1
 #include "gstmfxdebug.h"
 
+/* Number of cached pixmaps for surfaces that do not belong to a pool */
+#define DEFAULT_PIXMAP_CACHE_SIZE 16
+
 #define _NET_WM_STATE_REMOVE    0       /* remove/unset property */
 #define _NET_WM_STATE_ADD       1       /* add/set property      */
 #define _NET_WM_STATE_TOGGLE    2       /* toggle property       */
@@ -130,6 +135,344 @@ timed_wait_event (GstMfxWindow * window, int type, guint64 end_time, XEvent * e)
   return FALSE;
 }
 
+#ifdef USE_X11_DRI3
+typedef struct _PixmapState PixmapState;
+
+/* DRI3 pixmap and XRender picture wrapping the PRIME export of a pooled
+ * surface, kept until the crop changes or the least recently displayed
+ * pixmaps are evicted to make room for new surfaces */
+struct _PixmapState
+{
+  GstMfxWindow *window;
+  GstMfxID surface_id;
+  GstMfxPrimeBufferProxy *proxy;
+  xcb_pixmap_t pixmap;
+  Picture picture;
+  guint width;
+  guint height;
+  /* Rectangles the picture transform was last computed for */
+  GstMfxRectangle src_rect;
+  GstMfxRectangle dst_rect;
+  /* Surfaces held for each present the server has not reported idle yet,
+   * oldest first. Pixmaps evicted from the cache are only freed once idle */
+  GQueue presents;
+  gboolean orphaned;
+  GList link;
+};
+
+/* Called with the display lock held */
+static void
+pixmap_state_free (PixmapState * state)
+{
+  GstMfxWindowX11Private *const priv =
+      GST_MFX_WINDOW_X11_GET_PRIVATE (state->window);
+  Display *display =
+      gst_mfx_display_x11_get_display (GST_MFX_WINDOW_DISPLAY (state->window));
+
+  g_queue_foreach (&state->presents, (GFunc) gst_mfx_surface_release_hold,
+      NULL);
+  g_queue_clear (&state->presents);
+  if (state->picture)
+    XRenderFreePicture (display, state->picture);
+  if (state->pixmap)
+    xcb_free_pixmap (priv->xcbconn, state->pixmap);
+  gst_mfx_prime_buffer_proxy_unref (state->proxy);
+  g_slice_free (PixmapState, state);
+}
+
+/* Called with the display lock held */
+static PixmapState *
+pixmap_state_new (GstMfxWindow * window, GstMfxSurface * surface,
+    GstMfxPrimeBufferProxy * proxy, guint width, guint height)
+{
+  GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
+  Display *display =
+      gst_mfx_display_x11_get_display (GST_MFX_WINDOW_DISPLAY (window));
+  PixmapState *state;
+  VaapiImage *vaapi_image;
+  xcb_void_cookie_t cookie;
+  xcb_generic_error_t *err;
+  guint stride;
+  int fd;
+
+  vaapi_image = gst_mfx_prime_buffer_proxy_get_vaapi_image (proxy);
+  stride = vaapi_image_get_pitch (vaapi_image, 0);
+  vaapi_image_unref (vaapi_image);
+
+  /* The fd is closed by xcb once sent, while the export stays cached */
+  fd = dup (GST_MFX_PRIME_BUFFER_PROXY_HANDLE (proxy));
+  if (fd < 0)
+    return NULL;
+
+  state = g_slice_new0 (PixmapState);
+  state->window = window;
+  state->surface_id = GST_MFX_SURFACE_ID (surface);
+  state->proxy = gst_mfx_prime_buffer_proxy_ref (proxy);
+  state->width = width;
+  state->height = height;
+  state->link.data = state;
+
+  state->pixmap = xcb_generate_id (priv->xcbconn);
+  if (!state->pixmap) {
+    GST_ERROR ("Unable to get XID.\n");
+    close (fd);
+    goto error;
+  }
+  /* Pixmaps are only created once per surface, so the round-trip is
+   * affordable, whereas an unchecked failure would reach the default Xlib
+   * error handler, which exits */
+  cookie = xcb_dri3_pixmap_from_buffer_checked (priv->xcbconn, state->pixmap,
+      GST_MFX_WINDOW_ID (window), GST_MFX_PRIME_BUFFER_PROXY_SIZE (proxy),
+      width, height, stride, priv->depth, priv->bpp, fd);
+  err = xcb_request_check (priv->xcbconn, cookie);
+  if (err) {
+    GST_ERROR ("Unable to import surface %" GST_MFX_ID_FORMAT
+        " as a pixmap, error %d", GST_MFX_ID_ARGS (state->surface_id),
+        err->error_code);
+    free (err);
+    state->pixmap = 0;
+    goto error;
+  }
+
+  state->picture = XRenderCreatePicture (display, state->pixmap,
+      priv->pixmap_format, 0, NULL);
+  if (!state->picture)
+    goto error;
+  XRenderSetPictureFilter (display, state->picture, FilterBilinear, 0, 0);
+
+  return state;
+error:
+  pixmap_state_free (state);
+  return NULL;
+}
+
+/* Called with the display lock held */
+static gboolean
+ensure_dri3_state (GstMfxWindow * window)
+{
+  GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
+  Display *display =
+      gst_mfx_display_x11_get_display (GST_MFX_WINDOW_DISPLAY (window));
+  const Window win = GST_MFX_WINDOW_ID (window);
+  const xcb_query_extension_reply_t *present_ext;
+  XRenderPictFormat *pic_fmt;
+  XWindowAttributes wattr;
+
+  if (priv->pixmaps)
+    return TRUE;
+
+  if (!priv->xcbconn)
+    priv->xcbconn = XGetXCBConnection (display);
+
+  /* Depth and visual never change for the lifetime of a window, so they
+   * are queried once instead of on every frame. Size changes are tracked
+   * by the sink through ConfigureNotify events */
+  XGetWindowAttributes (display, win, &wattr);
+
+  if (!priv->picture) {
+    pic_fmt = XRenderFindVisualFormat (display, wattr.visual);
+    if (pic_fmt)
+      priv->picture = XRenderCreatePicture (display, win, pic_fmt, 0, NULL);
+    if (!priv->picture)
+      return FALSE;
+  }
+
+  switch (wattr.depth) {
+    case 24:
+      priv->pixmap_format =
+          XRenderFindStandardFormat (display, PictStandardRGB24);
+      priv->op = PictOpSrc;
+      break;
+    case 32:
+      priv->pixmap_format =
+          XRenderFindStandardFormat (display, PictStandardARGB32);
+      priv->op = PictOpOver;
+      break;
+    default:
+      priv->pixmap_format = NULL;
+      break;
+  }
+  if (!priv->pixmap_format) {
+    GST_ERROR("Unable to initialize picture format.\n");
+    return FALSE;
+  }
+  priv->depth = wattr.depth;
+  priv->bpp = 32;
+
+  present_ext = xcb_get_extension_data (priv->xcbconn, &xcb_present_id);
+  if (present_ext && present_ext->present) {
+    priv->present_eid = xcb_generate_id (priv->xcbconn);
+    xcb_present_select_input (priv->xcbconn, priv->present_eid, win,
+        XCB_PRESENT_EVENT_MASK_IDLE_NOTIFY);
+    priv->present_events = xcb_register_for_special_xge (priv->xcbconn,
+        &xcb_present_id, priv->present_eid, NULL);
+  }
+
+  priv->pixmaps = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) pixmap_state_free);
+  g_queue_init (&priv->pixmaps_lru);
+  return TRUE;
+}
+
+/* Called with the display lock held */
+static void
+pixmap_state_retire (GstMfxWindow * window, PixmapState * state)
+{
+  GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
+
+  if (!g_queue_is_empty (&state->presents)) {
+    state->orphaned = TRUE;
+    priv->orphaned_pixmaps = g_list_prepend (priv->orphaned_pixmaps, state);
+  } else
+    pixmap_state_free (state);
+}
+
+/* Called with the display lock held */
+static void
+pixmap_cache_remove (GstMfxWindow * window, PixmapState * state)
+{
+  GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
+
+  g_hash_table_steal (priv->pixmaps, GUINT_TO_POINTER (state->surface_id));
+  g_queue_unlink (&priv->pixmaps_lru, &state->link);
+  pixmap_state_retire (window, state);
+}
+
+/* Called with the display lock held. Drops the pixmaps of surfaces that
+ * were destroyed, e.g. along with their pool, whenever any was */
+static void
+pixmap_cache_sweep (GstMfxWindow * window)
+{
+  GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
+  const guint detach_count = gst_mfx_prime_buffer_proxy_get_detach_count ();
+  PixmapState *state;
+  GList *l, *next;
+
+  if (detach_count == priv->detach_count)
+    return;
+  priv->detach_count = detach_count;
+
+  for (l = priv->pixmaps_lru.head; l; l = next) {
+    next = l->next;
+    state = l->data;
+    if (gst_mfx_prime_buffer_proxy_is_detached (state->proxy))
+      pixmap_cache_remove (window, state);
+  }
+}
+
+/* Keeps one pixmap per surface of the pool that is cycled through, so
+ * that steady-state playback does not create any pixmap */
+static guint
+pixmap_cache_get_max_size (GstMfxSurface * surface)
+{
+  if (surface->pool)
+    return MAX (gst_mfx_surface_pool_get_size (surface->pool), 1);
+  return DEFAULT_PIXMAP_CACHE_SIZE;
+}
+
+static gint
+compare_pixmap (gconstpointer a, gconstpointer b)
+{
+  const PixmapState *const state = a;
+
+  return state->pixmap == GPOINTER_TO_UINT (b) ? 0 : 1;
+}
+
+/* Called with the display lock held */
+static void
+process_present_events (GstMfxWindow * window)
+{
+  GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
+  xcb_generic_event_t *ev;
+
+  if (!priv->present_events)
+    return;
+
+  while ((ev = xcb_poll_for_special_event (priv->xcbconn,
+              priv->present_events))) {
+    xcb_present_generic_event_t *const ge = (xcb_present_generic_event_t *) ev;
+
+    if (ge->evtype == XCB_PRESENT_EVENT_IDLE_NOTIFY) {
+      xcb_present_idle_notify_event_t *const ie =
+          (xcb_present_idle_notify_event_t *) ev;
+      PixmapState *state = g_hash_table_lookup (priv->pixmaps,
+          GUINT_TO_POINTER (ie->serial));
+
+      if (!state || state->pixmap != ie->pixmap) {
+        GList *const l = g_list_find_custom (priv->orphaned_pixmaps,
+            GUINT_TO_POINTER (ie->pixmap), compare_pixmap);
+        state = l ? l->data : NULL;
+      }
+
+      /* The surface may be handed out by its pool again */
+      if (state && !g_queue_is_empty (&state->presents))
+        gst_mfx_surface_release_hold (g_queue_pop_head (&state->presents));
+
+      if (state && g_queue_is_empty (&state->presents)
+          && state->orphaned) {
+        priv->orphaned_pixmaps = g_list_remove (priv->orphaned_pixmaps, state);
+        pixmap_state_free (state);
+      }
+    }
+    free (ev);
+  }
+}
+
+/* Called with the display lock held */
+static PixmapState *
+get_pixmap_state (GstMfxWindow * window, GstMfxSurface * surface,
+    const GstMfxRectangle * src_rect)
+{
+  GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
+  gpointer surface_id = GUINT_TO_POINTER (GST_MFX_SURFACE_ID (surface));
+  GstMfxPrimeBufferProxy *proxy;
+  PixmapState *state;
+  guint max_size;
+
+  proxy = gst_mfx_prime_buffer_proxy_get_from_surface (surface);
+  if (!proxy)
+    return NULL;
+
+  pixmap_cache_sweep (window);
+  state = g_hash_table_lookup (priv->pixmaps, surface_id);
+  /* A different export means the surface pool was torn down and the
+   * VASurfaceID reused since the pixmap was created */
+  if (state && (state->proxy != proxy || state->width != src_rect->width
+          || state->height != src_rect->height)) {
+    pixmap_cache_remove (window, state);
+    state = NULL;
+  }
+
+  if (state) {
+    g_queue_unlink (&priv->pixmaps_lru, &state->link);
+    g_queue_push_tail_link (&priv->pixmaps_lru, &state->link);
+  } else {
+    state = pixmap_state_new (window, surface, proxy, src_rect->width,
+        src_rect->height);
+    if (state) {
+      g_hash_table_insert (priv->pixmaps, surface_id, state);
+      g_queue_push_tail_link (&priv->pixmaps_lru, &state->link);
+
+      /* The pixmap being displayed is the most recent one, so it is
+       * never evicted here */
+      max_size = pixmap_cache_get_max_size (surface);
+      while (priv->pixmaps_lru.length > max_size)
+        pixmap_cache_remove (window, priv->pixmaps_lru.head->data);
+    }
+  }
+
+  gst_mfx_prime_buffer_proxy_unref (proxy);
+  return state;
+}
+
+static inline gboolean
+rect_equal (const GstMfxRectangle * a, const GstMfxRectangle * b)
+{
+  return a->x == b->x && a->y == b->y &&
+      a->width == b->width && a->height == b->height;
+}
+#endif
+
 static gboolean
 gst_mfx_window_x11_show (GstMfxWindow * window)
 {
@@ -258,6 +601,24 @@ gst_mfx_window_x11_destroy (GstMfxWindow * window)
   Display *const dpy = GST_MFX_DISPLAY_HANDLE (GST_MFX_WINDOW_DISPLAY (window));
   const Window xid = GST_MFX_WINDOW_ID (window);
 
+#ifdef USE_X11_DRI3
+  if (priv->pixmaps) {
+    GST_MFX_DISPLAY_LOCK (GST_MFX_WINDOW_DISPLAY (window));
+    g_hash_table_unref (priv->pixmaps);
+    priv->pixmaps = NULL;
+    g_queue_init (&priv->pixmaps_lru);
+    g_list_free_full (priv->orphaned_pixmaps,
+        (GDestroyNotify) pixmap_state_free);
+    priv->orphaned_pixmaps = NULL;
+    if (priv->present_events) {
+      xcb_present_select_input (priv->xcbconn, priv->present_eid, xid, 0);
+      xcb_unregister_for_special_event (priv->xcbconn, priv->present_events);
+      priv->present_events = NULL;
+    }
+    GST_MFX_DISPLAY_UNLOCK (GST_MFX_WINDOW_DISPLAY (window));
+  }
+#endif
+
 #ifdef HAVE_XRENDER
   if (priv->picture) {
     GST_MFX_DISPLAY_LOCK (GST_MFX_WINDOW_DISPLAY (window));
@@ -390,137 +751,66 @@ gst_mfx_window_x11_render (GstMfxWindow * window,
     GstMfxSurface * surface,
     const GstMfxRectangle * src_rect, const GstMfxRectangle * dst_rect)
 {
-#if defined(USE_DRI3) && defined(HAVE_XCBDRI3) && defined(HAVE_XCBPRESENT) && defined(HAVE_XRENDER)
+#ifdef USE_X11_DRI3
   GstMfxWindowX11Private *const priv = GST_MFX_WINDOW_X11_GET_PRIVATE (window);
   GstMfxDisplay *const x11_display = GST_MFX_WINDOW_DISPLAY (window);
-  GstMfxPrimeBufferProxy *buffer_proxy;
-
   Display *display = gst_mfx_display_x11_get_display (x11_display);
-  const Window win = GST_MFX_WINDOW_ID (window);
-  Window root;
-  int x = 0, y = 0, bpp = 0;
-  unsigned int width, height, border, depth, stride, size;
-  xcb_pixmap_t pixmap;
-  xcb_void_cookie_t cookie_pixmap;
-  xcb_generic_error_t *error;
-  Picture picture;
-  XRenderPictFormat *pic_fmt = NULL;
-  XWindowAttributes wattr;
-  int fmt = 0, op = 0;
-
-  if (!priv->xcbconn) {
-    GST_MFX_DISPLAY_LOCK (x11_display);
-    priv->xcbconn = XGetXCBConnection (display);
-    GST_MFX_DISPLAY_UNLOCK (x11_display);
-  }
-
-  buffer_proxy = gst_mfx_prime_buffer_proxy_new_from_surface (surface);
-  if (!buffer_proxy)
-    return FALSE;
-
-  GST_MFX_DISPLAY_LOCK (x11_display);
-  XGetGeometry (display, win, &root, &x, &y,
-      &width, &height, &border, &depth);
-  GST_MFX_DISPLAY_UNLOCK (x11_display);
-
-  /* Ensure Picture for window created */
-  if (!priv->picture) {
-    GST_MFX_DISPLAY_LOCK (x11_display);
-    XGetWindowAttributes (display, win, &wattr);
-    pic_fmt = XRenderFindVisualFormat (display, wattr.visual);
-    if (pic_fmt)
-      priv->picture = XRenderCreatePicture (display, win, pic_fmt, 0, NULL);
-    GST_MFX_DISPLAY_UNLOCK (x11_display);
-    if (!priv->picture)
-      return FALSE;
-  }
-
-  switch (depth) {
-    case 8:
-      bpp = 8;
-      break;
-    case 15:
-    case 16:
-      bpp = 16;
-      break;
-    case 24:
-      fmt = PictStandardRGB24;
-      op = PictOpSrc;
-      goto get_pic_fmt;
-    case 32:
-      fmt = PictStandardARGB32;
-      op = PictOpOver;
-get_pic_fmt:
-      bpp = 32;
-      GST_MFX_DISPLAY_LOCK (x11_display);
-      pic_fmt = XRenderFindStandardFormat (display, fmt);
-      GST_MFX_DISPLAY_UNLOCK (x11_display);
-      break;
-    default:
-      break;
-  }
-  stride = GST_ROUND_UP_16 (src_rect->width) * bpp / 8;
-  size = GST_ROUND_UP_N (stride * src_rect->height, 4096);
-  if (!pic_fmt) {
-    GST_ERROR("Unable to initialize picture format.\n");
-    return FALSE;
-  }
+  PixmapState *state;
 
   GST_MFX_DISPLAY_LOCK (x11_display);
-  pixmap = xcb_generate_id (priv->xcbconn);
-
-  if (!pixmap) {
-    GST_MFX_DISPLAY_UNLOCK (x11_display);
-    GST_ERROR("Unable to get XID.\n");
-    return FALSE;
-  }
-  cookie_pixmap = xcb_dri3_pixmap_from_buffer_checked (priv->xcbconn, pixmap, win, size,
-      src_rect->width, src_rect->height, stride, depth, bpp,
-      GST_MFX_PRIME_BUFFER_PROXY_HANDLE (buffer_proxy));
-  error = xcb_request_check (priv->xcbconn, cookie_pixmap);
-  if (error) {
-    GST_MFX_DISPLAY_UNLOCK (x11_display);
-    GST_ERROR("Unable to delivers a request to Xserver.\n");
-    xcb_free_pixmap (priv->xcbconn, pixmap);
-    return FALSE;
-  }
-
-  do {
-    const double sx = (double) src_rect->width / dst_rect->width;
-    const double sy = (double) src_rect->height / dst_rect->height;
-    XTransform xform;
-
-    picture = XRenderCreatePicture (display, pixmap, pic_fmt, 0, NULL);
-    if (!picture)
-      break;
-
-    xform.matrix[0][0] = XDoubleToFixed (sx);
-    xform.matrix[0][1] = XDoubleToFixed (0.0);
-    xform.matrix[0][2] = XDoubleToFixed (src_rect->x);
-    xform.matrix[1][0] = XDoubleToFixed (0.0);
-    xform.matrix[1][1] = XDoubleToFixed (sy);
-    xform.matrix[1][2] = XDoubleToFixed (src_rect->y);
-    xform.matrix[2][0] = XDoubleToFixed (0.0);
-    xform.matrix[2][1] = XDoubleToFixed (0.0);
-    xform.matrix[2][2] = XDoubleToFixed (1.0);
-
-    XRenderSetPictureTransform (display, picture, &xform);
-    XRenderSetPictureFilter (display, picture, FilterBilinear, 0, 0);
+  if (!ensure_dri3_state (window))
+    goto error;
+
+  process_present_events (window);
+
+  state = get_pixmap_state (window, surface, src_rect);
+  if (!state)
+    goto error;
+
+  if (priv->present_events && src_rect->x == 0 && src_rect->y == 0
+      && src_rect->width == dst_rect->width
+      && src_rect->height == dst_rect->height) {
+    /* Unscaled: let the server flip or blit the pixmap itself */
+    xcb_present_pixmap (priv->xcbconn, GST_MFX_WINDOW_ID (window),
+        state->pixmap, GST_MFX_SURFACE_ID (surface), 0, 0,
+        dst_rect->x, dst_rect->y, 0, 0, 0, XCB_PRESENT_OPTION_NONE,
+        0, 0, 0, 0, NULL);
+    /* The server scans the surface out until it reports the pixmap idle */
+    gst_mfx_surface_hold (surface);
+    g_queue_push_tail (&state->presents, surface);
+  } else {
+    if (!rect_equal (&state->src_rect, src_rect)
+        || !rect_equal (&state->dst_rect, dst_rect)) {
+      const double sx = (double) src_rect->width / dst_rect->width;
+      const double sy = (double) src_rect->height / dst_rect->height;
+      XTransform xform;
+
+      xform.matrix[0][0] = XDoubleToFixed (sx);
+      xform.matrix[0][1] = XDoubleToFixed (0.0);
+      xform.matrix[0][2] = XDoubleToFixed (src_rect->x);
+      xform.matrix[1][0] = XDoubleToFixed (0.0);
+      xform.matrix[1][1] = XDoubleToFixed (sy);
+      xform.matrix[1][2] = XDoubleToFixed (src_rect->y);
+      xform.matrix[2][0] = XDoubleToFixed (0.0);
+      xform.matrix[2][1] = XDoubleToFixed (0.0);
+      xform.matrix[2][2] = XDoubleToFixed (1.0);
+
+      XRenderSetPictureTransform (display, state->picture, &xform);
+      state->src_rect = *src_rect;
+      state->dst_rect = *dst_rect;
+    }
 
-    XRenderComposite (display, op, picture, None, priv->picture,
+    XRenderComposite (display, priv->op, state->picture, None, priv->picture,
         0, 0, 0, 0, dst_rect->x, dst_rect->y,
         dst_rect->width, dst_rect->height);
-  } while (0);
-
-  if (picture)
-    XRenderFreePicture (display, picture);
-  xcb_free_pixmap (priv->xcbconn, pixmap);
-  xcb_flush (priv->xcbconn);
+  }
 
+  XFlush (display);
   GST_MFX_DISPLAY_UNLOCK (x11_display);
-
-  gst_mfx_prime_buffer_proxy_unref (buffer_proxy);
   return TRUE;
+error:
+  GST_MFX_DISPLAY_UNLOCK (x11_display);
+  return FALSE;
 #else
   GST_ERROR("Unable to render the video.\n");
   return FALSE;
@@ -27,6 +27,10 @@
 
 G_BEGIN_DECLS
 
+#if defined(USE_DRI3) && defined(HAVE_XCBDRI3) && defined(HAVE_XCBPRESENT) && defined(HAVE_XRENDER)
+# define USE_X11_DRI3 1
+#endif
+
 #define GST_MFX_WINDOW_X11_GET_PRIVATE(obj) \
   (&GST_MFX_WINDOW_X11(obj)->priv)
 
@@ -50,6 +54,22 @@ struct _GstMfxWindowX11Private
   Picture picture;
 #endif
   xcb_connection_t *xcbconn;
+#ifdef USE_X11_DRI3
+  /* VASurfaceID -> PixmapState, created once per pooled surface, least
+   * recently displayed first */
+  GHashTable *pixmaps;
+  GQueue pixmaps_lru;
+  /* Detached PRIME exports last swept from the cache */
+  guint detach_count;
+  GList *orphaned_pixmaps;
+  XRenderPictFormat *pixmap_format;
+  guint depth;
+  guint bpp;
+  int op;
+  /* Present IdleNotify events, if the server supports Present */
+  xcb_special_event_t *present_events;
+  guint32 present_eid;
+#endif
 };
 
 /**
@@ -25,6 +25,7 @@
 #endif
 #ifdef MFX_VPP
 # include "gstmfxpostproc.h"
+# include "gstmfxvppsplit.h"
 #endif
 #ifdef MFX_SINK
 # include "gstmfxsink.h"
@@ -61,6 +62,8 @@ plugin_init (GstPlugin * plugin)
 #ifdef MFX_VPP
   ret |= gst_element_register (plugin, "mfxvpp",
       GST_RANK_NONE, GST_TYPE_MFXPOSTPROC);
+  ret |= gst_element_register (plugin, "mfxvppsplit",
+      GST_RANK_NONE, GST_TYPE_MFXVPPSPLIT);
 #endif
 
 #ifdef MFX_SINK
@@ -43,6 +43,7 @@ GST_DEBUG_CATEGORY_STATIC (mfxdec_debug);
 
 #define DEFAULT_ASYNC_DEPTH 4
 #define ASYNC_DEPTH_VIDEO_MEM 16;
+#define DEFAULT_IN_FLIGHT_DEPTH 0
 
 /* Default templates */
 #define GST_CAPS_CODEC(CODEC) CODEC "; "
@@ -85,7 +86,12 @@ enum
   PROP_0,
   PROP_ASYNC_DEPTH,
   PROP_LIVE_MODE,
-  PROP_SKIP_CORRUPTED_FRAMES
+  PROP_SKIP_CORRUPTED_FRAMES,
+  PROP_IN_FLIGHT_DEPTH,
+  PROP_IN_FLIGHT_FRAMES,
+  PROP_WAIT_TIME,
+  PROP_LOW_LATENCY,
+  PROP_LATENCY_STATS
 };
 
 static GstStaticPadTemplate src_template_factory =
@@ -302,6 +308,39 @@ redo:
   return TRUE;
 }
 
+/* Describes the decode latency of the frames decoded so far, in
+ * microseconds. See #GstMfxDecoderLatency for the histogram bins */
+static GstStructure *
+gst_mfxdec_get_latency_stats (GstMfxDec * mfxdec)
+{
+  GstMfxDecoderLatency latency = { 0, };
+  GValue histogram = G_VALUE_INIT;
+  GValue bin = G_VALUE_INIT;
+  GstStructure *stats;
+  guint i;
+
+  if (mfxdec->decoder)
+    gst_mfx_decoder_get_latency (mfxdec->decoder, &latency);
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  g_value_init (&bin, G_TYPE_UINT64);
+  for (i = 0; i < GST_MFX_DECODER_LATENCY_BINS; i++) {
+    g_value_set_uint64 (&bin, latency.histogram[i]);
+    gst_value_array_append_value (&histogram, &bin);
+  }
+  g_value_unset (&bin);
+
+  stats = gst_structure_new ("mfxdec-latency",
+      "frames", G_TYPE_UINT64, latency.num_frames,
+      "min", G_TYPE_UINT64, latency.min,
+      "max", G_TYPE_UINT64, latency.max,
+      "average", G_TYPE_UINT64, latency.num_frames ?
+          latency.total / latency.num_frames : (guint64) 0, NULL);
+  gst_structure_take_value (stats, "histogram", &histogram);
+
+  return stats;
+}
+
 static void
 gst_mfxdec_set_property (GObject * object, guint prop_id,
   const GValue * value, GParamSpec * pspec)
@@ -318,6 +357,12 @@ gst_mfxdec_set_property (GObject * object, guint prop_id,
   case PROP_SKIP_CORRUPTED_FRAMES:
     dec->skip_corrupted_frames = g_value_get_boolean (value);
     break;
+  case PROP_IN_FLIGHT_DEPTH:
+    dec->in_flight_depth = g_value_get_uint (value);
+    break;
+  case PROP_LOW_LATENCY:
+    dec->low_latency = g_value_get_boolean (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     break;
@@ -340,6 +385,23 @@ gst_mfxdec_get_property (GObject * object, guint prop_id, GValue * value,
   case PROP_SKIP_CORRUPTED_FRAMES:
     g_value_set_boolean (value, dec->skip_corrupted_frames);
     break;
+  case PROP_IN_FLIGHT_DEPTH:
+    g_value_set_uint (value, dec->in_flight_depth);
+    break;
+  case PROP_IN_FLIGHT_FRAMES:
+    g_value_set_uint (value, dec->decoder ?
+        gst_mfx_decoder_get_in_flight_count (dec->decoder) : 0);
+    break;
+  case PROP_WAIT_TIME:
+    g_value_set_uint64 (value, dec->wait_time + (dec->decoder ?
+        gst_mfx_decoder_get_wait_time (dec->decoder) : 0));
+    break;
+  case PROP_LOW_LATENCY:
+    g_value_set_boolean (value, dec->low_latency);
+    break;
+  case PROP_LATENCY_STATS:
+    g_value_take_boxed (value, gst_mfxdec_get_latency_stats (dec));
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     break;
@@ -393,6 +455,10 @@ gst_mfxdec_create (GstMfxDec * mfxdec, GstCaps * caps)
 
   if (mfxdec->skip_corrupted_frames)
     gst_mfx_decoder_skip_corrupted_frames (mfxdec->decoder);
+  gst_mfx_decoder_set_in_flight_depth (mfxdec->decoder,
+      mfxdec->in_flight_depth);
+  if (mfxdec->low_latency)
+    gst_mfx_decoder_set_low_latency (mfxdec->decoder, TRUE);
 
   mfxdec->do_renego = TRUE;
   mfxdec->do_reconfigure = FALSE;
@@ -578,14 +644,23 @@ error_get_meta:
   }
 }
 
+static gboolean
+gst_mfxdec_prev_surface_released (gpointer data)
+{
+  GstMfxDec *mfxdec = GST_MFXDEC (data);
+
+  return g_atomic_int_get (&mfxdec->flushing)
+      || !gst_mfx_surface_is_queued (mfxdec->prev_surf);
+}
+
 static GstFlowReturn
 gst_mfxdec_handle_frame (GstVideoDecoder *vdec, GstVideoCodecFrame * frame)
 {
   GstMfxDec *mfxdec = GST_MFXDEC (vdec);
+  GstMfxPluginBase *const plugin = GST_MFX_PLUGIN_BASE (vdec);
   GstMfxDecoderStatus sts;
   GstFlowReturn ret = GST_FLOW_OK;
   GstVideoCodecFrame *out_frame = NULL;
-  gint cnt = 0;
 
   if (!gst_mfxdec_negotiate (mfxdec))
       goto not_negotiated;
@@ -599,14 +674,14 @@ gst_mfxdec_handle_frame (GstVideoDecoder *vdec, GstVideoCodecFrame * frame)
       GST_TIME_ARGS (frame->pts),
       GST_TIME_ARGS (frame->duration));
 
-  if (mfxdec->prev_surf && mfxdec->dequeuing) {
-    cnt = frame->duration / 100000;
-    while (!g_atomic_int_get(&mfxdec->flushing) && (cnt > 0) &&
-        gst_mfx_surface_is_queued(mfxdec->prev_surf)) {
-      g_usleep(100);
-      --cnt;
-    }
-  }
+  /* Wait at most one frame duration for the sink to release the previous
+   * surface. The sink signals the aggregator backpressure on release */
+  if (mfxdec->prev_surf && mfxdec->dequeuing
+      && GST_CLOCK_TIME_IS_VALID (frame->duration))
+    mfxdec->wait_time += gst_mfx_backpressure_wait_until (
+        gst_mfx_task_aggregator_get_backpressure (plugin->aggregator),
+        gst_mfxdec_prev_surface_released, mfxdec,
+        frame->duration / GST_USECOND);
 
   sts = gst_mfx_decoder_decode (mfxdec->decoder, frame);
 
@@ -657,17 +732,20 @@ gst_mfxdec_finish (GstVideoDecoder *vdec)
 
   do {
     sts = gst_mfx_decoder_flush (mfxdec->decoder);
-    if (GST_MFX_DECODER_STATUS_FLUSHED == sts)
-      break;
-    while (gst_mfx_decoder_get_decoded_frames(mfxdec->decoder, &out_frame)) {
+    /* Frames drained when the decoder was last re-initialized may still
+     * be queued once it reports being flushed */
+    while (GST_FLOW_OK == ret
+        && gst_mfx_decoder_get_decoded_frames(mfxdec->decoder, &out_frame))
       ret = gst_mfxdec_push_decoded_frame (mfxdec, out_frame);
-      if (ret != GST_FLOW_OK)
-        break;
-    }
   } while (GST_MFX_DECODER_STATUS_SUCCESS == sts);
 
   gst_mfxdec_flush_discarded_frames (mfxdec);
 
+  if (mfxdec->low_latency)
+    gst_element_post_message (GST_ELEMENT (mfxdec),
+        gst_message_new_element (GST_OBJECT (mfxdec),
+            gst_mfxdec_get_latency_stats (mfxdec)));
+
   return ret;
 }
 
@@ -697,8 +775,13 @@ gst_mfxdec_sink_event (GstVideoDecoder * vdec, GstEvent * event)
   GstMfxDec *mfxdec = GST_MFXDEC (vdec);
 
   if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START) {
+    GstMfxPluginBase *const plugin = GST_MFX_PLUGIN_BASE (vdec);
+
     g_atomic_int_set(&mfxdec->flushing, 1);
     mfxdec->dequeuing = TRUE;
+    if (plugin->aggregator)
+      gst_mfx_backpressure_signal (
+          gst_mfx_task_aggregator_get_backpressure (plugin->aggregator));
   }
 
   if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP) {
@@ -796,6 +879,47 @@ gst_mfxdec_class_init (GstMfxDecClass *klass)
       "Skip decoded frames that have major corruption",
       FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_IN_FLIGHT_DEPTH,
+  g_param_spec_uint ("in-flight-depth", "In-flight Depth",
+      "Number of decode operations kept in flight before synchronizing "
+      "the oldest one (0 = async-depth, 1 = synchronous)",
+      0, 20, DEFAULT_IN_FLIGHT_DEPTH,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_IN_FLIGHT_FRAMES,
+  g_param_spec_uint ("in-flight-frames", "In-flight Frames",
+      "Number of decode operations currently in flight",
+      0, G_MAXUINT, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_WAIT_TIME,
+  g_param_spec_uint64 ("wait-time", "Wait Time",
+      "Total time spent waiting on a busy device or on downstream "
+      "to release surfaces, in microseconds",
+      0, G_MAXUINT64, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LOW_LATENCY,
+  g_param_spec_boolean ("low-latency", "Low Latency",
+      "Output each frame as soon as it is decoded. H.264 and HEVC frames "
+      "are output in decoding order until a reordered frame shows up",
+      FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMfxDec:latency-stats:
+   *
+   * Decode latency of the frames decoded so far, in microseconds, with
+   * "frames", "min", "max" and "average" fields and a "histogram" array.
+   * The first bin of the histogram counts frames decoded within 1 ms,
+   * the next ones within 2, 4, 8, ... ms and the last one the rest. In
+   * low latency mode the same structure is posted as an element message
+   * once the stream is drained.
+   */
+  g_object_class_install_property (gobject_class, PROP_LATENCY_STATS,
+  g_param_spec_boxed ("latency-stats", "Latency Statistics",
+      "Decode latency statistics of the frames decoded so far",
+      GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   vdec_class->open = GST_DEBUG_FUNCPTR (gst_mfxdec_open);
   vdec_class->close = GST_DEBUG_FUNCPTR (gst_mfxdec_close);
   vdec_class->flush = GST_DEBUG_FUNCPTR (gst_mfxdec_flush);
@@ -848,6 +972,9 @@ gst_mfxdec_init (GstMfxDec *mfxdec)
   mfxdec->async_depth = DEFAULT_ASYNC_DEPTH;
   mfxdec->live_mode = FALSE;
   mfxdec->skip_corrupted_frames = FALSE;
+  mfxdec->in_flight_depth = DEFAULT_IN_FLIGHT_DEPTH;
+  mfxdec->low_latency = FALSE;
+  mfxdec->wait_time = 0;
   mfxdec->prev_surf = NULL;
   mfxdec->dequeuing = FALSE;
   mfxdec->flushing = 0;
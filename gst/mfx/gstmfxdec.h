@@ -41,6 +41,9 @@ struct _GstMfxDec {
   guint                async_depth;
   gboolean             live_mode;
   gboolean             skip_corrupted_frames;
+  guint                in_flight_depth;
+  gboolean             low_latency;
+  guint64              wait_time;
   GstMfxSurface*       prev_surf;
   gboolean             dequeuing;
   gint                 flushing;
@@ -28,6 +28,7 @@
 #include "gstmfxvideobufferpool.h"
 
 #include <gst-libs/mfx/gstmfxdisplay.h>
+#include <gst-libs/mfx/gstmfxutils_bitstream.h>
 
 #define GST_PLUGIN_NAME "mfxencode"
 #define GST_PLUGIN_DESC "A MFX-based video encoder"
@@ -42,6 +43,8 @@ enum
 {
   PROP_0,
 
+  PROP_WAIT_TIME,
+  PROP_LATENCY_STATS,
   PROP_BASE,
 };
 
@@ -165,6 +168,43 @@ gst_mfxenc_default_set_property (GstMfxEnc * encode, guint prop_id,
   return FALSE;
 }
 
+static GstStructure *
+gst_mfxenc_get_latency_stats (GstMfxEnc * encode)
+{
+  GstMfxEncoderLatency latency = { 0, };
+
+  if (encode->encoder)
+    gst_mfx_encoder_get_latency (encode->encoder, &latency);
+
+  return gst_structure_new ("mfxenc-latency",
+      "frames", G_TYPE_UINT64, latency.num_frames,
+      "last", G_TYPE_UINT64, latency.last,
+      "min", G_TYPE_UINT64, latency.min,
+      "max", G_TYPE_UINT64, latency.max,
+      "average", G_TYPE_UINT64, latency.num_frames ?
+      latency.total / latency.num_frames : (guint64) 0, NULL);
+}
+
+static void
+gst_mfxenc_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstMfxEnc *const encode = GST_MFXENC_CAST (object);
+
+  switch (prop_id) {
+    case PROP_WAIT_TIME:
+      g_value_set_uint64 (value, encode->encoder ?
+          gst_mfx_encoder_get_wait_time (encode->encoder) : 0);
+      break;
+    case PROP_LATENCY_STATS:
+      g_value_take_boxed (value, gst_mfxenc_get_latency_stats (encode));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static gboolean
 ensure_output_state (GstMfxEnc * encode)
 {
@@ -243,6 +283,101 @@ error_output_state:
   }
 }
 
+static GstBuffer *
+append_region (GstBuffer * outbuf, GstBuffer * inbuf, gsize offset,
+    gsize size)
+{
+  return gst_buffer_append (outbuf,
+      gst_buffer_copy_region (inbuf, GST_BUFFER_COPY_MEMORY, offset, size));
+}
+
+/**
+ * gst_mfxenc_convert_byte_stream:
+ * @inbuf: a #GstBuffer holding a frame in byte stream format
+ * @drop_nal: a #GstMfxEncNalFilterFunc, or %NULL to keep all NAL units
+ * @outbuf_ptr: return location for the converted #GstBuffer
+ *
+ * Converts the byte stream in @inbuf to NAL units prefixed with their
+ * 4-byte size, as in avc1 and hvc1 streams, without copying them. The
+ * 4-byte start codes, which the encoder uses for most NAL units, are
+ * overwritten in place with the size. The resulting NAL units are
+ * referenced from @inbuf in as few chunks as they are contiguous, while
+ * NAL units with a 3-byte start code get a separate size prefix. @inbuf
+ * is modified and shall not be used afterwards.
+ *
+ * Return value: %TRUE if @outbuf_ptr is set to the converted buffer, or
+ *   left as is if there were no NAL unit to keep
+ */
+gboolean
+gst_mfxenc_convert_byte_stream (GstBuffer * inbuf,
+    GstMfxEncNalFilterFunc drop_nal, GstBuffer ** outbuf_ptr)
+{
+  GstBuffer *outbuf, *prefix;
+  GstMapInfo info;
+  gsize pos, next, start, body, end, size;
+  gsize run_start = 0, run_end = 0;
+  guint8 nal_size[4];
+
+  if (!gst_buffer_map (inbuf, &info, GST_MAP_READWRITE))
+    return FALSE;
+
+  outbuf = gst_buffer_new ();
+  size = info.size;
+
+  for (pos = gst_mfx_utils_find_start_code (info.data, size, 0); pos < size;
+      pos = next) {
+    start = (pos > 0 && !info.data[pos - 1]) ? pos - 1 : pos;
+    body = pos + 3;
+    next = gst_mfx_utils_find_start_code (info.data, size, body);
+    end = (next < size && next > body && !info.data[next - 1]) ?
+        next - 1 : next;
+
+    if (end == body || (drop_nal && drop_nal (info.data + body, end - body)))
+      continue;
+
+    if (body - start == 4) {
+      GST_WRITE_UINT32_BE (info.data + start, end - body);
+      if (run_end != start) {
+        if (run_end > run_start)
+          outbuf = append_region (outbuf, inbuf, run_start,
+              run_end - run_start);
+        run_start = start;
+      }
+      run_end = end;
+      continue;
+    }
+
+    if (run_end > run_start)
+      outbuf = append_region (outbuf, inbuf, run_start, run_end - run_start);
+    run_start = run_end = 0;
+
+    GST_WRITE_UINT32_BE (nal_size, end - body);
+    prefix = gst_buffer_new_allocate (NULL, sizeof (nal_size), NULL);
+    if (!prefix)
+      goto error;
+    gst_buffer_fill (prefix, 0, nal_size, sizeof (nal_size));
+    outbuf = gst_buffer_append (outbuf, prefix);
+    outbuf = append_region (outbuf, inbuf, body, end - body);
+  }
+  if (run_end > run_start)
+    outbuf = append_region (outbuf, inbuf, run_start, run_end - run_start);
+
+  gst_buffer_unmap (inbuf, &info);
+
+  if (gst_buffer_get_size (outbuf))
+    gst_buffer_replace (outbuf_ptr, outbuf);
+  gst_buffer_unref (outbuf);
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    gst_buffer_unmap (inbuf, &info);
+    gst_buffer_unref (outbuf);
+    return FALSE;
+  }
+}
+
 static GstCaps *
 gst_mfxenc_get_caps_impl (GstVideoEncoder * venc)
 {
@@ -388,6 +523,7 @@ gst_mfxenc_handle_frame (GstVideoEncoder * venc, GstVideoCodecFrame * frame)
   GstMfxEncoderStatus status;
   GstMfxVideoMeta *meta;
   GstMfxSurface *surface;
+  GstVideoCodecFrame *out_frame;
   GstFlowReturn ret;
   GstBuffer *buf;
 
@@ -413,14 +549,17 @@ gst_mfxenc_handle_frame (GstVideoEncoder * venc, GstVideoCodecFrame * frame)
   status = gst_mfx_encoder_encode (encode->encoder, frame);
   if (status < GST_MFX_ENCODER_STATUS_SUCCESS)
     goto error_encode_frame;
-  else if (status > 0) {
-    ret = GST_FLOW_OK;
-    goto done;
-  }
-  ret = gst_mfxenc_push_frame (encode, frame);
-  gst_mfx_surface_dequeue(surface);
 
-done:
+  /* The encoder keeps its own reference while the frame is in flight */
+  gst_video_codec_frame_unref (frame);
+
+  /* Push whatever frames completed so far, in order */
+  ret = GST_FLOW_OK;
+  while (GST_FLOW_OK == ret
+      && GST_MFX_ENCODER_STATUS_SUCCESS ==
+          gst_mfx_encoder_get_output (encode->encoder, &out_frame))
+    ret = gst_mfxenc_push_frame (encode, out_frame);
+
   return ret;
   /* ERRORS */
 error_buffer_invalid:
@@ -457,7 +596,7 @@ gst_mfxenc_finish (GstVideoEncoder * venc)
   GstMfxEnc *const encode = GST_MFXENC_CAST (venc);
   GstMfxEncoderStatus status;
   GstVideoCodecFrame *frame;
-  GstFlowReturn ret = GST_FLOW_ERROR;
+  GstFlowReturn ret = GST_FLOW_OK;
 
   /* Return "not-negotiated" error since this means we did not even reach
    * GstVideoEncoder::set_format () state, where the encoder could have
@@ -465,11 +604,16 @@ gst_mfxenc_finish (GstVideoEncoder * venc)
   if (!encode->encoder)
     return GST_FLOW_NOT_NEGOTIATED;
 
+  /* Drain the in-flight frames, then the ones buffered by the encoder */
   do {
     status = gst_mfx_encoder_flush (encode->encoder, &frame);
-    if (GST_MFX_ENCODER_STATUS_SUCCESS != status)
+    if (GST_MFX_ENCODER_STATUS_MORE_DATA == status)
+      break;
+    if (GST_MFX_ENCODER_STATUS_SUCCESS != status) {
+      ret = GST_FLOW_ERROR;
       break;
-    ret = gst_mfxenc_push_frame (encode, gst_video_codec_frame_ref (frame));
+    }
+    ret = gst_mfxenc_push_frame (encode, frame);
   } while (GST_FLOW_OK == ret);
 
   return ret;
@@ -523,6 +667,7 @@ gst_mfxenc_class_init (GstMfxEncClass * klass)
   gst_mfx_plugin_base_class_init (GST_MFX_PLUGIN_BASE_CLASS (klass));
 
   object_class->finalize = gst_mfxenc_finalize;
+  object_class->get_property = gst_mfxenc_get_property;
 
   venc_class->open = GST_DEBUG_FUNCPTR (gst_mfxenc_open);
   venc_class->stop = GST_DEBUG_FUNCPTR (gst_mfxenc_stop);
@@ -537,6 +682,17 @@ gst_mfxenc_class_init (GstMfxEncClass * klass)
   klass->get_property = gst_mfxenc_default_get_property;
   klass->set_property = gst_mfxenc_default_set_property;
 
+  g_object_class_install_property (object_class, PROP_WAIT_TIME,
+      g_param_spec_uint64 ("wait-time", "Wait Time",
+          "Total time spent waiting on a busy device, in microseconds",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_LATENCY_STATS,
+      g_param_spec_boxed ("latency-stats", "Latency statistics",
+          "Time from submitting a frame to the encoder to outputting it, "
+          "in microseconds", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   venc_class->src_query = GST_DEBUG_FUNCPTR (gst_mfxenc_src_query);
   venc_class->sink_query = GST_DEBUG_FUNCPTR (gst_mfxenc_sink_query);
 }
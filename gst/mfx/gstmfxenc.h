@@ -76,6 +76,11 @@ struct _GstMfxEncClass
   GstFlowReturn      		(*format_buffer)  (GstMfxEnc * encode, GstBuffer * in_buffer, GstBuffer ** out_buffer_ptr);
 };
 
+/* Tells whether a NAL unit, without its start code, is to be dropped
+ * when converting a byte stream to length prefixed NAL units */
+typedef gboolean (*GstMfxEncNalFilterFunc) (const guint8 * nal,
+    gsize nal_size);
+
 GType
 gst_mfxenc_get_type (void);
 
@@ -85,6 +90,10 @@ gst_mfxenc_init_properties (GstMfxEnc * encode);
 gboolean
 gst_mfxenc_class_init_properties (GstMfxEncClass * encode_class);
 
+gboolean
+gst_mfxenc_convert_byte_stream (GstBuffer * inbuf,
+    GstMfxEncNalFilterFunc drop_nal, GstBuffer ** outbuf_ptr);
+
 G_END_DECLS
 
 #endif /* GST_MFXENC_H */
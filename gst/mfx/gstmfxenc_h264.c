@@ -41,6 +41,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_mfx_h264_enc_debug);
 
 static const char gst_mfxenc_h264_sink_caps_str[] =
     GST_MFX_MAKE_SURFACE_CAPS "; "
+    GST_MFX_MAKE_DMABUF_CAPS "; "
     GST_VIDEO_CAPS_MAKE (GST_MFX_SUPPORTED_INPUT_FORMATS);
 
 static const char gst_mfxenc_h264_src_caps_str[] =
@@ -229,107 +230,18 @@ gst_mfxenc_h264_alloc_encoder (GstMfxEnc * base)
       plugin->sinkpad_caps_is_raw);
 }
 
-/* h264 NAL byte stream operations */
-static guint8 *
-_h264_byte_stream_next_nal (guint8 * buffer, gint32 len, guint32 * nal_size)
-{
-  const guint8 *cur = buffer;
-  const guint8 *const end = buffer + len;
-  guint8 *nal_start = NULL;
-  guint32 flag = 0xFFFFFFFF;
-  guint32 nal_start_len = 0;
-
-  g_assert (len >= 0 && buffer && nal_size);
-  if (len < 3) {
-    *nal_size = len;
-    nal_start = (len ? buffer : NULL);
-    return nal_start;
-  }
-
-  /*locate head postion */
-  if (!buffer[0] && !buffer[1]) {
-    if (buffer[2] == 1) {       /* 0x000001 */
-      nal_start_len = 3;
-    } else if (!buffer[2] && len >= 4 && buffer[3] == 1) {      /* 0x00000001 */
-      nal_start_len = 4;
-    }
-  }
-  nal_start = buffer + nal_start_len;
-  cur = nal_start;
-
-  /*find next nal start position */
-  while (cur < end) {
-    flag = ((flag << 8) | ((*cur++) & 0xFF));
-    if ((flag & 0x00FFFFFF) == 0x00000001) {
-      if (flag == 0x00000001)
-        *nal_size = cur - 4 - nal_start;
-      else
-        *nal_size = cur - 3 - nal_start;
-      break;
-    }
-  }
-  if (cur >= end) {
-    *nal_size = end - nal_start;
-    if (nal_start >= end) {
-      nal_start = NULL;
-    }
-  }
-  return nal_start;
-}
-
+/* Parameter sets are carried in the codec data of avc1 streams */
 static gboolean
-_h264_convert_byte_stream_to_avc (GstBuffer * inbuf, GstBuffer ** outbuf_ptr)
+_h264_nal_is_parameter_set (const guint8 * nal, gsize nal_size)
 {
-  GstMapInfo info;
-  guint32 nal_size = 0;
-  guint8 *nal_start_code, *nal_body;
-  guint8 *avc_data = NULL;
-  guint8 *frame_end;
-  GByteArray *avc_bytes = g_byte_array_new();
-
-  if (!avc_bytes)
-    return FALSE;
-
-  if (!gst_buffer_map (inbuf, &info, GST_MAP_READ))
-    return FALSE;
-
-  nal_start_code = info.data;
-  frame_end = info.data + info.size;
-
-  while ((frame_end > nal_start_code) &&
-      (nal_body = _h264_byte_stream_next_nal (nal_start_code,
-              frame_end - nal_start_code, &nal_size)) != NULL) {
-    if (!nal_size)
-      goto error;
-
-    /* A start code size of 3 indicates the start of an
-     * encoded picture in MSDK */
-    if (nal_body - nal_start_code == 3) {
-      avc_data = g_malloc(nal_size + 4);
-      if (!avc_data)
-        goto error;
-
-      /* Precede NALU with NALU size */
-      GST_WRITE_UINT32_BE (avc_data, nal_size);
-      memcpy (avc_data + 4, nal_body, nal_size);
-
-      g_byte_array_append(avc_bytes, avc_data, nal_size + 4);
-      g_free (avc_data);
-    }
-    nal_start_code = nal_body + nal_size;
+  switch (nal[0] & 0x1f) {
+    case 7:                     /* SPS */
+    case 8:                     /* PPS */
+    case 9:                     /* AUD */
+      return TRUE;
+    default:
+      return FALSE;
   }
-  gst_buffer_unmap (inbuf, &info);
-
-  if (avc_bytes->data)
-    *outbuf_ptr = gst_buffer_new_wrapped(avc_bytes->data, avc_bytes->len);
-
-  g_byte_array_free(avc_bytes, FALSE);
-  return TRUE;
-
-error:
-  g_byte_array_free(avc_bytes, TRUE);
-  gst_buffer_unmap (inbuf, &info);
-  return FALSE;
 }
 
 static GstFlowReturn
@@ -342,7 +254,8 @@ gst_mfxenc_h264_format_buffer (GstMfxEnc * base_encode,
     return GST_FLOW_OK;
 
   /* Convert to avcC format */
-  if (!_h264_convert_byte_stream_to_avc (inbuf, outbuf_ptr))
+  if (!gst_mfxenc_convert_byte_stream (inbuf,
+          _h264_nal_is_parameter_set, outbuf_ptr))
     goto error_convert_buffer;
   return GST_FLOW_OK;
 
@@ -35,6 +35,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_mfx_jpeg_encode_debug);
 
 static const char gst_mfxenc_jpeg_sink_caps_str[] =
     GST_MFX_MAKE_SURFACE_CAPS "; "
+    GST_MFX_MAKE_DMABUF_CAPS "; "
     GST_VIDEO_CAPS_MAKE (GST_MFX_SUPPORTED_INPUT_FORMATS);
 
 static const char gst_mfxenc_jpeg_src_caps_str[] = GST_CODEC_CAPS;
@@ -29,6 +29,12 @@
 #include "gstmfxvideometa.h"
 #include "gstmfxvideobufferpool.h"
 
+#include <gst-libs/mfx/gstmfxcopy.h>
+#include <gst-libs/mfx/gstmfxsurface_vaapi.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 #ifdef HAVE_GST_GL_LIBS
 # if GST_CHECK_VERSION(1,11,1)
 # include <gst/gl/gstglcontext.h>
@@ -40,6 +46,55 @@
 /* Default debug category is from the subclass */
 #define GST_CAT_DEFAULT (plugin->debug_category)
 
+/* Upstream pools recycle far fewer buffers than this. Producers that
+ * allocate a new dmabuf per frame flush the import cache instead */
+#define MAX_DMABUF_IMPORTS 32
+
+typedef struct
+{
+  guint64 dev;
+  guint64 ino;
+} DmaBufKey;
+
+typedef struct
+{
+  DmaBufKey key;
+  gsize offset;
+  /* Tags the GstMemory the dmabuf was imported from */
+  guint serial;
+  /* Keeps the dmabuf, and thereby its inode, from being reused while
+   * the import is cached */
+  gint fd;
+  GstMfxSurface *surface;
+} DmaBufImport;
+
+static volatile gint dmabuf_import_serial = 0;
+
+static guint
+dmabuf_key_hash (gconstpointer key)
+{
+  const DmaBufKey *const k = key;
+
+  return (guint) (k->ino ^ (k->ino >> 32)) ^ (guint) (k->dev * 31);
+}
+
+static gboolean
+dmabuf_key_equal (gconstpointer a, gconstpointer b)
+{
+  const DmaBufKey *const ka = a;
+  const DmaBufKey *const kb = b;
+
+  return ka->dev == kb->dev && ka->ino == kb->ino;
+}
+
+static void
+dmabuf_import_free (DmaBufImport * import)
+{
+  gst_mfx_surface_unref (import->surface);
+  close (import->fd);
+  g_slice_free (DmaBufImport, import);
+}
+
 static gpointer plugin_parent_class = NULL;
 
 static void
@@ -53,6 +108,12 @@ plugin_set_aggregator (GstElement * element, GstContext * context)
     gst_mfx_task_aggregator_replace (&plugin->aggregator, aggregator);
     gst_mfx_task_aggregator_unref (aggregator);
   }
+  else {
+    gst_mfx_video_context_get_device (context, &plugin->device_path,
+        &plugin->device_selection);
+    gst_mfx_video_context_get_session_pool_size (context,
+        &plugin->session_pool_size);
+  }
 
   if (element_class->set_context)
     element_class->set_context (element, context);
@@ -84,27 +145,42 @@ void
 gst_mfx_plugin_base_init (GstMfxPluginBase * plugin,
     GstDebugCategory * debug_category)
 {
+  gchar *quark_name;
+
   plugin->debug_category = debug_category;
+  plugin->device_selection = gst_mfx_device_list_get_default_selection ();
 
   /* sink pad */
   plugin->sinkpad = gst_element_get_static_pad (GST_ELEMENT (plugin), "sink");
   gst_video_info_init (&plugin->sinkpad_info);
   plugin->sinkpad_query = GST_PAD_QUERYFUNC (plugin->sinkpad);
 
-  /* src pad */
+  /* src pad, elements with request src pads have no static one */
   if (!(GST_OBJECT_FLAGS (plugin) & GST_ELEMENT_FLAG_SINK)) {
     plugin->srcpad = gst_element_get_static_pad (GST_ELEMENT (plugin), "src");
-    plugin->srcpad_query = GST_PAD_QUERYFUNC (plugin->srcpad);
+    if (plugin->srcpad)
+      plugin->srcpad_query = GST_PAD_QUERYFUNC (plugin->srcpad);
   }
   gst_video_info_init (&plugin->srcpad_info);
 
   plugin->need_linear_dmabuf = FALSE;
+
+  plugin->dmabuf_imports = g_hash_table_new_full (dmabuf_key_hash,
+      dmabuf_key_equal, NULL, (GDestroyNotify) dmabuf_import_free);
+  /* Each element tags the memories it imported with a quark of its own,
+   * as several of them may import the same upstream buffers */
+  quark_name = g_strdup_printf ("GstMfxDmaBufImport-%p", plugin);
+  plugin->dmabuf_quark = g_quark_from_string (quark_name);
+  g_free (quark_name);
 }
 
 void
 gst_mfx_plugin_base_finalize (GstMfxPluginBase * plugin)
 {
   gst_mfx_plugin_base_close (plugin);
+  g_hash_table_unref (plugin->dmabuf_imports);
+  g_free (plugin->device_path);
+  plugin->device_path = NULL;
   if (plugin->sinkpad)
     gst_object_unref (plugin->sinkpad);
   if (plugin->srcpad)
@@ -125,7 +201,9 @@ gst_mfx_plugin_base_close (GstMfxPluginBase * plugin)
 
   gst_caps_replace (&plugin->sinkpad_caps, NULL);
   plugin->sinkpad_caps_changed = FALSE;
+  plugin->sinkpad_caps_is_dmabuf = FALSE;
   gst_video_info_init (&plugin->sinkpad_info);
+  g_hash_table_remove_all (plugin->dmabuf_imports);
   if (plugin->sinkpad_buffer_pool) {
     gst_object_unref (plugin->sinkpad_buffer_pool);
     plugin->sinkpad_buffer_pool = NULL;
@@ -226,8 +304,9 @@ ensure_sinkpad_buffer_pool (GstMfxPluginBase * plugin, GstCaps * caps)
     plugin->sinkpad_has_dmabuf =
         has_dmabuf_capable_peer (plugin, plugin->sinkpad);
 
+  plugin->sinkpad_caps_is_dmabuf = gst_caps_has_dmabuf (caps);
   plugin->sinkpad_caps_is_raw = !plugin->sinkpad_has_dmabuf &&
-      !gst_caps_has_mfx_surface (caps);
+      !plugin->sinkpad_caps_is_dmabuf && !gst_caps_has_mfx_surface (caps);
 
   if (!gst_mfx_plugin_base_ensure_aggregator (plugin))
     return FALSE;
@@ -307,6 +386,9 @@ gst_mfx_plugin_base_set_caps (GstMfxPluginBase * plugin, GstCaps * incaps,
       return FALSE;
     plugin->sinkpad_caps_changed = TRUE;
     plugin->sinkpad_caps_is_raw = !gst_caps_has_mfx_surface (incaps);
+
+    /* Imports are only valid for the frame layout they were made with */
+    g_hash_table_remove_all (plugin->dmabuf_imports);
   }
 
   if (!GST_IS_VIDEO_DECODER (plugin))
@@ -551,6 +633,129 @@ config_failed:
   }
 }
 
+/* Returns a new reference to the surface imported from the dmabuf backing
+ * @inbuf, importing it on first use. Upstream pools hand out the same
+ * dmabufs over and over, and an fd number may be reused for another dmabuf
+ * while the same dmabuf may come with different fds, so imports are looked
+ * up by device and inode. Before Linux 5.3 all dmabufs share a single
+ * anonymous inode, which is told apart by its zero size, so the memory
+ * holding the dmabuf is also tagged and checked. Imports of a shared inode
+ * are never cached */
+static GstMfxSurface *
+get_dmabuf_surface (GstMfxPluginBase * plugin, GstBuffer * inbuf)
+{
+  GstVideoInfo *const vip = &plugin->sinkpad_info;
+  GstVideoMeta *const vmeta = gst_buffer_get_video_meta (inbuf);
+  gsize offsets[GST_VIDEO_MAX_PLANES];
+  gint strides[GST_VIDEO_MAX_PLANES];
+  GstMfxDisplay *display;
+  GstMfxSurface *surface;
+  DmaBufImport *import;
+  GstMemory *mem;
+  struct stat st;
+  DmaBufKey key;
+  gsize offset, maxsize;
+  gpointer tag;
+  gint fd;
+  guint i;
+
+  /* Planes in distinct dmabufs cannot be imported as a single surface */
+  if (gst_buffer_n_memory (inbuf) != 1)
+    return NULL;
+
+  mem = gst_buffer_peek_memory (inbuf, 0);
+  if (!gst_is_dmabuf_memory (mem))
+    return NULL;
+
+  fd = gst_dmabuf_memory_get_fd (mem);
+  if (fstat (fd, &st) < 0)
+    return NULL;
+  key.dev = st.st_dev;
+  key.ino = st.st_ino;
+
+  gst_memory_get_sizes (mem, &offset, &maxsize);
+
+  import = NULL;
+  if (st.st_size > 0) {
+    tag = gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (mem),
+        plugin->dmabuf_quark);
+    import = g_hash_table_lookup (plugin->dmabuf_imports, &key);
+    if (import && import->offset == offset
+        && tag == GUINT_TO_POINTER (import->serial))
+      return gst_mfx_surface_ref (import->surface);
+  }
+
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (vip); i++) {
+    offsets[i] = offset +
+        (vmeta ? vmeta->offset[i] : GST_VIDEO_INFO_PLANE_OFFSET (vip, i));
+    strides[i] = vmeta ? vmeta->stride[i] : GST_VIDEO_INFO_PLANE_STRIDE (vip, i);
+  }
+
+  display = gst_mfx_task_aggregator_get_display (plugin->aggregator);
+  surface = gst_mfx_surface_vaapi_new_from_dmabuf (display, vip, fd,
+      maxsize, offsets, strides);
+  gst_mfx_display_unref (display);
+  if (!surface || st.st_size <= 0)
+    return surface;
+
+  if (!import && g_hash_table_size (plugin->dmabuf_imports) >=
+      MAX_DMABUF_IMPORTS) {
+    GST_DEBUG_OBJECT (plugin, "upstream does not recycle its dmabufs, "
+        "flushing the import cache");
+    g_hash_table_remove_all (plugin->dmabuf_imports);
+  }
+
+  import = g_slice_new (DmaBufImport);
+  import->key = key;
+  import->offset = offset;
+  import->serial = (guint) g_atomic_int_add (&dmabuf_import_serial, 1) + 1;
+  import->fd = dup (fd);
+  import->surface = gst_mfx_surface_ref (surface);
+  g_hash_table_replace (plugin->dmabuf_imports, &import->key, import);
+
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (mem), plugin->dmabuf_quark,
+      GUINT_TO_POINTER (import->serial), NULL);
+
+  return surface;
+}
+
+/* Wraps the surface imported from @inbuf without copying the frame. The
+ * producer may only write to the dmabuf again once @inbuf is released,
+ * so it is kept alive along with the returned buffer */
+static gboolean
+import_dma_buffer (GstMfxPluginBase * plugin, GstBuffer * inbuf,
+    GstBuffer ** outbuf_ptr)
+{
+  GstMfxVideoMeta *meta;
+  GstMfxSurface *surface;
+  GstBuffer *outbuf;
+
+  surface = get_dmabuf_surface (plugin, inbuf);
+  if (!surface)
+    return FALSE;
+
+  meta = gst_mfx_video_meta_new ();
+  if (!meta) {
+    gst_mfx_surface_unref (surface);
+    return FALSE;
+  }
+  gst_mfx_video_meta_set_surface (meta, surface);
+  gst_mfx_surface_unref (surface);
+
+  outbuf = gst_buffer_new ();
+  gst_buffer_set_mfx_video_meta (outbuf, meta);
+  gst_mfx_video_meta_unref (meta);
+
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (outbuf),
+      g_quark_from_static_string ("GstMfxDmaBufSource"),
+      gst_buffer_ref (inbuf), (GDestroyNotify) gst_buffer_unref);
+  gst_buffer_copy_into (outbuf, inbuf,
+      GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+  *outbuf_ptr = outbuf;
+  return TRUE;
+}
+
 /**
  * gst_mfx_plugin_base_get_input_buffer:
  * @plugin: a #GstMfxPluginBase
@@ -560,7 +765,8 @@ config_failed:
  * Acquires the sink pad (input) buffer as a VA surface backed
  * buffer. This is mostly useful for raw YUV buffers, as source
  * buffers that are already backed as a VA surface are passed
- * verbatim.
+ * verbatim. Dmabufs are imported as VA surfaces without any copy
+ * when the sink pad expects video memory.
  *
  * Returns: #GST_FLOW_OK if the buffer could be acquired
  */
@@ -582,8 +788,11 @@ gst_mfx_plugin_base_get_input_buffer (GstMfxPluginBase * plugin,
     return GST_FLOW_OK;
   }
 
-  if (!plugin->sinkpad_caps_is_raw)
+  if (!plugin->sinkpad_caps_is_raw) {
+    if (import_dma_buffer (plugin, inbuf, outbuf_ptr))
+      return GST_FLOW_OK;
     goto error_invalid_buffer;
+  }
 
   if (!plugin->sinkpad_buffer_pool)
     goto error_no_pool;
@@ -608,7 +817,8 @@ gst_mfx_plugin_base_get_input_buffer (GstMfxPluginBase * plugin,
   GST_VIDEO_FRAME_WIDTH (&src_frame) = GST_VIDEO_FRAME_WIDTH (&out_frame);
   GST_VIDEO_FRAME_HEIGHT (&src_frame) = GST_VIDEO_FRAME_HEIGHT (&out_frame);
 
-  success = gst_video_frame_copy (&out_frame, &src_frame);
+  success = gst_mfx_copy_video_frame (&out_frame, &src_frame,
+      GST_MFX_COPY_FLAG_NONE);
   gst_video_frame_unmap (&out_frame);
   gst_video_frame_unmap (&src_frame);
   if (!success)
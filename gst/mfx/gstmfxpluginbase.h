@@ -126,9 +126,21 @@ struct _GstMfxPluginBase
   gboolean              srcpad_has_dmabuf;
   GstAllocator         *dmabuf_allocator;
 
+  /* Upstream dmabufs imported as surfaces, by device and inode */
+  gboolean              sinkpad_caps_is_dmabuf;
+  GHashTable           *dmabuf_imports;
+  GQuark                dmabuf_quark;
+
   gboolean              need_linear_dmabuf;
 
   GstMfxTaskAggregator *aggregator;
+
+  /* DRM node requested through the aggregator context, if any */
+  gchar                *device_path;
+  GstMfxDeviceSelection device_selection;
+  /* Session pool size requested through the aggregator context, 0 if
+   * none was */
+  guint                 session_pool_size;
 };
 
 struct _GstMfxPluginBaseClass
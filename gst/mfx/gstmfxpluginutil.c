@@ -38,9 +38,13 @@ gst_mfx_ensure_aggregator (GstElement * element)
   if (gst_mfx_video_context_prepare (element, &plugin->aggregator))
     return TRUE;
 
-  aggregator = gst_mfx_task_aggregator_new ();
+  aggregator = gst_mfx_task_aggregator_new_with_device (
+      plugin->device_selection, plugin->device_path);
   if (!aggregator)
     return FALSE;
+  if (plugin->session_pool_size)
+    gst_mfx_task_aggregator_set_session_pool_size (aggregator,
+        plugin->session_pool_size);
 
   gst_mfx_video_context_propagate (element, aggregator);
   gst_mfx_task_aggregator_unref (aggregator);
@@ -382,6 +386,15 @@ gst_caps_has_mfx_surface (GstCaps * caps)
   return _gst_caps_has_feature (caps, GST_CAPS_FEATURE_MEMORY_MFX_SURFACE);
 }
 
+/* Checks whether the supplied caps contain dmabufs */
+gboolean
+gst_caps_has_dmabuf (GstCaps * caps)
+{
+  g_return_val_if_fail (caps != NULL, FALSE);
+
+  return _gst_caps_has_feature (caps, GST_MFX_CAPS_FEATURE_MEMORY_DMABUF);
+}
+
 gboolean
 gst_mfx_query_peer_has_raw_caps (GstPad * srcpad)
 {
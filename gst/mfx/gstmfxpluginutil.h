@@ -77,6 +77,13 @@ gst_mfx_caps_feature_to_string(GstMfxCapsFeature feature);
     GST_VIDEO_CAPS_MAKE_WITH_FEATURES(          \
     GST_CAPS_FEATURE_MEMORY_MFX_SURFACE, "{ NV12, BGRA }")
 
+/* Linear dmabufs imported as surfaces, see gstmfxpluginbase.c */
+#define GST_MFX_CAPS_FEATURE_MEMORY_DMABUF "memory:DMABuf"
+
+#define GST_MFX_MAKE_DMABUF_CAPS                \
+    GST_VIDEO_CAPS_MAKE_WITH_FEATURES(          \
+    GST_MFX_CAPS_FEATURE_MEMORY_DMABUF, "{ NV12, BGRA, BGRx }")
+
 #ifdef WITH_MSS_2016
 #define GST_MFX_SUPPORTED_INPUT_FORMATS \
     "{ NV12, YV12, I420, YUY2, BGRA, BGRx }"
@@ -89,6 +96,9 @@ gst_mfx_caps_feature_to_string(GstMfxCapsFeature feature);
 gboolean
 gst_caps_has_mfx_surface(GstCaps * caps);
 
+gboolean
+gst_caps_has_dmabuf(GstCaps * caps);
+
 gboolean
 gst_mfx_query_peer_has_raw_caps(GstPad * pad);
 
@@ -93,9 +93,12 @@ enum
   PROP_ROTATION,
   PROP_FRAMERATE,
   PROP_FRC_ALGORITHM,
+  PROP_WAIT_TIME,
+  PROP_PIPELINE_DEPTH,
 };
 
 #define DEFAULT_ASYNC_DEPTH             0
+#define DEFAULT_PIPELINE_DEPTH          1
 #define DEFAULT_FORMAT                  GST_VIDEO_FORMAT_NV12
 #define DEFAULT_DEINTERLACE_MODE        GST_MFX_DEINTERLACE_MODE_BOB
 #define DEFAULT_ROTATION                GST_MFX_ROTATION_0
@@ -388,9 +391,13 @@ find_best_size (GstMfxPostproc * vpp, GstVideoInfo * vip,
   *height_ptr = height;
 }
 
+static void
+drain_pending_frames (GstMfxPostproc * vpp, gboolean push);
+
 static void
 gst_mfxpostproc_destroy (GstMfxPostproc * vpp)
 {
+  drain_pending_frames (vpp, FALSE);
   gst_mfx_filter_replace (&vpp->filter, NULL);
   cb_channels_finalize (vpp);
   gst_caps_replace (&vpp->allowed_sinkpad_caps, NULL);
@@ -592,6 +599,144 @@ gst_mfxpostproc_before_transform (GstBaseTransform * trans,
   }
 }
 
+/* Frame rate conversion and deinterlacing may produce zero or several
+ * outputs per input, which the in-order pipeline does not track */
+static inline gboolean
+is_pipelined (GstMfxPostproc * vpp)
+{
+  return vpp->pipeline_depth > 1 && !(vpp->flags &
+      (GST_MFX_POSTPROC_FLAG_DEINTERLACING | GST_MFX_POSTPROC_FLAG_FRC));
+}
+
+/* Completes the oldest frame in flight into @outbuf, which gets the
+ * timestamps of the input buffer that frame was submitted with */
+static GstFlowReturn
+finish_pending_frame (GstMfxPostproc * vpp, GstBuffer * outbuf)
+{
+  GstMfxVideoMeta *outbuf_meta;
+  GstMfxSurface *out_surface;
+  GstMfxRectangle *crop_rect;
+  GstMfxFilterStatus status;
+  GstBuffer *inbuf;
+
+  status = gst_mfx_filter_get_output (vpp->filter, TRUE, &out_surface);
+  inbuf = g_queue_pop_head (&vpp->pending_inputs);
+  if (!inbuf)
+    return GST_FLOW_ERROR;
+
+  gst_mfx_surface_dequeue (gst_mfx_video_meta_get_surface (
+          gst_buffer_get_mfx_video_meta (inbuf)));
+
+  if (GST_MFX_FILTER_STATUS_SUCCESS != status)
+    goto error_process_vpp;
+
+  outbuf_meta = gst_buffer_get_mfx_video_meta (outbuf);
+  if (!outbuf_meta)
+    goto error_create_meta;
+
+  gst_mfx_video_meta_set_surface (outbuf_meta, out_surface);
+  crop_rect = gst_mfx_surface_get_crop_rect (out_surface);
+  if (crop_rect) {
+    GstVideoCropMeta *const crop_meta =
+        gst_buffer_add_video_crop_meta (outbuf);
+    if (crop_meta) {
+      crop_meta->x = crop_rect->x;
+      crop_meta->y = crop_rect->y;
+      crop_meta->width = crop_rect->width;
+      crop_meta->height = crop_rect->height;
+    }
+  }
+  gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+#if GST_CHECK_VERSION(1,8,0)
+  gst_mfx_plugin_base_export_dma_buffer (GST_MFX_PLUGIN_BASE (vpp), outbuf);
+#endif // GST_CHECK_VERSION
+
+  gst_buffer_unref (inbuf);
+  return GST_FLOW_OK;
+  /* ERRORS */
+error_process_vpp:
+  {
+    GST_ERROR ("failed to apply VPP (error %d)", status);
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_ERROR;
+  }
+error_create_meta:
+  {
+    GST_ERROR ("failed to create new output buffer meta");
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+static void
+discard_pending_frame (GstMfxPostproc * vpp)
+{
+  GstMfxSurface *out_surface;
+  GstBuffer *inbuf;
+
+  gst_mfx_filter_get_output (vpp->filter, TRUE, &out_surface);
+  inbuf = g_queue_pop_head (&vpp->pending_inputs);
+  gst_mfx_surface_dequeue (gst_mfx_video_meta_get_surface (
+          gst_buffer_get_mfx_video_meta (inbuf)));
+  gst_buffer_unref (inbuf);
+}
+
+/* Pushes the frames still in flight downstream, or only waits for them
+ * to complete and drops them if @push is not set */
+static void
+drain_pending_frames (GstMfxPostproc * vpp, gboolean push)
+{
+  GstBaseTransform *const trans = GST_BASE_TRANSFORM (vpp);
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *outbuf;
+
+  while (!g_queue_is_empty (&vpp->pending_inputs)) {
+    outbuf = (push && GST_FLOW_OK == ret) ? create_output_buffer (vpp) : NULL;
+    if (!outbuf) {
+      discard_pending_frame (vpp);
+      continue;
+    }
+
+    ret = finish_pending_frame (vpp, outbuf);
+    if (GST_FLOW_OK == ret)
+      ret = gst_pad_push (trans->srcpad, outbuf);
+    else
+      gst_buffer_unref (outbuf);
+  }
+}
+
+static GstFlowReturn
+gst_mfxpostproc_transform_pipelined (GstMfxPostproc * vpp, GstBuffer * buf,
+    GstBuffer * outbuf)
+{
+  GstMfxSurface *surface;
+  GstMfxFilterStatus status;
+
+  surface = gst_mfx_video_meta_get_surface (
+      gst_buffer_get_mfx_video_meta (buf));
+  if (!surface) {
+    GST_ERROR ("failed to create surface surface from buffer");
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
+  status = gst_mfx_filter_submit (vpp->filter, surface);
+  if (GST_MFX_FILTER_STATUS_SUCCESS != status) {
+    GST_ERROR ("failed to apply VPP (error %d)", status);
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+
+  /* The input buffer keeps its surface alive until VPP is done with it */
+  g_queue_push_tail (&vpp->pending_inputs, buf);
+
+  if (g_queue_get_length (&vpp->pending_inputs) < vpp->pipeline_depth)
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+  return finish_pending_frame (vpp, outbuf);
+}
+
 static GstFlowReturn
 gst_mfxpostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
     GstBuffer * outbuf)
@@ -612,6 +757,9 @@ gst_mfxpostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
   if (GST_FLOW_OK != ret)
     return ret;
 
+  if (is_pipelined (vpp))
+    return gst_mfxpostproc_transform_pipelined (vpp, buf, outbuf);
+
   inbuf_meta = gst_buffer_get_mfx_video_meta (buf);
   surface = gst_mfx_video_meta_get_surface (inbuf_meta);
   if (!surface)
@@ -711,6 +859,26 @@ error_process_vpp:
   }
 }
 
+static gboolean
+gst_mfxpostproc_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstMfxPostproc *const vpp = GST_MFXPOSTPROC (trans);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      drain_pending_frames (vpp, TRUE);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      drain_pending_frames (vpp, FALSE);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_mfxpostproc_parent_class)->sink_event
+      (trans, event);
+}
+
 static gboolean
 gst_mfxpostproc_propose_allocation (GstBaseTransform * trans,
     GstQuery * decide_query, GstQuery * query)
@@ -879,6 +1047,8 @@ gst_mfxpostproc_create (GstMfxPostproc * vpp)
   if (vpp->async_depth)
     gst_mfx_filter_set_async_depth (vpp->filter, vpp->async_depth);
 
+  gst_mfx_filter_set_pipeline_depth (vpp->filter, vpp->pipeline_depth);
+
   gst_mfx_filter_set_size (vpp->filter,
     GST_VIDEO_INFO_WIDTH (&vpp->srcpad_info),
     GST_VIDEO_INFO_HEIGHT (&vpp->srcpad_info));
@@ -1000,6 +1170,9 @@ gst_mfxpostproc_set_property (GObject * object,
     case PROP_ASYNC_DEPTH:
       vpp->async_depth = g_value_get_uint (value);
       break;
+    case PROP_PIPELINE_DEPTH:
+      vpp->pipeline_depth = g_value_get_uint (value);
+      break;
     case PROP_FORMAT:
       vpp->format = g_value_get_enum (value);
       break;
@@ -1123,6 +1296,13 @@ gst_mfxpostproc_get_property (GObject * object,
     case PROP_FRC_ALGORITHM:
       g_value_set_enum (value, vpp->alg);
       break;
+    case PROP_WAIT_TIME:
+      g_value_set_uint64 (value, vpp->filter ?
+          gst_mfx_filter_get_wait_time (vpp->filter) : 0);
+      break;
+    case PROP_PIPELINE_DEPTH:
+      g_value_set_uint (value, vpp->pipeline_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1154,6 +1334,7 @@ gst_mfxpostproc_class_init (GstMfxPostprocClass * klass)
   trans_class->propose_allocation = gst_mfxpostproc_propose_allocation;
   trans_class->decide_allocation = gst_mfxpostproc_decide_allocation;
   trans_class->before_transform = gst_mfxpostproc_before_transform;
+  trans_class->sink_event = gst_mfxpostproc_sink_event;
 
   gst_element_class_set_static_metadata (element_class,
       "MFX video postprocessing",
@@ -1358,6 +1539,36 @@ gst_mfxpostproc_class_init (GstMfxPostprocClass * klass)
           "The algorithm type",
           GST_MFX_TYPE_FRC_ALGORITHM,
           DEFAULT_FRC_ALG, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMfxPostproc:wait-time
+   *
+   * Total time the filter spent waiting on a busy device, in microseconds.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_WAIT_TIME,
+      g_param_spec_uint64 ("wait-time",
+          "Wait Time",
+          "Total time spent waiting on a busy device, in microseconds",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMfxPostproc:pipeline-depth
+   *
+   * Number of frames submitted to VPP before waiting for the oldest one.
+   * Outputs are then delayed by as many frames, but the hardware never
+   * idles waiting for the next input. Does not apply to deinterlacing
+   * and frame rate conversion.
+   */
+  g_object_class_install_property
+      (object_class,
+      PROP_PIPELINE_DEPTH,
+      g_param_spec_uint ("pipeline-depth",
+          "Pipeline Depth",
+          "Number of frames in flight before waiting for the oldest one",
+          1, 20, DEFAULT_PIPELINE_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -1366,6 +1577,8 @@ gst_mfxpostproc_init (GstMfxPostproc * vpp)
   gst_mfx_plugin_base_init (GST_MFX_PLUGIN_BASE (vpp), GST_CAT_DEFAULT);
 
   vpp->async_depth = DEFAULT_ASYNC_DEPTH;
+  vpp->pipeline_depth = DEFAULT_PIPELINE_DEPTH;
+  g_queue_init (&vpp->pending_inputs);
   vpp->format = DEFAULT_FORMAT;
   vpp->deinterlace_mode = DEFAULT_DEINTERLACE_MODE;
   vpp->keep_aspect = TRUE;
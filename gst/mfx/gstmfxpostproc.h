@@ -98,6 +98,10 @@ struct _GstMfxPostproc
   guint                   flags;
   guint                   async_depth;
 
+  /* Pipelined VPP: input buffers of the frames in flight, oldest first */
+  guint                   pipeline_depth;
+  GQueue                  pending_inputs;
+
   GstCaps                *allowed_sinkpad_caps;
   GstVideoInfo            sinkpad_info;
   GstCaps                *allowed_srcpad_caps;
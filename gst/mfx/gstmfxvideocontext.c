@@ -86,6 +86,82 @@ gst_mfx_video_context_get_aggregator (GstContext * context,
       GST_MFX_TYPE_TASK_AGGREGATOR, aggregator_ptr, NULL);
 }
 
+/**
+ * gst_mfx_video_context_get_device:
+ * @context: an aggregator #GstContext
+ * @device_path_ptr: (out): return location for the requested DRM node
+ * @selection_ptr: (out): return location for the device selection policy
+ *
+ * Retrieves the device an application asked new aggregators to be
+ * created on, through the "device" string and "device-selection"
+ * #GstMfxDeviceSelection fields of the context. Locations of missing
+ * fields are left untouched.
+ *
+ * Returns: %TRUE if @context has any of the device fields
+ */
+gboolean
+gst_mfx_video_context_get_device (GstContext * context,
+    gchar ** device_path_ptr, GstMfxDeviceSelection * selection_ptr)
+{
+  const GstStructure *structure;
+  const gchar *device_path;
+  gint selection;
+  gboolean found = FALSE;
+
+  g_return_val_if_fail (GST_IS_CONTEXT (context), FALSE);
+  g_return_val_if_fail (device_path_ptr != NULL, FALSE);
+  g_return_val_if_fail (selection_ptr != NULL, FALSE);
+
+  if (g_strcmp0 (gst_context_get_context_type (context),
+          GST_MFX_AGGREGATOR_CONTEXT_TYPE_NAME))
+    return FALSE;
+
+  structure = gst_context_get_structure (context);
+
+  device_path = gst_structure_get_string (structure,
+      GST_MFX_DEVICE_CONTEXT_FIELD_NAME);
+  if (device_path) {
+    g_free (*device_path_ptr);
+    *device_path_ptr = g_strdup (device_path);
+    found = TRUE;
+  }
+
+  if (gst_structure_get_enum (structure,
+          GST_MFX_DEVICE_SELECTION_CONTEXT_FIELD_NAME,
+          GST_MFX_TYPE_DEVICE_SELECTION, &selection)) {
+    *selection_ptr = selection;
+    found = TRUE;
+  }
+
+  return found;
+}
+
+/**
+ * gst_mfx_video_context_get_session_pool_size:
+ * @context: an aggregator #GstContext
+ * @size_ptr: (out): return location for the session pool size
+ *
+ * Retrieves the number of idle MFX sessions an application asked new
+ * aggregators to keep initialized, through the "session-pool-size"
+ * unsigned integer field of the context.
+ *
+ * Returns: %TRUE if @context has the session pool size field
+ */
+gboolean
+gst_mfx_video_context_get_session_pool_size (GstContext * context,
+    guint * size_ptr)
+{
+  g_return_val_if_fail (GST_IS_CONTEXT (context), FALSE);
+  g_return_val_if_fail (size_ptr != NULL, FALSE);
+
+  if (g_strcmp0 (gst_context_get_context_type (context),
+          GST_MFX_AGGREGATOR_CONTEXT_TYPE_NAME))
+    return FALSE;
+
+  return gst_structure_get_uint (gst_context_get_structure (context),
+      GST_MFX_SESSION_POOL_SIZE_CONTEXT_FIELD_NAME, size_ptr);
+}
+
 static gboolean
 context_pad_query (const GValue * item, GValue * value, gpointer user_data)
 {
@@ -29,6 +29,14 @@
 
 #define GST_MFX_AGGREGATOR_CONTEXT_TYPE_NAME "gst.mfx.Aggregator"
 
+/* Optional fields of an aggregator context without an aggregator, that
+ * select the DRM node the aggregator gets created on */
+#define GST_MFX_DEVICE_CONTEXT_FIELD_NAME "device"
+#define GST_MFX_DEVICE_SELECTION_CONTEXT_FIELD_NAME "device-selection"
+/* Optional field of the same context, with the number of idle sessions
+ * the new aggregator keeps initialized */
+#define GST_MFX_SESSION_POOL_SIZE_CONTEXT_FIELD_NAME "session-pool-size"
+
 void
 gst_mfx_video_context_set_aggregator(GstContext * context,
     GstMfxTaskAggregator * aggregator);
@@ -41,6 +49,14 @@ gboolean
 gst_mfx_video_context_get_aggregator(GstContext * context,
     GstMfxTaskAggregator ** aggregator_ptr);
 
+gboolean
+gst_mfx_video_context_get_device(GstContext * context,
+    gchar ** device_path_ptr, GstMfxDeviceSelection * selection_ptr);
+
+gboolean
+gst_mfx_video_context_get_session_pool_size(GstContext * context,
+    guint * size_ptr);
+
 gboolean
 gst_mfx_video_context_prepare(GstElement * element,
     GstMfxTaskAggregator ** aggregator_ptr);
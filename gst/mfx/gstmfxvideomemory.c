@@ -28,40 +28,43 @@ GST_DEBUG_CATEGORY_STATIC (gst_debug_mfxvideomemory);
 static gboolean
 copy_image (GstMfxVideoMemory * mem)
 {
-  guint i, j, src_stride, dest_stride, height, offset, num_planes, plane_size;
-  guint8 *src_plane = NULL;
+  GstMfxCopyPlane planes[GST_VIDEO_MAX_PLANES];
+  GstMfxCopyFlags flags = GST_MFX_COPY_FLAG_NONE;
+  guint i, src_stride, dest_stride, num_planes;
+
+  /* The copy buffer is kept across maps, its size never changes. Only
+   * the visible part of each row is copied, so the padding up to the
+   * stride is cleared once here rather than leaking heap contents */
+  if (!mem->copy_data) {
+    mem->copy_data = g_try_malloc0 (GST_VIDEO_INFO_SIZE (mem->image_info));
+    if (!mem->copy_data)
+      return FALSE;
+  }
+  mem->data = mem->copy_data;
 
-  guint data_size = GST_VIDEO_INFO_SIZE (mem->image_info);
-  mem->data = g_slice_alloc (data_size);
-  if (!mem->data)
-    return FALSE;
+  /* Mapped video memory is uncached, read it with streaming loads */
+  if (gst_mfx_surface_has_video_memory (mem->surface))
+    flags |= GST_MFX_COPY_FLAG_UNCACHED_SRC;
 
   num_planes = GST_VIDEO_INFO_N_PLANES (mem->image_info);
 
   for (i = 0; i < num_planes; i++) {
-    src_plane = gst_mfx_surface_get_plane (mem->surface, i);
     src_stride = gst_mfx_surface_get_pitch (mem->surface, i);
-
     dest_stride = GST_VIDEO_INFO_PLANE_STRIDE (mem->image_info, i);
-    offset = GST_VIDEO_INFO_PLANE_OFFSET (mem->image_info, i);
-
-    if (i != num_planes - 1)
-      plane_size =
-          GST_VIDEO_INFO_PLANE_OFFSET (mem->image_info, i + 1) - offset;
-    else
-      plane_size = data_size - offset;
-
-    if (src_stride != dest_stride) {
-      height = plane_size / dest_stride;
-      for (j = 0; j < height; j++) {
-        memcpy (mem->data + offset, src_plane, dest_stride);
-        src_plane += src_stride;
-        offset += dest_stride;
-      }
-    } else
-      memcpy (mem->data + offset, src_plane, plane_size);
+
+    planes[i].src = gst_mfx_surface_get_plane (mem->surface, i);
+    planes[i].src_stride = src_stride;
+    planes[i].dst =
+        mem->data + GST_VIDEO_INFO_PLANE_OFFSET (mem->image_info, i);
+    planes[i].dst_stride = dest_stride;
+    planes[i].row_bytes =
+        MIN (gst_mfx_copy_get_plane_row_bytes (mem->image_info, i),
+        MIN (src_stride, dest_stride));
+    planes[i].rows = gst_mfx_copy_get_plane_rows (mem->image_info, i);
   }
 
+  gst_mfx_copy_planes (planes, num_planes, flags);
+
   mem->new_copy = TRUE;
 
   return TRUE;
@@ -211,6 +214,7 @@ gst_mfx_video_memory_new (GstAllocator * base_allocator, GstMfxVideoMeta * meta)
   mem->meta = meta ? gst_mfx_video_meta_ref (meta) : NULL;
   mem->map_type = 0;
   mem->new_copy = FALSE;
+  mem->copy_data = NULL;
 
   return GST_MEMORY_CAST (mem);
 }
@@ -220,6 +224,7 @@ gst_mfx_video_memory_free (GstMfxVideoMemory * mem)
 {
   gst_mfx_surface_replace (&mem->surface, NULL);
   gst_mfx_video_meta_replace (&mem->meta, NULL);
+  g_free (mem->copy_data);
   gst_object_unref (GST_MEMORY_CAST (mem)->allocator);
   g_slice_free (GstMfxVideoMemory, mem);
 }
@@ -304,8 +309,6 @@ gst_mfx_video_memory_unmap (GstMfxVideoMemory * mem)
       gst_mfx_surface_replace (&mem->surface, NULL);
       break;
     case GST_MFX_SYSTEM_MEMORY_MAP_TYPE_LINEAR:
-      if (mem->data && mem->new_copy)
-        g_slice_free1(GST_VIDEO_INFO_SIZE(mem->image_info), mem->data);
       gst_mfx_surface_unmap(mem->surface);
       mem->data = NULL;
       break;
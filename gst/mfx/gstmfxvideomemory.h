@@ -30,6 +30,7 @@
 
 #include "gstmfxvideometa.h"
 
+#include <gst-libs/mfx/gstmfxcopy.h>
 #include <gst-libs/mfx/gstmfxdisplay.h>
 #include <gst-libs/mfx/gstmfxtaskaggregator.h>
 #include <gst-libs/mfx/gstmfxsurface.h>
@@ -98,6 +99,7 @@ struct _GstMfxVideoMemory
   guint                map_type;
   guint8              *data;
   gboolean             new_copy;
+  guint8              *copy_data;
 };
 
 GstMemory *
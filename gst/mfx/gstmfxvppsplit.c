@@ -0,0 +1,766 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:element-mfxvppsplit
+ *
+ * Scales and converts every input frame into one rendition per requested
+ * src pad, for instance to feed the encoders of an adaptive bitrate
+ * ladder from a single decoder. The size and format of each rendition
+ * are negotiated with the downstream caps and default to the input ones.
+ *
+ * All renditions read the same input surfaces, so the input is neither
+ * copied nor processed more than once. Encoders linked directly to the
+ * src pads share the VPP task of their rendition, and the decoder, VPP
+ * and encoders then run as a fused transcode. Queues should therefore be
+ * placed after the encoders rather than between them and this element.
+ *
+ * |[
+ * gst-launch-1.0 filesrc location=in.mp4 ! qtdemux ! h264parse ! mfxdecode
+ *     ! mfxvppsplit name=split
+ *     split.src_0 ! video/x-raw(memory:MFXSurface),width=1280,height=720
+ *         ! mfxh264enc bitrate=3000 ! queue ! h264parse ! mp4mux ! filesink location=720p.mp4
+ *     split.src_1 ! video/x-raw(memory:MFXSurface),width=640,height=360
+ *         ! mfxh264enc bitrate=800 ! queue ! h264parse ! mp4mux ! filesink location=360p.mp4
+ * ]|
+ */
+
+#include "gst-libs/mfx/sysdeps.h"
+#include <gst/video/video.h>
+
+#include "gstmfxvppsplit.h"
+#include "gstmfxpluginutil.h"
+#include "gstmfxvideobufferpool.h"
+#include "gstmfxvideomemory.h"
+
+#define GST_PLUGIN_NAME "mfxvppsplit"
+#define GST_PLUGIN_DESC "A multi-output video scaler and converter"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_mfxvppsplit);
+#define GST_CAT_DEFAULT gst_debug_mfxvppsplit
+
+/* Default templates */
+static const char gst_mfxvppsplit_sink_caps_str[] =
+    GST_MFX_MAKE_SURFACE_CAPS "; "
+    GST_VIDEO_CAPS_MAKE (GST_MFX_SUPPORTED_INPUT_FORMATS);
+
+static const char gst_mfxvppsplit_src_caps_str[] = GST_MFX_MAKE_SURFACE_CAPS;
+
+static GstStaticPadTemplate gst_mfxvppsplit_sink_factory =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (gst_mfxvppsplit_sink_caps_str));
+
+static GstStaticPadTemplate gst_mfxvppsplit_src_factory =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (gst_mfxvppsplit_src_caps_str));
+
+/* ------------------------------------------------------------------------ */
+/* --- Rendition pads                                                   --- */
+/* ------------------------------------------------------------------------ */
+
+#define GST_TYPE_MFXVPPSPLIT_PAD \
+  (gst_mfxvppsplit_pad_get_type ())
+#define GST_MFXVPPSPLIT_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_MFXVPPSPLIT_PAD, \
+  GstMfxVppSplitPad))
+
+typedef struct _GstMfxVppSplitPad GstMfxVppSplitPad;
+typedef struct _GstMfxVppSplitPadClass GstMfxVppSplitPadClass;
+
+struct _GstMfxVppSplitPad
+{
+  GstPad parent_instance;
+
+  GstVideoInfo info;
+  GstBufferPool *buffer_pool;
+  /* Output of the multi-output filter, or -1 until negotiated */
+  gint output_index;
+};
+
+struct _GstMfxVppSplitPadClass
+{
+  GstPadClass parent_class;
+};
+
+GType gst_mfxvppsplit_pad_get_type (void);
+
+G_DEFINE_TYPE (GstMfxVppSplitPad, gst_mfxvppsplit_pad, GST_TYPE_PAD);
+
+static void
+gst_mfxvppsplit_pad_reset (GstMfxVppSplitPad * pad)
+{
+  if (pad->buffer_pool) {
+    gst_buffer_pool_set_active (pad->buffer_pool, FALSE);
+    g_clear_object (&pad->buffer_pool);
+  }
+  gst_video_info_init (&pad->info);
+  pad->output_index = -1;
+}
+
+static void
+gst_mfxvppsplit_pad_finalize (GObject * object)
+{
+  gst_mfxvppsplit_pad_reset (GST_MFXVPPSPLIT_PAD (object));
+  G_OBJECT_CLASS (gst_mfxvppsplit_pad_parent_class)->finalize (object);
+}
+
+static void
+gst_mfxvppsplit_pad_class_init (GstMfxVppSplitPadClass * klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = gst_mfxvppsplit_pad_finalize;
+}
+
+static void
+gst_mfxvppsplit_pad_init (GstMfxVppSplitPad * pad)
+{
+  gst_video_info_init (&pad->info);
+  pad->output_index = -1;
+}
+
+/* ------------------------------------------------------------------------ */
+/* --- Element                                                          --- */
+/* ------------------------------------------------------------------------ */
+
+G_DEFINE_TYPE_WITH_CODE (GstMfxVppSplit,
+    gst_mfxvppsplit,
+    GST_TYPE_ELEMENT,
+    GST_MFX_PLUGIN_BASE_INIT_INTERFACES);
+
+static GList *
+get_srcpads (GstMfxVppSplit * split)
+{
+  GList *pads;
+
+  GST_OBJECT_LOCK (split);
+  pads = g_list_copy_deep (split->srcpads, (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (split);
+
+  return pads;
+}
+
+static void
+gst_mfxvppsplit_destroy (GstMfxVppSplit * split)
+{
+  GList *l;
+
+  GST_OBJECT_LOCK (split);
+  for (l = split->srcpads; l; l = l->next)
+    gst_mfxvppsplit_pad_reset (l->data);
+  GST_OBJECT_UNLOCK (split);
+
+  gst_mfx_multi_filter_replace (&split->filter, NULL);
+}
+
+static gboolean
+gst_mfxvppsplit_ensure_filter (GstMfxVppSplit * split)
+{
+  GstMfxPluginBase *const plugin = GST_MFX_PLUGIN_BASE (split);
+
+  if (split->filter)
+    return TRUE;
+
+  if (!plugin->sinkpad_caps_is_raw && !plugin->sinkpad_has_dmabuf) {
+    /* Once caps were pushed, the current task is the one of a rendition,
+     * so the upstream task can only be looked up at first negotiation */
+    if (!split->upstream_task)
+      split->upstream_task =
+          gst_mfx_task_aggregator_get_current_task (plugin->aggregator);
+    if (split->upstream_task)
+      plugin->sinkpad_caps_is_raw =
+          !gst_mfx_task_has_video_memory (split->upstream_task);
+  }
+
+  split->filter = gst_mfx_multi_filter_new (plugin->aggregator,
+      split->upstream_task, &split->sinkpad_info,
+      plugin->sinkpad_caps_is_raw);
+  return split->filter != NULL;
+}
+
+static gboolean
+ensure_pad_buffer_pool (GstMfxVppSplit * split, GstMfxVppSplitPad * pad,
+    GstCaps * caps)
+{
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  pool = gst_mfx_video_buffer_pool_new (GST_MFX_PLUGIN_BASE_AGGREGATOR (split),
+      FALSE);
+  if (!pool)
+    goto error_create_pool;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps,
+      GST_VIDEO_INFO_SIZE (&pad->info), 0, 0);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_MFX_VIDEO_META);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  if (!gst_buffer_pool_set_config (pool, config))
+    goto error_pool_config;
+  if (!gst_buffer_pool_set_active (pool, TRUE))
+    goto error_pool_config;
+
+  pad->buffer_pool = pool;
+  return TRUE;
+
+  /* ERRORS */
+error_create_pool:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create buffer pool");
+    return FALSE;
+  }
+error_pool_config:
+  {
+    GST_ERROR_OBJECT (pad, "failed to configure buffer pool");
+    gst_object_unref (pool);
+    return FALSE;
+  }
+}
+
+/* Picks the size and format of a rendition from the downstream caps and
+ * adds the matching output to the filter */
+static gboolean
+configure_pad (GstMfxVppSplit * split, GstMfxVppSplitPad * pad,
+    GstCaps ** caps_ptr)
+{
+  GstCaps *templ_caps, *peer_caps, *out_caps;
+  GstStructure *structure;
+  GstVideoInfo peer_info;
+
+  templ_caps = gst_pad_get_pad_template_caps (GST_PAD (pad));
+  peer_caps = gst_pad_peer_query_caps (GST_PAD (pad), templ_caps);
+  gst_caps_unref (templ_caps);
+
+  if (gst_caps_is_empty (peer_caps))
+    goto error_no_caps;
+
+  /* Unconstrained renditions keep the input size */
+  peer_caps = gst_caps_truncate (peer_caps);
+  structure = gst_caps_get_structure (peer_caps, 0);
+  gst_structure_fixate_field_nearest_int (structure, "width",
+      GST_VIDEO_INFO_WIDTH (&split->sinkpad_info));
+  gst_structure_fixate_field_nearest_int (structure, "height",
+      GST_VIDEO_INFO_HEIGHT (&split->sinkpad_info));
+  gst_structure_fixate_field_string (structure, "format", "NV12");
+  peer_caps = gst_caps_fixate (peer_caps);
+
+  if (!gst_video_info_from_caps (&peer_info, peer_caps))
+    goto error_no_caps;
+  gst_caps_unref (peer_caps);
+
+  pad->info = split->sinkpad_info;
+  gst_video_info_change_format (&pad->info,
+      GST_VIDEO_INFO_FORMAT (&peer_info), GST_VIDEO_INFO_WIDTH (&peer_info),
+      GST_VIDEO_INFO_HEIGHT (&peer_info));
+
+  pad->output_index = gst_mfx_multi_filter_add_output (split->filter,
+      GST_VIDEO_INFO_FORMAT (&pad->info), GST_VIDEO_INFO_WIDTH (&pad->info),
+      GST_VIDEO_INFO_HEIGHT (&pad->info));
+  if (pad->output_index < 0)
+    return FALSE;
+
+  out_caps = gst_video_info_to_caps (&pad->info);
+  if (!out_caps)
+    return FALSE;
+  gst_caps_set_features (out_caps, 0,
+      gst_caps_features_new (GST_CAPS_FEATURE_MEMORY_MFX_SURFACE, NULL));
+
+  if (!ensure_pad_buffer_pool (split, pad, out_caps)) {
+    gst_caps_unref (out_caps);
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (pad, "rendition %d is %dx%d %s", pad->output_index,
+      GST_VIDEO_INFO_WIDTH (&pad->info), GST_VIDEO_INFO_HEIGHT (&pad->info),
+      gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&pad->info)));
+
+  *caps_ptr = out_caps;
+  return TRUE;
+
+  /* ERRORS */
+error_no_caps:
+  {
+    GST_ERROR_OBJECT (pad, "failed to negotiate caps with downstream");
+    gst_caps_unref (peer_caps);
+    return FALSE;
+  }
+}
+
+static gboolean
+push_pad_caps (GstMfxVppSplit * split, GstMfxVppSplitPad * pad,
+    GstCaps * caps)
+{
+  GstMfxTaskAggregator *const aggregator =
+      GST_MFX_PLUGIN_BASE_AGGREGATOR (split);
+  GstMfxTask *task;
+
+  /* Downstream MFX elements look up the task they may share when they
+   * receive the caps, so make it the one of this rendition */
+  task = gst_mfx_multi_filter_get_output_task (split->filter,
+      pad->output_index);
+  if (task) {
+    gst_mfx_task_aggregator_set_current_task (aggregator, task);
+    gst_mfx_task_unref (task);
+  }
+
+  if (!gst_pad_push_event (GST_PAD (pad), gst_event_new_caps (caps))
+      && gst_pad_is_linked (GST_PAD (pad))) {
+    GST_ERROR_OBJECT (pad, "downstream refused caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+gst_mfxvppsplit_set_caps (GstMfxVppSplit * split, GstCaps * caps)
+{
+  GstMfxPluginBase *const plugin = GST_MFX_PLUGIN_BASE (split);
+  GList *l, *pads, *pad_caps = NULL;
+  GstCaps *out_caps;
+  gboolean success = FALSE;
+
+  gst_mfxvppsplit_destroy (split);
+
+  if (!gst_video_info_from_caps (&split->sinkpad_info, caps))
+    return FALSE;
+
+  if (!gst_mfx_plugin_base_set_caps (plugin, caps, NULL))
+    return FALSE;
+
+  pads = get_srcpads (split);
+  if (!pads) {
+    GST_ERROR_OBJECT (split, "no src pad was requested");
+    return FALSE;
+  }
+
+  if (!gst_mfxvppsplit_ensure_filter (split))
+    goto done;
+
+  for (l = pads; l; l = l->next) {
+    if (!configure_pad (split, l->data, &out_caps))
+      goto done;
+    pad_caps = g_list_append (pad_caps, out_caps);
+  }
+
+  /* All outputs must exist before the filter is prepared, and prepared
+   * before an encoder downstream shares one of its tasks */
+  if (!gst_mfx_multi_filter_prepare (split->filter))
+    goto done;
+
+  for (l = pads; l; l = l->next)
+    if (!push_pad_caps (split, l->data,
+            g_list_nth_data (pad_caps, g_list_position (pads, l))))
+      goto done;
+
+  success = TRUE;
+
+done:
+  g_list_free_full (pad_caps, (GDestroyNotify) gst_caps_unref);
+  g_list_free_full (pads, (GDestroyNotify) gst_object_unref);
+  if (!success)
+    gst_mfxvppsplit_destroy (split);
+  return success;
+}
+
+static GstFlowReturn
+push_rendition (GstMfxVppSplit * split, GstMfxVppSplitPad * pad,
+    GstMfxSurface * surface, GstBuffer * inbuf)
+{
+  GstMfxVideoMeta *meta;
+  GstMfxRectangle *crop_rect;
+  GstBuffer *outbuf = NULL;
+  GstFlowReturn ret;
+
+  ret = gst_buffer_pool_acquire_buffer (pad->buffer_pool, &outbuf, NULL);
+  if (GST_FLOW_OK != ret || !outbuf)
+    goto error_create_buffer;
+
+  meta = gst_buffer_get_mfx_video_meta (outbuf);
+  if (!meta)
+    goto error_create_meta;
+
+  gst_mfx_video_meta_set_surface (meta, surface);
+  crop_rect = gst_mfx_surface_get_crop_rect (surface);
+  if (crop_rect) {
+    GstVideoCropMeta *const crop_meta =
+        gst_buffer_add_video_crop_meta (outbuf);
+    if (crop_meta) {
+      crop_meta->x = crop_rect->x;
+      crop_meta->y = crop_rect->y;
+      crop_meta->width = crop_rect->width;
+      crop_meta->height = crop_rect->height;
+    }
+  }
+
+  gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+  return gst_pad_push (GST_PAD (pad), outbuf);
+
+  /* ERRORS */
+error_create_buffer:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create output buffer");
+    return GST_FLOW_ERROR;
+  }
+error_create_meta:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create new output buffer meta");
+    gst_buffer_unref (outbuf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+static GstFlowReturn
+gst_mfxvppsplit_chain (GstPad * sinkpad, GstObject * parent,
+    GstBuffer * inbuf)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (parent);
+  GstMfxSurface *out_surfaces[GST_MFX_MULTI_FILTER_MAX_OUTPUTS];
+  GstMfxVppSplitPad *pad;
+  GstMfxVideoMeta *meta;
+  GstMfxSurface *surface = NULL;
+  GstMfxFilterStatus status;
+  GstFlowReturn ret;
+  GstBuffer *buf = NULL;
+  GList *l, *pads;
+
+  if (!split->filter) {
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  ret = gst_mfx_plugin_base_get_input_buffer (GST_MFX_PLUGIN_BASE (split),
+      inbuf, &buf);
+  if (GST_FLOW_OK != ret)
+    goto done;
+
+  meta = gst_buffer_get_mfx_video_meta (buf);
+  if (meta)
+    surface = gst_mfx_video_meta_get_surface (meta);
+  if (!surface)
+    goto error_no_surface;
+
+  status = gst_mfx_multi_filter_process (split->filter, surface,
+      out_surfaces);
+  if (GST_MFX_FILTER_STATUS_SUCCESS != status)
+    goto error_process_vpp;
+
+  pads = get_srcpads (split);
+  for (l = pads; l; l = l->next) {
+    pad = l->data;
+    if (pad->output_index < 0)
+      continue;
+
+    ret = push_rendition (split, pad, out_surfaces[pad->output_index], inbuf);
+
+    /* Unlinked or finished renditions do not hold back the others */
+    GST_OBJECT_LOCK (split);
+    ret = gst_flow_combiner_update_pad_flow (split->flow_combiner,
+        GST_PAD (pad), ret);
+    GST_OBJECT_UNLOCK (split);
+    if (GST_FLOW_OK != ret)
+      break;
+  }
+  g_list_free_full (pads, (GDestroyNotify) gst_object_unref);
+
+  gst_mfx_surface_dequeue (surface);
+
+done:
+  if (buf)
+    gst_buffer_unref (buf);
+  gst_buffer_unref (inbuf);
+  return ret;
+
+  /* ERRORS */
+error_no_surface:
+  {
+    GST_ERROR_OBJECT (split, "failed to get surface from input buffer");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_process_vpp:
+  {
+    GST_ERROR_OBJECT (split, "failed to apply VPP (error %d)", status);
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+}
+
+static gboolean
+gst_mfxvppsplit_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (parent);
+  GstCaps *caps;
+  gboolean ret;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+      gst_event_parse_caps (event, &caps);
+      ret = gst_mfxvppsplit_set_caps (split, caps);
+      gst_event_unref (event);
+      return ret;
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (split);
+      gst_flow_combiner_reset (split->flow_combiner);
+      GST_OBJECT_UNLOCK (split);
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_mfxvppsplit_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (parent);
+  GstCaps *caps, *filter;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CONTEXT:
+      if (gst_mfx_handle_context_query (query,
+              GST_MFX_PLUGIN_BASE_AGGREGATOR (split)))
+        return TRUE;
+      break;
+    case GST_QUERY_CAPS:
+      /* Renditions are negotiated independently, so the input caps do
+       * not depend on downstream */
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *const tmp =
+            gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = tmp;
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    case GST_QUERY_ALLOCATION:
+      return gst_mfx_plugin_base_propose_allocation (GST_MFX_PLUGIN_BASE
+          (split), query);
+    default:
+      break;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+gst_mfxvppsplit_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (parent);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_CONTEXT) {
+    if (gst_mfx_handle_context_query (query,
+            GST_MFX_PLUGIN_BASE_AGGREGATOR (split))) {
+      GST_DEBUG_OBJECT (split, "sharing tasks %p",
+          GST_MFX_PLUGIN_BASE_AGGREGATOR (split));
+      return TRUE;
+    }
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+copy_sticky_event (GstPad * pad, GstEvent ** event, gpointer user_data)
+{
+  /* Caps are pushed per rendition once negotiated */
+  if (GST_EVENT_TYPE (*event) != GST_EVENT_CAPS)
+    gst_pad_store_sticky_event (GST_PAD (user_data), *event);
+  return TRUE;
+}
+
+static GstPad *
+gst_mfxvppsplit_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (element);
+  GstPad *pad;
+  gchar *pad_name;
+  guint id;
+
+  GST_OBJECT_LOCK (split);
+  if (split->filter) {
+    GST_OBJECT_UNLOCK (split);
+    GST_ERROR_OBJECT (split, "src pads must be requested before the caps "
+        "are negotiated");
+    return NULL;
+  }
+  if (g_list_length (split->srcpads) >= GST_MFX_MULTI_FILTER_MAX_OUTPUTS) {
+    GST_OBJECT_UNLOCK (split);
+    GST_ERROR_OBJECT (split, "at most %d src pads are supported",
+        GST_MFX_MULTI_FILTER_MAX_OUTPUTS);
+    return NULL;
+  }
+
+  if (name && sscanf (name, "src_%u", &id) == 1) {
+    pad_name = g_strdup (name);
+    split->next_pad_id = MAX (split->next_pad_id, id + 1);
+  }
+  else {
+    pad_name = g_strdup_printf ("src_%u", split->next_pad_id++);
+  }
+  GST_OBJECT_UNLOCK (split);
+
+  pad = g_object_new (GST_TYPE_MFXVPPSPLIT_PAD, "name", pad_name,
+      "direction", GST_PAD_SRC, "template", templ, NULL);
+  g_free (pad_name);
+
+  gst_pad_set_query_function (pad,
+      GST_DEBUG_FUNCPTR (gst_mfxvppsplit_src_query));
+
+  GST_OBJECT_LOCK (split);
+  split->srcpads = g_list_append (split->srcpads, gst_object_ref (pad));
+  gst_flow_combiner_add_pad (split->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (split);
+
+  gst_element_add_pad (element, pad);
+  gst_pad_sticky_events_foreach (GST_MFX_PLUGIN_BASE_SINK_PAD (split),
+      copy_sticky_event, pad);
+
+  return pad;
+}
+
+static void
+gst_mfxvppsplit_release_pad (GstElement * element, GstPad * pad)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (element);
+  GList *l;
+
+  GST_OBJECT_LOCK (split);
+  l = g_list_find (split->srcpads, pad);
+  if (l) {
+    split->srcpads = g_list_delete_link (split->srcpads, l);
+    gst_flow_combiner_remove_pad (split->flow_combiner, pad);
+  }
+  GST_OBJECT_UNLOCK (split);
+
+  if (!l)
+    return;
+
+  gst_object_unref (pad);
+  gst_element_remove_pad (element, pad);
+}
+
+static GstStateChangeReturn
+gst_mfxvppsplit_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (gst_mfxvppsplit_parent_class)->change_state
+      (element, transition);
+  if (GST_STATE_CHANGE_FAILURE == ret)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_mfxvppsplit_destroy (split);
+      GST_OBJECT_LOCK (split);
+      gst_flow_combiner_reset (split->flow_combiner);
+      GST_OBJECT_UNLOCK (split);
+      gst_video_info_init (&split->sinkpad_info);
+      gst_mfx_task_replace (&split->upstream_task, NULL);
+      gst_mfx_plugin_base_close (GST_MFX_PLUGIN_BASE (split));
+      break;
+    default:
+      break;
+  }
+  return ret;
+}
+
+static void
+gst_mfxvppsplit_finalize (GObject * object)
+{
+  GstMfxVppSplit *const split = GST_MFXVPPSPLIT (object);
+
+  gst_mfxvppsplit_destroy (split);
+  gst_mfx_task_replace (&split->upstream_task, NULL);
+  g_list_free_full (split->srcpads, (GDestroyNotify) gst_object_unref);
+  split->srcpads = NULL;
+  gst_flow_combiner_free (split->flow_combiner);
+
+  gst_mfx_plugin_base_finalize (GST_MFX_PLUGIN_BASE (split));
+  G_OBJECT_CLASS (gst_mfxvppsplit_parent_class)->finalize (object);
+}
+
+static void
+gst_mfxvppsplit_class_init (GstMfxVppSplitClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+  GstPadTemplate *pad_template;
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_mfxvppsplit,
+      GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
+
+  gst_mfx_plugin_base_class_init (GST_MFX_PLUGIN_BASE_CLASS (klass));
+
+  object_class->finalize = gst_mfxvppsplit_finalize;
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_mfxvppsplit_request_new_pad);
+  element_class->release_pad = GST_DEBUG_FUNCPTR (gst_mfxvppsplit_release_pad);
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_mfxvppsplit_change_state);
+
+  gst_element_class_set_static_metadata (element_class,
+      "MFX multi-output video postprocessing",
+      "Filter/Converter/Video;Filter/Converter/Video/Scaler",
+      GST_PLUGIN_DESC, "Ishmael Sameen <ishmael.visayana.sameen@intel.com>");
+
+  /* sink pad */
+  pad_template = gst_static_pad_template_get (&gst_mfxvppsplit_sink_factory);
+  gst_element_class_add_pad_template (element_class, pad_template);
+
+  /* src pads */
+  pad_template = gst_static_pad_template_get (&gst_mfxvppsplit_src_factory);
+  gst_element_class_add_pad_template (element_class, pad_template);
+}
+
+static void
+gst_mfxvppsplit_init (GstMfxVppSplit * split)
+{
+  GstPad *sinkpad;
+
+  sinkpad =
+      gst_pad_new_from_static_template (&gst_mfxvppsplit_sink_factory, "sink");
+  gst_pad_set_chain_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_mfxvppsplit_chain));
+  gst_pad_set_event_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_mfxvppsplit_sink_event));
+  gst_pad_set_query_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_mfxvppsplit_sink_query));
+  gst_element_add_pad (GST_ELEMENT (split), sinkpad);
+
+  gst_mfx_plugin_base_init (GST_MFX_PLUGIN_BASE (split), GST_CAT_DEFAULT);
+
+  split->flow_combiner = gst_flow_combiner_new ();
+  gst_video_info_init (&split->sinkpad_info);
+}
@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2016 Intel Corporation
+ *    Author: Ishmael Visayana Sameen <ishmael.visayana.sameen@intel.com>
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_MFXVPPSPLIT_H
+#define GST_MFXVPPSPLIT_H
+
+#include "gstmfxpluginbase.h"
+
+#include <gst/base/gstflowcombiner.h>
+#include <gst-libs/mfx/gstmfxmultifilter.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_MFXVPPSPLIT \
+  (gst_mfxvppsplit_get_type ())
+#define GST_MFXVPPSPLIT(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_MFXVPPSPLIT, GstMfxVppSplit))
+#define GST_MFXVPPSPLIT_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), GST_TYPE_MFXVPPSPLIT, \
+  GstMfxVppSplitClass))
+#define GST_IS_MFXVPPSPLIT(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GST_TYPE_MFXVPPSPLIT))
+#define GST_IS_MFXVPPSPLIT_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_TYPE_MFXVPPSPLIT))
+#define GST_MFXVPPSPLIT_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_MFXVPPSPLIT, \
+  GstMfxVppSplitClass))
+
+typedef struct _GstMfxVppSplit GstMfxVppSplit;
+typedef struct _GstMfxVppSplitClass GstMfxVppSplitClass;
+
+struct _GstMfxVppSplit
+{
+  /*< private >*/
+  GstMfxPluginBase        parent_instance;
+
+  GstMfxMultiFilter      *filter;
+  GstVideoInfo            sinkpad_info;
+  /* Task producing the input surfaces, captured at first negotiation */
+  GstMfxTask             *upstream_task;
+
+  /* Request src pads, protected by the object lock */
+  GList                  *srcpads;
+  guint                   next_pad_id;
+  GstFlowCombiner        *flow_combiner;
+};
+
+struct _GstMfxVppSplitClass
+{
+  /*< private >*/
+  GstMfxPluginBaseClass parent_class;
+};
+
+GType
+gst_mfxvppsplit_get_type (void);
+
+G_END_DECLS
+
+#endif /* GST_MFXVPPSPLIT_H */
@@ -76,6 +76,7 @@
  */
 
 #include "gstvc1parse.h"
+#include "gstmfxutils_bitstream.h"
 
 #include <gst/base/base.h>
 #include <gst/pbutils/pbutils.h>
@@ -145,6 +146,9 @@ header_format_to_string (VC1HeaderFormat header_format)
   return header_formats[header_format].str;
 }
 
+/* Start code and suffix of a frame BDU */
+static const guint8 frame_start_code[4] = { 0x00, 0x00, 0x01, 0x0d };
+
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -224,6 +228,11 @@ gst_mfx_vc1_parse_init (GstMfxVC1Parse * vc1parse)
   gst_base_parse_set_syncable (GST_BASE_PARSE (vc1parse), TRUE);
   gst_base_parse_set_has_timing_info (GST_BASE_PARSE (vc1parse), FALSE);
 
+  vc1parse->frame_start_code =
+      gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      (gpointer) frame_start_code, sizeof (frame_start_code), 0,
+      sizeof (frame_start_code), NULL, NULL);
+
   gst_vc1_parse_reset (vc1parse);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (vc1parse));
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_BASE_PARSE_SINK_PAD (vc1parse));
@@ -232,6 +241,10 @@ gst_mfx_vc1_parse_init (GstMfxVC1Parse * vc1parse)
 static void
 gst_vc1_parse_finalize (GObject * object)
 {
+  GstMfxVC1Parse *vc1parse = GST_VC1_PARSE (object);
+
+  gst_memory_unref (vc1parse->frame_start_code);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -261,6 +274,7 @@ gst_vc1_parse_reset (GstMfxVC1Parse * vc1parse)
   gst_buffer_replace (&vc1parse->entrypoint_buffer, NULL);
 
   vc1parse->codec_data_sent = FALSE;
+  vc1parse->bdu_scan_offset = 0;
 }
 
 static gboolean
@@ -784,45 +798,42 @@ static gboolean
 gst_vc1_parse_handle_bdus (GstMfxVC1Parse * vc1parse, GstBuffer * buffer,
     guint offset, guint size)
 {
-  GstVC1BDU bdu;
-  GstVC1ParserResult pres;
-  guint8 *data;
   GstMapInfo minfo;
+  const guint8 *data;
+  gsize pos, next, end;
+  gboolean ret = TRUE;
 
   gst_buffer_map (buffer, &minfo, GST_MAP_READ);
 
-  data = minfo.data + offset;
+  data = minfo.data;
+  end = offset + size;
 
-  do {
-    memset (&bdu, 0, sizeof (bdu));
-    pres = gst_vc1_identify_next_bdu (data, size, &bdu);
-    if (pres == GST_VC1_PARSER_OK || pres == GST_VC1_PARSER_NO_BDU_END) {
-      if (pres == GST_VC1_PARSER_NO_BDU_END) {
-        pres = GST_VC1_PARSER_OK;
-        bdu.size = size - bdu.offset;
-      }
+  /* Each BDU runs from the byte following its start code suffix up to the
+   * next start code */
+  pos = gst_mfx_utils_find_start_code (data, end, offset);
+  if (pos + 4 > end) {
+    GST_DEBUG_OBJECT (vc1parse, "Failed to parse BDUs");
+    ret = FALSE;
+  }
 
-      data += bdu.offset;
-      size -= bdu.offset;
+  for (; pos + 4 <= end; pos = next) {
+    /* Sequence headers and entry points precede the picture they apply
+     * to, and nothing after the frame BDU needs parsing. This keeps the
+     * scan of a non-key frame down to its first few bytes */
+    if (data[pos + 3] == GST_VC1_FRAME)
+      break;
 
-      if (!gst_vc1_parse_handle_bdu (vc1parse, bdu.type, buffer,
-              data - minfo.data, bdu.size)) {
-        gst_buffer_unmap (buffer, &minfo);
-        return FALSE;
-      }
+    next = gst_mfx_utils_find_start_code (data, end, pos + 4);
 
-      data += bdu.size;
-      size -= bdu.size;
+    if (!gst_vc1_parse_handle_bdu (vc1parse, data[pos + 3], buffer,
+            pos + 4, next - pos - 4)) {
+      ret = FALSE;
+      break;
     }
-  } while (pres == GST_VC1_PARSER_OK && size > 0);
+  }
 
   gst_buffer_unmap (buffer, &minfo);
-
-  if (pres != GST_VC1_PARSER_OK) {
-    GST_DEBUG_OBJECT (vc1parse, "Failed to parse BDUs");
-    return FALSE;
-  }
-  return TRUE;
+  return ret;
 }
 
 static GstFlowReturn
@@ -881,51 +892,51 @@ gst_vc1_parse_handle_frame (GstBaseParse * parse, GstBaseParseFrame * frame,
               VC1_STREAM_FORMAT_SEQUENCE_LAYER_BDU
               || vc1parse->input_stream_format ==
               VC1_STREAM_FORMAT_SEQUENCE_LAYER_BDU_FRAME))) {
-    GstVC1ParserResult pres;
-    GstVC1BDU bdu;
+    gsize sc, next;
 
     g_assert (size >= 4);
-    memset (&bdu, 0, sizeof (bdu));
     GST_DEBUG_OBJECT (vc1parse,
         "Handling buffer of size %" G_GSIZE_FORMAT " at offset %"
         G_GUINT64_FORMAT, size, GST_BUFFER_OFFSET (buffer));
+
+    /* The BDU ends at the next start code. While waiting for more data,
+     * the part of the BDU already searched is not searched again */
+    if (frame->flags & GST_BASE_PARSE_FRAME_FLAG_NEW_FRAME)
+      vc1parse->bdu_scan_offset = 0;
+
     /* XXX: when a buffer contains multiple BDUs, does the first one start with
      * a startcode?
      */
-    pres = gst_vc1_identify_next_bdu (data, size, &bdu);
-    switch (pres) {
-      case GST_VC1_PARSER_OK:
+    sc = gst_mfx_utils_find_start_code (data, size, 0);
+    if (sc + 4 > size) {
+      GST_DEBUG_OBJECT (vc1parse, "Found no BDU startcode");
+      *skipsize = size - 3;
+    } else if (sc > 4) {
+      *skipsize = sc;
+    } else if (data[sc + 3] == GST_VC1_END_OF_SEQ) {
+      GST_DEBUG_OBJECT (vc1parse, "Have end of sequence");
+      framesize = sc + 4;
+    } else {
+      next = gst_mfx_utils_find_start_code (data, size,
+          MAX (sc + 4, vc1parse->bdu_scan_offset));
+      if (next < size) {
         GST_DEBUG_OBJECT (vc1parse, "Have complete BDU");
-        if (bdu.sc_offset > 4) {
-          *skipsize = bdu.sc_offset;
-        } else {
-          framesize = bdu.offset + bdu.size;
-        }
-        break;
-      case GST_VC1_PARSER_BROKEN_DATA:
-        GST_ERROR_OBJECT (vc1parse, "Broken data");
-        *skipsize = 1;
-        break;
-      case GST_VC1_PARSER_NO_BDU:
-        GST_DEBUG_OBJECT (vc1parse, "Found no BDU startcode");
-        *skipsize = size - 3;
-        break;
-      case GST_VC1_PARSER_NO_BDU_END:
+        /* The leading zero of a 4-byte start code belongs to the next BDU */
+        if (next > sc + 4 && !data[next - 1])
+          next--;
+        framesize = next;
+      } else {
         GST_DEBUG_OBJECT (vc1parse, "Found no BDU end");
         if (G_UNLIKELY (GST_BASE_PARSE_DRAINING (vc1parse))) {
           GST_DEBUG_OBJECT (vc1parse, "Draining - assuming complete frame");
           framesize = size;
         } else {
-          /* Need more data */
+          /* Need more data. The last two bytes may still begin a start
+           * code */
+          vc1parse->bdu_scan_offset = size - 2;
           *skipsize = 0;
         }
-        break;
-      case GST_VC1_PARSER_ERROR:
-        GST_ERROR_OBJECT (vc1parse, "Parsing error");
-        break;
-      default:
-        g_assert_not_reached ();
-        break;
+      }
     }
   } else if (vc1parse->input_stream_format == VC1_STREAM_FORMAT_ASF ||
       (vc1parse->seq_layer_buffer
@@ -1255,14 +1266,9 @@ static GstFlowReturn
 gst_vc1_parse_convert_asf_to_bdu (GstMfxVC1Parse * vc1parse,
     GstBaseParseFrame * frame)
 {
-  GstByteWriter bw;
   GstBuffer *buffer;
-  GstBuffer *tmp;
-  GstMemory *mem;
   guint8 sc_data[4];
   guint32 startcode;
-  gboolean ok;
-  GstFlowReturn ret = GST_FLOW_OK;
 
   buffer = frame->buffer;
 
@@ -1272,74 +1278,50 @@ gst_vc1_parse_convert_asf_to_bdu (GstMfxVC1Parse * vc1parse,
     startcode = GST_READ_UINT32_BE (sc_data);
     if (((startcode & 0xffffff00) == 0x00000100)) {
       /* Start code found */
-      goto done;
+      return GST_FLOW_OK;
     }
   }
 
   /* Yes, a frame could be smaller than 4 bytes and valid, for instance
    * black video. */
 
-  /* We will prepend 4 bytes to buffer */
-  gst_byte_writer_init_with_size (&bw, 4, TRUE);
-
-  /* Set start code and suffixe, we assume raw asf data is a frame */
-  ok = gst_byte_writer_put_uint24_be (&bw, 0x000001);
-  ok &= gst_byte_writer_put_uint8 (&bw, 0x0D);
-  tmp = gst_byte_writer_reset_and_get_buffer (&bw);
-
-  /* Prepend startcode buffer to frame buffer */
-  mem = gst_buffer_get_all_memory (tmp);
-  gst_buffer_prepend_memory (buffer, mem);
-  gst_buffer_unref (tmp);
-
-  if (G_UNLIKELY (!ok)) {
-    GST_ERROR_OBJECT (vc1parse, "convert asf to bdu failed");
-    ret = GST_FLOW_ERROR;
-  }
+  /* We assume raw asf data is a frame, so the frame start code is
+   * prepended. All frames share the same read-only memory for it */
+  gst_buffer_prepend_memory (buffer,
+      gst_memory_ref (vc1parse->frame_start_code));
 
-done:
-  return ret;
+  return GST_FLOW_OK;
 }
 
 static GstFlowReturn
 gst_vc1_parse_convert_to_frame_layer (GstMfxVC1Parse * vc1parse,
     GstBaseParseFrame * frame)
 {
-  GstByteWriter bw;
   GstBuffer *buffer;
-  GstBuffer *frame_layer;
-  gsize frame_layer_size;
   GstMemory *mem;
-  gboolean ok;
+  GstMapInfo minfo;
   gboolean keyframe;
 
   buffer = frame->buffer;
   keyframe = !(GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
 
-  /* We need 8 bytes for frame-layer header */
-  frame_layer_size = 8;
-
-  gst_byte_writer_init_with_size (&bw, frame_layer_size, TRUE);
+  /* We need 8 bytes for frame-layer header, which is prepended to the
+   * frame data without copying it */
+  mem = gst_allocator_alloc (NULL, 8, NULL);
+  if (!mem || !gst_memory_map (mem, &minfo, GST_MAP_WRITE)) {
+    GST_ERROR_OBJECT (vc1parse, "failed to convert to frame layer");
+    if (mem)
+      gst_memory_unref (mem);
+    return GST_FLOW_ERROR;
+  }
 
   /* frame-layer header shall be serialized in little-endian byte order */
-  ok = gst_byte_writer_put_uint24_le (&bw, gst_buffer_get_size (buffer));
+  GST_WRITE_UINT24_LE (minfo.data, gst_buffer_get_size (buffer));
+  GST_WRITE_UINT8 (minfo.data + 3, keyframe ? 0x80 : 0x00);
+  GST_WRITE_UINT32_LE (minfo.data + 4, GST_BUFFER_PTS (buffer));
+  gst_memory_unmap (mem, &minfo);
 
-  if (keyframe)
-    ok &= gst_byte_writer_put_uint8 (&bw, 0x80);        /* keyframe */
-  else
-    ok &= gst_byte_writer_put_uint8 (&bw, 0x00);
-
-  ok &= gst_byte_writer_put_uint32_le (&bw, GST_BUFFER_PTS (buffer));
-
-  frame_layer = gst_byte_writer_reset_and_get_buffer (&bw);
-  mem = gst_buffer_get_all_memory (frame_layer);
   gst_buffer_prepend_memory (buffer, mem);
-  gst_buffer_unref (frame_layer);
-
-  if (G_UNLIKELY (!ok)) {
-    GST_ERROR_OBJECT (vc1parse, "failed to convert to frame layer");
-    return GST_FLOW_ERROR;
-  }
 
   return GST_FLOW_OK;
 }
@@ -110,6 +110,13 @@ struct _GstVC1Parse
   /* TRUE if we have already sent the codec-data,
    * use for stream-format conversion */
   gboolean codec_data_sent;
+
+  /* Offset up to which the pending BDU was already searched for its end */
+  gsize bdu_scan_offset;
+
+  /* Read-only frame start code, prepended to every ASF frame converted
+   * to BDUs */
+  GstMemory *frame_start_code;
 };
 
 struct _GstVC1ParseClass